@@ -45,11 +45,11 @@ rmw_ret_t
 init_context_impl(rmw_context_t * context)
 {
   rmw_publisher_options_t publisher_options = rmw_get_default_publisher_options();
+  // Local publications are not ignored: the listener thread applies the messages received by
+  // the first context of a group to all of them, including the ones published by that context.
+  // Each context skips the messages of its own participant instead.
   rmw_subscription_options_t subscription_options = rmw_get_default_subscription_options();
 
-  // This is currently not implemented in fastrtps
-  subscription_options.ignore_local_publications = true;
-
   std::unique_ptr<rmw_dds_common::Context> common_context(
     new(std::nothrow) rmw_dds_common::Context());
   if (!common_context) {
@@ -165,12 +165,14 @@ init_context_impl(rmw_context_t * context)
     return ret;
   }
 
+  context->impl->graph_change_notifier.set_guard_condition(
+    eprosima_fastrtps_identifier, graph_guard_condition.get());
   common_context->graph_cache.set_on_change_callback(
-    [guard_condition = graph_guard_condition.get()]() {
-      rmw_fastrtps_shared_cpp::__rmw_trigger_guard_condition(
-        eprosima_fastrtps_identifier,
-        guard_condition);
+    [notifier = &context->impl->graph_change_notifier]() {
+      notifier->notify();
     });
+  participant_info->listener_->set_graph_change_notifier(
+    &context->impl->graph_change_notifier);
 
   common_context->graph_cache.add_participant(
     common_context->gid,
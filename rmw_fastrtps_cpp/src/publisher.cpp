@@ -38,8 +38,10 @@
 #include "rmw_fastrtps_shared_cpp/create_rmw_gid.hpp"
 #include "rmw_fastrtps_shared_cpp/custom_participant_info.hpp"
 #include "rmw_fastrtps_shared_cpp/custom_publisher_info.hpp"
+#include "rmw_fastrtps_shared_cpp/intra_participant_delivery.hpp"
 #include "rmw_fastrtps_shared_cpp/names.hpp"
 #include "rmw_fastrtps_shared_cpp/namespace_prefix.hpp"
+#include "rmw_fastrtps_shared_cpp/payload_pool.hpp"
 #include "rmw_fastrtps_shared_cpp/qos.hpp"
 #include "rmw_fastrtps_shared_cpp/rmw_common.hpp"
 #include "rmw_fastrtps_shared_cpp/utils.hpp"
@@ -173,6 +175,10 @@ rmw_fastrtps_cpp::create_publisher(
     });
 
   info->typesupport_identifier_ = type_support->typesupport_identifier;
+  info->serialize_once_ = participant_info->serialize_once;
+  if (participant_info->publisher_timing) {
+    info->statistics_.enable_timing();
+  }
   info->type_support_impl_ = callbacks;
 
   /////
@@ -184,6 +190,10 @@ rmw_fastrtps_cpp::create_publisher(
       return nullptr;
     }
 
+    if (participant_info->serialized_loans) {
+      tsupport->enable_serialized_loans();
+    }
+
     // Transfer ownership to fastdds_type
     fastdds_type.reset(tsupport);
   }
@@ -260,11 +270,17 @@ rmw_fastrtps_cpp::create_publisher(
     return nullptr;
   }
 
+  if (participant_info->publisher_payload_pool) {
+    info->payload_pool_ = rmw_fastrtps_shared_cpp::create_payload_pool(writer_qos);
+  }
+
   // Creates DataWriter
-  info->data_writer_ = publisher->create_datawriter(
+  info->data_writer_ = rmw_fastrtps_shared_cpp::create_datawriter(
+    publisher,
     topic.topic,
     writer_qos,
-    info->listener_);
+    info->listener_,
+    info->payload_pool_);
 
   if (!info->data_writer_) {
     RMW_SET_ERROR_MSG("create_publisher() could not create data writer");
@@ -296,7 +312,10 @@ rmw_fastrtps_cpp::create_publisher(
     });
 
   bool has_data_sharing = DataSharingKind::OFF != writer_qos.data_sharing().kind();
-  rmw_publisher->can_loan_messages = has_data_sharing && info->type_support_->is_plain();
+  auto type_support =
+    static_cast<const rmw_fastrtps_shared_cpp::TypeSupport *>(info->type_support_.get());
+  rmw_publisher->can_loan_messages = has_data_sharing && type_support->can_loan_ros_messages();
+  info->can_loan_serialized_messages_ = has_data_sharing && type_support->has_serialized_loans();
   rmw_publisher->implementation_identifier = eprosima_fastrtps_identifier;
   rmw_publisher->data = info;
 
@@ -309,6 +328,11 @@ rmw_fastrtps_cpp::create_publisher(
 
   rmw_publisher->options = *publisher_options;
 
+  if (participant_info->intra_participant_delivery) {
+    participant_info->intra_participant_delivery->add_publisher(
+      info, rmw_publisher->can_loan_messages);
+  }
+
   topic.should_be_deleted = false;
   cleanup_rmw_publisher.cancel();
   cleanup_datawriter.cancel();
@@ -49,6 +49,7 @@
 #include "rmw_fastrtps_shared_cpp/names.hpp"
 #include "rmw_fastrtps_shared_cpp/namespace_prefix.hpp"
 #include "rmw_fastrtps_shared_cpp/qos.hpp"
+#include "rmw_fastrtps_shared_cpp/discovery_batch.hpp"
 #include "rmw_fastrtps_shared_cpp/rmw_common.hpp"
 #include "rmw_fastrtps_shared_cpp/rmw_context_impl.hpp"
 #include "rmw_fastrtps_shared_cpp/utils.hpp"
@@ -444,11 +445,10 @@ rmw_create_service(
       common_context->gid,
       node->name,
       node->namespace_);
-    rmw_ret_t ret = rmw_fastrtps_shared_cpp::__rmw_publish(
+    rmw_ret_t ret = rmw_fastrtps_shared_cpp::publish_participant_entities_info(
       eprosima_fastrtps_identifier,
-      common_context->pub,
-      static_cast<void *>(&msg),
-      nullptr);
+      node->context,
+      msg);
     if (RMW_RET_OK != ret) {
       common_context->graph_cache.dissociate_writer(
         response_publisher_gid,
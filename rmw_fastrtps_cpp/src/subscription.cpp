@@ -39,6 +39,7 @@
 
 #include "rmw_fastrtps_shared_cpp/custom_participant_info.hpp"
 #include "rmw_fastrtps_shared_cpp/custom_subscriber_info.hpp"
+#include "rmw_fastrtps_shared_cpp/intra_participant_delivery.hpp"
 #include "rmw_fastrtps_shared_cpp/names.hpp"
 #include "rmw_fastrtps_shared_cpp/namespace_prefix.hpp"
 #include "rmw_fastrtps_shared_cpp/qos.hpp"
@@ -182,6 +183,10 @@ create_subscription(
       return nullptr;
     }
 
+    if (participant_info->serialized_loans) {
+      tsupport->enable_serialized_loans();
+    }
+
     // Transfer ownership to fastdds_type
     fastdds_type.reset(tsupport);
   }
@@ -292,6 +297,7 @@ create_subscription(
     RMW_SET_ERROR_MSG("create_subscription() could not create data reader");
     return nullptr;
   }
+  info->listener_->set_history_bounds(info->data_reader_->get_qos());
 
   // lambda to delete datareader
   auto cleanup_datareader = rcpputils::make_scope_exit(
@@ -329,6 +335,12 @@ create_subscription(
   rmw_subscription->options = *subscription_options;
   rmw_fastrtps_shared_cpp::__init_subscription_for_loans(rmw_subscription);
 
+  if (participant_info->intra_participant_delivery) {
+    participant_info->intra_participant_delivery->add_subscription(
+      info, rmw_subscription->can_loan_messages,
+      subscription_options->ignore_local_publications);
+  }
+
   topic.should_be_deleted = false;
   cleanup_rmw_subscription.cancel();
   cleanup_datareader.cancel();
@@ -0,0 +1,139 @@
+// Copyright 2021 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <vector>
+
+#include "performance_test_fixture/performance_test_fixture.hpp"
+
+#include "rcutils/allocator.h"
+#include "rcutils/strdup.h"
+
+#include "rmw/error_handling.h"
+#include "rmw/rmw.h"
+
+#include "rmw_fastrtps_shared_cpp/rmw_common.hpp"
+
+#include "test_msgs/msg/basic_types.h"
+
+using performance_test_fixture::PerformanceTest;
+
+namespace
+{
+
+class PublishSequenceBenchmark : public PerformanceTest
+{
+public:
+  void SetUp(benchmark::State & state) override
+  {
+    rmw_init_options_t options = rmw_get_zero_initialized_init_options();
+    if (RMW_RET_OK != rmw_init_options_init(&options, rcutils_get_default_allocator())) {
+      state.SkipWithError(rmw_get_error_string().str);
+      return;
+    }
+    options.enclave = rcutils_strdup("/", rcutils_get_default_allocator());
+    rmw_ret_t ret = rmw_init(&options, &context);
+    rmw_init_options_fini(&options);
+    if (RMW_RET_OK != ret) {
+      state.SkipWithError(rmw_get_error_string().str);
+      return;
+    }
+    node = rmw_create_node(&context, "benchmark_node", "/");
+    if (nullptr == node) {
+      state.SkipWithError(rmw_get_error_string().str);
+      return;
+    }
+    const rosidl_message_type_support_t * ts =
+      ROSIDL_GET_MSG_TYPE_SUPPORT(test_msgs, msg, BasicTypes);
+    rmw_qos_profile_t qos_profile = rmw_qos_profile_default;
+    qos_profile.depth = 1000u;
+    rmw_publisher_options_t publisher_options = rmw_get_default_publisher_options();
+    publisher = rmw_create_publisher(
+      node, ts, "/benchmark_publish_sequence", &qos_profile, &publisher_options);
+    if (nullptr == publisher) {
+      state.SkipWithError(rmw_get_error_string().str);
+      return;
+    }
+
+    // Small samples, like IMU or CAN frames
+    const size_t count = static_cast<size_t>(state.range(0));
+    messages.resize(count);
+    message_ptrs.resize(count);
+    for (size_t i = 0u; i < count; ++i) {
+      test_msgs__msg__BasicTypes__init(&messages[i]);
+      messages[i].int64_value = static_cast<int64_t>(i);
+      message_ptrs[i] = &messages[i];
+    }
+
+    PerformanceTest::SetUp(state);
+  }
+
+  void TearDown(benchmark::State & state) override
+  {
+    PerformanceTest::TearDown(state);
+
+    for (auto & message : messages) {
+      test_msgs__msg__BasicTypes__fini(&message);
+    }
+    if (nullptr != publisher) {
+      rmw_destroy_publisher(node, publisher);
+    }
+    if (nullptr != node) {
+      rmw_destroy_node(node);
+    }
+    rmw_shutdown(&context);
+    rmw_context_fini(&context);
+  }
+
+protected:
+  rmw_context_t context{rmw_get_zero_initialized_context()};
+  rmw_node_t * node{nullptr};
+  rmw_publisher_t * publisher{nullptr};
+  std::vector<test_msgs__msg__BasicTypes> messages;
+  std::vector<void *> message_ptrs;
+};
+
+}  // namespace
+
+BENCHMARK_DEFINE_F(PublishSequenceBenchmark, publish_one_by_one)(benchmark::State & st)
+{
+  for (auto _ : st) {
+    for (void * message : message_ptrs) {
+      if (RMW_RET_OK != rmw_publish(publisher, message, nullptr)) {
+        st.SkipWithError(rmw_get_error_string().str);
+        return;
+      }
+    }
+  }
+  st.SetItemsProcessed(st.iterations() * st.range(0));
+}
+BENCHMARK_REGISTER_F(PublishSequenceBenchmark, publish_one_by_one)->Arg(100)->Arg(1000);
+
+BENCHMARK_DEFINE_F(PublishSequenceBenchmark, publish_sequence)(benchmark::State & st)
+{
+  rmw_message_sequence_t sequence;
+  sequence.data = message_ptrs.data();
+  sequence.size = message_ptrs.size();
+  sequence.capacity = message_ptrs.size();
+  sequence.allocator = nullptr;
+  for (auto _ : st) {
+    if (RMW_RET_OK != rmw_fastrtps_shared_cpp::__rmw_publish_sequence(
+        publisher->implementation_identifier, publisher, &sequence, nullptr, nullptr))
+    {
+      st.SkipWithError(rmw_get_error_string().str);
+      return;
+    }
+  }
+  st.SetItemsProcessed(st.iterations() * st.range(0));
+}
+BENCHMARK_REGISTER_F(PublishSequenceBenchmark, publish_sequence)->Arg(100)->Arg(1000);
@@ -0,0 +1,200 @@
+// Copyright 2021 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "osrf_testing_tools_cpp/scope_exit.hpp"
+
+#include "rcutils/allocator.h"
+#include "rcutils/strdup.h"
+
+#include "rmw/error_handling.h"
+#include "rmw/rmw.h"
+
+#include "rmw_dds_common/context.hpp"
+#include "rmw_dds_common/msg/participant_entities_info.hpp"
+
+#include "rmw_fastrtps_shared_cpp/discovery_batch.hpp"
+#include "rmw_fastrtps_shared_cpp/rmw_context_impl.hpp"
+
+#include "rosidl_typesupport_cpp/message_type_support.hpp"
+
+#include "test_msgs/msg/basic_types.hpp"
+
+using rmw_dds_common::msg::ParticipantEntitiesInfo;
+
+class TestDiscoveryBatch : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    rmw_init_options_t options = rmw_get_zero_initialized_init_options();
+    rmw_ret_t ret = rmw_init_options_init(&options, rcutils_get_default_allocator());
+    ASSERT_EQ(RMW_RET_OK, ret) << rcutils_get_error_string().str;
+    OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+    {
+      rmw_ret_t ret = rmw_init_options_fini(&options);
+      EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    });
+    options.enclave = rcutils_strdup("/", rcutils_get_default_allocator());
+    ASSERT_STREQ("/", options.enclave);
+    ret = rmw_init(&options, &context);
+    ASSERT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    node = rmw_create_node(&context, "my_node", "/my_ns");
+    ASSERT_NE(nullptr, node) << rmw_get_error_string().str;
+
+    // Listen to the ros_discovery_info publications of the context
+    rmw_qos_profile_t qos = rmw_qos_profile_default;
+    qos.avoid_ros_namespace_conventions = true;
+    qos.depth = 100u;
+    rmw_subscription_options_t sub_options = rmw_get_default_subscription_options();
+    sub = rmw_create_subscription(
+      node,
+      rosidl_typesupport_cpp::get_message_type_support_handle<ParticipantEntitiesInfo>(),
+      "ros_discovery_info", &qos, &sub_options);
+    ASSERT_NE(nullptr, sub) << rmw_get_error_string().str;
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    take_discovery_info();
+  }
+
+  void TearDown() override
+  {
+    rmw_ret_t ret = rmw_destroy_subscription(node, sub);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    ret = rmw_destroy_node(node);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    ret = rmw_shutdown(&context);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    ret = rmw_context_fini(&context);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+  }
+
+  // Take the pending ros_discovery_info messages published by this context
+  std::vector<ParticipantEntitiesInfo> take_discovery_info()
+  {
+    auto common_context = static_cast<rmw_dds_common::Context *>(context.impl->common);
+    std::vector<ParticipantEntitiesInfo> messages;
+    while (true) {
+      ParticipantEntitiesInfo msg;
+      bool taken = false;
+      rmw_ret_t ret = rmw_take(sub, &msg, &taken, nullptr);
+      EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+      if (RMW_RET_OK != ret || !taken) {
+        break;
+      }
+      // Other processes may publish on the same domain
+      if (std::equal(
+          msg.gid.data.begin(), msg.gid.data.end(), common_context->gid.data))
+      {
+        messages.push_back(msg);
+      }
+    }
+    return messages;
+  }
+
+  rmw_context_t context{rmw_get_zero_initialized_context()};
+  rmw_node_t * node{nullptr};
+  rmw_subscription_t * sub{nullptr};
+};
+
+static bool
+has_writer(const ParticipantEntitiesInfo & msg, const rmw_publisher_t * pub)
+{
+  rmw_gid_t gid;
+  EXPECT_EQ(RMW_RET_OK, rmw_get_gid_for_publisher(pub, &gid)) << rmw_get_error_string().str;
+  for (const auto & node_info : msg.node_entities_info_seq) {
+    for (const auto & writer_gid : node_info.writer_gid_seq) {
+      if (std::equal(writer_gid.data.begin(), writer_gid.data.end(), gid.data)) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+TEST_F(TestDiscoveryBatch, nested_batch_publishes_final_state_once) {
+  const char * identifier = rmw_get_implementation_identifier();
+  const rosidl_message_type_support_t * ts =
+    rosidl_typesupport_cpp::get_message_type_support_handle<test_msgs::msg::BasicTypes>();
+  rmw_qos_profile_t qos = rmw_qos_profile_default;
+  rmw_publisher_options_t pub_options = rmw_get_default_publisher_options();
+
+  ASSERT_EQ(
+    RMW_RET_OK,
+    rmw_fastrtps_shared_cpp::begin_discovery_batch(identifier, &context)) <<
+    rmw_get_error_string().str;
+  ASSERT_EQ(
+    RMW_RET_OK,
+    rmw_fastrtps_shared_cpp::begin_discovery_batch(identifier, &context)) <<
+    rmw_get_error_string().str;
+  rmw_publisher_t * first = rmw_create_publisher(
+    node, ts, "/test_discovery_batch_first", &qos, &pub_options);
+  ASSERT_NE(nullptr, first) << rmw_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_publisher(node, first)) << rmw_get_error_string().str;
+  });
+  ASSERT_EQ(
+    RMW_RET_OK,
+    rmw_fastrtps_shared_cpp::end_discovery_batch(identifier, &context)) <<
+    rmw_get_error_string().str;
+
+  // Still within the outer batch
+  rmw_publisher_t * second = rmw_create_publisher(
+    node, ts, "/test_discovery_batch_second", &qos, &pub_options);
+  ASSERT_NE(nullptr, second) << rmw_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_publisher(node, second)) << rmw_get_error_string().str;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(500));
+  EXPECT_TRUE(take_discovery_info().empty());
+
+  ASSERT_EQ(
+    RMW_RET_OK,
+    rmw_fastrtps_shared_cpp::end_discovery_batch(identifier, &context)) <<
+    rmw_get_error_string().str;
+  std::this_thread::sleep_for(std::chrono::milliseconds(500));
+  auto messages = take_discovery_info();
+  ASSERT_EQ(1u, messages.size());
+  EXPECT_TRUE(has_writer(messages[0], first));
+  EXPECT_TRUE(has_writer(messages[0], second));
+}
+
+TEST_F(TestDiscoveryBatch, end_without_begin_fails) {
+  const char * identifier = rmw_get_implementation_identifier();
+  EXPECT_EQ(
+    RMW_RET_ERROR,
+    rmw_fastrtps_shared_cpp::end_discovery_batch(identifier, &context));
+  rmw_reset_error();
+
+  // A finished batch cannot be ended twice
+  ASSERT_EQ(
+    RMW_RET_OK,
+    rmw_fastrtps_shared_cpp::begin_discovery_batch(identifier, &context)) <<
+    rmw_get_error_string().str;
+  EXPECT_EQ(
+    RMW_RET_OK,
+    rmw_fastrtps_shared_cpp::end_discovery_batch(identifier, &context)) <<
+    rmw_get_error_string().str;
+  EXPECT_EQ(
+    RMW_RET_ERROR,
+    rmw_fastrtps_shared_cpp::end_discovery_batch(identifier, &context));
+  rmw_reset_error();
+}
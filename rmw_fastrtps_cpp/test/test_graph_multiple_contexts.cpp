@@ -0,0 +1,187 @@
+// Copyright 2021 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+#include "osrf_testing_tools_cpp/scope_exit.hpp"
+
+#include "rcutils/allocator.h"
+#include "rcutils/strdup.h"
+
+#include "rmw/error_handling.h"
+#include "rmw/get_node_info_and_types.h"
+#include "rmw/names_and_types.h"
+#include "rmw/rmw.h"
+
+#include "rosidl_typesupport_cpp/message_type_support.hpp"
+
+#include "test_msgs/msg/basic_types.hpp"
+
+static constexpr const char * kTopicName = "/test_graph_multiple_contexts";
+
+// Two contexts of the same process share the thread listening to ros_discovery_info.
+class TestGraphMultipleContexts : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    // The first context to create a node leads the discovery of the group
+    init_context(&first_context, &first_node, "first_node");
+    init_context(&second_context, &second_node, "second_node");
+  }
+
+  void TearDown() override
+  {
+    fini_context(&second_context, second_node);
+    fini_context(&first_context, first_node);
+  }
+
+  void init_context(rmw_context_t * context, rmw_node_t ** node, const char * node_name)
+  {
+    rmw_init_options_t options = rmw_get_zero_initialized_init_options();
+    rmw_ret_t ret = rmw_init_options_init(&options, rcutils_get_default_allocator());
+    ASSERT_EQ(RMW_RET_OK, ret) << rcutils_get_error_string().str;
+    OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+    {
+      rmw_ret_t ret = rmw_init_options_fini(&options);
+      EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    });
+    options.enclave = rcutils_strdup("/", rcutils_get_default_allocator());
+    ASSERT_STREQ("/", options.enclave);
+    ret = rmw_init(&options, context);
+    ASSERT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    *node = rmw_create_node(context, node_name, "/my_ns");
+    ASSERT_NE(nullptr, *node) << rmw_get_error_string().str;
+  }
+
+  void fini_context(rmw_context_t * context, rmw_node_t * node)
+  {
+    rmw_ret_t ret = rmw_destroy_node(node);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    ret = rmw_shutdown(context);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    ret = rmw_context_fini(context);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+  }
+
+  // Wait until the graph of a node has the expected number of publishers and subscriptions
+  void wait_for_graph(const rmw_node_t * node, size_t publishers, size_t subscriptions)
+  {
+    size_t publisher_count = 0u;
+    size_t subscription_count = 0u;
+    for (size_t i = 0u; i < 100u; ++i) {
+      ASSERT_EQ(RMW_RET_OK, rmw_count_publishers(node, kTopicName, &publisher_count)) <<
+        rmw_get_error_string().str;
+      ASSERT_EQ(RMW_RET_OK, rmw_count_subscribers(node, kTopicName, &subscription_count)) <<
+        rmw_get_error_string().str;
+      if (publishers == publisher_count && subscriptions == subscription_count) {
+        break;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    EXPECT_EQ(publishers, publisher_count);
+    EXPECT_EQ(subscriptions, subscription_count);
+  }
+
+  // Wait until the graph of a node knows the publishers of another node on the topic, which
+  // are only learned from ros_discovery_info
+  void wait_for_node_publisher(const rmw_node_t * node, const char * node_name)
+  {
+    rcutils_allocator_t allocator = rcutils_get_default_allocator();
+    bool found = false;
+    for (size_t i = 0u; i < 100u && !found; ++i) {
+      rmw_names_and_types_t names_and_types = rmw_get_zero_initialized_names_and_types();
+      rmw_ret_t ret = rmw_get_publisher_names_and_types_by_node(
+        node, &allocator, node_name, "/my_ns", false, &names_and_types);
+      if (RMW_RET_OK == ret) {
+        for (size_t j = 0u; j < names_and_types.names.size; ++j) {
+          found |= 0 == std::strcmp(kTopicName, names_and_types.names.data[j]);
+        }
+        EXPECT_EQ(RMW_RET_OK, rmw_names_and_types_fini(&names_and_types));
+      } else {
+        // The node is not known yet
+        rmw_reset_error();
+      }
+      if (!found) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+      }
+    }
+    EXPECT_TRUE(found) << node_name << " publisher not seen by " << node->name;
+  }
+
+  const rosidl_message_type_support_t * ts{
+    rosidl_typesupport_cpp::get_message_type_support_handle<test_msgs::msg::BasicTypes>()};
+  rmw_context_t first_context{rmw_get_zero_initialized_context()};
+  rmw_context_t second_context{rmw_get_zero_initialized_context()};
+  rmw_node_t * first_node{nullptr};
+  rmw_node_t * second_node{nullptr};
+};
+
+TEST_F(TestGraphMultipleContexts, contexts_see_each_other_entities) {
+  rmw_qos_profile_t qos = rmw_qos_profile_default;
+
+  // Published by the first context, which receives ros_discovery_info for both
+  rmw_publisher_options_t pub_options = rmw_get_default_publisher_options();
+  rmw_publisher_t * pub = rmw_create_publisher(first_node, ts, kTopicName, &qos, &pub_options);
+  ASSERT_NE(nullptr, pub) << rmw_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_publisher(first_node, pub)) <<
+      rmw_get_error_string().str;
+  });
+  wait_for_graph(second_node, 1u, 0u);
+  wait_for_graph(first_node, 1u, 0u);
+
+  rmw_subscription_options_t sub_options = rmw_get_default_subscription_options();
+  rmw_subscription_t * sub =
+    rmw_create_subscription(second_node, ts, kTopicName, &qos, &sub_options);
+  ASSERT_NE(nullptr, sub) << rmw_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_subscription(second_node, sub)) <<
+      rmw_get_error_string().str;
+  });
+  wait_for_graph(first_node, 1u, 1u);
+  wait_for_graph(second_node, 1u, 1u);
+}
+
+TEST_F(TestGraphMultipleContexts, late_context_sees_entities_published_before) {
+  rmw_qos_profile_t qos = rmw_qos_profile_default;
+  rmw_publisher_options_t pub_options = rmw_get_default_publisher_options();
+  rmw_publisher_t * pub = rmw_create_publisher(first_node, ts, kTopicName, &qos, &pub_options);
+  ASSERT_NE(nullptr, pub) << rmw_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_publisher(first_node, pub)) <<
+      rmw_get_error_string().str;
+  });
+  // The ros_discovery_info message of the first context has been fanned out
+  wait_for_node_publisher(second_node, "first_node");
+
+  // Nothing is published after this context joins the group of the first two, so it can only
+  // learn about them from what the group received before
+  rmw_context_t third_context = rmw_get_zero_initialized_context();
+  rmw_node_t * third_node = nullptr;
+  init_context(&third_context, &third_node, "third_node");
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    fini_context(&third_context, third_node);
+  });
+  ASSERT_NE(nullptr, third_node);
+  wait_for_node_publisher(third_node, "first_node");
+}
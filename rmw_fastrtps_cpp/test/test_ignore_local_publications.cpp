@@ -0,0 +1,202 @@
+// Copyright 2021 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <chrono>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+#include "osrf_testing_tools_cpp/scope_exit.hpp"
+
+#include "rcutils/allocator.h"
+#include "rcutils/strdup.h"
+
+#include "rmw/error_handling.h"
+#include "rmw/message_sequence.h"
+#include "rmw/rmw.h"
+
+#include "rosidl_typesupport_cpp/message_type_support.hpp"
+
+#include "test_msgs/msg/basic_types.hpp"
+
+static constexpr const char * kTopicName = "/test_ignore_local_publications";
+static constexpr size_t kMessageCount = 4u;
+
+// A subscription ignoring local publications, with a publisher of the same participant and
+// one of another context, whose publications are the only ones taken
+class TestIgnoreLocalPublications : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    init_context(&context, &node, "my_node");
+    init_context(&other_context, &other_node, "other_node");
+
+    qos = rmw_qos_profile_default;
+    qos.depth = kMessageCount;
+    rmw_subscription_options_t sub_options = rmw_get_default_subscription_options();
+    sub_options.ignore_local_publications = true;
+    sub = rmw_create_subscription(node, ts, kTopicName, &qos, &sub_options);
+    ASSERT_NE(nullptr, sub) << rmw_get_error_string().str;
+    rmw_publisher_options_t pub_options = rmw_get_default_publisher_options();
+    local_pub = rmw_create_publisher(node, ts, kTopicName, &qos, &pub_options);
+    ASSERT_NE(nullptr, local_pub) << rmw_get_error_string().str;
+    other_pub = rmw_create_publisher(other_node, ts, kTopicName, &qos, &pub_options);
+    ASSERT_NE(nullptr, other_pub) << rmw_get_error_string().str;
+    wait_for_match(local_pub);
+    wait_for_match(other_pub);
+  }
+
+  void TearDown() override
+  {
+    rmw_ret_t ret = rmw_destroy_publisher(other_node, other_pub);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    ret = rmw_destroy_publisher(node, local_pub);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    ret = rmw_destroy_subscription(node, sub);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    fini_context(&other_context, other_node);
+    fini_context(&context, node);
+  }
+
+  void init_context(rmw_context_t * context, rmw_node_t ** node, const char * node_name)
+  {
+    rmw_init_options_t options = rmw_get_zero_initialized_init_options();
+    rmw_ret_t ret = rmw_init_options_init(&options, rcutils_get_default_allocator());
+    ASSERT_EQ(RMW_RET_OK, ret) << rcutils_get_error_string().str;
+    OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+    {
+      rmw_ret_t ret = rmw_init_options_fini(&options);
+      EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    });
+    options.enclave = rcutils_strdup("/", rcutils_get_default_allocator());
+    ASSERT_STREQ("/", options.enclave);
+    ret = rmw_init(&options, context);
+    ASSERT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    *node = rmw_create_node(context, node_name, "/my_ns");
+    ASSERT_NE(nullptr, *node) << rmw_get_error_string().str;
+  }
+
+  void fini_context(rmw_context_t * context, rmw_node_t * node)
+  {
+    rmw_ret_t ret = rmw_destroy_node(node);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    ret = rmw_shutdown(context);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    ret = rmw_context_fini(context);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+  }
+
+  void wait_for_match(const rmw_publisher_t * pub)
+  {
+    size_t matched = 0u;
+    for (size_t i = 0u; i < 100u && 0u == matched; ++i) {
+      ASSERT_EQ(RMW_RET_OK, rmw_publisher_count_matched_subscriptions(pub, &matched));
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    ASSERT_EQ(1u, matched);
+  }
+
+  void publish(const rmw_publisher_t * pub, int32_t value)
+  {
+    test_msgs::msg::BasicTypes msg;
+    msg.int32_value = value;
+    ASSERT_EQ(RMW_RET_OK, rmw_publish(pub, &msg, nullptr)) << rmw_get_error_string().str;
+    // Keep the samples of both publishers in the order they were published
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  }
+
+  const rosidl_message_type_support_t * ts{
+    rosidl_typesupport_cpp::get_message_type_support_handle<test_msgs::msg::BasicTypes>()};
+  rmw_qos_profile_t qos;
+  rmw_context_t context{rmw_get_zero_initialized_context()};
+  rmw_context_t other_context{rmw_get_zero_initialized_context()};
+  rmw_node_t * node{nullptr};
+  rmw_node_t * other_node{nullptr};
+  rmw_subscription_t * sub{nullptr};
+  rmw_publisher_t * local_pub{nullptr};
+  rmw_publisher_t * other_pub{nullptr};
+};
+
+TEST_F(TestIgnoreLocalPublications, take_leaves_message_of_skipped_sample) {
+  publish(local_pub, 1);
+
+  test_msgs::msg::BasicTypes msg;
+  msg.int32_value = -1;
+  msg.float64_value = 2.0;
+  const test_msgs::msg::BasicTypes original = msg;
+  bool taken = true;
+  ASSERT_EQ(RMW_RET_OK, rmw_take(sub, &msg, &taken, nullptr)) << rmw_get_error_string().str;
+  EXPECT_FALSE(taken);
+  EXPECT_EQ(original, msg);
+
+  // The local sample is skipped on the way to the next one
+  publish(local_pub, 2);
+  publish(other_pub, 3);
+  ASSERT_EQ(RMW_RET_OK, rmw_take(sub, &msg, &taken, nullptr)) << rmw_get_error_string().str;
+  EXPECT_TRUE(taken);
+  EXPECT_EQ(3, msg.int32_value);
+  EXPECT_EQ(0.0, msg.float64_value);
+
+  msg = original;
+  ASSERT_EQ(RMW_RET_OK, rmw_take(sub, &msg, &taken, nullptr)) << rmw_get_error_string().str;
+  EXPECT_FALSE(taken);
+  EXPECT_EQ(original, msg);
+}
+
+TEST_F(TestIgnoreLocalPublications, take_sequence_keeps_messages_contiguous) {
+  publish(local_pub, 1);
+  publish(other_pub, 2);
+  publish(local_pub, 3);
+  publish(other_pub, 4);
+
+  rcutils_allocator_t allocator = rcutils_get_default_allocator();
+  rmw_message_sequence_t message_sequence = rmw_get_zero_initialized_message_sequence();
+  ASSERT_EQ(
+    RMW_RET_OK, rmw_message_sequence_init(&message_sequence, kMessageCount, &allocator)) <<
+    rmw_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_message_sequence_fini(&message_sequence));
+  });
+  rmw_message_info_sequence_t message_info_sequence =
+    rmw_get_zero_initialized_message_info_sequence();
+  ASSERT_EQ(
+    RMW_RET_OK,
+    rmw_message_info_sequence_init(&message_info_sequence, kMessageCount, &allocator)) <<
+    rmw_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_message_info_sequence_fini(&message_info_sequence));
+  });
+  test_msgs::msg::BasicTypes messages[kMessageCount];
+  for (size_t i = 0u; i < kMessageCount; ++i) {
+    messages[i].int32_value = -1;
+    message_sequence.data[i] = &messages[i];
+  }
+
+  size_t taken = 0u;
+  ASSERT_EQ(
+    RMW_RET_OK, rmw_take_sequence(
+      sub, kMessageCount, &message_sequence, &message_info_sequence, &taken, nullptr)) <<
+    rmw_get_error_string().str;
+  ASSERT_EQ(2u, taken);
+  EXPECT_EQ(2u, message_sequence.size);
+  EXPECT_EQ(2u, message_info_sequence.size);
+  EXPECT_EQ(2, messages[0].int32_value);
+  EXPECT_EQ(4, messages[1].int32_value);
+  // Messages past those taken are left as they were
+  EXPECT_EQ(-1, messages[2].int32_value);
+  EXPECT_EQ(-1, messages[3].int32_value);
+}
@@ -0,0 +1,155 @@
+// Copyright 2021 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <chrono>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+#include "osrf_testing_tools_cpp/scope_exit.hpp"
+
+#include "rcutils/allocator.h"
+#include "rcutils/strdup.h"
+
+#include "rmw/error_handling.h"
+#include "rmw/message_sequence.h"
+#include "rmw/rmw.h"
+
+#include "rmw_fastrtps_shared_cpp/message_sequence_loans.hpp"
+
+#include "rosidl_typesupport_cpp/message_type_support.hpp"
+
+#include "test_msgs/msg/basic_types.hpp"
+
+// Run with RMW_FASTRTPS_USE_QOS_FROM_XML=1 so that data sharing is left to its default of
+// automatic
+class TestMessageSequenceLoans : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    rmw_init_options_t options = rmw_get_zero_initialized_init_options();
+    rmw_ret_t ret = rmw_init_options_init(&options, rcutils_get_default_allocator());
+    ASSERT_EQ(RMW_RET_OK, ret) << rcutils_get_error_string().str;
+    OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+    {
+      rmw_ret_t ret = rmw_init_options_fini(&options);
+      EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    });
+    options.enclave = rcutils_strdup("/", rcutils_get_default_allocator());
+    ASSERT_STREQ("/", options.enclave);
+    ret = rmw_init(&options, &context);
+    ASSERT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    node = rmw_create_node(&context, "my_node", "/my_ns");
+    ASSERT_NE(nullptr, node) << rmw_get_error_string().str;
+  }
+
+  void TearDown() override
+  {
+    rmw_ret_t ret = rmw_destroy_node(node);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    ret = rmw_shutdown(&context);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    ret = rmw_context_fini(&context);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+  }
+
+  rmw_context_t context{rmw_get_zero_initialized_context()};
+  rmw_node_t * node{nullptr};
+};
+
+TEST_F(TestMessageSequenceLoans, take_and_return_sequence) {
+  const rosidl_message_type_support_t * ts =
+    rosidl_typesupport_cpp::get_message_type_support_handle<test_msgs::msg::BasicTypes>();
+  constexpr char topic_name[] = "/test_message_sequence_loans";
+  rmw_subscription_options_t sub_options = rmw_get_default_subscription_options();
+  rmw_subscription_t * sub =
+    rmw_create_subscription(node, ts, topic_name, &rmw_qos_profile_default, &sub_options);
+  ASSERT_NE(nullptr, sub) << rmw_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_subscription(node, sub)) << rmw_get_error_string().str;
+  });
+  if (!sub->can_loan_messages) {
+    GTEST_SKIP() << "data sharing is not available";
+  }
+
+  rmw_publisher_options_t pub_options = rmw_get_default_publisher_options();
+  rmw_publisher_t * pub =
+    rmw_create_publisher(node, ts, topic_name, &rmw_qos_profile_default, &pub_options);
+  ASSERT_NE(nullptr, pub) << rmw_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_publisher(node, pub)) << rmw_get_error_string().str;
+  });
+
+  size_t matched = 0u;
+  for (size_t i = 0u; i < 100u && 0u == matched; ++i) {
+    ASSERT_EQ(RMW_RET_OK, rmw_publisher_count_matched_subscriptions(pub, &matched));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+  ASSERT_EQ(1u, matched);
+
+  constexpr size_t count = 3u;
+  rcutils_allocator_t allocator = rcutils_get_default_allocator();
+  rmw_message_sequence_t message_sequence = rmw_get_zero_initialized_message_sequence();
+  ASSERT_EQ(RMW_RET_OK, rmw_message_sequence_init(&message_sequence, count, &allocator)) <<
+    rmw_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_message_sequence_fini(&message_sequence)) <<
+      rmw_get_error_string().str;
+  });
+  rmw_message_info_sequence_t message_info_sequence =
+    rmw_get_zero_initialized_message_info_sequence();
+  ASSERT_EQ(
+    RMW_RET_OK,
+    rmw_message_info_sequence_init(&message_info_sequence, count, &allocator)) <<
+    rmw_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_message_info_sequence_fini(&message_info_sequence)) <<
+      rmw_get_error_string().str;
+  });
+
+  test_msgs::msg::BasicTypes msg;
+  msg.int32_value = 42;
+  ASSERT_EQ(RMW_RET_OK, rmw_publish(pub, &msg, nullptr)) << rmw_get_error_string().str;
+
+  size_t taken = 0u;
+  for (size_t i = 0u; i < 100u && 0u == taken; ++i) {
+    ASSERT_EQ(
+      RMW_RET_OK, rmw_fastrtps_shared_cpp::take_loaned_message_sequence(
+        rmw_get_implementation_identifier(), sub, count, &message_sequence,
+        &message_info_sequence, &taken)) << rmw_get_error_string().str;
+    if (0u == taken) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  }
+  ASSERT_EQ(1u, taken);
+  EXPECT_EQ(1u, message_sequence.size);
+  EXPECT_EQ(1u, message_info_sequence.size);
+  void * loaned_message = message_sequence.data[0];
+  EXPECT_EQ(42, static_cast<test_msgs::msg::BasicTypes *>(loaned_message)->int32_value);
+
+  ASSERT_EQ(
+    RMW_RET_OK, rmw_fastrtps_shared_cpp::return_loaned_message_sequence_from_subscription(
+      rmw_get_implementation_identifier(), sub, &message_sequence)) <<
+    rmw_get_error_string().str;
+  EXPECT_EQ(0u, message_sequence.size);
+
+  // Already returned
+  EXPECT_EQ(RMW_RET_ERROR, rmw_return_loaned_message_from_subscription(sub, loaned_message));
+  rmw_reset_error();
+}
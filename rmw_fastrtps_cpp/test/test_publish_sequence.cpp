@@ -0,0 +1,200 @@
+// Copyright 2021 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "osrf_testing_tools_cpp/scope_exit.hpp"
+
+#include "rcutils/allocator.h"
+#include "rcutils/strdup.h"
+
+#include "rmw/error_handling.h"
+#include "rmw/message_sequence.h"
+#include "rmw/rmw.h"
+
+#include "rmw_fastrtps_shared_cpp/publisher_statistics.hpp"
+#include "rmw_fastrtps_shared_cpp/rmw_common.hpp"
+
+#include "rosidl_typesupport_cpp/message_type_support.hpp"
+
+#include "test_msgs/msg/bounded_plain_sequences.hpp"
+
+static constexpr size_t kMessageCount = 3u;
+
+class TestPublishSequence : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    rmw_init_options_t options = rmw_get_zero_initialized_init_options();
+    rmw_ret_t ret = rmw_init_options_init(&options, rcutils_get_default_allocator());
+    ASSERT_EQ(RMW_RET_OK, ret) << rcutils_get_error_string().str;
+    OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+    {
+      rmw_ret_t ret = rmw_init_options_fini(&options);
+      EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    });
+    options.enclave = rcutils_strdup("/", rcutils_get_default_allocator());
+    ASSERT_STREQ("/", options.enclave);
+    ret = rmw_init(&options, &context);
+    ASSERT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    node = rmw_create_node(&context, "my_node", "/my_ns");
+    ASSERT_NE(nullptr, node) << rmw_get_error_string().str;
+
+    rmw_qos_profile_t qos = rmw_qos_profile_default;
+    qos.depth = kMessageCount;
+    rmw_publisher_options_t pub_options = rmw_get_default_publisher_options();
+    pub = rmw_create_publisher(node, ts, "/test_publish_sequence", &qos, &pub_options);
+    ASSERT_NE(nullptr, pub) << rmw_get_error_string().str;
+    rmw_subscription_options_t sub_options = rmw_get_default_subscription_options();
+    sub = rmw_create_subscription(node, ts, "/test_publish_sequence", &qos, &sub_options);
+    ASSERT_NE(nullptr, sub) << rmw_get_error_string().str;
+
+    size_t matched = 0u;
+    for (size_t i = 0u; i < 100u && 0u == matched; ++i) {
+      ASSERT_EQ(RMW_RET_OK, rmw_publisher_count_matched_subscriptions(pub, &matched));
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    ASSERT_EQ(1u, matched);
+
+    for (size_t i = 0u; i < kMessageCount; ++i) {
+      messages[i].int32_values = {static_cast<int32_t>(i)};
+      message_ptrs[i] = &messages[i];
+    }
+    sequence.data = message_ptrs;
+    sequence.size = kMessageCount;
+    sequence.capacity = kMessageCount;
+    sequence.allocator = nullptr;
+  }
+
+  void TearDown() override
+  {
+    rmw_ret_t ret = rmw_destroy_subscription(node, sub);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    ret = rmw_destroy_publisher(node, pub);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    ret = rmw_destroy_node(node);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    ret = rmw_shutdown(&context);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    ret = rmw_context_fini(&context);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+  }
+
+  // Take the received messages, returning the first value of each
+  std::vector<int32_t> take_all()
+  {
+    // Give the messages time to be received
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    std::vector<int32_t> values;
+    while (true) {
+      test_msgs::msg::BoundedPlainSequences msg;
+      bool taken = false;
+      rmw_ret_t ret = rmw_take(sub, &msg, &taken, nullptr);
+      EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+      if (RMW_RET_OK != ret || !taken) {
+        break;
+      }
+      EXPECT_EQ(1u, msg.int32_values.size());
+      if (!msg.int32_values.empty()) {
+        values.push_back(msg.int32_values[0]);
+      }
+    }
+    return values;
+  }
+
+  rmw_fastrtps_shared_cpp::PublisherStatistics get_statistics()
+  {
+    rmw_fastrtps_shared_cpp::PublisherStatistics statistics{};
+    EXPECT_EQ(
+      RMW_RET_OK,
+      rmw_fastrtps_shared_cpp::get_publisher_statistics(identifier, pub, &statistics)) <<
+      rmw_get_error_string().str;
+    return statistics;
+  }
+
+  const char * identifier{rmw_get_implementation_identifier()};
+  const rosidl_message_type_support_t * ts{
+    rosidl_typesupport_cpp::get_message_type_support_handle<
+      test_msgs::msg::BoundedPlainSequences>()};
+  rmw_context_t context{rmw_get_zero_initialized_context()};
+  rmw_node_t * node{nullptr};
+  rmw_publisher_t * pub{nullptr};
+  rmw_subscription_t * sub{nullptr};
+  test_msgs::msg::BoundedPlainSequences messages[kMessageCount];
+  void * message_ptrs[kMessageCount];
+  rmw_message_sequence_t sequence;
+};
+
+TEST_F(TestPublishSequence, publishes_all_messages_in_order) {
+  size_t published = 0u;
+  ASSERT_EQ(
+    RMW_RET_OK,
+    rmw_fastrtps_shared_cpp::__rmw_publish_sequence(
+      identifier, pub, &sequence, &published, nullptr)) << rmw_get_error_string().str;
+  EXPECT_EQ(kMessageCount, published);
+  EXPECT_EQ(std::vector<int32_t>({0, 1, 2}), take_all());
+  EXPECT_EQ(kMessageCount, get_statistics().published_messages);
+
+  // The count is optional
+  ASSERT_EQ(
+    RMW_RET_OK,
+    rmw_fastrtps_shared_cpp::__rmw_publish_sequence(
+      identifier, pub, &sequence, nullptr, nullptr)) << rmw_get_error_string().str;
+  EXPECT_EQ(std::vector<int32_t>({0, 1, 2}), take_all());
+}
+
+TEST_F(TestPublishSequence, stops_at_first_failure) {
+  // Exceeds the bound of the sequence, so it cannot be serialized
+  messages[1].bool_values = {true, true, true, true};
+
+  size_t published = kMessageCount;
+  EXPECT_EQ(
+    RMW_RET_ERROR,
+    rmw_fastrtps_shared_cpp::__rmw_publish_sequence(
+      identifier, pub, &sequence, &published, nullptr));
+  rmw_reset_error();
+  EXPECT_EQ(1u, published);
+  EXPECT_EQ(std::vector<int32_t>({0}), take_all());
+
+  auto statistics = get_statistics();
+  EXPECT_EQ(1u, statistics.published_messages);
+  EXPECT_EQ(1u, statistics.failed_messages);
+}
+
+TEST_F(TestPublishSequence, rejects_null_elements) {
+  message_ptrs[1] = nullptr;
+
+  size_t published = kMessageCount;
+  EXPECT_EQ(
+    RMW_RET_INVALID_ARGUMENT,
+    rmw_fastrtps_shared_cpp::__rmw_publish_sequence(
+      identifier, pub, &sequence, &published, nullptr));
+  rmw_reset_error();
+  // Elements are checked before publishing any of them
+  EXPECT_EQ(0u, published);
+  EXPECT_TRUE(take_all().empty());
+  EXPECT_EQ(0u, get_statistics().published_messages);
+
+  EXPECT_EQ(
+    RMW_RET_INVALID_ARGUMENT,
+    rmw_fastrtps_shared_cpp::__rmw_publish_sequence(
+      identifier, pub, nullptr, &published, nullptr));
+  rmw_reset_error();
+  EXPECT_EQ(0u, published);
+}
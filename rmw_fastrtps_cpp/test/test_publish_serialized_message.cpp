@@ -0,0 +1,172 @@
+// Copyright 2021 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+#include "osrf_testing_tools_cpp/scope_exit.hpp"
+
+#include "rcutils/allocator.h"
+#include "rcutils/strdup.h"
+
+#include "rmw/error_handling.h"
+#include "rmw/rmw.h"
+#include "rmw/serialized_message.h"
+
+#include "rosidl_typesupport_cpp/message_type_support.hpp"
+
+#include "test_msgs/msg/builtins.hpp"
+
+class TestPublishSerializedMessage : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    rmw_init_options_t options = rmw_get_zero_initialized_init_options();
+    rmw_ret_t ret = rmw_init_options_init(&options, rcutils_get_default_allocator());
+    ASSERT_EQ(RMW_RET_OK, ret) << rcutils_get_error_string().str;
+    OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+    {
+      rmw_ret_t ret = rmw_init_options_fini(&options);
+      EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    });
+    options.enclave = rcutils_strdup("/", rcutils_get_default_allocator());
+    ASSERT_STREQ("/", options.enclave);
+    ret = rmw_init(&options, &context);
+    ASSERT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    node = rmw_create_node(&context, "my_node", "/my_ns");
+    ASSERT_NE(nullptr, node) << rmw_get_error_string().str;
+
+    rmw_publisher_options_t pub_options = rmw_get_default_publisher_options();
+    pub = rmw_create_publisher(
+      node, ts, "/test_publish_serialized_message", &rmw_qos_profile_default, &pub_options);
+    ASSERT_NE(nullptr, pub) << rmw_get_error_string().str;
+    rmw_subscription_options_t sub_options = rmw_get_default_subscription_options();
+    sub = rmw_create_subscription(
+      node, ts, "/test_publish_serialized_message", &rmw_qos_profile_default, &sub_options);
+    ASSERT_NE(nullptr, sub) << rmw_get_error_string().str;
+
+    size_t matched = 0u;
+    for (size_t i = 0u; i < 100u && 0u == matched; ++i) {
+      ASSERT_EQ(RMW_RET_OK, rmw_publisher_count_matched_subscriptions(pub, &matched));
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    ASSERT_EQ(1u, matched);
+  }
+
+  void TearDown() override
+  {
+    rmw_ret_t ret = rmw_destroy_subscription(node, sub);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    ret = rmw_destroy_publisher(node, pub);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    ret = rmw_destroy_node(node);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    ret = rmw_shutdown(&context);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    ret = rmw_context_fini(&context);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+  }
+
+  // Take a message, waiting for it for a while, returning whether it was taken
+  bool take(test_msgs::msg::Builtins & msg)
+  {
+    bool taken = false;
+    for (size_t i = 0u; i < 100u && !taken; ++i) {
+      EXPECT_EQ(RMW_RET_OK, rmw_take(sub, &msg, &taken, nullptr)) << rmw_get_error_string().str;
+      if (!taken) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      }
+    }
+    return taken;
+  }
+
+  const rosidl_message_type_support_t * ts{
+    rosidl_typesupport_cpp::get_message_type_support_handle<test_msgs::msg::Builtins>()};
+  rmw_context_t context{rmw_get_zero_initialized_context()};
+  rmw_node_t * node{nullptr};
+  rmw_publisher_t * pub{nullptr};
+  rmw_subscription_t * sub{nullptr};
+};
+
+TEST_F(TestPublishSerializedMessage, shorter_than_encapsulation_is_rejected) {
+  uint8_t buffer[4] = {0x00, 0x01, 0x00, 0x00};
+  rmw_serialized_message_t serialized_message = rmw_get_zero_initialized_serialized_message();
+  serialized_message.buffer = buffer;
+  serialized_message.buffer_capacity = sizeof(buffer);
+  serialized_message.buffer_length = 3u;
+  EXPECT_EQ(
+    RMW_RET_INVALID_ARGUMENT, rmw_publish_serialized_message(pub, &serialized_message, nullptr));
+  rmw_reset_error();
+  serialized_message.buffer_length = 0u;
+  EXPECT_EQ(
+    RMW_RET_INVALID_ARGUMENT, rmw_publish_serialized_message(pub, &serialized_message, nullptr));
+  rmw_reset_error();
+
+  // Nothing was written
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  test_msgs::msg::Builtins msg;
+  bool taken = false;
+  ASSERT_EQ(RMW_RET_OK, rmw_take(sub, &msg, &taken, nullptr)) << rmw_get_error_string().str;
+  EXPECT_FALSE(taken);
+}
+
+TEST_F(TestPublishSerializedMessage, big_endian_message_is_republished_as_is) {
+  // Encapsulation header of big endian CDR, followed by the four 32 bits fields of the message
+  uint8_t buffer[] = {
+    0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x01,
+    0x00, 0x00, 0x00, 0x02,
+    0x00, 0x00, 0x01, 0x00,
+    0x00, 0x00, 0x00, 0x04,
+  };
+  rmw_serialized_message_t serialized_message = rmw_get_zero_initialized_serialized_message();
+  serialized_message.buffer = buffer;
+  serialized_message.buffer_capacity = sizeof(buffer);
+  serialized_message.buffer_length = sizeof(buffer);
+  ASSERT_EQ(RMW_RET_OK, rmw_publish_serialized_message(pub, &serialized_message, nullptr)) <<
+    rmw_get_error_string().str;
+
+  test_msgs::msg::Builtins msg;
+  ASSERT_TRUE(take(msg));
+  EXPECT_EQ(1, msg.duration_value.sec);
+  EXPECT_EQ(2u, msg.duration_value.nanosec);
+  EXPECT_EQ(256, msg.time_value.sec);
+  EXPECT_EQ(4u, msg.time_value.nanosec);
+
+  // The bytes reach the subscription unchanged
+  ASSERT_EQ(RMW_RET_OK, rmw_publish_serialized_message(pub, &serialized_message, nullptr)) <<
+    rmw_get_error_string().str;
+  rcutils_allocator_t allocator = rcutils_get_default_allocator();
+  rmw_serialized_message_t received = rmw_get_zero_initialized_serialized_message();
+  ASSERT_EQ(RMW_RET_OK, rmw_serialized_message_init(&received, 0u, &allocator));
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_serialized_message_fini(&received));
+  });
+  bool taken = false;
+  for (size_t i = 0u; i < 100u && !taken; ++i) {
+    ASSERT_EQ(RMW_RET_OK, rmw_take_serialized_message(sub, &received, &taken, nullptr)) <<
+      rmw_get_error_string().str;
+    if (!taken) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  }
+  ASSERT_TRUE(taken);
+  ASSERT_EQ(sizeof(buffer), received.buffer_length);
+  EXPECT_EQ(0, std::memcmp(buffer, received.buffer, sizeof(buffer)));
+}
@@ -0,0 +1,196 @@
+// Copyright 2021 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "gtest/gtest.h"
+
+#include "osrf_testing_tools_cpp/memory_tools/memory_tools.hpp"
+#include "osrf_testing_tools_cpp/memory_tools/testing_helpers.hpp"
+#include "osrf_testing_tools_cpp/scope_exit.hpp"
+
+#include "rcutils/allocator.h"
+#include "rcutils/strdup.h"
+
+#include "rmw/error_handling.h"
+#include "rmw/rmw.h"
+
+#include "rmw_fastrtps_shared_cpp/publisher_coalescing.hpp"
+
+#include "rosidl_typesupport_cpp/message_type_support.hpp"
+
+#include "test_msgs/msg/basic_types.hpp"
+#include "test_msgs/msg/strings.hpp"
+
+class TestPublisherAllocation : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    rmw_init_options_t options = rmw_get_zero_initialized_init_options();
+    rmw_ret_t ret = rmw_init_options_init(&options, rcutils_get_default_allocator());
+    ASSERT_EQ(RMW_RET_OK, ret) << rcutils_get_error_string().str;
+    OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+    {
+      rmw_ret_t ret = rmw_init_options_fini(&options);
+      EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    });
+    options.enclave = rcutils_strdup("/", rcutils_get_default_allocator());
+    ASSERT_STREQ("/", options.enclave);
+    ret = rmw_init(&options, &context);
+    ASSERT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    node = rmw_create_node(&context, "my_node", "/my_ns");
+    ASSERT_NE(nullptr, node) << rmw_get_error_string().str;
+  }
+
+  void TearDown() override
+  {
+    rmw_ret_t ret = rmw_destroy_node(node);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    ret = rmw_shutdown(&context);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    ret = rmw_context_fini(&context);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+  }
+
+  rmw_context_t context{rmw_get_zero_initialized_context()};
+  rmw_node_t * node{nullptr};
+};
+
+TEST_F(TestPublisherAllocation, unbounded_types_are_unsupported) {
+  const rosidl_message_type_support_t * ts =
+    rosidl_typesupport_cpp::get_message_type_support_handle<test_msgs::msg::Strings>();
+  rmw_publisher_allocation_t allocation{nullptr, nullptr};
+  EXPECT_EQ(RMW_RET_UNSUPPORTED, rmw_init_publisher_allocation(ts, nullptr, &allocation));
+  rmw_reset_error();
+  EXPECT_EQ(nullptr, allocation.data);
+}
+
+TEST_F(TestPublisherAllocation, publish_without_memory_operations) {
+  const rosidl_message_type_support_t * ts =
+    rosidl_typesupport_cpp::get_message_type_support_handle<test_msgs::msg::BasicTypes>();
+  rmw_publisher_options_t options = rmw_get_default_publisher_options();
+  rmw_publisher_t * pub = rmw_create_publisher(
+    node, ts, "/test_publisher_allocation", &rmw_qos_profile_default, &options);
+  ASSERT_NE(nullptr, pub) << rmw_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_publisher(node, pub)) << rmw_get_error_string().str;
+  });
+
+  rmw_publisher_allocation_t allocation{nullptr, nullptr};
+  ASSERT_EQ(RMW_RET_OK, rmw_init_publisher_allocation(ts, nullptr, &allocation)) <<
+    rmw_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_fini_publisher_allocation(&allocation)) <<
+      rmw_get_error_string().str;
+  });
+
+  test_msgs::msg::BasicTypes msg;
+  // Fill the history of the publisher, so that every payload has been used once
+  for (size_t i = 0u; i < 2u * rmw_qos_profile_default.depth; ++i) {
+    ASSERT_EQ(RMW_RET_OK, rmw_publish(pub, &msg, &allocation)) << rmw_get_error_string().str;
+  }
+
+  osrf_testing_tools_cpp::memory_tools::initialize();
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    osrf_testing_tools_cpp::memory_tools::uninitialize();
+  });
+  osrf_testing_tools_cpp::memory_tools::on_unexpected_malloc(
+    []() {ADD_FAILURE() << "unexpected malloc";});
+  osrf_testing_tools_cpp::memory_tools::on_unexpected_realloc(
+    []() {ADD_FAILURE() << "unexpected realloc";});
+  osrf_testing_tools_cpp::memory_tools::on_unexpected_calloc(
+    []() {ADD_FAILURE() << "unexpected calloc";});
+  osrf_testing_tools_cpp::memory_tools::on_unexpected_free(
+    []() {ADD_FAILURE() << "unexpected free";});
+  // Only the publishing thread is monitored, Fast DDS threads may allocate on their own
+  osrf_testing_tools_cpp::memory_tools::enable_monitoring();
+  for (size_t i = 0u; i < 2u * rmw_qos_profile_default.depth; ++i) {
+    msg.int32_value = static_cast<int32_t>(i);
+    rmw_ret_t ret = RMW_RET_ERROR;
+    EXPECT_NO_MEMORY_OPERATIONS(
+    {
+      ret = rmw_publish(pub, &msg, &allocation);
+    });
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+  }
+  osrf_testing_tools_cpp::memory_tools::disable_monitoring();
+}
+
+TEST_F(TestPublisherAllocation, allocation_of_another_type) {
+  const rosidl_message_type_support_t * ts =
+    rosidl_typesupport_cpp::get_message_type_support_handle<test_msgs::msg::Strings>();
+  rmw_publisher_options_t options = rmw_get_default_publisher_options();
+  rmw_publisher_t * pub = rmw_create_publisher(
+    node, ts, "/test_publisher_allocation", &rmw_qos_profile_default, &options);
+  ASSERT_NE(nullptr, pub) << rmw_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_publisher(node, pub)) << rmw_get_error_string().str;
+  });
+
+  rmw_publisher_allocation_t allocation{nullptr, nullptr};
+  ASSERT_EQ(
+    RMW_RET_OK, rmw_init_publisher_allocation(
+      rosidl_typesupport_cpp::get_message_type_support_handle<test_msgs::msg::BasicTypes>(),
+      nullptr, &allocation)) << rmw_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_fini_publisher_allocation(&allocation)) <<
+      rmw_get_error_string().str;
+  });
+
+  test_msgs::msg::Strings msg;
+  EXPECT_EQ(RMW_RET_INVALID_ARGUMENT, rmw_publish(pub, &msg, &allocation));
+  rmw_reset_error();
+}
+
+TEST_F(TestPublisherAllocation, coalescing_publisher_is_unsupported) {
+  const rosidl_message_type_support_t * ts =
+    rosidl_typesupport_cpp::get_message_type_support_handle<test_msgs::msg::BasicTypes>();
+  rmw_publisher_options_t options = rmw_get_default_publisher_options();
+  rmw_publisher_t * pub = rmw_create_publisher(
+    node, ts, "/test_publisher_allocation", &rmw_qos_profile_default, &options);
+  ASSERT_NE(nullptr, pub) << rmw_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_publisher(node, pub)) << rmw_get_error_string().str;
+  });
+
+  rmw_publisher_allocation_t allocation{nullptr, nullptr};
+  ASSERT_EQ(RMW_RET_OK, rmw_init_publisher_allocation(ts, nullptr, &allocation)) <<
+    rmw_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_fini_publisher_allocation(&allocation)) <<
+      rmw_get_error_string().str;
+  });
+
+  ASSERT_EQ(
+    RMW_RET_OK, rmw_fastrtps_shared_cpp::set_publisher_coalescing(
+      rmw_get_implementation_identifier(), pub, {0, 0}, 1024u * 1024u)) <<
+    rmw_get_error_string().str;
+  test_msgs::msg::BasicTypes msg;
+  EXPECT_EQ(RMW_RET_UNSUPPORTED, rmw_publish(pub, &msg, &allocation));
+  rmw_reset_error();
+  // Publishing without the allocation is still possible
+  EXPECT_EQ(RMW_RET_OK, rmw_publish(pub, &msg, nullptr)) << rmw_get_error_string().str;
+
+  ASSERT_EQ(
+    RMW_RET_OK, rmw_fastrtps_shared_cpp::set_publisher_coalescing(
+      rmw_get_implementation_identifier(), pub, {0, 0}, 0u)) <<
+    rmw_get_error_string().str;
+  EXPECT_EQ(RMW_RET_OK, rmw_publish(pub, &msg, &allocation)) << rmw_get_error_string().str;
+}
@@ -0,0 +1,241 @@
+// Copyright 2021 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "osrf_testing_tools_cpp/scope_exit.hpp"
+
+#include "rcutils/allocator.h"
+#include "rcutils/strdup.h"
+
+#include "rmw/error_handling.h"
+#include "rmw/rmw.h"
+
+#include "rmw_fastrtps_shared_cpp/publisher_coalescing.hpp"
+
+#include "rosidl_typesupport_cpp/message_type_support.hpp"
+
+#include "test_msgs/msg/basic_types.hpp"
+#include "test_msgs/msg/bounded_plain_sequences.hpp"
+
+class TestPublisherCoalescing : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    rmw_init_options_t options = rmw_get_zero_initialized_init_options();
+    rmw_ret_t ret = rmw_init_options_init(&options, rcutils_get_default_allocator());
+    ASSERT_EQ(RMW_RET_OK, ret) << rcutils_get_error_string().str;
+    OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+    {
+      rmw_ret_t ret = rmw_init_options_fini(&options);
+      EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    });
+    options.enclave = rcutils_strdup("/", rcutils_get_default_allocator());
+    ASSERT_STREQ("/", options.enclave);
+    ret = rmw_init(&options, &context);
+    ASSERT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    node = rmw_create_node(&context, "my_node", "/my_ns");
+    ASSERT_NE(nullptr, node) << rmw_get_error_string().str;
+
+    const rosidl_message_type_support_t * ts =
+      rosidl_typesupport_cpp::get_message_type_support_handle<test_msgs::msg::BasicTypes>();
+    rmw_qos_profile_t qos = rmw_qos_profile_default;
+    qos.depth = 10u;
+    rmw_publisher_options_t pub_options = rmw_get_default_publisher_options();
+    pub = rmw_create_publisher(node, ts, "/test_publisher_coalescing", &qos, &pub_options);
+    ASSERT_NE(nullptr, pub) << rmw_get_error_string().str;
+    rmw_subscription_options_t sub_options = rmw_get_default_subscription_options();
+    sub = rmw_create_subscription(node, ts, "/test_publisher_coalescing", &qos, &sub_options);
+    ASSERT_NE(nullptr, sub) << rmw_get_error_string().str;
+
+    size_t matched = 0u;
+    for (size_t i = 0u; i < 100u && 0u == matched; ++i) {
+      ASSERT_EQ(RMW_RET_OK, rmw_publisher_count_matched_subscriptions(pub, &matched));
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    ASSERT_EQ(1u, matched);
+  }
+
+  void TearDown() override
+  {
+    rmw_ret_t ret = rmw_destroy_subscription(node, sub);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    ret = rmw_destroy_publisher(node, pub);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    ret = rmw_destroy_node(node);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    ret = rmw_shutdown(&context);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    ret = rmw_context_fini(&context);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+  }
+
+  void publish(int32_t value)
+  {
+    test_msgs::msg::BasicTypes msg;
+    msg.int32_value = value;
+    ASSERT_EQ(RMW_RET_OK, rmw_publish(pub, &msg, nullptr)) << rmw_get_error_string().str;
+  }
+
+  // Take a message, waiting up to a timeout for it to be received
+  bool take(int32_t * value, std::chrono::milliseconds timeout)
+  {
+    test_msgs::msg::BasicTypes msg;
+    bool taken = false;
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (true) {
+      EXPECT_EQ(RMW_RET_OK, rmw_take(sub, &msg, &taken, nullptr)) << rmw_get_error_string().str;
+      if (taken || std::chrono::steady_clock::now() >= deadline) {
+        break;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    *value = msg.int32_value;
+    return taken;
+  }
+
+  rmw_context_t context{rmw_get_zero_initialized_context()};
+  rmw_node_t * node{nullptr};
+  rmw_publisher_t * pub{nullptr};
+  rmw_subscription_t * sub{nullptr};
+};
+
+TEST_F(TestPublisherCoalescing, flush_publishes_held_back_messages) {
+  // Only bound by size, far larger than the messages published
+  ASSERT_EQ(
+    RMW_RET_OK, rmw_fastrtps_shared_cpp::set_publisher_coalescing(
+      rmw_get_implementation_identifier(), pub, {0, 0}, 1024u * 1024u)) <<
+    rmw_get_error_string().str;
+  for (int32_t i = 1; i <= 3; ++i) {
+    publish(i);
+  }
+
+  int32_t value = 0;
+  EXPECT_FALSE(take(&value, std::chrono::milliseconds(200)));
+  ASSERT_EQ(
+    RMW_RET_OK, rmw_fastrtps_shared_cpp::flush_publisher(
+      rmw_get_implementation_identifier(), pub)) << rmw_get_error_string().str;
+  for (int32_t i = 1; i <= 3; ++i) {
+    ASSERT_TRUE(take(&value, std::chrono::seconds(5)));
+    EXPECT_EQ(i, value);
+  }
+}
+
+TEST_F(TestPublisherCoalescing, max_delay_publishes_held_back_messages) {
+  ASSERT_EQ(
+    RMW_RET_OK, rmw_fastrtps_shared_cpp::set_publisher_coalescing(
+      rmw_get_implementation_identifier(), pub, {0, 10000000}, 0u)) <<
+    rmw_get_error_string().str;
+  publish(1);
+  publish(2);
+
+  int32_t value = 0;
+  ASSERT_TRUE(take(&value, std::chrono::seconds(5)));
+  EXPECT_EQ(1, value);
+  ASSERT_TRUE(take(&value, std::chrono::seconds(5)));
+  EXPECT_EQ(2, value);
+}
+
+TEST_F(TestPublisherCoalescing, disabling_publishes_held_back_messages) {
+  ASSERT_EQ(
+    RMW_RET_OK, rmw_fastrtps_shared_cpp::set_publisher_coalescing(
+      rmw_get_implementation_identifier(), pub, {0, 0}, 1024u * 1024u)) <<
+    rmw_get_error_string().str;
+  publish(1);
+  ASSERT_EQ(
+    RMW_RET_OK, rmw_fastrtps_shared_cpp::set_publisher_coalescing(
+      rmw_get_implementation_identifier(), pub, {0, 0}, 0u)) <<
+    rmw_get_error_string().str;
+
+  int32_t value = 0;
+  ASSERT_TRUE(take(&value, std::chrono::seconds(5)));
+  EXPECT_EQ(1, value);
+  // Not coalescing anymore
+  publish(2);
+  ASSERT_TRUE(take(&value, std::chrono::seconds(5)));
+  EXPECT_EQ(2, value);
+}
+
+TEST_F(TestPublisherCoalescing, message_exceeding_a_bound_is_not_held_back) {
+  const rosidl_message_type_support_t * ts =
+    rosidl_typesupport_cpp::get_message_type_support_handle<
+    test_msgs::msg::BoundedPlainSequences>();
+  rmw_qos_profile_t qos = rmw_qos_profile_default;
+  qos.depth = 10u;
+  rmw_publisher_options_t pub_options = rmw_get_default_publisher_options();
+  rmw_publisher_t * bounded_pub =
+    rmw_create_publisher(node, ts, "/test_publisher_coalescing_bounded", &qos, &pub_options);
+  ASSERT_NE(nullptr, bounded_pub) << rmw_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_publisher(node, bounded_pub)) <<
+      rmw_get_error_string().str;
+  });
+  rmw_subscription_options_t sub_options = rmw_get_default_subscription_options();
+  rmw_subscription_t * bounded_sub = rmw_create_subscription(
+    node, ts, "/test_publisher_coalescing_bounded", &qos, &sub_options);
+  ASSERT_NE(nullptr, bounded_sub) << rmw_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_subscription(node, bounded_sub)) <<
+      rmw_get_error_string().str;
+  });
+  size_t matched = 0u;
+  for (size_t i = 0u; i < 100u && 0u == matched; ++i) {
+    ASSERT_EQ(RMW_RET_OK, rmw_publisher_count_matched_subscriptions(bounded_pub, &matched));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+  ASSERT_EQ(1u, matched);
+
+  ASSERT_EQ(
+    RMW_RET_OK, rmw_fastrtps_shared_cpp::set_publisher_coalescing(
+      rmw_get_implementation_identifier(), bounded_pub, {0, 0}, 1024u * 1024u)) <<
+    rmw_get_error_string().str;
+  test_msgs::msg::BoundedPlainSequences msg;
+  msg.int32_values = {1};
+  ASSERT_EQ(RMW_RET_OK, rmw_publish(bounded_pub, &msg, nullptr)) << rmw_get_error_string().str;
+  // Exceeds the bound of the sequence, so the type support throws while serializing it
+  test_msgs::msg::BoundedPlainSequences too_long_msg;
+  too_long_msg.int32_values = {2, 2, 2, 2};
+  EXPECT_EQ(RMW_RET_ERROR, rmw_publish(bounded_pub, &too_long_msg, nullptr));
+  EXPECT_TRUE(rmw_error_is_set());
+  rmw_reset_error();
+  msg.int32_values = {3};
+  ASSERT_EQ(RMW_RET_OK, rmw_publish(bounded_pub, &msg, nullptr)) << rmw_get_error_string().str;
+
+  // Only the messages held back are published
+  ASSERT_EQ(
+    RMW_RET_OK, rmw_fastrtps_shared_cpp::flush_publisher(
+      rmw_get_implementation_identifier(), bounded_pub)) << rmw_get_error_string().str;
+  std::vector<int32_t> values;
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (values.size() < 2u && std::chrono::steady_clock::now() < deadline) {
+    test_msgs::msg::BoundedPlainSequences taken_msg;
+    bool taken = false;
+    ASSERT_EQ(RMW_RET_OK, rmw_take(bounded_sub, &taken_msg, &taken, nullptr)) <<
+      rmw_get_error_string().str;
+    if (taken) {
+      ASSERT_EQ(1u, taken_msg.int32_values.size());
+      values.push_back(taken_msg.int32_values[0]);
+    } else {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  }
+  EXPECT_EQ(std::vector<int32_t>({1, 3}), values);
+}
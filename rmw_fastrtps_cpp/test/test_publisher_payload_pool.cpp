@@ -0,0 +1,104 @@
+// Copyright 2021 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "osrf_testing_tools_cpp/scope_exit.hpp"
+
+#include "rcutils/allocator.h"
+#include "rcutils/strdup.h"
+
+#include "rmw/error_handling.h"
+#include "rmw/rmw.h"
+
+#include "rmw_fastrtps_shared_cpp/payload_pool.hpp"
+
+#include "rosidl_typesupport_cpp/message_type_support.hpp"
+
+#include "test_msgs/msg/strings.hpp"
+
+// Run with RMW_FASTRTPS_PUBLISHER_PAYLOAD_POOL=1, only built with Fast DDS 2.5 or newer
+class TestPublisherPayloadPool : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    rmw_init_options_t options = rmw_get_zero_initialized_init_options();
+    rmw_ret_t ret = rmw_init_options_init(&options, rcutils_get_default_allocator());
+    ASSERT_EQ(RMW_RET_OK, ret) << rcutils_get_error_string().str;
+    OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+    {
+      rmw_ret_t ret = rmw_init_options_fini(&options);
+      EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    });
+    options.enclave = rcutils_strdup("/", rcutils_get_default_allocator());
+    ASSERT_STREQ("/", options.enclave);
+    ret = rmw_init(&options, &context);
+    ASSERT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    node = rmw_create_node(&context, "my_node", "/my_ns");
+    ASSERT_NE(nullptr, node) << rmw_get_error_string().str;
+  }
+
+  void TearDown() override
+  {
+    rmw_ret_t ret = rmw_destroy_node(node);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    ret = rmw_shutdown(&context);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    ret = rmw_context_fini(&context);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+  }
+
+  rmw_context_t context{rmw_get_zero_initialized_context()};
+  rmw_node_t * node{nullptr};
+};
+
+TEST_F(TestPublisherPayloadPool, payloads_are_reused) {
+  const rosidl_message_type_support_t * ts =
+    rosidl_typesupport_cpp::get_message_type_support_handle<test_msgs::msg::Strings>();
+  rmw_qos_profile_t qos = rmw_qos_profile_default;
+  qos.depth = 1u;
+  rmw_publisher_options_t options = rmw_get_default_publisher_options();
+  rmw_publisher_t * pub =
+    rmw_create_publisher(node, ts, "/test_publisher_payload_pool", &qos, &options);
+  ASSERT_NE(nullptr, pub) << rmw_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_publisher(node, pub)) << rmw_get_error_string().str;
+  });
+
+  const char * identifier = rmw_get_implementation_identifier();
+  rmw_fastrtps_shared_cpp::PayloadPoolStatistics statistics{};
+  ASSERT_EQ(
+    RMW_RET_OK, rmw_fastrtps_shared_cpp::get_publisher_payload_pool_statistics(
+      identifier, pub, &statistics)) << rmw_get_error_string().str;
+  EXPECT_EQ(0u, statistics.hits);
+  EXPECT_EQ(0u, statistics.misses);
+
+  // Messages of the same size class, so that the history of depth 1 releases a payload
+  // for the next message to reuse
+  test_msgs::msg::Strings msg;
+  for (size_t i = 0u; i < 10u; ++i) {
+    msg.string_value = std::string(100u + i, 'a');
+    ASSERT_EQ(RMW_RET_OK, rmw_publish(pub, &msg, nullptr)) << rmw_get_error_string().str;
+  }
+  ASSERT_EQ(
+    RMW_RET_OK, rmw_fastrtps_shared_cpp::get_publisher_payload_pool_statistics(
+      identifier, pub, &statistics)) << rmw_get_error_string().str;
+  EXPECT_GE(statistics.hits + statistics.misses, 10u);
+  EXPECT_GT(statistics.hits, 0u);
+  EXPECT_GT(statistics.allocated_bytes, 0u);
+}
@@ -0,0 +1,138 @@
+// Copyright 2021 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstdint>
+
+#include "gtest/gtest.h"
+
+#include "osrf_testing_tools_cpp/scope_exit.hpp"
+
+#include "rcutils/allocator.h"
+#include "rcutils/strdup.h"
+
+#include "rmw/error_handling.h"
+#include "rmw/rmw.h"
+#include "rmw/serialized_message.h"
+
+#include "rmw_fastrtps_shared_cpp/publisher_statistics.hpp"
+
+#include "rosidl_typesupport_cpp/message_type_support.hpp"
+
+#include "test_msgs/msg/basic_types.hpp"
+
+// Run with RMW_FASTRTPS_PUBLISHER_TIMING=1
+class TestPublisherStatistics : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    rmw_init_options_t options = rmw_get_zero_initialized_init_options();
+    rmw_ret_t ret = rmw_init_options_init(&options, rcutils_get_default_allocator());
+    ASSERT_EQ(RMW_RET_OK, ret) << rcutils_get_error_string().str;
+    OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+    {
+      rmw_ret_t ret = rmw_init_options_fini(&options);
+      EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    });
+    options.enclave = rcutils_strdup("/", rcutils_get_default_allocator());
+    ASSERT_STREQ("/", options.enclave);
+    ret = rmw_init(&options, &context);
+    ASSERT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    node = rmw_create_node(&context, "my_node", "/my_ns");
+    ASSERT_NE(nullptr, node) << rmw_get_error_string().str;
+  }
+
+  void TearDown() override
+  {
+    rmw_ret_t ret = rmw_destroy_node(node);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    ret = rmw_shutdown(&context);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    ret = rmw_context_fini(&context);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+  }
+
+  rmw_context_t context{rmw_get_zero_initialized_context()};
+  rmw_node_t * node{nullptr};
+};
+
+static uint64_t
+sum(const uint64_t (& histogram)[rmw_fastrtps_shared_cpp::kPublisherHistogramSize])
+{
+  uint64_t count = 0u;
+  for (uint64_t bucket : histogram) {
+    count += bucket;
+  }
+  return count;
+}
+
+TEST_F(TestPublisherStatistics, counts_publications) {
+  const rosidl_message_type_support_t * ts =
+    rosidl_typesupport_cpp::get_message_type_support_handle<test_msgs::msg::BasicTypes>();
+  rmw_publisher_options_t options = rmw_get_default_publisher_options();
+  rmw_publisher_t * pub = rmw_create_publisher(
+    node, ts, "/test_publisher_statistics", &rmw_qos_profile_default, &options);
+  ASSERT_NE(nullptr, pub) << rmw_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_publisher(node, pub)) << rmw_get_error_string().str;
+  });
+
+  rmw_fastrtps_shared_cpp::PublisherStatistics statistics;
+  ASSERT_EQ(
+    RMW_RET_OK, rmw_fastrtps_shared_cpp::get_publisher_statistics(
+      rmw_get_implementation_identifier(), pub, &statistics)) << rmw_get_error_string().str;
+  EXPECT_EQ(0u, statistics.published_messages);
+  EXPECT_EQ(0u, statistics.written_bytes);
+  EXPECT_EQ(0u, sum(statistics.write_time_histogram));
+
+  test_msgs::msg::BasicTypes msg;
+  for (int32_t i = 0; i < 3; ++i) {
+    msg.int32_value = i;
+    ASSERT_EQ(RMW_RET_OK, rmw_publish(pub, &msg, nullptr)) << rmw_get_error_string().str;
+  }
+  rmw_serialized_message_t serialized_message = rmw_get_zero_initialized_serialized_message();
+  rcutils_allocator_t allocator = rcutils_get_default_allocator();
+  ASSERT_EQ(
+    RMW_RET_OK, rmw_serialized_message_init(&serialized_message, 0u, &allocator)) <<
+    rmw_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_serialized_message_fini(&serialized_message)) <<
+      rmw_get_error_string().str;
+  });
+  ASSERT_EQ(RMW_RET_OK, rmw_serialize(&msg, ts, &serialized_message)) <<
+    rmw_get_error_string().str;
+  ASSERT_EQ(RMW_RET_OK, rmw_publish_serialized_message(pub, &serialized_message, nullptr)) <<
+    rmw_get_error_string().str;
+
+  ASSERT_EQ(
+    RMW_RET_OK, rmw_fastrtps_shared_cpp::get_publisher_statistics(
+      rmw_get_implementation_identifier(), pub, &statistics)) << rmw_get_error_string().str;
+  EXPECT_EQ(4u, statistics.published_messages);
+  EXPECT_EQ(0u, statistics.failed_messages);
+  // Messages of this type all have the same size
+  EXPECT_EQ(4u * serialized_message.buffer_length, statistics.written_bytes);
+  EXPECT_EQ(4u, sum(statistics.serialize_time_histogram));
+  EXPECT_EQ(4u, sum(statistics.write_time_histogram));
+  EXPECT_LT(0u, statistics.write_time_ns);
+}
+
+TEST_F(TestPublisherStatistics, rejects_invalid_arguments) {
+  rmw_fastrtps_shared_cpp::PublisherStatistics statistics;
+  EXPECT_EQ(
+    RMW_RET_INVALID_ARGUMENT, rmw_fastrtps_shared_cpp::get_publisher_statistics(
+      rmw_get_implementation_identifier(), nullptr, &statistics));
+  rmw_reset_error();
+}
@@ -0,0 +1,190 @@
+// Copyright 2021 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+#include "osrf_testing_tools_cpp/scope_exit.hpp"
+
+#include "rcutils/allocator.h"
+#include "rcutils/strdup.h"
+
+#include "rmw/error_handling.h"
+#include "rmw/message_sequence.h"
+#include "rmw/rmw.h"
+
+#include "rmw_fastrtps_shared_cpp/rmw_common.hpp"
+
+#include "rosidl_typesupport_cpp/message_type_support.hpp"
+
+#include "test_msgs/msg/bounded_sequences.hpp"
+
+// Run with RMW_FASTRTPS_SERIALIZE_ONCE=1, so that messages of unbounded types are serialized
+// into the scratch buffer of their publisher when their size is requested
+class TestSerializeOnce : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    rmw_init_options_t options = rmw_get_zero_initialized_init_options();
+    rmw_ret_t ret = rmw_init_options_init(&options, rcutils_get_default_allocator());
+    ASSERT_EQ(RMW_RET_OK, ret) << rcutils_get_error_string().str;
+    OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+    {
+      rmw_ret_t ret = rmw_init_options_fini(&options);
+      EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    });
+    options.enclave = rcutils_strdup("/", rcutils_get_default_allocator());
+    ASSERT_STREQ("/", options.enclave);
+    ret = rmw_init(&options, &context);
+    ASSERT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    node = rmw_create_node(&context, "my_node", "/my_ns");
+    ASSERT_NE(nullptr, node) << rmw_get_error_string().str;
+
+    rmw_qos_profile_t qos = rmw_qos_profile_default;
+    qos.depth = 10u;
+    rmw_publisher_options_t pub_options = rmw_get_default_publisher_options();
+    pub = rmw_create_publisher(node, ts, "/test_serialize_once", &qos, &pub_options);
+    ASSERT_NE(nullptr, pub) << rmw_get_error_string().str;
+    rmw_subscription_options_t sub_options = rmw_get_default_subscription_options();
+    sub = rmw_create_subscription(node, ts, "/test_serialize_once", &qos, &sub_options);
+    ASSERT_NE(nullptr, sub) << rmw_get_error_string().str;
+
+    size_t matched = 0u;
+    for (size_t i = 0u; i < 100u && 0u == matched; ++i) {
+      ASSERT_EQ(RMW_RET_OK, rmw_publisher_count_matched_subscriptions(pub, &matched));
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    ASSERT_EQ(1u, matched);
+  }
+
+  void TearDown() override
+  {
+    rmw_ret_t ret = rmw_destroy_subscription(node, sub);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    ret = rmw_destroy_publisher(node, pub);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    ret = rmw_destroy_node(node);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    ret = rmw_shutdown(&context);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    ret = rmw_context_fini(&context);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+  }
+
+  // Wait for the next message, and take it
+  void take(test_msgs::msg::BoundedSequences & msg)
+  {
+    bool taken = false;
+    for (size_t i = 0u; i < 100u && !taken; ++i) {
+      ASSERT_EQ(RMW_RET_OK, rmw_take(sub, &msg, &taken, nullptr)) <<
+        rmw_get_error_string().str;
+      if (!taken) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      }
+    }
+    ASSERT_TRUE(taken);
+  }
+
+  // Check that nothing is left to take
+  void expect_nothing_taken()
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    test_msgs::msg::BoundedSequences msg;
+    bool taken = true;
+    EXPECT_EQ(RMW_RET_OK, rmw_take(sub, &msg, &taken, nullptr)) << rmw_get_error_string().str;
+    EXPECT_FALSE(taken);
+  }
+
+  // The strings make the type unbounded, though its sequences are bounded
+  const rosidl_message_type_support_t * ts{
+    rosidl_typesupport_cpp::get_message_type_support_handle<
+      test_msgs::msg::BoundedSequences>()};
+  rmw_context_t context{rmw_get_zero_initialized_context()};
+  rmw_node_t * node{nullptr};
+  rmw_publisher_t * pub{nullptr};
+  rmw_subscription_t * sub{nullptr};
+};
+
+TEST_F(TestSerializeOnce, round_trip) {
+  // The scratch buffer grows for the first message, and is reused for the shorter second one
+  test_msgs::msg::BoundedSequences long_msg;
+  long_msg.string_values = {std::string(1000u, 'a'), "b", std::string(100u, 'c')};
+  long_msg.int32_values = {1, 2, 3};
+  test_msgs::msg::BoundedSequences short_msg;
+  short_msg.string_values = {"d"};
+  short_msg.float64_values = {4.0};
+
+  ASSERT_EQ(RMW_RET_OK, rmw_publish(pub, &long_msg, nullptr)) << rmw_get_error_string().str;
+  ASSERT_EQ(RMW_RET_OK, rmw_publish(pub, &short_msg, nullptr)) << rmw_get_error_string().str;
+
+  test_msgs::msg::BoundedSequences received;
+  take(received);
+  EXPECT_EQ(long_msg, received);
+  take(received);
+  EXPECT_EQ(short_msg, received);
+  expect_nothing_taken();
+}
+
+TEST_F(TestSerializeOnce, sequence_round_trip) {
+  test_msgs::msg::BoundedSequences messages[3];
+  void * message_ptrs[3];
+  for (size_t i = 0u; i < 3u; ++i) {
+    messages[i].string_values = {std::string(10u * (3u - i), 'a' + static_cast<char>(i))};
+    messages[i].int32_values = {static_cast<int32_t>(i)};
+    message_ptrs[i] = &messages[i];
+  }
+  rmw_message_sequence_t sequence = rmw_get_zero_initialized_message_sequence();
+  sequence.data = message_ptrs;
+  sequence.size = 3u;
+  sequence.capacity = 3u;
+
+  size_t published = 0u;
+  ASSERT_EQ(
+    RMW_RET_OK, rmw_fastrtps_shared_cpp::__rmw_publish_sequence(
+      rmw_get_implementation_identifier(), pub, &sequence, &published, nullptr)) <<
+    rmw_get_error_string().str;
+  EXPECT_EQ(3u, published);
+
+  for (size_t i = 0u; i < 3u; ++i) {
+    test_msgs::msg::BoundedSequences received;
+    take(received);
+    EXPECT_EQ(messages[i], received);
+  }
+  expect_nothing_taken();
+}
+
+TEST_F(TestSerializeOnce, falls_back_when_not_serialized_into_scratch_buffer) {
+  // Exceeding a bound fails serializing into the scratch buffer, so the size of the message
+  // is estimated instead and the message serialized when written, which fails again
+  test_msgs::msg::BoundedSequences too_long;
+  too_long.string_values = {"a"};
+  too_long.int32_values = {1, 2, 3, 4};
+  EXPECT_EQ(RMW_RET_ERROR, rmw_publish(pub, &too_long, nullptr));
+  rmw_reset_error();
+  expect_nothing_taken();
+
+  // Nothing is left in the scratch buffer to be written in place of the next message
+  test_msgs::msg::BoundedSequences msg;
+  msg.string_values = {"b"};
+  msg.int32_values = {5};
+  ASSERT_EQ(RMW_RET_OK, rmw_publish(pub, &msg, nullptr)) << rmw_get_error_string().str;
+  test_msgs::msg::BoundedSequences received;
+  take(received);
+  EXPECT_EQ(msg, received);
+  expect_nothing_taken();
+}
@@ -0,0 +1,352 @@
+// Copyright 2021 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <chrono>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+#include "osrf_testing_tools_cpp/scope_exit.hpp"
+
+#include "rcutils/allocator.h"
+#include "rcutils/strdup.h"
+
+#include "rmw/error_handling.h"
+#include "rmw/rmw.h"
+#include "rmw/serialized_message.h"
+
+#include "rmw_fastrtps_shared_cpp/serialized_loans.hpp"
+
+#include "rosidl_typesupport_cpp/message_type_support.hpp"
+
+#include "test_msgs/msg/basic_types.hpp"
+#include "test_msgs/msg/bounded_plain_sequences.hpp"
+#include "test_msgs/msg/strings.hpp"
+
+// Run with RMW_FASTRTPS_SERIALIZED_LOANS=1, and RMW_FASTRTPS_USE_QOS_FROM_XML=1 so that
+// data sharing is left to its default of automatic
+class TestSerializedLoans : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    rmw_init_options_t options = rmw_get_zero_initialized_init_options();
+    rmw_ret_t ret = rmw_init_options_init(&options, rcutils_get_default_allocator());
+    ASSERT_EQ(RMW_RET_OK, ret) << rcutils_get_error_string().str;
+    OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+    {
+      rmw_ret_t ret = rmw_init_options_fini(&options);
+      EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    });
+    options.enclave = rcutils_strdup("/", rcutils_get_default_allocator());
+    ASSERT_STREQ("/", options.enclave);
+    ret = rmw_init(&options, &context);
+    ASSERT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    node = rmw_create_node(&context, "my_node", "/my_ns");
+    ASSERT_NE(nullptr, node) << rmw_get_error_string().str;
+  }
+
+  void TearDown() override
+  {
+    rmw_ret_t ret = rmw_destroy_node(node);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    ret = rmw_shutdown(&context);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    ret = rmw_context_fini(&context);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+  }
+
+  rmw_context_t context{rmw_get_zero_initialized_context()};
+  rmw_node_t * node{nullptr};
+};
+
+TEST_F(TestSerializedLoans, plain_types_loan_ros_messages) {
+  const rosidl_message_type_support_t * ts =
+    rosidl_typesupport_cpp::get_message_type_support_handle<test_msgs::msg::BasicTypes>();
+  rmw_publisher_options_t options = rmw_get_default_publisher_options();
+  rmw_publisher_t * pub = rmw_create_publisher(
+    node, ts, "/test_serialized_loans_plain", &rmw_qos_profile_default, &options);
+  ASSERT_NE(nullptr, pub) << rmw_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_publisher(node, pub)) << rmw_get_error_string().str;
+  });
+
+  bool can_loan = true;
+  ASSERT_EQ(
+    RMW_RET_OK, rmw_fastrtps_shared_cpp::publisher_can_loan_serialized_messages(
+      rmw_get_implementation_identifier(), pub, &can_loan));
+  EXPECT_FALSE(can_loan);
+
+  rmw_serialized_message_t serialized_message = rmw_get_zero_initialized_serialized_message();
+  EXPECT_EQ(
+    RMW_RET_UNSUPPORTED, rmw_fastrtps_shared_cpp::borrow_loaned_serialized_message(
+      rmw_get_implementation_identifier(), pub, &serialized_message));
+  rmw_reset_error();
+}
+
+TEST_F(TestSerializedLoans, unbounded_types_loan_nothing) {
+  const rosidl_message_type_support_t * ts =
+    rosidl_typesupport_cpp::get_message_type_support_handle<test_msgs::msg::Strings>();
+  constexpr char topic_name[] = "/test_serialized_loans_unbounded";
+  rmw_publisher_options_t pub_options = rmw_get_default_publisher_options();
+  rmw_publisher_t * pub =
+    rmw_create_publisher(node, ts, topic_name, &rmw_qos_profile_default, &pub_options);
+  ASSERT_NE(nullptr, pub) << rmw_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_publisher(node, pub)) << rmw_get_error_string().str;
+  });
+  rmw_subscription_options_t sub_options = rmw_get_default_subscription_options();
+  rmw_subscription_t * sub =
+    rmw_create_subscription(node, ts, topic_name, &rmw_qos_profile_default, &sub_options);
+  ASSERT_NE(nullptr, sub) << rmw_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_subscription(node, sub)) << rmw_get_error_string().str;
+  });
+
+  // Samples of unbounded types have no size to be loaned with
+  bool can_loan = true;
+  ASSERT_EQ(
+    RMW_RET_OK, rmw_fastrtps_shared_cpp::publisher_can_loan_serialized_messages(
+      rmw_get_implementation_identifier(), pub, &can_loan));
+  EXPECT_FALSE(can_loan);
+  can_loan = true;
+  ASSERT_EQ(
+    RMW_RET_OK, rmw_fastrtps_shared_cpp::subscription_can_loan_serialized_messages(
+      rmw_get_implementation_identifier(), sub, &can_loan));
+  EXPECT_FALSE(can_loan);
+
+  rmw_serialized_message_t serialized_message = rmw_get_zero_initialized_serialized_message();
+  EXPECT_EQ(
+    RMW_RET_UNSUPPORTED, rmw_fastrtps_shared_cpp::borrow_loaned_serialized_message(
+      rmw_get_implementation_identifier(), pub, &serialized_message));
+  rmw_reset_error();
+  bool taken = true;
+  EXPECT_EQ(
+    RMW_RET_UNSUPPORTED, rmw_fastrtps_shared_cpp::take_loaned_serialized_message(
+      rmw_get_implementation_identifier(), sub, &serialized_message, &taken, nullptr));
+  rmw_reset_error();
+  EXPECT_EQ(nullptr, serialized_message.buffer);
+}
+
+TEST_F(TestSerializedLoans, publish_serialized_into_loan) {
+  const rosidl_message_type_support_t * ts = rosidl_typesupport_cpp::
+    get_message_type_support_handle<test_msgs::msg::BoundedPlainSequences>();
+  constexpr char topic_name[] = "/test_serialized_loans";
+  rmw_publisher_options_t pub_options = rmw_get_default_publisher_options();
+  rmw_publisher_t * pub =
+    rmw_create_publisher(node, ts, topic_name, &rmw_qos_profile_default, &pub_options);
+  ASSERT_NE(nullptr, pub) << rmw_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_publisher(node, pub)) << rmw_get_error_string().str;
+  });
+  // Messages of bounded sequences cannot be loaned as such
+  EXPECT_FALSE(pub->can_loan_messages);
+
+  bool can_loan = false;
+  ASSERT_EQ(
+    RMW_RET_OK, rmw_fastrtps_shared_cpp::publisher_can_loan_serialized_messages(
+      rmw_get_implementation_identifier(), pub, &can_loan));
+  if (!can_loan) {
+    GTEST_SKIP() << "data sharing is not available";
+  }
+
+  rmw_subscription_options_t sub_options = rmw_get_default_subscription_options();
+  rmw_subscription_t * sub =
+    rmw_create_subscription(node, ts, topic_name, &rmw_qos_profile_default, &sub_options);
+  ASSERT_NE(nullptr, sub) << rmw_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_subscription(node, sub)) << rmw_get_error_string().str;
+  });
+  EXPECT_FALSE(sub->can_loan_messages);
+
+  size_t matched = 0u;
+  for (size_t i = 0u; i < 100u && 0u == matched; ++i) {
+    ASSERT_EQ(RMW_RET_OK, rmw_publisher_count_matched_subscriptions(pub, &matched));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+  ASSERT_EQ(1u, matched);
+
+  // A sample which is returned isn't published
+  rmw_serialized_message_t serialized_message = rmw_get_zero_initialized_serialized_message();
+  ASSERT_EQ(
+    RMW_RET_OK, rmw_fastrtps_shared_cpp::borrow_loaned_serialized_message(
+      rmw_get_implementation_identifier(), pub, &serialized_message)) <<
+    rmw_get_error_string().str;
+  EXPECT_EQ(
+    RMW_RET_OK, rmw_fastrtps_shared_cpp::return_loaned_serialized_message_from_publisher(
+      rmw_get_implementation_identifier(), pub, &serialized_message)) <<
+    rmw_get_error_string().str;
+  EXPECT_EQ(nullptr, serialized_message.buffer);
+
+  test_msgs::msg::BoundedPlainSequences sent;
+  sent.int32_values = {1, 2, 3};
+  sent.float64_values = {4.0};
+  ASSERT_EQ(
+    RMW_RET_OK, rmw_fastrtps_shared_cpp::borrow_loaned_serialized_message(
+      rmw_get_implementation_identifier(), pub, &serialized_message)) <<
+    rmw_get_error_string().str;
+  ASSERT_NE(nullptr, serialized_message.buffer);
+  const size_t capacity = serialized_message.buffer_capacity;
+  // The sample cannot be reallocated, it is large enough for any message
+  ASSERT_EQ(RMW_RET_OK, rmw_serialize(&sent, ts, &serialized_message)) <<
+    rmw_get_error_string().str;
+  const size_t length = serialized_message.buffer_length;
+  ASSERT_LT(length, capacity);
+  ASSERT_EQ(
+    RMW_RET_OK, rmw_fastrtps_shared_cpp::publish_loaned_serialized_message(
+      rmw_get_implementation_identifier(), pub, &serialized_message)) <<
+    rmw_get_error_string().str;
+  EXPECT_EQ(nullptr, serialized_message.buffer);
+
+  test_msgs::msg::BoundedPlainSequences received;
+  bool taken = false;
+  for (size_t i = 0u; i < 100u && !taken; ++i) {
+    ASSERT_EQ(RMW_RET_OK, rmw_take(sub, &received, &taken, nullptr)) <<
+      rmw_get_error_string().str;
+    if (!taken) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  }
+  ASSERT_TRUE(taken);
+  EXPECT_EQ(sent, received);
+
+  // Though the sample is written whole, the message taken as a loan ends where it did
+  sent.int32_values = {5};
+  ASSERT_EQ(
+    RMW_RET_OK, rmw_fastrtps_shared_cpp::borrow_loaned_serialized_message(
+      rmw_get_implementation_identifier(), pub, &serialized_message)) <<
+    rmw_get_error_string().str;
+  ASSERT_EQ(RMW_RET_OK, rmw_serialize(&sent, ts, &serialized_message)) <<
+    rmw_get_error_string().str;
+  const size_t shorter_length = serialized_message.buffer_length;
+  ASSERT_LT(shorter_length, length);
+  ASSERT_EQ(
+    RMW_RET_OK, rmw_fastrtps_shared_cpp::publish_loaned_serialized_message(
+      rmw_get_implementation_identifier(), pub, &serialized_message)) <<
+    rmw_get_error_string().str;
+
+  taken = false;
+  for (size_t i = 0u; i < 100u && !taken; ++i) {
+    ASSERT_EQ(
+      RMW_RET_OK, rmw_fastrtps_shared_cpp::take_loaned_serialized_message(
+        rmw_get_implementation_identifier(), sub, &serialized_message, &taken, nullptr)) <<
+      rmw_get_error_string().str;
+    if (!taken) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  }
+  ASSERT_TRUE(taken);
+  EXPECT_EQ(shorter_length, serialized_message.buffer_length);
+  EXPECT_EQ(capacity, serialized_message.buffer_capacity);
+  EXPECT_EQ(RMW_RET_OK, rmw_deserialize(&serialized_message, ts, &received)) <<
+    rmw_get_error_string().str;
+  EXPECT_EQ(sent, received);
+  ASSERT_EQ(
+    RMW_RET_OK, rmw_fastrtps_shared_cpp::return_loaned_serialized_message_from_subscription(
+      rmw_get_implementation_identifier(), sub, &serialized_message)) <<
+    rmw_get_error_string().str;
+}
+
+TEST_F(TestSerializedLoans, take_serialized_as_loan) {
+  const rosidl_message_type_support_t * ts = rosidl_typesupport_cpp::
+    get_message_type_support_handle<test_msgs::msg::BoundedPlainSequences>();
+  constexpr char topic_name[] = "/test_serialized_loans_take";
+  rmw_subscription_options_t sub_options = rmw_get_default_subscription_options();
+  rmw_subscription_t * sub =
+    rmw_create_subscription(node, ts, topic_name, &rmw_qos_profile_default, &sub_options);
+  ASSERT_NE(nullptr, sub) << rmw_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_subscription(node, sub)) << rmw_get_error_string().str;
+  });
+
+  bool can_loan = false;
+  ASSERT_EQ(
+    RMW_RET_OK, rmw_fastrtps_shared_cpp::subscription_can_loan_serialized_messages(
+      rmw_get_implementation_identifier(), sub, &can_loan));
+  if (!can_loan) {
+    GTEST_SKIP() << "data sharing is not available";
+  }
+
+  rmw_publisher_options_t pub_options = rmw_get_default_publisher_options();
+  rmw_publisher_t * pub =
+    rmw_create_publisher(node, ts, topic_name, &rmw_qos_profile_default, &pub_options);
+  ASSERT_NE(nullptr, pub) << rmw_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_publisher(node, pub)) << rmw_get_error_string().str;
+  });
+
+  size_t matched = 0u;
+  for (size_t i = 0u; i < 100u && 0u == matched; ++i) {
+    ASSERT_EQ(RMW_RET_OK, rmw_publisher_count_matched_subscriptions(pub, &matched));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+  ASSERT_EQ(1u, matched);
+
+  test_msgs::msg::BoundedPlainSequences sent;
+  sent.int32_values = {1, 2, 3};
+  ASSERT_EQ(RMW_RET_OK, rmw_publish(pub, &sent, nullptr)) << rmw_get_error_string().str;
+
+  rmw_serialized_message_t serialized_message = rmw_get_zero_initialized_serialized_message();
+  rmw_message_info_t message_info{};
+  bool taken = false;
+  for (size_t i = 0u; i < 100u && !taken; ++i) {
+    ASSERT_EQ(
+      RMW_RET_OK, rmw_fastrtps_shared_cpp::take_loaned_serialized_message(
+        rmw_get_implementation_identifier(), sub, &serialized_message, &taken,
+        &message_info)) << rmw_get_error_string().str;
+    if (!taken) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  }
+  ASSERT_TRUE(taken);
+  ASSERT_NE(nullptr, serialized_message.buffer);
+
+  // The message taken is as long as when serialized, not as the payload holding it
+  rcutils_allocator_t allocator = rcutils_get_default_allocator();
+  rmw_serialized_message_t expected = rmw_get_zero_initialized_serialized_message();
+  ASSERT_EQ(RMW_RET_OK, rmw_serialized_message_init(&expected, 0u, &allocator));
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_serialized_message_fini(&expected));
+  });
+  ASSERT_EQ(RMW_RET_OK, rmw_serialize(&sent, ts, &expected)) << rmw_get_error_string().str;
+  EXPECT_EQ(expected.buffer_length, serialized_message.buffer_length);
+  EXPECT_LT(serialized_message.buffer_length, serialized_message.buffer_capacity);
+
+  test_msgs::msg::BoundedPlainSequences received;
+  EXPECT_EQ(RMW_RET_OK, rmw_deserialize(&serialized_message, ts, &received)) <<
+    rmw_get_error_string().str;
+  EXPECT_EQ(sent, received);
+
+  ASSERT_EQ(
+    RMW_RET_OK, rmw_fastrtps_shared_cpp::return_loaned_serialized_message_from_subscription(
+      rmw_get_implementation_identifier(), sub, &serialized_message)) <<
+    rmw_get_error_string().str;
+  EXPECT_EQ(nullptr, serialized_message.buffer);
+
+  // Nothing left to take
+  ASSERT_EQ(
+    RMW_RET_OK, rmw_fastrtps_shared_cpp::take_loaned_serialized_message(
+      rmw_get_implementation_identifier(), sub, &serialized_message, &taken, nullptr)) <<
+    rmw_get_error_string().str;
+  EXPECT_FALSE(taken);
+  EXPECT_EQ(nullptr, serialized_message.buffer);
+}
@@ -0,0 +1,169 @@
+// Copyright 2021 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstddef>
+
+#include "gtest/gtest.h"
+
+#include "osrf_testing_tools_cpp/scope_exit.hpp"
+
+#include "rcutils/allocator.h"
+#include "rcutils/strdup.h"
+
+#include "rmw/error_handling.h"
+#include "rmw/rmw.h"
+
+#include "rmw_fastrtps_shared_cpp/graph_guard_conditions.hpp"
+
+#include "rosidl_typesupport_cpp/service_type_support.hpp"
+
+#include "test_msgs/srv/basic_types.hpp"
+
+static constexpr const char * kServiceName = "/test_service_server_is_available";
+
+class TestServiceServerIsAvailable : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    rmw_init_options_t options = rmw_get_zero_initialized_init_options();
+    rmw_ret_t ret = rmw_init_options_init(&options, rcutils_get_default_allocator());
+    ASSERT_EQ(RMW_RET_OK, ret) << rcutils_get_error_string().str;
+    OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+    {
+      rmw_ret_t ret = rmw_init_options_fini(&options);
+      EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    });
+    options.enclave = rcutils_strdup("/", rcutils_get_default_allocator());
+    ASSERT_STREQ("/", options.enclave);
+    ret = rmw_init(&options, &context);
+    ASSERT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    node = rmw_create_node(&context, "my_node", "/my_ns");
+    ASSERT_NE(nullptr, node) << rmw_get_error_string().str;
+
+    client = rmw_create_client(node, ts, kServiceName, &rmw_qos_profile_services_default);
+    ASSERT_NE(nullptr, client) << rmw_get_error_string().str;
+    ret = rmw_fastrtps_shared_cpp::get_client_graph_guard_condition(
+      rmw_get_implementation_identifier(), node, client, &graph_guard_condition);
+    ASSERT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    ASSERT_NE(nullptr, graph_guard_condition);
+    wait_set = rmw_create_wait_set(&context, 1u);
+    ASSERT_NE(nullptr, wait_set) << rmw_get_error_string().str;
+  }
+
+  void TearDown() override
+  {
+    rmw_ret_t ret = rmw_destroy_wait_set(wait_set);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    ret = rmw_destroy_client(node, client);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    ret = rmw_destroy_node(node);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    ret = rmw_shutdown(&context);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    ret = rmw_context_fini(&context);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+  }
+
+  // Wait for the graph guard condition of the client, returning whether it was triggered
+  bool wait_for_graph_guard_condition(const rmw_time_t & timeout)
+  {
+    void * conditions[] = {graph_guard_condition->data};
+    rmw_guard_conditions_t guard_conditions{1u, conditions};
+    rmw_ret_t ret =
+      rmw_wait(nullptr, &guard_conditions, nullptr, nullptr, nullptr, wait_set, &timeout);
+    EXPECT_TRUE(RMW_RET_OK == ret || RMW_RET_TIMEOUT == ret) << rmw_get_error_string().str;
+    return RMW_RET_OK == ret && nullptr != conditions[0];
+  }
+
+  // Let the discovery of the client itself settle, until the guard condition stays quiet
+  void drain_graph_guard_condition()
+  {
+    bool triggered = true;
+    for (size_t i = 0u; i < 50u && triggered; ++i) {
+      triggered = wait_for_graph_guard_condition({0, 200000000});
+    }
+    ASSERT_FALSE(triggered);
+  }
+
+  bool is_available()
+  {
+    bool available = false;
+    EXPECT_EQ(RMW_RET_OK, rmw_service_server_is_available(node, client, &available)) <<
+      rmw_get_error_string().str;
+    return available;
+  }
+
+  // Wait on the graph guard condition until the server is available or not, as expected.
+  // Only the guard condition wakes the waits up, so the server wouldn't be seen otherwise.
+  void wait_for_availability(bool expected)
+  {
+    bool available = !expected;
+    for (size_t i = 0u; i < 50u && expected != available; ++i) {
+      if (wait_for_graph_guard_condition({0, 100000000})) {
+        available = is_available();
+      }
+    }
+    EXPECT_EQ(expected, available);
+  }
+
+  const rosidl_service_type_support_t * ts{
+    rosidl_typesupport_cpp::get_service_type_support_handle<test_msgs::srv::BasicTypes>()};
+  rmw_context_t context{rmw_get_zero_initialized_context()};
+  rmw_node_t * node{nullptr};
+  rmw_client_t * client{nullptr};
+  const rmw_guard_condition_t * graph_guard_condition{nullptr};
+  rmw_wait_set_t * wait_set{nullptr};
+};
+
+TEST_F(TestServiceServerIsAvailable, follows_server_with_graph_guard_condition) {
+  drain_graph_guard_condition();
+  EXPECT_FALSE(is_available());
+  // The answer is kept until the graph changes, and is the same when asked again
+  EXPECT_FALSE(is_available());
+  EXPECT_FALSE(wait_for_graph_guard_condition({0, 0}));
+
+  rmw_service_t * service =
+    rmw_create_service(node, ts, kServiceName, &rmw_qos_profile_services_default);
+  ASSERT_NE(nullptr, service) << rmw_get_error_string().str;
+  wait_for_availability(true);
+  EXPECT_TRUE(is_available());
+
+  ASSERT_EQ(RMW_RET_OK, rmw_destroy_service(node, service)) << rmw_get_error_string().str;
+  wait_for_availability(false);
+  EXPECT_FALSE(is_available());
+
+  // Servers coming back are seen again
+  service = rmw_create_service(node, ts, kServiceName, &rmw_qos_profile_services_default);
+  ASSERT_NE(nullptr, service) << rmw_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_service(node, service)) << rmw_get_error_string().str;
+  });
+  wait_for_availability(true);
+}
+
+TEST_F(TestServiceServerIsAvailable, other_services_do_not_trigger_graph_guard_condition) {
+  drain_graph_guard_condition();
+
+  rmw_service_t * service = rmw_create_service(
+    node, ts, "/test_service_server_is_available_other", &rmw_qos_profile_services_default);
+  ASSERT_NE(nullptr, service) << rmw_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_service(node, service)) << rmw_get_error_string().str;
+  });
+  EXPECT_FALSE(wait_for_graph_guard_condition({0, 500000000}));
+  EXPECT_FALSE(is_available());
+}
@@ -0,0 +1,238 @@
+// Copyright 2021 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <chrono>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+#include "osrf_testing_tools_cpp/scope_exit.hpp"
+
+#include "rcutils/allocator.h"
+#include "rcutils/strdup.h"
+
+#include "rmw/error_handling.h"
+#include "rmw/message_sequence.h"
+#include "rmw/rmw.h"
+
+#include "rosidl_typesupport_cpp/message_type_support.hpp"
+
+#include "test_msgs/msg/basic_types.hpp"
+
+static constexpr size_t kMessageCount = 5u;
+
+class TestTakeSequence : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    rmw_init_options_t options = rmw_get_zero_initialized_init_options();
+    rmw_ret_t ret = rmw_init_options_init(&options, rcutils_get_default_allocator());
+    ASSERT_EQ(RMW_RET_OK, ret) << rcutils_get_error_string().str;
+    OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+    {
+      rmw_ret_t ret = rmw_init_options_fini(&options);
+      EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    });
+    options.enclave = rcutils_strdup("/", rcutils_get_default_allocator());
+    ASSERT_STREQ("/", options.enclave);
+    ret = rmw_init(&options, &context);
+    ASSERT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    node = rmw_create_node(&context, "my_node", "/my_ns");
+    ASSERT_NE(nullptr, node) << rmw_get_error_string().str;
+
+    qos = rmw_qos_profile_default;
+    qos.depth = kMessageCount;
+    rmw_publisher_options_t pub_options = rmw_get_default_publisher_options();
+    pub = rmw_create_publisher(node, ts, "/test_take_sequence", &qos, &pub_options);
+    ASSERT_NE(nullptr, pub) << rmw_get_error_string().str;
+
+    allocator = rcutils_get_default_allocator();
+    ASSERT_EQ(
+      RMW_RET_OK,
+      rmw_message_sequence_init(&message_sequence, kMessageCount, &allocator)) <<
+      rmw_get_error_string().str;
+    ASSERT_EQ(
+      RMW_RET_OK,
+      rmw_message_info_sequence_init(&message_info_sequence, kMessageCount, &allocator)) <<
+      rmw_get_error_string().str;
+    for (size_t i = 0u; i < kMessageCount; ++i) {
+      message_sequence.data[i] = &messages[i];
+    }
+  }
+
+  void TearDown() override
+  {
+    rmw_ret_t ret = rmw_message_info_sequence_fini(&message_info_sequence);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    ret = rmw_message_sequence_fini(&message_sequence);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    ret = rmw_destroy_publisher(node, pub);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    ret = rmw_destroy_node(node);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    ret = rmw_shutdown(&context);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    ret = rmw_context_fini(&context);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+  }
+
+  void wait_for_match()
+  {
+    size_t matched = 0u;
+    for (size_t i = 0u; i < 100u && 0u == matched; ++i) {
+      ASSERT_EQ(RMW_RET_OK, rmw_publisher_count_matched_subscriptions(pub, &matched));
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    ASSERT_EQ(1u, matched);
+  }
+
+  void publish_all()
+  {
+    for (size_t i = 0u; i < kMessageCount; ++i) {
+      test_msgs::msg::BasicTypes msg;
+      msg.int32_value = static_cast<int32_t>(i);
+      ASSERT_EQ(RMW_RET_OK, rmw_publish(pub, &msg, nullptr)) << rmw_get_error_string().str;
+    }
+    // Give the messages time to be received
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+  }
+
+  const rosidl_message_type_support_t * ts{
+    rosidl_typesupport_cpp::get_message_type_support_handle<test_msgs::msg::BasicTypes>()};
+  rmw_qos_profile_t qos;
+  rmw_context_t context{rmw_get_zero_initialized_context()};
+  rmw_node_t * node{nullptr};
+  rmw_publisher_t * pub{nullptr};
+  rcutils_allocator_t allocator;
+  test_msgs::msg::BasicTypes messages[kMessageCount];
+  rmw_message_sequence_t message_sequence{rmw_get_zero_initialized_message_sequence()};
+  rmw_message_info_sequence_t message_info_sequence{
+    rmw_get_zero_initialized_message_info_sequence()};
+};
+
+TEST_F(TestTakeSequence, takes_all_messages_in_order) {
+  rmw_subscription_options_t sub_options = rmw_get_default_subscription_options();
+  rmw_subscription_t * sub =
+    rmw_create_subscription(node, ts, "/test_take_sequence", &qos, &sub_options);
+  ASSERT_NE(nullptr, sub) << rmw_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_subscription(node, sub)) << rmw_get_error_string().str;
+  });
+  wait_for_match();
+  publish_all();
+
+  size_t taken = 0u;
+  ASSERT_EQ(
+    RMW_RET_OK, rmw_take_sequence(
+      sub, kMessageCount, &message_sequence, &message_info_sequence, &taken, nullptr)) <<
+    rmw_get_error_string().str;
+  ASSERT_EQ(kMessageCount, taken);
+  EXPECT_EQ(kMessageCount, message_sequence.size);
+  EXPECT_EQ(kMessageCount, message_info_sequence.size);
+  for (size_t i = 0u; i < kMessageCount; ++i) {
+    EXPECT_EQ(static_cast<int32_t>(i), messages[i].int32_value);
+  }
+
+  // Nothing left
+  ASSERT_EQ(
+    RMW_RET_OK, rmw_take_sequence(
+      sub, kMessageCount, &message_sequence, &message_info_sequence, &taken, nullptr)) <<
+    rmw_get_error_string().str;
+  EXPECT_EQ(0u, taken);
+  EXPECT_EQ(0u, message_sequence.size);
+}
+
+TEST_F(TestTakeSequence, skips_ignored_local_publications) {
+  rmw_subscription_options_t sub_options = rmw_get_default_subscription_options();
+  sub_options.ignore_local_publications = true;
+  rmw_subscription_t * sub =
+    rmw_create_subscription(node, ts, "/test_take_sequence", &qos, &sub_options);
+  ASSERT_NE(nullptr, sub) << rmw_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_subscription(node, sub)) << rmw_get_error_string().str;
+  });
+  wait_for_match();
+  publish_all();
+
+  size_t taken = 1u;
+  ASSERT_EQ(
+    RMW_RET_OK, rmw_take_sequence(
+      sub, kMessageCount, &message_sequence, &message_info_sequence, &taken, nullptr)) <<
+    rmw_get_error_string().str;
+  EXPECT_EQ(0u, taken);
+  EXPECT_EQ(0u, message_sequence.size);
+  EXPECT_EQ(0u, message_info_sequence.size);
+}
+
+TEST_F(TestTakeSequence, messages_stay_contiguous_past_samples_without_data) {
+  rmw_subscription_options_t sub_options = rmw_get_default_subscription_options();
+  rmw_subscription_t * sub =
+    rmw_create_subscription(node, ts, "/test_take_sequence", &qos, &sub_options);
+  ASSERT_NE(nullptr, sub) << rmw_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_subscription(node, sub)) << rmw_get_error_string().str;
+  });
+  wait_for_match();
+
+  rmw_publisher_options_t pub_options = rmw_get_default_publisher_options();
+  rmw_publisher_t * other_pub =
+    rmw_create_publisher(node, ts, "/test_take_sequence", &qos, &pub_options);
+  ASSERT_NE(nullptr, other_pub) << rmw_get_error_string().str;
+  size_t matched = 0u;
+  for (size_t i = 0u; i < 100u && 0u == matched; ++i) {
+    ASSERT_EQ(RMW_RET_OK, rmw_publisher_count_matched_subscriptions(other_pub, &matched));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+  ASSERT_EQ(1u, matched);
+
+  // The samples of a publisher that goes away are followed by a sample without data, which
+  // tells that the instance has no writer anymore.
+  // The sample is not deserialized, and the messages after it take its place.
+  const size_t kFirstCount = 2u;
+  for (size_t i = 0u; i < kFirstCount; ++i) {
+    test_msgs::msg::BasicTypes msg;
+    msg.int32_value = static_cast<int32_t>(i);
+    ASSERT_EQ(RMW_RET_OK, rmw_publish(other_pub, &msg, nullptr)) << rmw_get_error_string().str;
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(500));
+  ASSERT_EQ(RMW_RET_OK, rmw_destroy_publisher(node, other_pub)) << rmw_get_error_string().str;
+  std::this_thread::sleep_for(std::chrono::milliseconds(500));
+  for (size_t i = kFirstCount; i < kMessageCount - 1u; ++i) {
+    test_msgs::msg::BasicTypes msg;
+    msg.int32_value = static_cast<int32_t>(i);
+    ASSERT_EQ(RMW_RET_OK, rmw_publish(pub, &msg, nullptr)) << rmw_get_error_string().str;
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+  for (size_t i = 0u; i < kMessageCount; ++i) {
+    messages[i].int32_value = -1;
+  }
+  size_t taken = 0u;
+  ASSERT_EQ(
+    RMW_RET_OK, rmw_take_sequence(
+      sub, kMessageCount, &message_sequence, &message_info_sequence, &taken, nullptr)) <<
+    rmw_get_error_string().str;
+  ASSERT_EQ(kMessageCount - 1u, taken);
+  EXPECT_EQ(taken, message_sequence.size);
+  EXPECT_EQ(taken, message_info_sequence.size);
+  for (size_t i = 0u; i < taken; ++i) {
+    EXPECT_EQ(static_cast<int32_t>(i), messages[i].int32_value);
+  }
+  // The message past the ones taken is left untouched
+  EXPECT_EQ(-1, messages[kMessageCount - 1u].int32_value);
+}
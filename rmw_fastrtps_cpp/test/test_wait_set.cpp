@@ -0,0 +1,459 @@
+// Copyright 2021 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/eventfd.h>
+#endif
+
+#include "gtest/gtest.h"
+
+#include "osrf_testing_tools_cpp/scope_exit.hpp"
+
+#include "rcutils/allocator.h"
+#include "rcutils/strdup.h"
+
+#include "rmw/error_handling.h"
+#include "rmw/message_sequence.h"
+#include "rmw/rmw.h"
+
+#include "rmw_fastrtps_shared_cpp/event_fd.hpp"
+
+#include "rosidl_typesupport_cpp/message_type_support.hpp"
+
+#include "test_msgs/msg/basic_types.hpp"
+
+class TestWaitSet : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    rmw_init_options_t options = rmw_get_zero_initialized_init_options();
+    rmw_ret_t ret = rmw_init_options_init(&options, rcutils_get_default_allocator());
+    ASSERT_EQ(RMW_RET_OK, ret) << rcutils_get_error_string().str;
+    OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+    {
+      rmw_ret_t ret = rmw_init_options_fini(&options);
+      EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    });
+    options.enclave = rcutils_strdup("/", rcutils_get_default_allocator());
+    ASSERT_STREQ("/", options.enclave);
+    ret = rmw_init(&options, &context);
+    ASSERT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    node = rmw_create_node(&context, "my_node", "/my_ns");
+    ASSERT_NE(nullptr, node) << rmw_get_error_string().str;
+
+    qos = rmw_qos_profile_default;
+    rmw_publisher_options_t pub_options = rmw_get_default_publisher_options();
+    pub = rmw_create_publisher(node, ts, "/test_wait_set", &qos, &pub_options);
+    ASSERT_NE(nullptr, pub) << rmw_get_error_string().str;
+    sub = create_subscription();
+    ASSERT_NE(nullptr, sub) << rmw_get_error_string().str;
+    wait_set = rmw_create_wait_set(&context, 1u);
+    ASSERT_NE(nullptr, wait_set) << rmw_get_error_string().str;
+  }
+
+  void TearDown() override
+  {
+    rmw_ret_t ret = rmw_destroy_wait_set(wait_set);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    if (nullptr != sub) {
+      ret = rmw_destroy_subscription(node, sub);
+      EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    }
+    ret = rmw_destroy_publisher(node, pub);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    ret = rmw_destroy_node(node);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    ret = rmw_shutdown(&context);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    ret = rmw_context_fini(&context);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+  }
+
+  rmw_subscription_t * create_subscription()
+  {
+    rmw_subscription_options_t sub_options = rmw_get_default_subscription_options();
+    return rmw_create_subscription(node, ts, "/test_wait_set", &qos, &sub_options);
+  }
+
+  void wait_for_match()
+  {
+    size_t matched = 0u;
+    for (size_t i = 0u; i < 100u && 0u == matched; ++i) {
+      ASSERT_EQ(RMW_RET_OK, rmw_publisher_count_matched_subscriptions(pub, &matched));
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    ASSERT_EQ(1u, matched);
+  }
+
+  void publish(int32_t value)
+  {
+    test_msgs::msg::BasicTypes msg;
+    msg.int32_value = value;
+    ASSERT_EQ(RMW_RET_OK, rmw_publish(pub, &msg, nullptr)) << rmw_get_error_string().str;
+  }
+
+  // Wait for the subscription only, returning whether it is ready
+  bool wait_for_subscription(rmw_wait_set_t * ws, const rmw_time_t & timeout)
+  {
+    void * subscribers[] = {sub->data};
+    rmw_subscriptions_t subscriptions{1u, subscribers};
+    rmw_ret_t ret = rmw_wait(&subscriptions, nullptr, nullptr, nullptr, nullptr, ws, &timeout);
+    EXPECT_TRUE(RMW_RET_OK == ret || RMW_RET_TIMEOUT == ret) << rmw_get_error_string().str;
+    return RMW_RET_OK == ret && nullptr != subscribers[0];
+  }
+
+  const rosidl_message_type_support_t * ts{
+    rosidl_typesupport_cpp::get_message_type_support_handle<test_msgs::msg::BasicTypes>()};
+  rmw_qos_profile_t qos;
+  rmw_context_t context{rmw_get_zero_initialized_context()};
+  rmw_node_t * node{nullptr};
+  rmw_publisher_t * pub{nullptr};
+  rmw_subscription_t * sub{nullptr};
+  rmw_wait_set_t * wait_set{nullptr};
+};
+
+TEST_F(TestWaitSet, sample_wakes_one_of_two_wait_sets) {
+  rmw_wait_set_t * other_wait_set = rmw_create_wait_set(&context, 1u);
+  ASSERT_NE(nullptr, other_wait_set) << rmw_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_wait_set(other_wait_set)) << rmw_get_error_string().str;
+  });
+  wait_for_match();
+
+  std::atomic_size_t woken{0u};
+  std::atomic_size_t taken{0u};
+  std::atomic_int32_t value{-1};
+  auto waiter = [this, &woken, &taken, &value](rmw_wait_set_t * ws) {
+      if (!wait_for_subscription(ws, {2, 0})) {
+        return;
+      }
+      ++woken;
+      test_msgs::msg::BasicTypes msg;
+      bool is_taken = false;
+      EXPECT_EQ(RMW_RET_OK, rmw_take(sub, &msg, &is_taken, nullptr)) <<
+        rmw_get_error_string().str;
+      if (is_taken) {
+        ++taken;
+        value = msg.int32_value;
+      }
+    };
+  std::thread first(waiter, wait_set);
+  std::thread second(waiter, other_wait_set);
+  // Let both waiters block before publishing
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  publish(42);
+  first.join();
+  second.join();
+
+  // The waiter that was not woken up times out once the sample has been taken
+  EXPECT_EQ(1u, woken.load());
+  EXPECT_EQ(1u, taken.load());
+  EXPECT_EQ(42, value.load());
+}
+
+TEST_F(TestWaitSet, ready_until_every_sample_is_taken) {
+  wait_for_match();
+  auto take = [this]() {
+      test_msgs::msg::BasicTypes msg;
+      bool taken = false;
+      EXPECT_EQ(RMW_RET_OK, rmw_take(sub, &msg, &taken, nullptr)) << rmw_get_error_string().str;
+      EXPECT_TRUE(taken);
+      return msg.int32_value;
+    };
+
+  // The second sample does not notify again, but the subscription stays ready for it
+  publish(1);
+  publish(2);
+  ASSERT_TRUE(wait_for_subscription(wait_set, {2, 0}));
+  EXPECT_EQ(1, take());
+  ASSERT_TRUE(wait_for_subscription(wait_set, {2, 0}));
+  EXPECT_EQ(2, take());
+  EXPECT_FALSE(wait_for_subscription(wait_set, {0, 0}));
+
+  // Once drained, the next sample notifies again
+  publish(3);
+  ASSERT_TRUE(wait_for_subscription(wait_set, {2, 0}));
+  EXPECT_EQ(3, take());
+}
+
+TEST_F(TestWaitSet, ready_until_sequence_is_taken) {
+  wait_for_match();
+  test_msgs::msg::BasicTypes messages[3];
+  rcutils_allocator_t allocator = rcutils_get_default_allocator();
+  rmw_message_sequence_t message_sequence = rmw_get_zero_initialized_message_sequence();
+  ASSERT_EQ(RMW_RET_OK, rmw_message_sequence_init(&message_sequence, 3u, &allocator));
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_message_sequence_fini(&message_sequence));
+  });
+  rmw_message_info_sequence_t message_info_sequence =
+    rmw_get_zero_initialized_message_info_sequence();
+  ASSERT_EQ(RMW_RET_OK, rmw_message_info_sequence_init(&message_info_sequence, 3u, &allocator));
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_message_info_sequence_fini(&message_info_sequence));
+  });
+  for (size_t i = 0u; i < 3u; ++i) {
+    message_sequence.data[i] = &messages[i];
+  }
+  auto take_sequence = [&](size_t count) {
+      size_t taken = 0u;
+      EXPECT_EQ(
+        RMW_RET_OK, rmw_take_sequence(
+          sub, count, &message_sequence, &message_info_sequence, &taken, nullptr)) <<
+        rmw_get_error_string().str;
+      return taken;
+    };
+
+  publish(1);
+  publish(2);
+  publish(3);
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  ASSERT_TRUE(wait_for_subscription(wait_set, {2, 0}));
+  EXPECT_EQ(2u, take_sequence(2u));
+  ASSERT_TRUE(wait_for_subscription(wait_set, {0, 0}));
+  // Taking exactly the samples left clears the flag, as does asking for more than are left
+  EXPECT_EQ(1u, take_sequence(1u));
+  EXPECT_EQ(3, messages[0].int32_value);
+  EXPECT_FALSE(wait_for_subscription(wait_set, {0, 0}));
+
+  publish(4);
+  ASSERT_TRUE(wait_for_subscription(wait_set, {2, 0}));
+  EXPECT_EQ(1u, take_sequence(3u));
+  EXPECT_EQ(4, messages[0].int32_value);
+  EXPECT_FALSE(wait_for_subscription(wait_set, {0, 0}));
+}
+
+TEST_F(TestWaitSet, not_ready_once_overflowing_history_is_taken) {
+  ASSERT_EQ(RMW_RET_OK, rmw_destroy_subscription(node, sub)) << rmw_get_error_string().str;
+  qos.history = RMW_QOS_POLICY_HISTORY_KEEP_LAST;
+  qos.depth = 1u;
+  sub = create_subscription();
+  ASSERT_NE(nullptr, sub) << rmw_get_error_string().str;
+  wait_for_match();
+
+  // Only the last of the samples is kept, and nothing is left once it is taken
+  for (int32_t value = 1; value <= 3; ++value) {
+    publish(value);
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  ASSERT_TRUE(wait_for_subscription(wait_set, {2, 0}));
+  test_msgs::msg::BasicTypes msg;
+  bool taken = false;
+  ASSERT_EQ(RMW_RET_OK, rmw_take(sub, &msg, &taken, nullptr)) << rmw_get_error_string().str;
+  ASSERT_TRUE(taken);
+  EXPECT_EQ(3, msg.int32_value);
+  EXPECT_FALSE(wait_for_subscription(wait_set, {0, 0}));
+
+  // The same goes when taking a sequence
+  for (int32_t value = 4; value <= 6; ++value) {
+    publish(value);
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  ASSERT_TRUE(wait_for_subscription(wait_set, {2, 0}));
+  rcutils_allocator_t allocator = rcutils_get_default_allocator();
+  rmw_message_sequence_t message_sequence = rmw_get_zero_initialized_message_sequence();
+  ASSERT_EQ(RMW_RET_OK, rmw_message_sequence_init(&message_sequence, 1u, &allocator));
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_message_sequence_fini(&message_sequence));
+  });
+  rmw_message_info_sequence_t message_info_sequence =
+    rmw_get_zero_initialized_message_info_sequence();
+  ASSERT_EQ(RMW_RET_OK, rmw_message_info_sequence_init(&message_info_sequence, 1u, &allocator));
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_message_info_sequence_fini(&message_info_sequence));
+  });
+  message_sequence.data[0] = &msg;
+  size_t taken_count = 0u;
+  ASSERT_EQ(
+    RMW_RET_OK, rmw_take_sequence(
+      sub, 1u, &message_sequence, &message_info_sequence, &taken_count, nullptr)) <<
+    rmw_get_error_string().str;
+  ASSERT_EQ(1u, taken_count);
+  EXPECT_EQ(6, msg.int32_value);
+  EXPECT_FALSE(wait_for_subscription(wait_set, {0, 0}));
+
+  // The next sample makes the subscription ready again
+  publish(7);
+  ASSERT_TRUE(wait_for_subscription(wait_set, {2, 0}));
+}
+
+TEST_F(TestWaitSet, guard_condition_wakes_all_wait_sets) {
+  rmw_wait_set_t * other_wait_set = rmw_create_wait_set(&context, 1u);
+  ASSERT_NE(nullptr, other_wait_set) << rmw_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_wait_set(other_wait_set)) << rmw_get_error_string().str;
+  });
+  rmw_guard_condition_t * guard_condition = rmw_create_guard_condition(&context);
+  ASSERT_NE(nullptr, guard_condition) << rmw_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_guard_condition(guard_condition)) <<
+      rmw_get_error_string().str;
+  });
+
+  // Wait for the guard condition only, returning whether it was triggered
+  auto wait_for_guard_condition = [guard_condition](rmw_wait_set_t * ws, rmw_time_t timeout) {
+      void * conditions[] = {guard_condition->data};
+      rmw_guard_conditions_t guard_conditions{1u, conditions};
+      rmw_ret_t ret = rmw_wait(nullptr, &guard_conditions, nullptr, nullptr, nullptr, ws, &timeout);
+      EXPECT_TRUE(RMW_RET_OK == ret || RMW_RET_TIMEOUT == ret) << rmw_get_error_string().str;
+      return RMW_RET_OK == ret && nullptr != conditions[0];
+    };
+
+  std::atomic_size_t woken{0u};
+  auto waiter = [&woken, &wait_for_guard_condition](rmw_wait_set_t * ws) {
+      if (wait_for_guard_condition(ws, {2, 0})) {
+        ++woken;
+      }
+    };
+  std::thread first(waiter, wait_set);
+  std::thread second(waiter, other_wait_set);
+  // Let both waiters block before triggering
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  ASSERT_EQ(RMW_RET_OK, rmw_trigger_guard_condition(guard_condition)) <<
+    rmw_get_error_string().str;
+  first.join();
+  second.join();
+  EXPECT_EQ(2u, woken.load());
+
+  // Each wait set consumed the trigger for itself only
+  EXPECT_FALSE(wait_for_guard_condition(wait_set, {0, 0}));
+  EXPECT_FALSE(wait_for_guard_condition(other_wait_set, {0, 0}));
+
+  // A trigger not waited for yet is seen by each wait set once
+  ASSERT_EQ(RMW_RET_OK, rmw_trigger_guard_condition(guard_condition)) <<
+    rmw_get_error_string().str;
+  EXPECT_TRUE(wait_for_guard_condition(wait_set, {0, 0}));
+  EXPECT_TRUE(wait_for_guard_condition(other_wait_set, {0, 0}));
+  EXPECT_FALSE(wait_for_guard_condition(wait_set, {0, 0}));
+  EXPECT_FALSE(wait_for_guard_condition(other_wait_set, {0, 0}));
+}
+
+TEST_F(TestWaitSet, destroy_entity_attached_between_waits) {
+  rmw_guard_condition_t * guard_condition = rmw_create_guard_condition(&context);
+  ASSERT_NE(nullptr, guard_condition) << rmw_get_error_string().str;
+  ASSERT_EQ(RMW_RET_OK, rmw_trigger_guard_condition(guard_condition)) <<
+    rmw_get_error_string().str;
+
+  // Both listeners stay attached to the wait set after this call
+  {
+    void * subscribers[] = {sub->data};
+    rmw_subscriptions_t subscriptions{1u, subscribers};
+    void * conditions[] = {guard_condition->data};
+    rmw_guard_conditions_t guard_conditions{1u, conditions};
+    rmw_time_t timeout{1, 0};
+    rmw_ret_t ret = rmw_wait(
+      &subscriptions, &guard_conditions, nullptr, nullptr, nullptr, wait_set, &timeout);
+    ASSERT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    EXPECT_EQ(nullptr, subscribers[0]);
+    EXPECT_NE(nullptr, conditions[0]);
+  }
+
+  EXPECT_EQ(RMW_RET_OK, rmw_destroy_guard_condition(guard_condition)) <<
+    rmw_get_error_string().str;
+  EXPECT_EQ(RMW_RET_OK, rmw_destroy_subscription(node, sub)) << rmw_get_error_string().str;
+
+  // A new subscription may reuse the address of the destroyed one
+  sub = create_subscription();
+  ASSERT_NE(nullptr, sub) << rmw_get_error_string().str;
+  EXPECT_FALSE(wait_for_subscription(wait_set, {0, 100000000}));
+  wait_for_match();
+  publish(1);
+  EXPECT_TRUE(wait_for_subscription(wait_set, {5, 0}));
+}
+
+#ifdef __linux__
+static bool
+is_readable(int fd, int timeout_ms)
+{
+  struct pollfd pfd = {fd, POLLIN, 0};
+  return ::poll(&pfd, 1, timeout_ms) == 1 && (pfd.revents & POLLIN);
+}
+
+TEST_F(TestWaitSet, subscription_event_fd_is_readable_while_there_is_data) {
+  int fd = -1;
+  ASSERT_EQ(
+    RMW_RET_OK, rmw_fastrtps_shared_cpp::get_subscription_event_fd(
+      rmw_get_implementation_identifier(), sub, &fd)) << rmw_get_error_string().str;
+  // Nothing was received yet
+  EXPECT_FALSE(is_readable(fd, 0));
+  wait_for_match();
+
+  publish(1);
+  publish(2);
+  ASSERT_TRUE(is_readable(fd, 2000));
+  size_t taken_count = 0u;
+  for (size_t i = 0u; i < 100u && taken_count < 2u; ++i) {
+    test_msgs::msg::BasicTypes msg;
+    bool taken = false;
+    ASSERT_EQ(RMW_RET_OK, rmw_take(sub, &msg, &taken, nullptr)) << rmw_get_error_string().str;
+    if (taken) {
+      ++taken_count;
+    } else {
+      ASSERT_TRUE(is_readable(fd, 2000));
+    }
+  }
+  ASSERT_EQ(2u, taken_count);
+  // Cleared once drained, without reading it
+  EXPECT_FALSE(is_readable(fd, 0));
+
+  publish(3);
+  EXPECT_TRUE(is_readable(fd, 2000));
+}
+
+TEST_F(TestWaitSet, wait_set_event_fd_is_not_readable_once_drained) {
+  int fd = -1;
+  ASSERT_EQ(
+    RMW_RET_OK, rmw_fastrtps_shared_cpp::get_wait_set_event_fd(
+      rmw_get_implementation_identifier(), wait_set, &fd)) << rmw_get_error_string().str;
+  // Attach the subscription, then clear the eventfd, which starts readable
+  EXPECT_FALSE(wait_for_subscription(wait_set, {0, 0}));
+  eventfd_t value = 0;
+  ASSERT_EQ(0, ::eventfd_read(fd, &value));
+  EXPECT_FALSE(is_readable(fd, 0));
+  wait_for_match();
+
+  publish(1);
+  publish(2);
+  ASSERT_TRUE(is_readable(fd, 2000));
+  // Let the second sample arrive, so that it would signal the eventfd again
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  ASSERT_EQ(0, ::eventfd_read(fd, &value));
+  size_t taken_count = 0u;
+  while (wait_for_subscription(wait_set, {0, 0})) {
+    test_msgs::msg::BasicTypes msg;
+    bool taken = false;
+    ASSERT_EQ(RMW_RET_OK, rmw_take(sub, &msg, &taken, nullptr)) << rmw_get_error_string().str;
+    if (taken) {
+      ++taken_count;
+    }
+  }
+  EXPECT_EQ(2u, taken_count);
+  EXPECT_FALSE(is_readable(fd, 0));
+
+  publish(3);
+  EXPECT_TRUE(is_readable(fd, 2000));
+}
+#endif
@@ -0,0 +1,157 @@
+// Copyright 2021 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <chrono>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+#include "osrf_testing_tools_cpp/scope_exit.hpp"
+
+#include "rcutils/allocator.h"
+#include "rcutils/strdup.h"
+
+#include "rmw/error_handling.h"
+#include "rmw/rmw.h"
+
+#include "rmw_fastrtps_shared_cpp/wait_set_spin.hpp"
+
+#include "rosidl_typesupport_cpp/message_type_support.hpp"
+
+#include "test_msgs/msg/basic_types.hpp"
+
+// Run with RMW_FASTRTPS_WAIT_SPIN_US=-1, which strtoull() would wrap around instead of rejecting
+class TestWaitSetSpin : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    rmw_init_options_t options = rmw_get_zero_initialized_init_options();
+    rmw_ret_t ret = rmw_init_options_init(&options, rcutils_get_default_allocator());
+    ASSERT_EQ(RMW_RET_OK, ret) << rcutils_get_error_string().str;
+    OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+    {
+      rmw_ret_t ret = rmw_init_options_fini(&options);
+      EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    });
+    options.enclave = rcutils_strdup("/", rcutils_get_default_allocator());
+    ASSERT_STREQ("/", options.enclave);
+    ret = rmw_init(&options, &context);
+    ASSERT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    node = rmw_create_node(&context, "my_node", "/my_ns");
+    ASSERT_NE(nullptr, node) << rmw_get_error_string().str;
+    wait_set = rmw_create_wait_set(&context, 1u);
+    ASSERT_NE(nullptr, wait_set) << rmw_get_error_string().str;
+  }
+
+  void TearDown() override
+  {
+    rmw_ret_t ret = rmw_destroy_wait_set(wait_set);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    ret = rmw_destroy_node(node);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    ret = rmw_shutdown(&context);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    ret = rmw_context_fini(&context);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+  }
+
+  rmw_fastrtps_shared_cpp::WaitSetSpinStatistics get_statistics()
+  {
+    rmw_fastrtps_shared_cpp::WaitSetSpinStatistics statistics{};
+    EXPECT_EQ(
+      RMW_RET_OK,
+      rmw_fastrtps_shared_cpp::get_wait_set_spin_statistics(identifier, wait_set, &statistics)) <<
+      rmw_get_error_string().str;
+    return statistics;
+  }
+
+  const char * identifier{rmw_get_implementation_identifier()};
+  rmw_context_t context{rmw_get_zero_initialized_context()};
+  rmw_node_t * node{nullptr};
+  rmw_wait_set_t * wait_set{nullptr};
+};
+
+TEST_F(TestWaitSetSpin, negative_environment_value_disables_spinning) {
+  EXPECT_EQ(0u, get_statistics().spin_budget_ns);
+}
+
+TEST_F(TestWaitSetSpin, max_spin_is_limited) {
+  ASSERT_EQ(
+    RMW_RET_OK,
+    rmw_fastrtps_shared_cpp::set_wait_set_max_spin(identifier, wait_set, 60000000000u)) <<
+    rmw_get_error_string().str;
+  EXPECT_EQ(1000000000u, get_statistics().spin_budget_ns);
+
+  ASSERT_EQ(
+    RMW_RET_OK,
+    rmw_fastrtps_shared_cpp::set_wait_set_max_spin(identifier, wait_set, 1000u)) <<
+    rmw_get_error_string().str;
+  EXPECT_EQ(1000u, get_statistics().spin_budget_ns);
+}
+
+TEST_F(TestWaitSetSpin, spin_hit_when_data_arrives_within_budget) {
+  ASSERT_EQ(
+    RMW_RET_OK,
+    rmw_fastrtps_shared_cpp::set_wait_set_max_spin(identifier, wait_set, 1000000000u)) <<
+    rmw_get_error_string().str;
+
+  const rosidl_message_type_support_t * ts =
+    rosidl_typesupport_cpp::get_message_type_support_handle<test_msgs::msg::BasicTypes>();
+  rmw_publisher_options_t pub_options = rmw_get_default_publisher_options();
+  rmw_publisher_t * pub = rmw_create_publisher(
+    node, ts, "/test_wait_set_spin", &rmw_qos_profile_default, &pub_options);
+  ASSERT_NE(nullptr, pub) << rmw_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_publisher(node, pub)) << rmw_get_error_string().str;
+  });
+  rmw_subscription_options_t sub_options = rmw_get_default_subscription_options();
+  rmw_subscription_t * sub = rmw_create_subscription(
+    node, ts, "/test_wait_set_spin", &rmw_qos_profile_default, &sub_options);
+  ASSERT_NE(nullptr, sub) << rmw_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_subscription(node, sub)) << rmw_get_error_string().str;
+  });
+  size_t matched = 0u;
+  for (size_t i = 0u; i < 100u && 0u == matched; ++i) {
+    ASSERT_EQ(RMW_RET_OK, rmw_publisher_count_matched_subscriptions(pub, &matched));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+  ASSERT_EQ(1u, matched);
+
+  std::thread publisher(
+    [pub]() {
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+      test_msgs::msg::BasicTypes msg;
+      msg.int32_value = 1;
+      EXPECT_EQ(RMW_RET_OK, rmw_publish(pub, &msg, nullptr)) << rmw_get_error_string().str;
+    });
+  void * subscribers[] = {sub->data};
+  rmw_subscriptions_t subscriptions{1u, subscribers};
+  rmw_time_t timeout{5, 0};
+  EXPECT_EQ(
+    RMW_RET_OK,
+    rmw_wait(&subscriptions, nullptr, nullptr, nullptr, nullptr, wait_set, &timeout)) <<
+    rmw_get_error_string().str;
+  EXPECT_NE(nullptr, subscribers[0]);
+  publisher.join();
+
+  rmw_fastrtps_shared_cpp::WaitSetSpinStatistics statistics = get_statistics();
+  EXPECT_EQ(1u, statistics.spin_hits);
+  EXPECT_EQ(0u, statistics.spin_misses);
+  EXPECT_GT(statistics.spin_budget_ns, 0u);
+  EXPECT_LE(statistics.spin_budget_ns, 1000000000u);
+}
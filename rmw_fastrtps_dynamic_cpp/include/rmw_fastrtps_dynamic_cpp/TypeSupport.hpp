@@ -15,7 +15,10 @@
 #ifndef RMW_FASTRTPS_DYNAMIC_CPP__TYPESUPPORT_HPP_
 #define RMW_FASTRTPS_DYNAMIC_CPP__TYPESUPPORT_HPP_
 
+#include <algorithm>
 #include <cassert>
+#include <cstring>
+#include <stdexcept>
 #include <string>
 
 #include "rosidl_runtime_c/string.h"
@@ -24,6 +27,7 @@
 #include "fastcdr/FastBuffer.h"
 #include "fastcdr/Cdr.h"
 
+#include "rcutils/allocator.h"
 #include "rcutils/logging_macros.h"
 
 #include "rosidl_typesupport_introspection_cpp/field_types.hpp"
@@ -99,12 +103,65 @@ struct StringHelper<rosidl_typesupport_introspection_c__MessageMembers>
     return std::string(data.data);
   }
 
+  // Deserialize in place, only reallocating the string if it is too small.
+  // The length is read from the buffer, and fastcdr doesn't tell how much of the buffer is
+  // left, so the string is grown as its characters are read: a length the buffer doesn't
+  // hold throws once its end is reached, before more than about twice its size is allocated.
   static void assign(eprosima::fastcdr::Cdr & deser, void * field)
   {
-    std::string str;
-    deser >> str;
     rosidl_runtime_c__String * c_str = static_cast<rosidl_runtime_c__String *>(field);
-    rosidl_runtime_c__String__assign(c_str, str.c_str());
+    uint32_t length = 0;
+    deser >> length;
+    const size_t required = static_cast<size_t>(length) + 1u;
+    size_t read = 0u;
+    while (true) {
+      // Read the characters that fit, leaving room for the terminating null character
+      size_t fit = c_str->capacity > 0u ? std::min(c_str->capacity - 1u, required - 1u) : 0u;
+      if (fit > read) {
+        deser.deserializeArray(c_str->data + read, fit - read);
+        read = fit;
+      }
+      if (c_str->capacity >= required) {
+        break;
+      }
+      size_t capacity = std::min(std::max<size_t>(2u * c_str->capacity, 64u), required);
+      rcutils_allocator_t allocator = rcutils_get_default_allocator();
+      auto data = static_cast<char *>(
+        allocator.reallocate(c_str->data, capacity, allocator.state));
+      if (!data) {
+        throw std::runtime_error("unable to allocate rosidl_runtime_c__String");
+      }
+      c_str->data = data;
+      c_str->capacity = capacity;
+    }
+    // The serialized length includes the terminating null character
+    if (length > 0u && '\0' == c_str->data[length - 1]) {
+      --length;
+    }
+    c_str->data[length] = '\0';
+    c_str->size = length;
+  }
+
+  // Copy in place, only reallocating the destination string if it is too small
+  static void copy(const void * src_field, void * dst_field)
+  {
+    auto src = static_cast<const rosidl_runtime_c__String *>(src_field);
+    auto dst = static_cast<rosidl_runtime_c__String *>(dst_field);
+    if (dst->capacity < src->size + 1u) {
+      rcutils_allocator_t allocator = rcutils_get_default_allocator();
+      auto data = static_cast<char *>(
+        allocator.reallocate(dst->data, src->size + 1u, allocator.state));
+      if (!data) {
+        throw std::runtime_error("unable to allocate rosidl_runtime_c__String");
+      }
+      dst->data = data;
+      dst->capacity = src->size + 1u;
+    }
+    if (src->size > 0u) {
+      memcpy(dst->data, src->data, src->size);
+    }
+    dst->data[src->size] = '\0';
+    dst->size = src->size;
   }
 };
 
@@ -138,6 +195,15 @@ public:
 
   bool deserializeROSmessage(
     eprosima::fastcdr::Cdr & deser, void * ros_message, const void * impl) const override;
+
+  bool can_copy_ros_messages() const override;
+
+  void * createROSmessage(const void * impl) const override;
+
+  void deleteROSmessage(void * ros_message, const void * impl) const override;
+
+  bool copyROSmessage(
+    const void * src_ros_message, void * dst_ros_message, const void * impl) const override;
 };
 
 class BaseTypeSupport : public rmw_fastrtps_shared_cpp::TypeSupport
@@ -170,6 +236,15 @@ public:
   bool deserializeROSmessage(
     eprosima::fastcdr::Cdr & deser, void * ros_message, const void * impl) const override;
 
+  bool can_copy_ros_messages() const override;
+
+  void * createROSmessage(const void * impl) const override;
+
+  void deleteROSmessage(void * ros_message, const void * impl) const override;
+
+  bool copyROSmessage(
+    const void * src_ros_message, void * dst_ros_message, const void * impl) const override;
+
 protected:
   explicit TypeSupport(const void * ros_type_support);
 
@@ -192,6 +267,11 @@ private:
     eprosima::fastcdr::Cdr & deser,
     const MembersType * members,
     void * ros_message) const;
+
+  bool copyROSmessage(
+    const MembersType * members,
+    const void * src_ros_message,
+    void * dst_ros_message) const;
 };
 
 }  // namespace rmw_fastrtps_dynamic_cpp
@@ -15,7 +15,9 @@
 #ifndef RMW_FASTRTPS_DYNAMIC_CPP__TYPESUPPORT_IMPL_HPP_
 #define RMW_FASTRTPS_DYNAMIC_CPP__TYPESUPPORT_IMPL_HPP_
 
+#include <algorithm>
 #include <cassert>
+#include <cstdlib>
 #include <string>
 #include <vector>
 
@@ -37,6 +39,7 @@
 #include "rosidl_typesupport_introspection_c/message_introspection.h"
 #include "rosidl_typesupport_introspection_c/service_introspection.h"
 
+#include "rosidl_runtime_c/message_initialization.h"
 #include "rosidl_runtime_c/primitives_sequence_functions.h"
 #include "rosidl_runtime_c/u16string_functions.h"
 
@@ -634,7 +637,9 @@ void deserialize_field(
     auto & data = *reinterpret_cast<typename GenericCSequence<T>::type *>(field);
     int32_t dsize = 0;
     deser >> dsize;
-    GenericCSequence<T>::init(&data, dsize);
+    if (!GenericCSequence<T>::resize(&data, dsize)) {
+      throw std::runtime_error("unable to initialize rosidl_runtime_c sequence");
+    }
     deser.deserializeArray(reinterpret_cast<T *>(data.data), dsize);
   }
 }
@@ -645,41 +650,33 @@ inline void deserialize_field<std::string>(
   void * field,
   eprosima::fastcdr::Cdr & deser)
 {
+  using CStringHelper = StringHelper<rosidl_typesupport_introspection_c__MessageMembers>;
   if (!member->is_array_) {
-    using CStringHelper = StringHelper<rosidl_typesupport_introspection_c__MessageMembers>;
     CStringHelper::assign(deser, field);
   } else {
     if (member->array_size_ && !member->is_upper_bound_) {
       auto deser_field = static_cast<rosidl_runtime_c__String *>(field);
-      // tmpstring is defined here and not below to avoid
-      // memory allocation in every iteration of the for loop
-      std::string tmpstring;
       for (size_t i = 0; i < member->array_size_; ++i) {
-        deser.deserialize(tmpstring);
-        if (!rosidl_runtime_c__String__assign(&deser_field[i], tmpstring.c_str())) {
-          throw std::runtime_error("unable to assign rosidl_runtime_c__String");
-        }
+        CStringHelper::assign(deser, &deser_field[i]);
       }
     } else {
-      std::vector<std::string> cpp_string_vector;
-      deser >> cpp_string_vector;
+      uint32_t size = 0;
+      deser >> size;
 
+      // The strings up to the capacity of the sequence are initialized, and reused
       auto & string_sequence_field =
         *reinterpret_cast<rosidl_runtime_c__String__Sequence *>(field);
-      if (
-        !rosidl_runtime_c__String__Sequence__init(
-          &string_sequence_field, cpp_string_vector.size()))
-      {
-        throw std::runtime_error("unable to initialize rosidl_runtime_c__String array");
+      if (size <= string_sequence_field.capacity) {
+        string_sequence_field.size = size;
+      } else {
+        rosidl_runtime_c__String__Sequence__fini(&string_sequence_field);
+        if (!rosidl_runtime_c__String__Sequence__init(&string_sequence_field, size)) {
+          throw std::runtime_error("unable to initialize rosidl_runtime_c__String array");
+        }
       }
 
-      for (size_t i = 0; i < cpp_string_vector.size(); ++i) {
-        if (
-          !rosidl_runtime_c__String__assign(
-            &string_sequence_field.data[i], cpp_string_vector[i].c_str()))
-        {
-          throw std::runtime_error("unable to assign rosidl_runtime_c__String");
-        }
+      for (size_t i = 0; i < size; ++i) {
+        CStringHelper::assign(deser, &string_sequence_field.data[i]);
       }
     }
   }
@@ -716,6 +713,35 @@ inline void deserialize_field<std::wstring>(
   }
 }
 
+inline void resize_message_sequence(
+  const rosidl_typesupport_introspection_cpp::MessageMember * member,
+  void * field,
+  size_t size)
+{
+  member->resize_function(field, size);
+}
+
+inline void resize_message_sequence(
+  const rosidl_typesupport_introspection_c__MessageMember * member,
+  void * field,
+  size_t size)
+{
+  // Every C sequence of messages has this layout, and its elements are initialized up to
+  // its capacity, so they are reused instead of finalizing and reallocating all of them
+  struct GenericCMessageSequence
+  {
+    void * data;
+    size_t size;
+    size_t capacity;
+  };
+  auto sequence = static_cast<GenericCMessageSequence *>(field);
+  if (size <= sequence->capacity) {
+    sequence->size = size;
+    return;
+  }
+  member->resize_function(field, size);
+}
+
 template<typename MembersType>
 bool TypeSupport<MembersType>::deserializeROSmessage(
   eprosima::fastcdr::Cdr & deser,
@@ -791,7 +817,7 @@ bool TypeSupport<MembersType>::deserializeROSmessage(
                 RMW_SET_ERROR_MSG("unexpected error: resize function is null");
                 return false;
               }
-              member->resize_function(field, array_size);
+              resize_message_sequence(member, field, array_size);
             }
 
             if (array_size != 0 && !member->get_function) {
@@ -814,6 +840,226 @@ bool TypeSupport<MembersType>::deserializeROSmessage(
   return true;
 }
 
+// C++ specialization
+template<typename T>
+void copy_field(
+  const rosidl_typesupport_introspection_cpp::MessageMember * member,
+  const void * src_field,
+  void * dst_field)
+{
+  if (!member->is_array_) {
+    *static_cast<T *>(dst_field) = *static_cast<const T *>(src_field);
+  } else if (member->array_size_ && !member->is_upper_bound_) {
+    std::copy_n(
+      static_cast<const T *>(src_field), member->array_size_, static_cast<T *>(dst_field));
+  } else {
+    *reinterpret_cast<std::vector<T> *>(dst_field) =
+      *reinterpret_cast<const std::vector<T> *>(src_field);
+  }
+}
+
+template<>
+inline void copy_field<std::wstring>(
+  const rosidl_typesupport_introspection_cpp::MessageMember * member,
+  const void * src_field,
+  void * dst_field)
+{
+  copy_field<std::u16string>(member, src_field, dst_field);
+}
+
+// C specialization
+template<typename T>
+void copy_field(
+  const rosidl_typesupport_introspection_c__MessageMember * member,
+  const void * src_field,
+  void * dst_field)
+{
+  if (!member->is_array_) {
+    *static_cast<T *>(dst_field) = *static_cast<const T *>(src_field);
+  } else if (member->array_size_ && !member->is_upper_bound_) {
+    std::copy_n(
+      static_cast<const T *>(src_field), member->array_size_, static_cast<T *>(dst_field));
+  } else {
+    auto & src = *reinterpret_cast<const typename GenericCSequence<T>::type *>(src_field);
+    auto & dst = *reinterpret_cast<typename GenericCSequence<T>::type *>(dst_field);
+    if (!GenericCSequence<T>::resize(&dst, src.size)) {
+      throw std::runtime_error("unable to initialize rosidl_runtime_c sequence");
+    }
+    std::copy_n(src.data, src.size, dst.data);
+  }
+}
+
+template<>
+inline void copy_field<std::string>(
+  const rosidl_typesupport_introspection_c__MessageMember * member,
+  const void * src_field,
+  void * dst_field)
+{
+  using CStringHelper = StringHelper<rosidl_typesupport_introspection_c__MessageMembers>;
+  if (!member->is_array_) {
+    CStringHelper::copy(src_field, dst_field);
+  } else if (member->array_size_ && !member->is_upper_bound_) {
+    auto src_array = static_cast<const rosidl_runtime_c__String *>(src_field);
+    auto dst_array = static_cast<rosidl_runtime_c__String *>(dst_field);
+    for (size_t i = 0; i < member->array_size_; ++i) {
+      CStringHelper::copy(&src_array[i], &dst_array[i]);
+    }
+  } else {
+    auto & src = *static_cast<const rosidl_runtime_c__String__Sequence *>(src_field);
+    auto & dst = *static_cast<rosidl_runtime_c__String__Sequence *>(dst_field);
+    // The strings up to the capacity of the sequence are initialized, and reused
+    if (src.size <= dst.capacity) {
+      dst.size = src.size;
+    } else {
+      rosidl_runtime_c__String__Sequence__fini(&dst);
+      if (!rosidl_runtime_c__String__Sequence__init(&dst, src.size)) {
+        throw std::runtime_error("unable to initialize rosidl_runtime_c__String array");
+      }
+    }
+    for (size_t i = 0; i < src.size; ++i) {
+      CStringHelper::copy(&src.data[i], &dst.data[i]);
+    }
+  }
+}
+
+template<>
+inline void copy_field<std::wstring>(
+  const rosidl_typesupport_introspection_c__MessageMember * member,
+  const void * src_field,
+  void * dst_field)
+{
+  auto copy = [](const rosidl_runtime_c__U16String & src, rosidl_runtime_c__U16String & dst) {
+      if (!rosidl_runtime_c__U16String__assignn(&dst, src.data, src.size)) {
+        throw std::runtime_error("unable to allocate rosidl_runtime_c__U16String");
+      }
+    };
+  if (!member->is_array_) {
+    copy(
+      *static_cast<const rosidl_runtime_c__U16String *>(src_field),
+      *static_cast<rosidl_runtime_c__U16String *>(dst_field));
+  } else if (member->array_size_ && !member->is_upper_bound_) {
+    auto src_array = static_cast<const rosidl_runtime_c__U16String *>(src_field);
+    auto dst_array = static_cast<rosidl_runtime_c__U16String *>(dst_field);
+    for (size_t i = 0; i < member->array_size_; ++i) {
+      copy(src_array[i], dst_array[i]);
+    }
+  } else {
+    auto & src = *static_cast<const rosidl_runtime_c__U16String__Sequence *>(src_field);
+    auto & dst = *static_cast<rosidl_runtime_c__U16String__Sequence *>(dst_field);
+    if (src.size <= dst.capacity) {
+      dst.size = src.size;
+    } else {
+      rosidl_runtime_c__U16String__Sequence__fini(&dst);
+      if (!rosidl_runtime_c__U16String__Sequence__init(&dst, src.size)) {
+        throw std::runtime_error("unable to initialize rosidl_runtime_c__U16String sequence");
+      }
+    }
+    for (size_t i = 0; i < src.size; ++i) {
+      copy(src.data[i], dst.data[i]);
+    }
+  }
+}
+
+template<typename MembersType>
+bool TypeSupport<MembersType>::copyROSmessage(
+  const MembersType * members,
+  const void * src_ros_message,
+  void * dst_ros_message) const
+{
+  assert(members);
+  assert(src_ros_message);
+  assert(dst_ros_message);
+
+  for (uint32_t i = 0; i < members->member_count_; ++i) {
+    const auto * member = members->members_ + i;
+    const void * src_field = static_cast<const char *>(src_ros_message) + member->offset_;
+    void * dst_field = static_cast<char *>(dst_ros_message) + member->offset_;
+    switch (member->type_id_) {
+      case ::rosidl_typesupport_introspection_cpp::ROS_TYPE_BOOL:
+        copy_field<bool>(member, src_field, dst_field);
+        break;
+      case ::rosidl_typesupport_introspection_cpp::ROS_TYPE_BYTE:
+      case ::rosidl_typesupport_introspection_cpp::ROS_TYPE_UINT8:
+        copy_field<uint8_t>(member, src_field, dst_field);
+        break;
+      case ::rosidl_typesupport_introspection_cpp::ROS_TYPE_CHAR:
+      case ::rosidl_typesupport_introspection_cpp::ROS_TYPE_INT8:
+        copy_field<char>(member, src_field, dst_field);
+        break;
+      case ::rosidl_typesupport_introspection_cpp::ROS_TYPE_FLOAT32:
+        copy_field<float>(member, src_field, dst_field);
+        break;
+      case ::rosidl_typesupport_introspection_cpp::ROS_TYPE_FLOAT64:
+        copy_field<double>(member, src_field, dst_field);
+        break;
+      case ::rosidl_typesupport_introspection_cpp::ROS_TYPE_INT16:
+        copy_field<int16_t>(member, src_field, dst_field);
+        break;
+      case ::rosidl_typesupport_introspection_cpp::ROS_TYPE_UINT16:
+        copy_field<uint16_t>(member, src_field, dst_field);
+        break;
+      case ::rosidl_typesupport_introspection_cpp::ROS_TYPE_INT32:
+        copy_field<int32_t>(member, src_field, dst_field);
+        break;
+      case ::rosidl_typesupport_introspection_cpp::ROS_TYPE_UINT32:
+        copy_field<uint32_t>(member, src_field, dst_field);
+        break;
+      case ::rosidl_typesupport_introspection_cpp::ROS_TYPE_INT64:
+        copy_field<int64_t>(member, src_field, dst_field);
+        break;
+      case ::rosidl_typesupport_introspection_cpp::ROS_TYPE_UINT64:
+        copy_field<uint64_t>(member, src_field, dst_field);
+        break;
+      case ::rosidl_typesupport_introspection_cpp::ROS_TYPE_STRING:
+        copy_field<std::string>(member, src_field, dst_field);
+        break;
+      case ::rosidl_typesupport_introspection_cpp::ROS_TYPE_WSTRING:
+        copy_field<std::wstring>(member, src_field, dst_field);
+        break;
+      case ::rosidl_typesupport_introspection_cpp::ROS_TYPE_MESSAGE:
+        {
+          auto sub_members = static_cast<const MembersType *>(member->members_->data);
+          if (!member->is_array_) {
+            if (!copyROSmessage(sub_members, src_field, dst_field)) {
+              return false;
+            }
+          } else {
+            size_t array_size = 0;
+
+            if (member->array_size_ && !member->is_upper_bound_) {
+              array_size = member->array_size_;
+            } else {
+              if (!member->size_function || !member->resize_function) {
+                RMW_SET_ERROR_MSG("unexpected error: size or resize function is null");
+                return false;
+              }
+              array_size = member->size_function(src_field);
+              resize_message_sequence(member, dst_field, array_size);
+            }
+
+            if (array_size != 0 && (!member->get_const_function || !member->get_function)) {
+              RMW_SET_ERROR_MSG("unexpected error: get_function function is null");
+              return false;
+            }
+            for (size_t index = 0; index < array_size; ++index) {
+              if (!copyROSmessage(
+                  sub_members, member->get_const_function(src_field, index),
+                  member->get_function(dst_field, index)))
+              {
+                return false;
+              }
+            }
+          }
+        }
+        break;
+      default:
+        throw std::runtime_error("unknown type");
+    }
+  }
+
+  return true;
+}
+
 template<typename MembersType>
 size_t TypeSupport<MembersType>::calculateMaxSerializedSize(
   const MembersType * members, size_t current_alignment)
@@ -967,11 +1213,85 @@ bool TypeSupport<MembersType>::deserializeROSmessage(
       "Fast CDR exception deserializing message of type %s.",
       getName());
     return false;
+  } catch (const std::exception & e) {
+    // A field could not be allocated
+    RMW_SET_ERROR_MSG_WITH_FORMAT_STRING(
+      "failed to deserialize message of type %s: %s", getName(), e.what());
+    return false;
   }
 
   return true;
 }
 
+template<typename MembersType>
+bool TypeSupport<MembersType>::can_copy_ros_messages() const
+{
+  return true;
+}
+
+inline void init_ros_message(
+  const rosidl_typesupport_introspection_cpp::MessageMembers * members,
+  void * ros_message)
+{
+  members->init_function(ros_message, rosidl_runtime_cpp::MessageInitialization::ALL);
+}
+
+inline void init_ros_message(
+  const rosidl_typesupport_introspection_c__MessageMembers * members,
+  void * ros_message)
+{
+  members->init_function(ros_message, ROSIDL_RUNTIME_C_MSG_INIT_ALL);
+}
+
+template<typename MembersType>
+void * TypeSupport<MembersType>::createROSmessage(const void * impl) const
+{
+  assert(members_);
+
+  (void)impl;
+  void * ros_message = std::calloc(1, members_->size_of_);
+  if (!ros_message) {
+    return nullptr;
+  }
+  try {
+    init_ros_message(members_, ros_message);
+  } catch (const std::exception &) {
+    std::free(ros_message);
+    return nullptr;
+  }
+  return ros_message;
+}
+
+template<typename MembersType>
+void TypeSupport<MembersType>::deleteROSmessage(void * ros_message, const void * impl) const
+{
+  assert(members_);
+
+  (void)impl;
+  if (ros_message) {
+    members_->fini_function(ros_message);
+    std::free(ros_message);
+  }
+}
+
+template<typename MembersType>
+bool TypeSupport<MembersType>::copyROSmessage(
+  const void * src_ros_message, void * dst_ros_message, const void * impl) const
+{
+  assert(src_ros_message);
+  assert(dst_ros_message);
+  assert(members_);
+
+  (void)impl;
+  try {
+    return TypeSupport::copyROSmessage(members_, src_ros_message, dst_ros_message);
+  } catch (const std::exception & e) {
+    RMW_SET_ERROR_MSG_WITH_FORMAT_STRING(
+      "failed to copy message of type %s: %s", getName(), e.what());
+    return false;
+  }
+}
+
 }  // namespace rmw_fastrtps_dynamic_cpp
 
 #endif  // RMW_FASTRTPS_DYNAMIC_CPP__TYPESUPPORT_IMPL_HPP_
@@ -31,6 +31,16 @@
     static bool init(type * array, size_t size) { \
       return rosidl_runtime_c__ ## C_NAME ## __Sequence__init(array, size); \
     } \
+ \
+    /* Keep the storage of the sequence if it is large enough */ \
+    static bool resize(type * array, size_t size) { \
+      if (size <= array->capacity) { \
+        array->size = size; \
+        return true; \
+      } \
+      fini(array); \
+      return init(array, size); \
+    } \
   };
 
 #endif  // RMW_FASTRTPS_DYNAMIC_CPP__MACROS_HPP_
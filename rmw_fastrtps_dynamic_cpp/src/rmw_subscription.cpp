@@ -15,12 +15,15 @@
 #include <string>
 #include <utility>
 
+#include "rcutils/error_handling.h"
+
 #include "rmw/allocators.h"
 #include "rmw/error_handling.h"
 #include "rmw/rmw.h"
 
 #include "rmw_fastrtps_shared_cpp/custom_participant_info.hpp"
 #include "rmw_fastrtps_shared_cpp/custom_subscriber_info.hpp"
+#include "rmw_fastrtps_shared_cpp/discovery_batch.hpp"
 #include "rmw_fastrtps_shared_cpp/rmw_common.hpp"
 #include "rmw_fastrtps_shared_cpp/rmw_context_impl.hpp"
 #include "rmw_fastrtps_shared_cpp/subscription.hpp"
@@ -39,21 +42,53 @@ rmw_init_subscription_allocation(
   const rosidl_runtime_c__Sequence__bound * message_bounds,
   rmw_subscription_allocation_t * allocation)
 {
-  // Unused in current implementation.
-  (void) type_support;
+  // Message bounds cannot bound sequences yet. Sequences and strings are deserialized
+  // reusing the storage of the message taken into, so the message plays that role.
   (void) message_bounds;
-  (void) allocation;
-  RMW_SET_ERROR_MSG("unimplemented");
-  return RMW_RET_UNSUPPORTED;
+  RMW_CHECK_ARGUMENT_FOR_NULL(type_support, RMW_RET_INVALID_ARGUMENT);
+  RMW_CHECK_ARGUMENT_FOR_NULL(allocation, RMW_RET_INVALID_ARGUMENT);
+
+  const rosidl_message_type_support_t * type_support_handle = get_message_typesupport_handle(
+    type_support, rosidl_typesupport_introspection_c__identifier);
+  if (!type_support_handle) {
+    rcutils_reset_error();
+    type_support_handle = get_message_typesupport_handle(
+      type_support, rosidl_typesupport_introspection_cpp::typesupport_identifier);
+    if (!type_support_handle) {
+      rcutils_reset_error();
+      RMW_SET_ERROR_MSG("type support not from this implementation");
+      return RMW_RET_INVALID_ARGUMENT;
+    }
+  }
+
+  // The type support is kept until the allocation is finalized, as subscriptions share it
+  TypeSupportRegistry & type_registry = TypeSupportRegistry::get_instance();
+  auto type_impl = type_registry.get_message_type_support(type_support_handle);
+  if (!type_impl) {
+    RMW_SET_ERROR_MSG("failed to get message_type_support");
+    return RMW_RET_ERROR;
+  }
+  rmw_ret_t ret = rmw_fastrtps_shared_cpp::__rmw_init_subscription_allocation(
+    eprosima_fastrtps_identifier, type_impl, type_support_handle, allocation);
+  if (RMW_RET_OK != ret) {
+    type_registry.return_message_type_support(type_support_handle);
+  }
+  return ret;
 }
 
 rmw_ret_t
 rmw_fini_subscription_allocation(rmw_subscription_allocation_t * allocation)
 {
-  // Unused in current implementation.
-  (void) allocation;
-  RMW_SET_ERROR_MSG("unimplemented");
-  return RMW_RET_UNSUPPORTED;
+  RMW_CHECK_ARGUMENT_FOR_NULL(allocation, RMW_RET_INVALID_ARGUMENT);
+  auto allocation_info = static_cast<CustomSubscriptionAllocation *>(allocation->data);
+  const rosidl_message_type_support_t * type_support =
+    nullptr != allocation_info ? allocation_info->type_support_ : nullptr;
+  rmw_ret_t ret = rmw_fastrtps_shared_cpp::__rmw_fini_subscription_allocation(
+    eprosima_fastrtps_identifier, allocation);
+  if (RMW_RET_OK == ret) {
+    TypeSupportRegistry::get_instance().return_message_type_support(type_support);
+  }
+  return ret;
 }
 
 rmw_subscription_t *
@@ -94,11 +129,10 @@ rmw_create_subscription(
     rmw_dds_common::msg::ParticipantEntitiesInfo msg =
       common_context->graph_cache.associate_reader(
       info->subscription_gid_, common_context->gid, node->name, node->namespace_);
-    rmw_ret_t rmw_ret = rmw_fastrtps_shared_cpp::__rmw_publish(
+    rmw_ret_t rmw_ret = rmw_fastrtps_shared_cpp::publish_participant_entities_info(
       eprosima_fastrtps_identifier,
-      common_context->pub,
-      static_cast<void *>(&msg),
-      nullptr);
+      node->context,
+      msg);
     if (RMW_RET_OK != rmw_ret) {
       rmw_error_state_t error_state = *rmw_get_error_state();
       rmw_reset_error();
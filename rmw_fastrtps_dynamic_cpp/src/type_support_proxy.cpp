@@ -46,4 +46,28 @@ bool TypeSupportProxy::deserializeROSmessage(
   return type_impl->deserializeROSmessage(deser, ros_message, impl);
 }
 
+bool TypeSupportProxy::can_copy_ros_messages() const
+{
+  return true;
+}
+
+void * TypeSupportProxy::createROSmessage(const void * impl) const
+{
+  auto type_impl = static_cast<const rmw_fastrtps_shared_cpp::TypeSupport *>(impl);
+  return type_impl->createROSmessage(impl);
+}
+
+void TypeSupportProxy::deleteROSmessage(void * ros_message, const void * impl) const
+{
+  auto type_impl = static_cast<const rmw_fastrtps_shared_cpp::TypeSupport *>(impl);
+  type_impl->deleteROSmessage(ros_message, impl);
+}
+
+bool TypeSupportProxy::copyROSmessage(
+  const void * src_ros_message, void * dst_ros_message, const void * impl) const
+{
+  auto type_impl = static_cast<const rmw_fastrtps_shared_cpp::TypeSupport *>(impl);
+  return type_impl->copyROSmessage(src_ros_message, dst_ros_message, impl);
+}
+
 }  // namespace rmw_fastrtps_dynamic_cpp
@@ -0,0 +1,422 @@
+// Copyright 2021 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "osrf_testing_tools_cpp/scope_exit.hpp"
+
+#include "rcutils/allocator.h"
+#include "rcutils/strdup.h"
+
+#include "rmw/error_handling.h"
+#include "rmw/rmw.h"
+#include "rmw/serialized_message.h"
+
+#include "rosidl_runtime_c/primitives_sequence_functions.h"
+#include "rosidl_runtime_c/string_functions.h"
+
+#include "rosidl_typesupport_cpp/message_type_support.hpp"
+
+#include "test_msgs/msg/unbounded_sequences.h"
+#include "test_msgs/msg/unbounded_sequences.hpp"
+
+// Run with RMW_FASTRTPS_INTRA_PARTICIPANT_DELIVERY=1
+class TestIntraParticipantDelivery : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    rmw_init_options_t options = rmw_get_zero_initialized_init_options();
+    rmw_ret_t ret = rmw_init_options_init(&options, rcutils_get_default_allocator());
+    ASSERT_EQ(RMW_RET_OK, ret) << rcutils_get_error_string().str;
+    OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+    {
+      rmw_ret_t ret = rmw_init_options_fini(&options);
+      EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    });
+    options.enclave = rcutils_strdup("/", rcutils_get_default_allocator());
+    ASSERT_STREQ("/", options.enclave);
+    ret = rmw_init(&options, &context);
+    ASSERT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    node = rmw_create_node(&context, "my_node", "/my_ns");
+    ASSERT_NE(nullptr, node) << rmw_get_error_string().str;
+  }
+
+  void TearDown() override
+  {
+    rmw_ret_t ret = rmw_destroy_node(node);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    ret = rmw_shutdown(&context);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    ret = rmw_context_fini(&context);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+  }
+
+  void wait_for_matched_publishers(const rmw_subscription_t * sub, size_t expected)
+  {
+    size_t matched = 0u;
+    for (size_t i = 0u; i < 100u && expected != matched; ++i) {
+      ASSERT_EQ(RMW_RET_OK, rmw_subscription_count_matched_publishers(sub, &matched));
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    ASSERT_EQ(expected, matched);
+  }
+
+  rmw_context_t context{rmw_get_zero_initialized_context()};
+  rmw_node_t * node{nullptr};
+};
+
+TEST_F(TestIntraParticipantDelivery, delivers_cpp_messages) {
+  const rosidl_message_type_support_t * ts = rosidl_typesupport_cpp::
+    get_message_type_support_handle<test_msgs::msg::UnboundedSequences>();
+  constexpr char topic_name[] = "/test_intra_participant_delivery_cpp";
+  rmw_publisher_options_t pub_options = rmw_get_default_publisher_options();
+  rmw_publisher_t * pub =
+    rmw_create_publisher(node, ts, topic_name, &rmw_qos_profile_default, &pub_options);
+  ASSERT_NE(nullptr, pub) << rmw_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_publisher(node, pub)) << rmw_get_error_string().str;
+  });
+  rmw_subscription_options_t sub_options = rmw_get_default_subscription_options();
+  rmw_subscription_t * sub =
+    rmw_create_subscription(node, ts, topic_name, &rmw_qos_profile_default, &sub_options);
+  ASSERT_NE(nullptr, sub) << rmw_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_subscription(node, sub)) << rmw_get_error_string().str;
+  });
+  rmw_subscription_t * serialized_sub =
+    rmw_create_subscription(node, ts, topic_name, &rmw_qos_profile_default, &sub_options);
+  ASSERT_NE(nullptr, serialized_sub) << rmw_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_subscription(node, serialized_sub)) <<
+      rmw_get_error_string().str;
+  });
+  wait_for_matched_publishers(sub, 1u);
+  wait_for_matched_publishers(serialized_sub, 1u);
+
+  test_msgs::msg::UnboundedSequences sent;
+  sent.int32_values = {1, 2, 3};
+  sent.string_values = {"a string longer than the small string optimization", ""};
+  sent.basic_types_values.resize(2u);
+  sent.basic_types_values[1].float64_value = 4.0;
+  ASSERT_EQ(RMW_RET_OK, rmw_publish(pub, &sent, nullptr)) << rmw_get_error_string().str;
+
+  // The message is delivered when published
+  test_msgs::msg::UnboundedSequences received;
+  received.int32_values = {4, 5, 6, 7};
+  bool taken = false;
+  rmw_message_info_t message_info = rmw_get_zero_initialized_message_info();
+  ASSERT_EQ(RMW_RET_OK, rmw_take_with_info(sub, &received, &taken, &message_info, nullptr)) <<
+    rmw_get_error_string().str;
+  ASSERT_TRUE(taken);
+  EXPECT_EQ(sent, received);
+
+  rmw_gid_t gid{};
+  ASSERT_EQ(RMW_RET_OK, rmw_get_gid_for_publisher(pub, &gid)) << rmw_get_error_string().str;
+  bool same_gid = false;
+  ASSERT_EQ(RMW_RET_OK, rmw_compare_gids_equal(&gid, &message_info.publisher_gid, &same_gid));
+  EXPECT_TRUE(same_gid);
+
+  // Each message is taken once, even though it is shared
+  ASSERT_EQ(RMW_RET_OK, rmw_take(sub, &received, &taken, nullptr)) <<
+    rmw_get_error_string().str;
+  EXPECT_FALSE(taken);
+
+  rcutils_allocator_t allocator = rcutils_get_default_allocator();
+  rmw_serialized_message_t serialized_message = rmw_get_zero_initialized_serialized_message();
+  ASSERT_EQ(RMW_RET_OK, rmw_serialized_message_init(&serialized_message, 0u, &allocator));
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_serialized_message_fini(&serialized_message));
+  });
+  ASSERT_EQ(
+    RMW_RET_OK,
+    rmw_take_serialized_message(serialized_sub, &serialized_message, &taken, nullptr)) <<
+    rmw_get_error_string().str;
+  ASSERT_TRUE(taken);
+  test_msgs::msg::UnboundedSequences deserialized;
+  ASSERT_EQ(RMW_RET_OK, rmw_deserialize(&serialized_message, ts, &deserialized)) <<
+    rmw_get_error_string().str;
+  EXPECT_EQ(sent, deserialized);
+}
+
+TEST_F(TestIntraParticipantDelivery, delivers_c_messages) {
+  const rosidl_message_type_support_t * ts =
+    ROSIDL_GET_MSG_TYPE_SUPPORT(test_msgs, msg, UnboundedSequences);
+  constexpr char topic_name[] = "/test_intra_participant_delivery_c";
+  rmw_publisher_options_t pub_options = rmw_get_default_publisher_options();
+  rmw_publisher_t * pub =
+    rmw_create_publisher(node, ts, topic_name, &rmw_qos_profile_default, &pub_options);
+  ASSERT_NE(nullptr, pub) << rmw_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_publisher(node, pub)) << rmw_get_error_string().str;
+  });
+  rmw_subscription_options_t sub_options = rmw_get_default_subscription_options();
+  rmw_subscription_t * sub =
+    rmw_create_subscription(node, ts, topic_name, &rmw_qos_profile_default, &sub_options);
+  ASSERT_NE(nullptr, sub) << rmw_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_subscription(node, sub)) << rmw_get_error_string().str;
+  });
+  wait_for_matched_publishers(sub, 1u);
+
+  test_msgs__msg__UnboundedSequences sent;
+  ASSERT_TRUE(test_msgs__msg__UnboundedSequences__init(&sent));
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    test_msgs__msg__UnboundedSequences__fini(&sent);
+  });
+  ASSERT_TRUE(rosidl_runtime_c__int32__Sequence__init(&sent.int32_values, 3u));
+  sent.int32_values.data[2] = 42;
+  ASSERT_TRUE(rosidl_runtime_c__String__Sequence__init(&sent.string_values, 2u));
+  ASSERT_TRUE(rosidl_runtime_c__String__assign(&sent.string_values.data[1], "local"));
+  ASSERT_EQ(RMW_RET_OK, rmw_publish(pub, &sent, nullptr)) << rmw_get_error_string().str;
+
+  test_msgs__msg__UnboundedSequences received;
+  ASSERT_TRUE(test_msgs__msg__UnboundedSequences__init(&received));
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    test_msgs__msg__UnboundedSequences__fini(&received);
+  });
+  bool taken = false;
+  ASSERT_EQ(RMW_RET_OK, rmw_take(sub, &received, &taken, nullptr)) <<
+    rmw_get_error_string().str;
+  ASSERT_TRUE(taken);
+  ASSERT_EQ(3u, received.int32_values.size);
+  EXPECT_EQ(42, received.int32_values.data[2]);
+  ASSERT_EQ(2u, received.string_values.size);
+  EXPECT_STREQ("", received.string_values.data[0].data);
+  EXPECT_STREQ("local", received.string_values.data[1].data);
+}
+
+TEST_F(TestIntraParticipantDelivery, transient_local_publishers_write_messages) {
+  const rosidl_message_type_support_t * ts = rosidl_typesupport_cpp::
+    get_message_type_support_handle<test_msgs::msg::UnboundedSequences>();
+  constexpr char topic_name[] = "/test_intra_participant_delivery_transient_local";
+  rmw_qos_profile_t qos = rmw_qos_profile_default;
+  qos.durability = RMW_QOS_POLICY_DURABILITY_TRANSIENT_LOCAL;
+  rmw_publisher_options_t pub_options = rmw_get_default_publisher_options();
+  rmw_publisher_t * pub = rmw_create_publisher(node, ts, topic_name, &qos, &pub_options);
+  ASSERT_NE(nullptr, pub) << rmw_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_publisher(node, pub)) << rmw_get_error_string().str;
+  });
+  rmw_subscription_options_t sub_options = rmw_get_default_subscription_options();
+  rmw_subscription_t * sub =
+    rmw_create_subscription(node, ts, topic_name, &rmw_qos_profile_default, &sub_options);
+  ASSERT_NE(nullptr, sub) << rmw_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_subscription(node, sub)) << rmw_get_error_string().str;
+  });
+  wait_for_matched_publishers(sub, 1u);
+
+  test_msgs::msg::UnboundedSequences sent;
+  sent.int32_values = {1, 2, 3};
+  ASSERT_EQ(RMW_RET_OK, rmw_publish(pub, &sent, nullptr)) << rmw_get_error_string().str;
+
+  // The subscription receives the message through Fast DDS instead
+  test_msgs::msg::UnboundedSequences received;
+  bool taken = false;
+  for (size_t i = 0u; i < 100u && !taken; ++i) {
+    ASSERT_EQ(RMW_RET_OK, rmw_take(sub, &received, &taken, nullptr)) <<
+      rmw_get_error_string().str;
+    if (!taken) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  }
+  ASSERT_TRUE(taken);
+  EXPECT_EQ(sent, received);
+}
+
+TEST_F(TestIntraParticipantDelivery, truncated_serialized_message_is_rejected) {
+  const rosidl_message_type_support_t * ts = rosidl_typesupport_cpp::
+    get_message_type_support_handle<test_msgs::msg::UnboundedSequences>();
+  constexpr char topic_name[] = "/test_intra_participant_delivery_truncated";
+  rmw_publisher_options_t pub_options = rmw_get_default_publisher_options();
+  rmw_publisher_t * pub =
+    rmw_create_publisher(node, ts, topic_name, &rmw_qos_profile_default, &pub_options);
+  ASSERT_NE(nullptr, pub) << rmw_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_publisher(node, pub)) << rmw_get_error_string().str;
+  });
+  rmw_subscription_options_t sub_options = rmw_get_default_subscription_options();
+  rmw_subscription_t * sub =
+    rmw_create_subscription(node, ts, topic_name, &rmw_qos_profile_default, &sub_options);
+  ASSERT_NE(nullptr, sub) << rmw_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_subscription(node, sub)) << rmw_get_error_string().str;
+  });
+  wait_for_matched_publishers(sub, 1u);
+
+  test_msgs::msg::UnboundedSequences sent;
+  sent.int32_values = {1, 2, 3};
+  sent.string_values = {"a string longer than the small string optimization"};
+  rcutils_allocator_t allocator = rcutils_get_default_allocator();
+  rmw_serialized_message_t serialized_message = rmw_get_zero_initialized_serialized_message();
+  ASSERT_EQ(RMW_RET_OK, rmw_serialized_message_init(&serialized_message, 0u, &allocator));
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_serialized_message_fini(&serialized_message));
+  });
+  ASSERT_EQ(RMW_RET_OK, rmw_serialize(&sent, ts, &serialized_message)) <<
+    rmw_get_error_string().str;
+
+  // Cut in the middle of the sequences, past the encapsulation header
+  const size_t buffer_length = serialized_message.buffer_length;
+  serialized_message.buffer_length = buffer_length / 2u;
+  EXPECT_EQ(RMW_RET_ERROR, rmw_publish_serialized_message(pub, &serialized_message, nullptr));
+  rmw_reset_error();
+
+  test_msgs::msg::UnboundedSequences received;
+  bool taken = false;
+  ASSERT_EQ(RMW_RET_OK, rmw_take(sub, &received, &taken, nullptr)) <<
+    rmw_get_error_string().str;
+  EXPECT_FALSE(taken);
+
+  // The whole message is still delivered
+  serialized_message.buffer_length = buffer_length;
+  ASSERT_EQ(RMW_RET_OK, rmw_publish_serialized_message(pub, &serialized_message, nullptr)) <<
+    rmw_get_error_string().str;
+  ASSERT_EQ(RMW_RET_OK, rmw_take(sub, &received, &taken, nullptr)) <<
+    rmw_get_error_string().str;
+  ASSERT_TRUE(taken);
+  EXPECT_EQ(sent, received);
+}
+
+TEST_F(TestIntraParticipantDelivery, no_message_lost_while_matching) {
+  const rosidl_message_type_support_t * ts = rosidl_typesupport_cpp::
+    get_message_type_support_handle<test_msgs::msg::UnboundedSequences>();
+  constexpr char topic_name[] = "/test_intra_participant_delivery_matching";
+  rmw_qos_profile_t qos = rmw_qos_profile_default;
+  qos.depth = 1000u;
+  rmw_publisher_options_t pub_options = rmw_get_default_publisher_options();
+  rmw_publisher_t * pub = rmw_create_publisher(node, ts, topic_name, &qos, &pub_options);
+  ASSERT_NE(nullptr, pub) << rmw_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_publisher(node, pub)) << rmw_get_error_string().str;
+  });
+
+  // Publish in a tight loop, only held back once taking lags too far behind, so that
+  // messages are published while the subscription is created and matched
+  std::atomic_bool stop{false};
+  std::atomic<int32_t> published{0};
+  std::atomic<int32_t> highest_taken{-1};
+  std::thread publisher(
+    [&]() {
+      test_msgs::msg::UnboundedSequences msg;
+      msg.int32_values = {0};
+      while (!stop) {
+        int32_t taken = highest_taken;
+        if (taken >= 0 && published - taken > static_cast<int32_t>(qos.depth / 2u)) {
+          std::this_thread::yield();
+          continue;
+        }
+        msg.int32_values[0] = published;
+        EXPECT_EQ(RMW_RET_OK, rmw_publish(pub, &msg, nullptr)) << rmw_get_error_string().str;
+        ++published;
+      }
+    });
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    stop = true;
+    if (publisher.joinable()) {
+      publisher.join();
+    }
+  });
+  while (published < 100) {
+    std::this_thread::yield();
+  }
+
+  rmw_subscription_options_t sub_options = rmw_get_default_subscription_options();
+  rmw_subscription_t * sub = rmw_create_subscription(node, ts, topic_name, &qos, &sub_options);
+  ASSERT_NE(nullptr, sub) << rmw_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_subscription(node, sub)) << rmw_get_error_string().str;
+  });
+
+  // Count the messages taken, whether delivered or received through Fast DDS
+  std::vector<size_t> taken_counts;
+  size_t taken_total = 0u;
+  auto take = [&]() {
+      test_msgs::msg::UnboundedSequences msg;
+      bool taken = false;
+      EXPECT_EQ(RMW_RET_OK, rmw_take(sub, &msg, &taken, nullptr)) << rmw_get_error_string().str;
+      if (!taken) {
+        return false;
+      }
+      if (1u != msg.int32_values.size()) {
+        ADD_FAILURE() << "taken message isn't one of those published";
+        return true;
+      }
+      int32_t value = msg.int32_values[0];
+      if (static_cast<size_t>(value) >= taken_counts.size()) {
+        taken_counts.resize(static_cast<size_t>(value) + 1u, 0u);
+      }
+      ++taken_counts[static_cast<size_t>(value)];
+      ++taken_total;
+      if (value > highest_taken) {
+        highest_taken = value;
+      }
+      return true;
+    };
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (taken_total < 5000u && std::chrono::steady_clock::now() < deadline) {
+    take();
+  }
+  stop = true;
+  publisher.join();
+  // Take what is left, until nothing was received for a while
+  for (size_t quiet = 0u; quiet < 20u; ) {
+    if (take()) {
+      quiet = 0u;
+    } else {
+      ++quiet;
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  }
+
+  // The first messages may be published before the publisher and the subscription are matched,
+  // but none is lost nor taken twice from the first one taken on
+  ASSERT_LT(0u, taken_total);
+  ASSERT_EQ(static_cast<size_t>(published.load()), taken_counts.size());
+  size_t first_taken = 0u;
+  while (0u == taken_counts[first_taken]) {
+    ++first_taken;
+  }
+  size_t lost = 0u;
+  size_t duplicated = 0u;
+  for (size_t i = first_taken; i < taken_counts.size(); ++i) {
+    lost += 0u == taken_counts[i] ? 1u : 0u;
+    duplicated += taken_counts[i] > 1u ? 1u : 0u;
+  }
+  EXPECT_EQ(0u, lost);
+  EXPECT_EQ(0u, duplicated);
+}
@@ -0,0 +1,230 @@
+// Copyright 2021 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <chrono>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+#include "osrf_testing_tools_cpp/memory_tools/memory_tools.hpp"
+#include "osrf_testing_tools_cpp/memory_tools/testing_helpers.hpp"
+#include "osrf_testing_tools_cpp/scope_exit.hpp"
+
+#include "rcutils/allocator.h"
+#include "rcutils/strdup.h"
+
+#include "rmw/error_handling.h"
+#include "rmw/rmw.h"
+#include "rmw/serialized_message.h"
+
+#include "rosidl_runtime_c/primitives_sequence_functions.h"
+#include "rosidl_runtime_c/string_functions.h"
+
+#include "test_msgs/msg/basic_types.h"
+#include "test_msgs/msg/strings.h"
+#include "test_msgs/msg/unbounded_sequences.h"
+
+class TestSubscriptionAllocation : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    rmw_init_options_t options = rmw_get_zero_initialized_init_options();
+    rmw_ret_t ret = rmw_init_options_init(&options, rcutils_get_default_allocator());
+    ASSERT_EQ(RMW_RET_OK, ret) << rcutils_get_error_string().str;
+    OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+    {
+      rmw_ret_t ret = rmw_init_options_fini(&options);
+      EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    });
+    options.enclave = rcutils_strdup("/", rcutils_get_default_allocator());
+    ASSERT_STREQ("/", options.enclave);
+    ret = rmw_init(&options, &context);
+    ASSERT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    node = rmw_create_node(&context, "my_node", "/my_ns");
+    ASSERT_NE(nullptr, node) << rmw_get_error_string().str;
+  }
+
+  void TearDown() override
+  {
+    rmw_ret_t ret = rmw_destroy_node(node);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    ret = rmw_shutdown(&context);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    ret = rmw_context_fini(&context);
+    EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+  }
+
+  rmw_context_t context{rmw_get_zero_initialized_context()};
+  rmw_node_t * node{nullptr};
+};
+
+TEST_F(TestSubscriptionAllocation, take_reuses_message_storage) {
+  const rosidl_message_type_support_t * ts =
+    ROSIDL_GET_MSG_TYPE_SUPPORT(test_msgs, msg, UnboundedSequences);
+  constexpr char topic_name[] = "/test_subscription_allocation";
+  rmw_publisher_options_t pub_options = rmw_get_default_publisher_options();
+  rmw_publisher_t * pub =
+    rmw_create_publisher(node, ts, topic_name, &rmw_qos_profile_default, &pub_options);
+  ASSERT_NE(nullptr, pub) << rmw_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_publisher(node, pub)) << rmw_get_error_string().str;
+  });
+  rmw_subscription_options_t sub_options = rmw_get_default_subscription_options();
+  rmw_subscription_t * sub =
+    rmw_create_subscription(node, ts, topic_name, &rmw_qos_profile_default, &sub_options);
+  ASSERT_NE(nullptr, sub) << rmw_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_subscription(node, sub)) << rmw_get_error_string().str;
+  });
+
+  rmw_subscription_allocation_t allocation{nullptr, nullptr};
+  ASSERT_EQ(RMW_RET_OK, rmw_init_subscription_allocation(ts, nullptr, &allocation)) <<
+    rmw_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_fini_subscription_allocation(&allocation)) <<
+      rmw_get_error_string().str;
+  });
+
+  size_t matched = 0u;
+  for (size_t i = 0u; i < 100u && 0u == matched; ++i) {
+    ASSERT_EQ(RMW_RET_OK, rmw_subscription_count_matched_publishers(sub, &matched));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+  ASSERT_EQ(1u, matched);
+
+  test_msgs__msg__UnboundedSequences sent;
+  ASSERT_TRUE(test_msgs__msg__UnboundedSequences__init(&sent));
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    test_msgs__msg__UnboundedSequences__fini(&sent);
+  });
+  ASSERT_TRUE(rosidl_runtime_c__int32__Sequence__init(&sent.int32_values, 16u));
+  ASSERT_TRUE(rosidl_runtime_c__String__Sequence__init(&sent.string_values, 4u));
+  // Distinct strings, so that a string taken into the wrong element is noticed
+  const char * strings[] = {
+    "a first string longer than the small string optimization",
+    "a second string longer than the small string optimization",
+    "a third string longer than the small string optimization",
+    "a fourth string longer than the small string optimization"};
+  for (size_t i = 0u; i < sent.string_values.size; ++i) {
+    ASSERT_TRUE(rosidl_runtime_c__String__assign(&sent.string_values.data[i], strings[i]));
+  }
+  ASSERT_TRUE(test_msgs__msg__BasicTypes__Sequence__init(&sent.basic_types_values, 2u));
+
+  test_msgs__msg__UnboundedSequences received;
+  ASSERT_TRUE(test_msgs__msg__UnboundedSequences__init(&received));
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    test_msgs__msg__UnboundedSequences__fini(&received);
+  });
+
+  auto publish_and_take =
+    [&](bool monitored) {
+      sent.int32_values.data[0]++;
+      ASSERT_EQ(RMW_RET_OK, rmw_publish(pub, &sent, nullptr)) << rmw_get_error_string().str;
+      bool taken = false;
+      for (size_t i = 0u; i < 100u && !taken; ++i) {
+        rmw_ret_t ret = RMW_RET_ERROR;
+        if (monitored) {
+          EXPECT_NO_MEMORY_OPERATIONS(
+          {
+            ret = rmw_take(sub, &received, &taken, &allocation);
+          });
+        } else {
+          ret = rmw_take(sub, &received, &taken, &allocation);
+        }
+        ASSERT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+        if (!taken) {
+          std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+      }
+      ASSERT_TRUE(taken);
+      ASSERT_EQ(sent.int32_values.size, received.int32_values.size);
+      EXPECT_EQ(sent.int32_values.data[0], received.int32_values.data[0]);
+      ASSERT_EQ(sent.string_values.size, received.string_values.size);
+      const size_t last = sent.string_values.size - 1u;
+      EXPECT_STREQ(sent.string_values.data[last].data, received.string_values.data[last].data);
+      EXPECT_EQ(sent.basic_types_values.size, received.basic_types_values.size);
+    };
+
+  // The first take grows the storage of the received message
+  publish_and_take(false);
+
+  osrf_testing_tools_cpp::memory_tools::initialize();
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    osrf_testing_tools_cpp::memory_tools::uninitialize();
+  });
+  osrf_testing_tools_cpp::memory_tools::on_unexpected_malloc(
+    []() {ADD_FAILURE() << "unexpected malloc";});
+  osrf_testing_tools_cpp::memory_tools::on_unexpected_realloc(
+    []() {ADD_FAILURE() << "unexpected realloc";});
+  osrf_testing_tools_cpp::memory_tools::on_unexpected_calloc(
+    []() {ADD_FAILURE() << "unexpected calloc";});
+  osrf_testing_tools_cpp::memory_tools::on_unexpected_free(
+    []() {ADD_FAILURE() << "unexpected free";});
+  // Only the taking thread is monitored, Fast DDS threads may allocate on their own
+  osrf_testing_tools_cpp::memory_tools::enable_monitoring();
+  for (size_t i = 0u; i < 5u; ++i) {
+    publish_and_take(true);
+  }
+  osrf_testing_tools_cpp::memory_tools::disable_monitoring();
+
+  // Smaller messages reuse the storage too
+  sent.int32_values.size = 8u;
+  sent.string_values.size = 2u;
+  osrf_testing_tools_cpp::memory_tools::enable_monitoring();
+  publish_and_take(true);
+  osrf_testing_tools_cpp::memory_tools::disable_monitoring();
+  sent.int32_values.size = 16u;
+  sent.string_values.size = 4u;
+}
+
+TEST_F(TestSubscriptionAllocation, deserialize_rejects_strings_beyond_buffer) {
+  const rosidl_message_type_support_t * ts =
+    ROSIDL_GET_MSG_TYPE_SUPPORT(test_msgs, msg, Strings);
+  test_msgs__msg__Strings msg;
+  ASSERT_TRUE(test_msgs__msg__Strings__init(&msg));
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    test_msgs__msg__Strings__fini(&msg);
+  });
+  ASSERT_TRUE(rosidl_runtime_c__String__assign(&msg.string_value, "short"));
+
+  rcutils_allocator_t allocator = rcutils_get_default_allocator();
+  rmw_serialized_message_t serialized = rmw_get_zero_initialized_serialized_message();
+  ASSERT_EQ(RMW_RET_OK, rmw_serialized_message_init(&serialized, 0u, &allocator)) <<
+    rmw_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_serialized_message_fini(&serialized)) <<
+      rmw_get_error_string().str;
+  });
+  ASSERT_EQ(RMW_RET_OK, rmw_serialize(&msg, ts, &serialized)) << rmw_get_error_string().str;
+  ASSERT_GT(serialized.buffer_length, 8u);
+
+  // The length of the first string follows the encapsulation, in the endianness it tells
+  const uint32_t length = 0x7ffffff0u;
+  for (size_t i = 0u; i < 4u; ++i) {
+    size_t shift = 1u == serialized.buffer[1] ? 8u * i : 8u * (3u - i);
+    serialized.buffer[4u + i] = static_cast<uint8_t>(length >> shift);
+  }
+  EXPECT_EQ(RMW_RET_ERROR, rmw_deserialize(&serialized, ts, &msg));
+  rmw_reset_error();
+  EXPECT_LT(msg.string_value.capacity, serialized.buffer_length * 2u + 64u);
+}
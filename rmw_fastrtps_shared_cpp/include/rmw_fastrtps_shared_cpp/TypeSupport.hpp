@@ -16,6 +16,8 @@
 #define RMW_FASTRTPS_SHARED_CPP__TYPESUPPORT_HPP_
 
 #include <cassert>
+#include <chrono>
+#include <cstdint>
 #include <string>
 
 #include "fastdds/dds/topic/TopicDataType.hpp"
@@ -33,12 +35,38 @@
 namespace rmw_fastrtps_shared_cpp
 {
 
+// Messages of a sequence the valid samples taken at once are deserialized into, in order
+struct MessageSlots
+{
+  void ** messages;
+  size_t count;
+  // Index of the message the next valid sample is deserialized into
+  size_t next = 0;
+};
+
 // Publishers write method will receive a pointer to this struct
 struct SerializedData
 {
   bool is_cdr_buffer;  // Whether next field is a pointer to a Cdr or to a plain ros message
   void * data;
   const void * impl;   // RMW implementation specific data
+  // Optional buffer a plain ros message of an unbounded type is serialized to when its size
+  // is requested, so that it is walked once instead of twice.
+  eprosima::fastcdr::FastBuffer * scratch_buffer = nullptr;
+  // Optional CDR encoded message, encapsulation included, written as is instead of `data`
+  const char * cdr_data = nullptr;
+  size_t cdr_length = 0;
+  // Number of the publication the written sample is tagged with, unless it is 0, see
+  // intra_participant_delivery.hpp
+  uint64_t local_publication_number = 0;
+  // Whether the time spent serializing `data` is added to serialize_time
+  bool measure_serialize_time = false;
+  std::chrono::nanoseconds serialize_time{0};
+  // Size of the payload, set once serialized
+  size_t serialized_length = 0;
+  // Optional messages a sample is deserialized into the next of, instead of `data`, which is
+  // then set to that message, so that samples without data leave no gap in a sequence
+  MessageSlots * message_slots = nullptr;
 };
 
 class TypeSupport : public eprosima::fastdds::dds::TopicDataType
@@ -52,6 +80,39 @@ public:
   virtual bool deserializeROSmessage(
     eprosima::fastcdr::Cdr & deser, void * ros_message, const void * impl) const = 0;
 
+  /// Whether ROS messages can be created, copied and deleted without being serialized.
+  /**
+   * Only then are messages published to subscriptions of the same participant shared
+   * with them, see intra_participant_delivery.hpp.
+   */
+  virtual bool can_copy_ros_messages() const
+  {
+    return false;
+  }
+
+  /// Allocate and initialize a ROS message, to be deleted with deleteROSmessage().
+  /**
+   * \return the ROS message, or nullptr if it could not be created.
+   */
+  virtual void * createROSmessage(const void * impl) const
+  {
+    (void)impl;
+    return nullptr;
+  }
+
+  virtual void deleteROSmessage(void * ros_message, const void * impl) const
+  {
+    (void)ros_message; (void)impl;
+  }
+
+  /// Deep copy a ROS message into another, initialized one.
+  virtual bool copyROSmessage(
+    const void * src_ros_message, void * dst_ros_message, const void * impl) const
+  {
+    (void)src_ros_message; (void)dst_ros_message; (void)impl;
+    return false;
+  }
+
   RMW_FASTRTPS_SHARED_CPP_PUBLIC
   bool getKey(
     void * data,
@@ -91,10 +152,65 @@ public:
 #ifdef TOPIC_DATA_TYPE_API_HAS_IS_PLAIN
   override
 #endif
+  {
+    // Samples loaned as serialized messages are written as is, like those of plain types
+    return is_plain_ || serialized_loans_;
+  }
+
+  /// Whether loaned samples hold ROS messages, which is only the case for plain types.
+  RMW_FASTRTPS_SHARED_CPP_PUBLIC
+  inline bool can_loan_ros_messages() const
   {
     return is_plain_;
   }
 
+  /// Whether loaned samples hold serialized messages, see enable_serialized_loans().
+  RMW_FASTRTPS_SHARED_CPP_PUBLIC
+  inline bool has_serialized_loans() const
+  {
+    return serialized_loans_;
+  }
+
+  /// Let samples of a bounded type which isn't plain be loaned to hold serialized messages.
+  /**
+   * Fast DDS writes such samples whole, so the length of the serialized message is kept in
+   * a trailer at their end, which m_typeSize is grown by.
+   * Must be called before the type is registered.
+   */
+  RMW_FASTRTPS_SHARED_CPP_PUBLIC
+  inline void enable_serialized_loans()
+  {
+    if (!serialized_loans_ && max_size_bound_ && !is_plain_) {
+      serialized_loans_ = true;
+      m_typeSize += serialized_loan_trailer_size;
+    }
+  }
+
+  /// Room for a serialized message in a loaned sample, encapsulation included.
+  RMW_FASTRTPS_SHARED_CPP_PUBLIC
+  inline size_t serialized_loan_capacity() const
+  {
+    assert(serialized_loans_);
+    return m_typeSize - serialized_loan_trailer_size;
+  }
+
+  /// Record the length of the serialized message a loaned sample holds.
+  /**
+   * \param[in] buffer start of the payload of the sample, encapsulation included
+   * \param[in] length length of the serialized message, at most serialized_loan_capacity()
+   */
+  RMW_FASTRTPS_SHARED_CPP_PUBLIC
+  void set_serialized_loan_length(uint8_t * buffer, size_t length) const;
+
+  /// Get the length of the serialized message a loaned sample holds.
+  /**
+   * \param[in] buffer start of the payload of the sample, encapsulation included
+   * \return the length recorded by set_serialized_loan_length(), or
+   *   serialized_loan_capacity() if the trailer is not valid.
+   */
+  RMW_FASTRTPS_SHARED_CPP_PUBLIC
+  size_t get_serialized_loan_length(const uint8_t * buffer) const;
+
   RMW_FASTRTPS_SHARED_CPP_PUBLIC
   virtual ~TypeSupport() {}
 
@@ -104,6 +220,13 @@ protected:
 
   bool max_size_bound_;
   bool is_plain_;
+  bool serialized_loans_;
+
+private:
+  bool serialize_payload(void * data, eprosima::fastrtps::rtps::SerializedPayload_t * payload);
+
+  // The length of the serialized message, followed by its complement as a check
+  static constexpr uint32_t serialized_loan_trailer_size = 2u * sizeof(uint32_t);
 };
 
 }  // namespace rmw_fastrtps_shared_cpp
@@ -0,0 +1,284 @@
+// Copyright 2021 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RMW_FASTRTPS_SHARED_CPP__CONDITION_LISTENER_HPP_
+#define RMW_FASTRTPS_SHARED_CPP__CONDITION_LISTENER_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include "rcpputils/thread_safety_annotations.hpp"
+
+#include "rmw_fastrtps_shared_cpp/event_fd.hpp"
+
+class ConditionListenerInterface;
+
+/// Condition a wait set shares with the listeners attached to it.
+/**
+ * Listeners change their state with the mutex locked, and record themselves as ready
+ * candidates, so that the waiter only has to check those after being woken up.
+ */
+struct WaitSetCondition
+{
+  std::mutex mutex;
+  std::condition_variable condition_variable;
+  // Signaled along with the condition variable, when enabled.
+  rmw_fastrtps_shared_cpp::EventFd event_fd RCPPUTILS_TSA_GUARDED_BY(mutex);
+
+  /// Record a listener as a ready candidate.
+  void push_ready(ConditionListenerInterface * listener) RCPPUTILS_TSA_REQUIRES(mutex)
+  {
+    ready_listeners_.push_back(listener);
+    has_ready_.store(true, std::memory_order_release);
+  }
+
+  /// Forget a listener that is being detached.
+  void remove_ready(ConditionListenerInterface * listener) RCPPUTILS_TSA_REQUIRES(mutex)
+  {
+    ready_listeners_.erase(
+      std::remove(ready_listeners_.begin(), ready_listeners_.end(), listener),
+      ready_listeners_.end());
+    has_ready_.store(!ready_listeners_.empty(), std::memory_order_release);
+  }
+
+  /// Append the ready candidates to `listeners`, and clear them.
+  void take_ready(std::vector<ConditionListenerInterface *> & listeners)
+  RCPPUTILS_TSA_REQUIRES(mutex)
+  {
+    listeners.insert(listeners.end(), ready_listeners_.begin(), ready_listeners_.end());
+    ready_listeners_.clear();
+    has_ready_.store(false, std::memory_order_release);
+    ++ready_generation_;
+  }
+
+  /// Whether there are ready candidates, without locking the mutex.
+  bool has_ready() const
+  {
+    return has_ready_.load(std::memory_order_acquire);
+  }
+
+  /// Number of times the ready candidates were taken, to avoid recording a listener twice.
+  uint64_t ready_generation() const RCPPUTILS_TSA_REQUIRES(mutex)
+  {
+    return ready_generation_;
+  }
+
+  /// Set whether the waiter is waiting for a notification, so it may be woken up.
+  void set_waiting(bool waiting) RCPPUTILS_TSA_REQUIRES(mutex)
+  {
+    waiting_ = waiting;
+  }
+
+  /// Return whether the waiter is waiting for a notification, and no longer consider it so.
+  bool claim_waiter() RCPPUTILS_TSA_REQUIRES(mutex)
+  {
+    bool waiting = waiting_;
+    waiting_ = false;
+    return waiting;
+  }
+
+private:
+  std::vector<ConditionListenerInterface *> ready_listeners_ RCPPUTILS_TSA_GUARDED_BY(mutex);
+  // Mirrors whether ready_listeners_ is empty, so a spinning waiter can poll it
+  std::atomic_bool has_ready_{false};
+  uint64_t ready_generation_ RCPPUTILS_TSA_GUARDED_BY(mutex) = 1u;
+  bool waiting_ RCPPUTILS_TSA_GUARDED_BY(mutex) = false;
+};
+
+/// Conditions of the wait sets a listener is attached to.
+/**
+ * The same entity can be waited for by several wait sets at once, e.g. in a multithreaded
+ * executor.
+ * Listeners only notify when they become ready, as the wait sets keep checking the listeners
+ * they reported as ready until they no longer are.
+ * Every one of them records the listener as a ready candidate when it notifies, but only one
+ * of the waiters is woken up, in turns, so that a ready sample does not wake them all up.
+ * Listeners whose readiness is not consumed by the first waiter, like guard conditions, wake
+ * all of them up instead.
+ *
+ * Conditions are kept sorted by address, which is the order they are locked in.
+ */
+class AttachedConditions
+{
+public:
+  /// Attach a condition, recording the listener as a ready candidate in case it already is.
+  void
+  attach(WaitSetCondition * condition, ConditionListenerInterface * listener)
+  {
+    auto it = find(condition);
+    if (it != attachments_.end() && it->condition == condition) {
+      return;
+    }
+    std::lock_guard<std::mutex> lock(condition->mutex);
+    condition->push_ready(listener);
+    attachments_.insert(it, {condition, condition->ready_generation()});
+  }
+
+  /// Detach a condition, forgetting the listener as a ready candidate.
+  void
+  detach(WaitSetCondition * condition, ConditionListenerInterface * listener)
+  {
+    auto it = find(condition);
+    if (it == attachments_.end() || it->condition != condition) {
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock(condition->mutex);
+      condition->remove_ready(listener);
+    }
+    attachments_.erase(it);
+  }
+
+  /// Lock every condition.
+  void
+  lock() RCPPUTILS_TSA_NO_THREAD_SAFETY_ANALYSIS
+  {
+    for (auto & attachment : attachments_) {
+      attachment.condition->mutex.lock();
+    }
+  }
+
+  /// Unlock every condition, notifying them if the listener became ready.
+  /**
+   * The listener is then recorded as a ready candidate of every condition, their eventfd is
+   * signaled, and one waiter is woken up, or all of them if `wake_all` is true.
+   */
+  void
+  unlock_and_notify(ConditionListenerInterface * listener, bool became_ready, bool wake_all)
+  RCPPUTILS_TSA_NO_THREAD_SAFETY_ANALYSIS
+  {
+    if (!became_ready) {
+      for (auto & attachment : attachments_) {
+        attachment.condition->mutex.unlock();
+      }
+      return;
+    }
+
+    const size_t count = attachments_.size();
+    for (auto & attachment : attachments_) {
+      WaitSetCondition * condition = attachment.condition;
+      if (attachment.ready_generation != condition->ready_generation()) {
+        condition->push_ready(listener);
+        attachment.ready_generation = condition->ready_generation();
+      }
+      condition->event_fd.signal();
+    }
+
+    if (wake_all) {
+      for (auto & attachment : attachments_) {
+        attachment.condition->claim_waiter();
+        attachment.condition->mutex.unlock();
+        attachment.condition->condition_variable.notify_all();
+      }
+      return;
+    }
+
+    // Start after the condition woken up last time
+    WaitSetCondition * woken = nullptr;
+    for (size_t i = 0; i < count; ++i) {
+      size_t index = (next_waiter_ + i) % count;
+      if (attachments_[index].condition->claim_waiter()) {
+        woken = attachments_[index].condition;
+        next_waiter_ = index + 1;
+        break;
+      }
+    }
+
+    for (auto & attachment : attachments_) {
+      attachment.condition->mutex.unlock();
+    }
+    // A wait set has a single waiter
+    if (nullptr != woken) {
+      woken->condition_variable.notify_one();
+    }
+  }
+
+private:
+  struct Attachment
+  {
+    WaitSetCondition * condition;
+    // Generation of the condition ready candidates the listener was last recorded in
+    uint64_t ready_generation;
+  };
+
+  std::vector<Attachment>::iterator
+  find(WaitSetCondition * condition)
+  {
+    return std::lower_bound(
+      attachments_.begin(), attachments_.end(), condition,
+      [](const Attachment & attachment, WaitSetCondition * condition) {
+        return std::less<WaitSetCondition *>()(attachment.condition, condition);
+      });
+  }
+
+  std::vector<Attachment> attachments_;
+  size_t next_waiter_ = 0;
+};
+
+/// Common interface of every listener a wait set can attach its condition to.
+class ConditionListenerInterface
+{
+protected:
+  class ConditionalScopedLock;
+
+public:
+  /// Connect a wait set condition so a waiter can be notified of new data.
+  /**
+   * A listener may be attached to several wait set conditions at once.
+   */
+  virtual void attachCondition(WaitSetCondition * condition) = 0;
+
+  /// Undo attachCondition for one wait set condition.
+  virtual void detachCondition(WaitSetCondition * condition) = 0;
+};
+
+/// Lock the attached conditions, and notify them with this listener when going out of scope,
+/// if it became ready in between.
+class ConditionListenerInterface::ConditionalScopedLock
+{
+public:
+  ConditionalScopedLock(
+    AttachedConditions & conditions,
+    ConditionListenerInterface * listener,
+    bool wake_all = false)
+  : conditions_(conditions), listener_(listener), wake_all_(wake_all)
+  {
+    conditions_.lock();
+  }
+
+  ~ConditionalScopedLock()
+  {
+    conditions_.unlock_and_notify(listener_, became_ready_, wake_all_);
+  }
+
+  /// Record that the listener went from not ready to ready, so the conditions are notified.
+  void
+  became_ready()
+  {
+    became_ready_ = true;
+  }
+
+private:
+  AttachedConditions & conditions_;
+  ConditionListenerInterface * listener_;
+  bool wake_all_;
+  bool became_ready_ = false;
+};
+
+#endif  // RMW_FASTRTPS_SHARED_CPP__CONDITION_LISTENER_HPP_
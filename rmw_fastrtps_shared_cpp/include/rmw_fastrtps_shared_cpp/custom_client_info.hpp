@@ -41,6 +41,10 @@
 
 #include "rcpputils/thread_safety_annotations.hpp"
 
+#include "rmw/types.h"
+
+#include "rmw_fastrtps_shared_cpp/condition_listener.hpp"
+#include "rmw_fastrtps_shared_cpp/graph_change_notifier.hpp"
 #include "rmw_fastrtps_shared_cpp/TypeSupport.hpp"
 
 class ClientListener;
@@ -66,6 +70,19 @@ typedef struct CustomClientInfo
   ClientPubListener * pub_listener_{nullptr};
   std::atomic_size_t response_subscriber_matched_count_;
   std::atomic_size_t request_publisher_matched_count_;
+
+  // Notified when the endpoints of the request or response topics change, or get matched
+  rmw_fastrtps_shared_cpp::TopicGraphWatcher graph_watcher_;
+  std::mutex graph_watcher_mutex_;
+  // Notifier the watcher is added to, on first use
+  rmw_fastrtps_shared_cpp::GraphChangeNotifier * graph_change_notifier_
+    RCPPUTILS_TSA_GUARDED_BY(graph_watcher_mutex_) = nullptr;
+  rmw_guard_condition_t * graph_guard_condition_
+    RCPPUTILS_TSA_GUARDED_BY(graph_watcher_mutex_) = nullptr;
+  // Last result of rmw_service_server_is_available(), valid until the watcher changes
+  bool has_cached_availability_ RCPPUTILS_TSA_GUARDED_BY(graph_watcher_mutex_) = false;
+  uint64_t cached_availability_changes_ RCPPUTILS_TSA_GUARDED_BY(graph_watcher_mutex_) = 0u;
+  bool cached_availability_ RCPPUTILS_TSA_GUARDED_BY(graph_watcher_mutex_) = false;
 } CustomClientInfo;
 
 typedef struct CustomClientResponse
@@ -75,12 +92,12 @@ typedef struct CustomClientResponse
   eprosima::fastdds::dds::SampleInfo sample_info_ {};
 } CustomClientResponse;
 
-class ClientListener : public eprosima::fastdds::dds::DataReaderListener
+class ClientListener
+  : public ConditionListenerInterface, public eprosima::fastdds::dds::DataReaderListener
 {
 public:
   explicit ClientListener(CustomClientInfo * info)
-  : info_(info), list_has_data_(false),
-    conditionMutex_(nullptr), conditionVariable_(nullptr) {}
+  : info_(info), list_has_data_(false) {}
 
 
   void
@@ -105,18 +122,13 @@ public:
         {
           std::lock_guard<std::mutex> lock(internalMutex_);
 
-          if (conditionMutex_ != nullptr) {
-            std::unique_lock<std::mutex> clock(*conditionMutex_);
-            list.emplace_back(std::move(response));
-            // the change to list_has_data_ needs to be mutually exclusive with
-            // rmw_wait() which checks hasData() and decides if wait() needs to
-            // be called
-            list_has_data_.store(true);
-            clock.unlock();
-            conditionVariable_->notify_one();
-          } else {
-            list.emplace_back(std::move(response));
-            list_has_data_.store(true);
+          // the change to list_has_data_ needs to be mutually exclusive with
+          // rmw_wait() which checks hasData() and decides if wait() needs to
+          // be called
+          ConditionalScopedLock clock(conditions_, this);
+          list.emplace_back(std::move(response));
+          if (!list_has_data_.exchange(true)) {
+            clock.became_ready();
           }
         }
       }
@@ -127,28 +139,23 @@ public:
   getResponse(CustomClientResponse & response)
   {
     std::lock_guard<std::mutex> lock(internalMutex_);
-
-    if (conditionMutex_ != nullptr) {
-      std::unique_lock<std::mutex> clock(*conditionMutex_);
-      return popResponse(response);
-    }
+    // Clearing list_has_data_ does not need to be exclusive with rmw_wait(), at worst it
+    // reports the client as ready for nothing
     return popResponse(response);
   }
 
   void
-  attachCondition(std::mutex * conditionMutex, std::condition_variable * conditionVariable)
+  attachCondition(WaitSetCondition * condition)
   {
     std::lock_guard<std::mutex> lock(internalMutex_);
-    conditionMutex_ = conditionMutex;
-    conditionVariable_ = conditionVariable;
+    conditions_.attach(condition, this);
   }
 
   void
-  detachCondition()
+  detachCondition(WaitSetCondition * condition)
   {
     std::lock_guard<std::mutex> lock(internalMutex_);
-    conditionMutex_ = nullptr;
-    conditionVariable_ = nullptr;
+    conditions_.detach(condition, this);
   }
 
   bool
@@ -172,6 +179,7 @@ public:
       return;
     }
     info_->response_subscriber_matched_count_.store(publishers_.size());
+    info_->graph_watcher_.notify();
   }
 
 private:
@@ -190,8 +198,7 @@ private:
   std::mutex internalMutex_;
   std::list<CustomClientResponse> list RCPPUTILS_TSA_GUARDED_BY(internalMutex_);
   std::atomic_bool list_has_data_;
-  std::mutex * conditionMutex_ RCPPUTILS_TSA_GUARDED_BY(internalMutex_);
-  std::condition_variable * conditionVariable_ RCPPUTILS_TSA_GUARDED_BY(internalMutex_);
+  AttachedConditions conditions_ RCPPUTILS_TSA_GUARDED_BY(internalMutex_);
   std::set<eprosima::fastrtps::rtps::GUID_t> publishers_;
 };
 
@@ -218,6 +225,7 @@ public:
       return;
     }
     info_->request_publisher_matched_count_.store(subscriptions_.size());
+    info_->graph_watcher_.notify();
   }
 
 private:
@@ -26,23 +26,13 @@
 
 #include "rmw/event.h"
 
+#include "rmw_fastrtps_shared_cpp/condition_listener.hpp"
 #include "rmw_fastrtps_shared_cpp/TypeSupport.hpp"
 
 
-class EventListenerInterface
+class EventListenerInterface : public ConditionListenerInterface
 {
-protected:
-  class ConditionalScopedLock;
-
 public:
-  /// Connect a condition variable so a waiter can be notified of new data.
-  virtual void attachCondition(
-    std::mutex * conditionMutex,
-    std::condition_variable * conditionVariable) = 0;
-
-  /// Unset the information from attachCondition.
-  virtual void detachCondition() = 0;
-
   /// Check if there is new data available for a specific event type.
   /**
     * \param event_type The event type to check on.
@@ -60,34 +50,6 @@ public:
   virtual bool takeNextEvent(rmw_event_type_t event_type, void * event_info) = 0;
 };
 
-class EventListenerInterface::ConditionalScopedLock
-{
-public:
-  ConditionalScopedLock(
-    std::mutex * mutex,
-    std::condition_variable * condition_variable = nullptr)
-  : mutex_(mutex), cv_(condition_variable)
-  {
-    if (nullptr != mutex_) {
-      mutex_->lock();
-    }
-  }
-
-  ~ConditionalScopedLock()
-  {
-    if (nullptr != mutex_) {
-      mutex_->unlock();
-      if (nullptr != cv_) {
-        cv_->notify_all();
-      }
-    }
-  }
-
-private:
-  std::mutex * mutex_;
-  std::condition_variable * cv_;
-};
-
 struct CustomEventInfo
 {
   virtual EventListenerInterface * getListener() const = 0;
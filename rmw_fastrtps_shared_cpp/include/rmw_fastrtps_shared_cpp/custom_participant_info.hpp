@@ -15,7 +15,9 @@
 #ifndef RMW_FASTRTPS_SHARED_CPP__CUSTOM_PARTICIPANT_INFO_HPP_
 #define RMW_FASTRTPS_SHARED_CPP__CUSTOM_PARTICIPANT_INFO_HPP_
 
+#include <atomic>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <vector>
@@ -39,6 +41,8 @@
 #include "rmw_dds_common/context.hpp"
 
 #include "rmw_fastrtps_shared_cpp/create_rmw_gid.hpp"
+#include "rmw_fastrtps_shared_cpp/graph_change_notifier.hpp"
+#include "rmw_fastrtps_shared_cpp/listener_thread.hpp"
 #include "rmw_fastrtps_shared_cpp/qos.hpp"
 #include "rmw_fastrtps_shared_cpp/rmw_common.hpp"
 
@@ -46,6 +50,11 @@ using rmw_dds_common::operator<<;
 
 class ParticipantListener;
 
+namespace rmw_fastrtps_shared_cpp
+{
+class IntraParticipantDelivery;
+}  // namespace rmw_fastrtps_shared_cpp
+
 enum class publishing_mode_t
 {
   ASYNCHRONOUS,  // Asynchronous publishing mode
@@ -71,6 +80,26 @@ typedef struct CustomParticipantInfo
   // with the default configuration.
   bool leave_middleware_default_qos;
   publishing_mode_t publishing_mode;
+
+  // Whether publishers of unbounded types serialize messages once into a scratch buffer,
+  // instead of walking them once to compute their size and once to serialize them.
+  bool serialize_once;
+
+  // Whether publishers take their payloads from a SizeClassedPayloadPool,
+  // instead of reallocating them in their history.
+  bool publisher_payload_pool;
+
+  // Whether samples of bounded types which aren't plain can be loaned to hold serialized
+  // messages, see serialized_loans.hpp.
+  bool serialized_loans;
+
+  // Whether publishers measure the time spent serializing and writing messages,
+  // see publisher_statistics.hpp.
+  bool publisher_timing;
+
+  // Shortcut between the publishers and subscriptions of the participant, if enabled,
+  // see intra_participant_delivery.hpp.
+  std::shared_ptr<rmw_fastrtps_shared_cpp::IntraParticipantDelivery> intra_participant_delivery;
 } CustomParticipantInfo;
 
 class ParticipantListener : public eprosima::fastdds::dds::DomainParticipantListener
@@ -83,6 +112,13 @@ public:
     identifier_(identifier)
   {}
 
+  /// Set the notifier of the changes to the endpoints of each topic.
+  void
+  set_graph_change_notifier(rmw_fastrtps_shared_cpp::GraphChangeNotifier * notifier)
+  {
+    graph_change_notifier_.store(notifier);
+  }
+
   void on_participant_discovery(
     eprosima::fastdds::dds::DomainParticipant *,
     eprosima::fastrtps::rtps::ParticipantDiscoveryInfo && info) override
@@ -108,9 +144,17 @@ public:
       case eprosima::fastrtps::rtps::ParticipantDiscoveryInfo::REMOVED_PARTICIPANT:
       // fall through
       case eprosima::fastrtps::rtps::ParticipantDiscoveryInfo::DROPPED_PARTICIPANT:
-        context->graph_cache.remove_participant(
-          rmw_fastrtps_shared_cpp::create_rmw_gid(
-            identifier_, info.info.m_guid));
+        {
+          rmw_gid_t gid = rmw_fastrtps_shared_cpp::create_rmw_gid(identifier_, info.info.m_guid);
+          context->graph_cache.remove_participant(gid);
+          rmw_fastrtps_shared_cpp::forget_discovery_participant(gid);
+        }
+        {
+          auto notifier = graph_change_notifier_.load();
+          if (nullptr != notifier) {
+            notifier->notify_all_topics();
+          }
+        }
         break;
       default:
         return;
@@ -168,10 +212,15 @@ private:
           is_reader);
       }
     }
+    auto notifier = graph_change_notifier_.load();
+    if (nullptr != notifier) {
+      notifier->notify_topic(proxyData.topicName().to_string());
+    }
   }
 
   rmw_dds_common::Context * context;
   const char * const identifier_;
+  std::atomic<rmw_fastrtps_shared_cpp::GraphChangeNotifier *> graph_change_notifier_{nullptr};
 };
 
 #endif  // RMW_FASTRTPS_SHARED_CPP__CUSTOM_PARTICIPANT_INFO_HPP_
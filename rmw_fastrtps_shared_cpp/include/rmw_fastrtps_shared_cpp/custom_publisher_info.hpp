@@ -17,6 +17,7 @@
 
 #include <atomic>
 #include <condition_variable>
+#include <memory>
 #include <mutex>
 #include <set>
 
@@ -31,10 +32,16 @@
 #include "fastdds/rtps/common/Guid.h"
 #include "fastdds/rtps/common/InstanceHandle.h"
 
+#include "fastcdr/FastBuffer.h"
+
 #include "rcpputils/thread_safety_annotations.hpp"
 #include "rmw/rmw.h"
 
 #include "rmw_fastrtps_shared_cpp/custom_event_info.hpp"
+#include "rmw_fastrtps_shared_cpp/intra_participant_delivery.hpp"
+#include "rmw_fastrtps_shared_cpp/payload_pool.hpp"
+#include "rmw_fastrtps_shared_cpp/publisher_coalescing.hpp"
+#include "rmw_fastrtps_shared_cpp/publisher_statistics.hpp"
 
 
 class PubListener;
@@ -50,19 +57,49 @@ typedef struct CustomPublisherInfo : public CustomEventInfo
   rmw_gid_t publisher_gid{};
   const char * typesupport_identifier_{nullptr};
 
+  // Whether messages are serialized once into the scratch buffer, see SerializedData
+  bool serialize_once_{false};
+  // Serialized messages, kept from one publication to the next to avoid reallocations.
+  // Locked for the whole write, as the buffer is used from within DataWriter::write().
+  std::mutex scratch_buffer_mutex_;
+  eprosima::fastcdr::FastBuffer scratch_buffer_;
+
+  // Pool the payloads of the DataWriter are taken from, if any, also owned by the DataWriter
+  std::shared_ptr<rmw_fastrtps_shared_cpp::SizeClassedPayloadPool> payload_pool_;
+
+  // Whether samples of the DataWriter can be loaned to hold serialized messages
+  bool can_loan_serialized_messages_{false};
+
+  // Shortcut the messages are delivered with to the subscriptions of the same participant,
+  // if the publisher is registered to it
+  std::shared_ptr<rmw_fastrtps_shared_cpp::IntraParticipantDelivery> local_delivery_;
+
+  // Messages held back to be written in bursts, if set with set_publisher_coalescing()
+  std::shared_ptr<rmw_fastrtps_shared_cpp::PublisherCoalescing> coalescing_;
+
+  // Statistics of the publications, see get_publisher_statistics()
+  rmw_fastrtps_shared_cpp::PublisherCounters statistics_;
+
   RMW_FASTRTPS_SHARED_CPP_PUBLIC
   EventListenerInterface *
   getListener() const final;
 } CustomPublisherInfo;
 
+/// Data of the allocations initialized with rmw_init_publisher_allocation().
+typedef struct CustomPublisherAllocation
+{
+  // Type support of the publishers the allocation can be used with, see type_support_impl_
+  const void * type_support_impl_{nullptr};
+  // ROS type support the allocation was initialized with
+  const rosidl_message_type_support_t * type_support_{nullptr};
+} CustomPublisherAllocation;
+
 class PubListener : public EventListenerInterface, public eprosima::fastdds::dds::DataWriterListener
 {
 public:
   explicit PubListener(CustomPublisherInfo * info)
   : deadline_changes_(false),
-    liveliness_changes_(false),
-    conditionMutex_(nullptr),
-    conditionVariable_(nullptr)
+    liveliness_changes_(false)
   {
     (void) info;
   }
@@ -112,19 +149,17 @@ public:
   }
 
   void
-  attachCondition(std::mutex * conditionMutex, std::condition_variable * conditionVariable)
+  attachCondition(WaitSetCondition * condition)
   {
     std::lock_guard<std::mutex> lock(internalMutex_);
-    conditionMutex_ = conditionMutex;
-    conditionVariable_ = conditionVariable;
+    conditions_.attach(condition, this);
   }
 
   void
-  detachCondition()
+  detachCondition(WaitSetCondition * condition)
   {
     std::lock_guard<std::mutex> lock(internalMutex_);
-    conditionMutex_ = nullptr;
-    conditionVariable_ = nullptr;
+    conditions_.detach(condition, this);
   }
 
 private:
@@ -141,8 +176,7 @@ private:
   eprosima::fastdds::dds::LivelinessLostStatus liveliness_lost_status_
     RCPPUTILS_TSA_GUARDED_BY(internalMutex_);
 
-  std::mutex * conditionMutex_ RCPPUTILS_TSA_GUARDED_BY(internalMutex_);
-  std::condition_variable * conditionVariable_ RCPPUTILS_TSA_GUARDED_BY(internalMutex_);
+  AttachedConditions conditions_ RCPPUTILS_TSA_GUARDED_BY(internalMutex_);
 };
 
 #endif  // RMW_FASTRTPS_SHARED_CPP__CUSTOM_PUBLISHER_INFO_HPP_
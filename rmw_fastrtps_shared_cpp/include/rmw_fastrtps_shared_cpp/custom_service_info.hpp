@@ -39,6 +39,7 @@
 
 #include "rcpputils/thread_safety_annotations.hpp"
 
+#include "rmw_fastrtps_shared_cpp/condition_listener.hpp"
 #include "rmw_fastrtps_shared_cpp/guid_utils.hpp"
 #include "rmw_fastrtps_shared_cpp/TypeSupport.hpp"
 
@@ -177,12 +178,12 @@ private:
   std::condition_variable cv_;
 };
 
-class ServiceListener : public eprosima::fastdds::dds::DataReaderListener
+class ServiceListener
+  : public ConditionListenerInterface, public eprosima::fastdds::dds::DataReaderListener
 {
 public:
   explicit ServiceListener(CustomServiceInfo * info)
-  : info_(info), list_has_data_(false),
-    conditionMutex_(nullptr), conditionVariable_(nullptr)
+  : info_(info), list_has_data_(false)
   {
   }
 
@@ -226,18 +227,13 @@ public:
 
         std::lock_guard<std::mutex> lock(internalMutex_);
 
-        if (conditionMutex_ != nullptr) {
-          std::unique_lock<std::mutex> clock(*conditionMutex_);
-          list.push_back(request);
-          // the change to list_has_data_ needs to be mutually exclusive with
-          // rmw_wait() which checks hasData() and decides if wait() needs to
-          // be called
-          list_has_data_.store(true);
-          clock.unlock();
-          conditionVariable_->notify_one();
-        } else {
-          list.push_back(request);
-          list_has_data_.store(true);
+        // the change to list_has_data_ needs to be mutually exclusive with
+        // rmw_wait() which checks hasData() and decides if wait() needs to
+        // be called
+        ConditionalScopedLock clock(conditions_, this);
+        list.push_back(request);
+        if (!list_has_data_.exchange(true)) {
+          clock.became_ready();
         }
       }
     }
@@ -249,38 +245,29 @@ public:
     std::lock_guard<std::mutex> lock(internalMutex_);
     CustomServiceRequest request;
 
-    if (conditionMutex_ != nullptr) {
-      std::unique_lock<std::mutex> clock(*conditionMutex_);
-      if (!list.empty()) {
-        request = list.front();
-        list.pop_front();
-        list_has_data_.store(!list.empty());
-      }
-    } else {
-      if (!list.empty()) {
-        request = list.front();
-        list.pop_front();
-        list_has_data_.store(!list.empty());
-      }
+    // Clearing list_has_data_ does not need to be exclusive with rmw_wait(), at worst it
+    // reports the service as ready for nothing
+    if (!list.empty()) {
+      request = list.front();
+      list.pop_front();
+      list_has_data_.store(!list.empty());
     }
 
     return request;
   }
 
   void
-  attachCondition(std::mutex * conditionMutex, std::condition_variable * conditionVariable)
+  attachCondition(WaitSetCondition * condition)
   {
     std::lock_guard<std::mutex> lock(internalMutex_);
-    conditionMutex_ = conditionMutex;
-    conditionVariable_ = conditionVariable;
+    conditions_.attach(condition, this);
   }
 
   void
-  detachCondition()
+  detachCondition(WaitSetCondition * condition)
   {
     std::lock_guard<std::mutex> lock(internalMutex_);
-    conditionMutex_ = nullptr;
-    conditionVariable_ = nullptr;
+    conditions_.detach(condition, this);
   }
 
   bool
@@ -294,8 +281,7 @@ private:
   std::mutex internalMutex_;
   std::list<CustomServiceRequest> list RCPPUTILS_TSA_GUARDED_BY(internalMutex_);
   std::atomic_bool list_has_data_;
-  std::mutex * conditionMutex_ RCPPUTILS_TSA_GUARDED_BY(internalMutex_);
-  std::condition_variable * conditionVariable_ RCPPUTILS_TSA_GUARDED_BY(internalMutex_);
+  AttachedConditions conditions_ RCPPUTILS_TSA_GUARDED_BY(internalMutex_);
 };
 
 #endif  // RMW_FASTRTPS_SHARED_CPP__CUSTOM_SERVICE_INFO_HPP_
@@ -17,6 +17,10 @@
 
 #include <atomic>
 #include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <set>
@@ -27,6 +31,7 @@
 #include "fastdds/dds/core/status/SubscriptionMatchedStatus.hpp"
 #include "fastdds/dds/subscriber/DataReader.hpp"
 #include "fastdds/dds/subscriber/DataReaderListener.hpp"
+#include "fastdds/dds/subscriber/qos/DataReaderQos.hpp"
 #include "fastdds/dds/topic/TypeSupport.hpp"
 
 #include "fastdds/rtps/common/Guid.h"
@@ -37,6 +42,7 @@
 #include "rmw/impl/cpp/macros.hpp"
 
 #include "rmw_fastrtps_shared_cpp/custom_event_info.hpp"
+#include "rmw_fastrtps_shared_cpp/intra_participant_delivery.hpp"
 
 
 class SubListener;
@@ -57,21 +63,33 @@ struct CustomSubscriberInfo : public CustomEventInfo
   rmw_gid_t subscription_gid_{};
   const char * typesupport_identifier_{nullptr};
   std::shared_ptr<rmw_fastrtps_shared_cpp::LoanManager> loan_manager_;
+  // Whether the DataReader can loan the serialized messages it receives
+  bool can_loan_serialized_messages_{false};
+  // Shortcut the subscription is delivered messages with by the publishers of the same
+  // participant, if it is registered to it
+  std::shared_ptr<rmw_fastrtps_shared_cpp::IntraParticipantDelivery> local_delivery_;
 
   RMW_FASTRTPS_SHARED_CPP_PUBLIC
   EventListenerInterface *
   getListener() const final;
 };
 
+/// Data of the allocations initialized with rmw_init_subscription_allocation().
+struct CustomSubscriptionAllocation
+{
+  // Type support of the subscriptions the allocation can be used with, see type_support_impl_
+  const void * type_support_impl_{nullptr};
+  // ROS type support the allocation was initialized with
+  const rosidl_message_type_support_t * type_support_{nullptr};
+};
+
 class SubListener : public EventListenerInterface, public eprosima::fastdds::dds::DataReaderListener
 {
 public:
   explicit SubListener(CustomSubscriberInfo * info)
   : data_(false),
     deadline_changes_(false),
-    liveliness_changes_(false),
-    conditionMutex_(nullptr),
-    conditionVariable_(nullptr)
+    liveliness_changes_(false)
   {
     // Field is not used right now
     (void)info;
@@ -86,7 +104,10 @@ public:
     {
       std::lock_guard<std::mutex> lock(internalMutex_);
       if (info.current_count_change == 1) {
-        publishers_.insert(eprosima::fastrtps::rtps::iHandle2GUID(info.last_publication_handle));
+        auto guid = eprosima::fastrtps::rtps::iHandle2GUID(info.last_publication_handle);
+        publishers_.insert(guid);
+        // Publications delivered while previously matched don't tell about the next ones
+        local_publishers_.erase(guid);
       } else if (info.current_count_change == -1) {
         publishers_.erase(eprosima::fastrtps::rtps::iHandle2GUID(info.last_publication_handle));
       }
@@ -95,9 +116,18 @@ public:
   }
 
   void
-  on_data_available(eprosima::fastdds::dds::DataReader * reader) final
+  on_data_available(eprosima::fastdds::dds::DataReader *) final
   {
-    update_has_data(reader);
+    // Counted instead of asking the reader, see unread_count_, up to what its history holds
+    int64_t count = unread_count_.load(std::memory_order_relaxed);
+    const int64_t max_count = max_unread_count_.load(std::memory_order_relaxed);
+    while (count < max_count &&
+      !unread_count_.compare_exchange_weak(count, count + 1, std::memory_order_relaxed))
+    {
+    }
+    std::lock_guard<std::mutex> lock(internalMutex_);
+    ConditionalScopedLock clock(conditions_, this);
+    set_has_data(clock);
   }
 
   RMW_FASTRTPS_SHARED_CPP_PUBLIC
@@ -123,19 +153,17 @@ public:
 
   // SubListener API
   void
-  attachCondition(std::mutex * conditionMutex, std::condition_variable * conditionVariable)
+  attachCondition(WaitSetCondition * condition)
   {
     std::lock_guard<std::mutex> lock(internalMutex_);
-    conditionMutex_ = conditionMutex;
-    conditionVariable_ = conditionVariable;
+    conditions_.attach(condition, this);
   }
 
   void
-  detachCondition()
+  detachCondition(WaitSetCondition * condition)
   {
     std::lock_guard<std::mutex> lock(internalMutex_);
-    conditionMutex_ = nullptr;
-    conditionVariable_ = nullptr;
+    conditions_.detach(condition, this);
   }
 
   bool
@@ -144,17 +172,144 @@ public:
     return data_.load(std::memory_order_relaxed);
   }
 
+  /// Bound the samples counted as unread to those the history of the reader can hold.
+  /**
+   * Otherwise, samples dropped by a full KEEP_LAST history would still be counted, and the
+   * subscription be ready once more after its last sample is taken.
+   *
+   * \param[in] qos QoS of the reader the listener is attached to
+   */
+  void
+  set_history_bounds(const eprosima::fastdds::dds::DataReaderQos & qos)
+  {
+    int64_t max_count = qos.resource_limits().max_samples;
+    if (eprosima::fastdds::dds::KEEP_LAST_HISTORY_QOS == qos.history().kind &&
+      0 < qos.history().depth && (0 >= max_count || qos.history().depth < max_count))
+    {
+      max_count = qos.history().depth;
+    }
+    if (0 >= max_count) {
+      max_count = std::numeric_limits<int64_t>::max();
+    }
+    max_unread_count_.store(max_count, std::memory_order_relaxed);
+  }
+
+  /// Recompute whether there is data, asking the reader for its number of unread samples.
   void
   update_has_data(eprosima::fastdds::dds::DataReader * reader)
   {
     // Make sure to call into Fast DDS before taking the lock to avoid an
     // ABBA deadlock between internalMutex_ and mutexes inside of Fast DDS.
-    auto unread_count = reader->get_unread_count();
-    bool has_data = unread_count > 0;
+    // Should samples be received or taken in between, the reader is asked again.
+    int64_t count = unread_count_.load(std::memory_order_relaxed);
+    while (!unread_count_.compare_exchange_strong(
+        count, static_cast<int64_t>(reader->get_unread_count()), std::memory_order_relaxed))
+    {
+    }
+
+    std::lock_guard<std::mutex> lock(internalMutex_);
+    ConditionalScopedLock clock(conditions_, this);
+    update_data_flag(clock);
+    if (0 == unread_count_.load(std::memory_order_relaxed)) {
+      forget_unmatched_local_publishers();
+    }
+  }
+
+  /// Account for samples taken from the reader, whether valid or not.
+  /**
+   * The reader is only asked for its number of unread samples once none may be left, so
+   * that taking a sample is most often a single atomic decrement.
+   *
+   * \param[in] reader reader the samples were taken from
+   * \param[in] count number of samples taken
+   */
+  void
+  on_samples_taken(eprosima::fastdds::dds::DataReader * reader, size_t count)
+  {
+    auto taken = static_cast<int64_t>(count);
+    if (unread_count_.fetch_sub(taken, std::memory_order_relaxed) > taken) {
+      return;
+    }
+    update_has_data(reader);
+  }
+
+  /// Queue a message delivered by a publisher of the same participant.
+  /**
+   * Once a message of a publisher is queued, those of its next publications are, and the
+   * samples written with Fast DDS for them are to be ignored, see was_delivered_locally().
+   *
+   * \param[in] sample message to queue
+   * \param[in] depth number of messages past which the oldest one is dropped, unless it is 0
+   * \return false if the publisher isn't matched with the subscription, or
+   * \return true if the message was queued.
+   */
+  bool
+  add_local_sample(const rmw_fastrtps_shared_cpp::LocalSample & sample, size_t depth)
+  {
+    std::lock_guard<std::mutex> lock(internalMutex_);
+    if (publishers_.find(sample.writer_guid) == publishers_.end()) {
+      return false;
+    }
+    if (0u != sample.publication_number) {
+      local_publishers_.emplace(sample.writer_guid, sample.publication_number);
+    }
+    ConditionalScopedLock clock(conditions_, this);
+    if (0u != depth && local_samples_.size() >= depth) {
+      local_samples_.pop_front();
+    }
+    local_samples_.push_back(sample);
+    set_has_data(clock);
+    return true;
+  }
+
+  /// Whether the publication a sample taken with Fast DDS is tagged with was queued as well.
+  /**
+   * \param[in] writer_guid GUID of the writer of the sample
+   * \param[in] publication_number number the sample is tagged with, or 0 if it isn't
+   */
+  bool
+  was_delivered_locally(
+    const eprosima::fastrtps::rtps::GUID_t & writer_guid, uint64_t publication_number)
+  {
+    if (0u == publication_number) {
+      return false;
+    }
+    std::lock_guard<std::mutex> lock(internalMutex_);
+    auto it = local_publishers_.find(writer_guid);
+    return it != local_publishers_.end() && publication_number >= it->second;
+  }
+
+  /// Take the oldest message delivered by a publisher of the same participant, if any.
+  bool
+  take_local_sample(rmw_fastrtps_shared_cpp::LocalSample & sample)
+  {
+    std::lock_guard<std::mutex> lock(internalMutex_);
+    if (local_samples_.empty()) {
+      return false;
+    }
+    sample = std::move(local_samples_.front());
+    local_samples_.pop_front();
+    ConditionalScopedLock clock(conditions_, this);
+    update_data_flag(clock);
+    return true;
+  }
 
+  size_t
+  local_sample_count()
+  {
     std::lock_guard<std::mutex> lock(internalMutex_);
-    ConditionalScopedLock clock(conditionMutex_, conditionVariable_);
-    data_.store(has_data, std::memory_order_relaxed);
+    return local_samples_.size();
+  }
+
+  /// Create the eventfd readable while there is data, if not done yet.
+  /**
+   * \return the eventfd, or -1 if it could not be created.
+   */
+  int
+  enable_event_fd()
+  {
+    std::lock_guard<std::mutex> lock(internalMutex_);
+    return event_fd_.enable(data_.load(std::memory_order_relaxed)) ? event_fd_.get() : -1;
   }
 
   size_t publisherCount()
@@ -163,10 +318,58 @@ public:
     return publishers_.size();
   }
 
+  bool hasPublisher(const eprosima::fastrtps::rtps::GUID_t & guid)
+  {
+    std::lock_guard<std::mutex> lock(internalMutex_);
+    return publishers_.find(guid) != publishers_.end();
+  }
+
 private:
+  // Waiters and the eventfd are only notified when there was no data yet
+  void
+  set_has_data(ConditionalScopedLock & clock) RCPPUTILS_TSA_REQUIRES(internalMutex_)
+  {
+    if (!data_.exchange(true, std::memory_order_relaxed)) {
+      clock.became_ready();
+      event_fd_.signal();
+    }
+  }
+
+  // Samples of the publishers which aren't matched anymore can't be received once none is
+  // left to take
+  void
+  forget_unmatched_local_publishers() RCPPUTILS_TSA_REQUIRES(internalMutex_)
+  {
+    for (auto it = local_publishers_.begin(); it != local_publishers_.end(); ) {
+      if (publishers_.find(it->first) == publishers_.end()) {
+        it = local_publishers_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  void
+  update_data_flag(ConditionalScopedLock & clock) RCPPUTILS_TSA_REQUIRES(internalMutex_)
+  {
+    bool has_data =
+      unread_count_.load(std::memory_order_relaxed) > 0 || !local_samples_.empty();
+    if (has_data) {
+      set_has_data(clock);
+    } else if (data_.exchange(false, std::memory_order_relaxed)) {
+      event_fd_.clear();
+    }
+  }
+
   mutable std::mutex internalMutex_;
 
   std::atomic_bool data_;
+  // Samples received minus samples taken, which may exceed the number of unread samples of
+  // the reader, e.g. once its history drops some, or lag behind it, until the next call to
+  // update_has_data(). Data is thus only known to be missing once the reader is asked.
+  std::atomic<int64_t> unread_count_{0};
+  // Most samples the history of the reader holds, see set_history_bounds()
+  std::atomic<int64_t> max_unread_count_{std::numeric_limits<int64_t>::max()};
 
   std::atomic_bool deadline_changes_;
   eprosima::fastdds::dds::RequestedDeadlineMissedStatus requested_deadline_missed_status_
@@ -176,10 +379,19 @@ private:
   eprosima::fastdds::dds::LivelinessChangedStatus liveliness_changed_status_
     RCPPUTILS_TSA_GUARDED_BY(internalMutex_);
 
-  std::mutex * conditionMutex_ RCPPUTILS_TSA_GUARDED_BY(internalMutex_);
-  std::condition_variable * conditionVariable_ RCPPUTILS_TSA_GUARDED_BY(internalMutex_);
+  AttachedConditions conditions_ RCPPUTILS_TSA_GUARDED_BY(internalMutex_);
+  rmw_fastrtps_shared_cpp::EventFd event_fd_ RCPPUTILS_TSA_GUARDED_BY(internalMutex_);
 
   std::set<eprosima::fastrtps::rtps::GUID_t> publishers_ RCPPUTILS_TSA_GUARDED_BY(internalMutex_);
+
+  // Number of the first publication queued, for each publisher of the same participant
+  // which delivered messages
+  std::map<eprosima::fastrtps::rtps::GUID_t, uint64_t> local_publishers_
+    RCPPUTILS_TSA_GUARDED_BY(internalMutex_);
+
+  // Messages delivered by publishers of the same participant, not taken yet
+  std::deque<rmw_fastrtps_shared_cpp::LocalSample> local_samples_
+    RCPPUTILS_TSA_GUARDED_BY(internalMutex_);
 };
 
 #endif  // RMW_FASTRTPS_SHARED_CPP__CUSTOM_SUBSCRIBER_INFO_HPP_
@@ -0,0 +1,81 @@
+// Copyright 2021 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RMW_FASTRTPS_SHARED_CPP__DISCOVERY_BATCH_HPP_
+#define RMW_FASTRTPS_SHARED_CPP__DISCOVERY_BATCH_HPP_
+
+#include "rmw/rmw.h"
+
+#include "rmw_dds_common/msg/participant_entities_info.hpp"
+
+#include "rmw_fastrtps_shared_cpp/visibility_control.h"
+
+namespace rmw_fastrtps_shared_cpp
+{
+
+/// Start holding back the ros_discovery_info publications of a context.
+/**
+ * Every entity creation or destruction publishes the entities of the whole participant, so
+ * creating many entities in a row sends a quadratic amount of discovery data.
+ * Within a batch, only the last state is kept, and it is published once when the outermost
+ * batch ends.
+ * Batches can be nested, and a batch can be started before the first node of the context
+ * is created.
+ *
+ * \param[in] identifier implementation identifier, as returned by
+ *   rmw_get_implementation_identifier()
+ * \param[in] context initialized context
+ * \return `RMW_RET_OK` if successful, or
+ * \return `RMW_RET_INVALID_ARGUMENT` if the context is null or not initialized, or
+ * \return `RMW_RET_INCORRECT_RMW_IMPLEMENTATION` if the context is from another
+ *   implementation.
+ */
+RMW_FASTRTPS_SHARED_CPP_PUBLIC
+rmw_ret_t
+begin_discovery_batch(const char * identifier, rmw_context_t * context);
+
+/// End a batch started with begin_discovery_batch().
+/**
+ * When the outermost batch ends, the last participant state held back, if any, is published.
+ * Entities are not rolled back if that fails.
+ *
+ * \param[in] identifier implementation identifier, as returned by
+ *   rmw_get_implementation_identifier()
+ * \param[in] context context a batch was started on
+ * \return `RMW_RET_OK` if successful, or
+ * \return `RMW_RET_INVALID_ARGUMENT` if the context is null or not initialized, or
+ * \return `RMW_RET_INCORRECT_RMW_IMPLEMENTATION` if the context is from another
+ *   implementation, or
+ * \return `RMW_RET_ERROR` if no batch was started, or publishing failed.
+ */
+RMW_FASTRTPS_SHARED_CPP_PUBLIC
+rmw_ret_t
+end_discovery_batch(const char * identifier, rmw_context_t * context);
+
+/// Publish the entities of the participant of a context on ros_discovery_info.
+/**
+ * The message is held back instead if a discovery batch is ongoing.
+ * Must be called with the node update mutex of the context locked, after updating the
+ * graph cache.
+ */
+RMW_FASTRTPS_SHARED_CPP_PUBLIC
+rmw_ret_t
+publish_participant_entities_info(
+  const char * identifier,
+  rmw_context_t * context,
+  const rmw_dds_common::msg::ParticipantEntitiesInfo & msg);
+
+}  // namespace rmw_fastrtps_shared_cpp
+
+#endif  // RMW_FASTRTPS_SHARED_CPP__DISCOVERY_BATCH_HPP_
@@ -0,0 +1,160 @@
+// Copyright 2021 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RMW_FASTRTPS_SHARED_CPP__EVENT_FD_HPP_
+#define RMW_FASTRTPS_SHARED_CPP__EVENT_FD_HPP_
+
+#ifdef __linux__
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+#include "rmw/rmw.h"
+
+#include "rmw_fastrtps_shared_cpp/visibility_control.h"
+
+namespace rmw_fastrtps_shared_cpp
+{
+
+/// Linux eventfd a listener signals, along with its condition variable, when notifying.
+/**
+ * It is only created on request, and is never available on other platforms.
+ */
+class EventFd
+{
+public:
+  EventFd() = default;
+
+  EventFd(const EventFd &) = delete;
+  EventFd & operator=(const EventFd &) = delete;
+
+  ~EventFd()
+  {
+#ifdef __linux__
+    if (fd_ >= 0) {
+      ::close(fd_);
+    }
+#endif
+  }
+
+  /// Create the eventfd, if not done yet, returning false on failure.
+  /**
+   * A new eventfd starts readable by default, as something may have been ready before it
+   * existed.
+   *
+   * \param[in] readable whether a new eventfd starts readable
+   */
+  bool
+  enable(bool readable = true)
+  {
+#ifdef __linux__
+    if (fd_ < 0) {
+      fd_ = ::eventfd(readable ? 1u : 0u, EFD_CLOEXEC | EFD_NONBLOCK);
+    }
+    return fd_ >= 0;
+#else
+    (void)readable;
+    return false;
+#endif
+  }
+
+  /// Return the eventfd, or -1 when not enabled.
+  int
+  get() const
+  {
+    return fd_;
+  }
+
+  /// Make the eventfd readable, if enabled.
+  void
+  signal() const
+  {
+#ifdef __linux__
+    if (fd_ >= 0) {
+      (void)::eventfd_write(fd_, 1u);
+    }
+#endif
+  }
+
+  /// Make the eventfd no longer readable, if enabled.
+  void
+  clear() const
+  {
+#ifdef __linux__
+    if (fd_ >= 0) {
+      eventfd_t value = 0;
+      (void)::eventfd_read(fd_, &value);
+    }
+#endif
+  }
+
+private:
+  int fd_ = -1;
+};
+
+/// Return a file descriptor that becomes readable when an entity of a wait set may be ready.
+/**
+ * The eventfd is created on the first call, and owned by the wait set.
+ * It is signaled whenever one of the entities passed to the last rmw_wait() call on the wait
+ * set becomes ready, as they stay attached to it between calls.
+ * The caller is expected to read the eventfd to clear it, then call rmw_wait() with a zero
+ * timeout to find out which entities are ready, and handle all of them.
+ *
+ * \param[in] identifier implementation identifier, as returned by
+ *   rmw_get_implementation_identifier()
+ * \param[in] wait_set wait set to get the file descriptor of
+ * \param[out] fd file descriptor, valid until the wait set is destroyed
+ * \return `RMW_RET_OK` if successful, or
+ * \return `RMW_RET_INVALID_ARGUMENT` if any argument is null, or
+ * \return `RMW_RET_INCORRECT_RMW_IMPLEMENTATION` if the wait set is from another
+ *   implementation, or
+ * \return `RMW_RET_UNSUPPORTED` if not running on Linux, or
+ * \return `RMW_RET_ERROR` if the eventfd could not be created.
+ */
+RMW_FASTRTPS_SHARED_CPP_PUBLIC
+rmw_ret_t
+get_wait_set_event_fd(
+  const char * identifier,
+  rmw_wait_set_t * wait_set,
+  int * fd);
+
+/// Return a file descriptor that becomes readable when a subscription receives data.
+/**
+ * The eventfd is created on the first call, and owned by the subscription.
+ * It is signaled when data is received while there was none, and cleared once all of it is
+ * taken.
+ * The caller is expected to read the eventfd to clear it, then take messages until none is
+ * left, without needing a wait set at all.
+ *
+ * \param[in] identifier implementation identifier, as returned by
+ *   rmw_get_implementation_identifier()
+ * \param[in] subscription subscription to get the file descriptor of
+ * \param[out] fd file descriptor, valid until the subscription is destroyed
+ * \return `RMW_RET_OK` if successful, or
+ * \return `RMW_RET_INVALID_ARGUMENT` if any argument is null, or
+ * \return `RMW_RET_INCORRECT_RMW_IMPLEMENTATION` if the subscription is from another
+ *   implementation, or
+ * \return `RMW_RET_UNSUPPORTED` if not running on Linux, or
+ * \return `RMW_RET_ERROR` if the eventfd could not be created.
+ */
+RMW_FASTRTPS_SHARED_CPP_PUBLIC
+rmw_ret_t
+get_subscription_event_fd(
+  const char * identifier,
+  rmw_subscription_t * subscription,
+  int * fd);
+
+}  // namespace rmw_fastrtps_shared_cpp
+
+#endif  // RMW_FASTRTPS_SHARED_CPP__EVENT_FD_HPP_
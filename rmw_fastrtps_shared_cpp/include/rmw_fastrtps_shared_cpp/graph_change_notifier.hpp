@@ -0,0 +1,245 @@
+// Copyright 2021 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RMW_FASTRTPS_SHARED_CPP__GRAPH_CHANGE_NOTIFIER_HPP_
+#define RMW_FASTRTPS_SHARED_CPP__GRAPH_CHANGE_NOTIFIER_HPP_
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "rcpputils/thread_safety_annotations.hpp"
+
+#include "rmw/rmw.h"
+
+#include "rmw_fastrtps_shared_cpp/rmw_common.hpp"
+
+namespace rmw_fastrtps_shared_cpp
+{
+
+/// Count the changes of the endpoints of some topics, and trigger a guard condition on each.
+class TopicGraphWatcher
+{
+public:
+  /// Set the guard condition to trigger on changes, or null to only count them.
+  void
+  set_guard_condition(const rmw_guard_condition_t * guard_condition)
+  {
+    guard_condition_.store(guard_condition);
+  }
+
+  const rmw_guard_condition_t *
+  get_guard_condition() const
+  {
+    return guard_condition_.load();
+  }
+
+  /// Number of changes notified so far.
+  uint64_t
+  get_changes() const
+  {
+    return changes_.load(std::memory_order_acquire);
+  }
+
+  void
+  notify()
+  {
+    changes_.fetch_add(1u, std::memory_order_acq_rel);
+    const rmw_guard_condition_t * guard_condition = guard_condition_.load();
+    if (nullptr != guard_condition) {
+      __rmw_trigger_guard_condition(guard_condition->implementation_identifier, guard_condition);
+    }
+  }
+
+private:
+  std::atomic<const rmw_guard_condition_t *> guard_condition_{nullptr};
+  std::atomic<uint64_t> changes_{0u};
+};
+
+/// Trigger the graph guard condition of a context when the graph changes.
+/**
+ * Notifications can be deferred while a batch of changes is applied, so that the guard
+ * condition is triggered once for the whole batch.
+ *
+ * Changes to the endpoints of a topic are also notified to the watchers of that topic
+ * only, so that waiting on a single topic doesn't wake up on every change in the domain.
+ */
+class GraphChangeNotifier
+{
+public:
+  /// Set the guard condition to trigger, before any notification.
+  void
+  set_guard_condition(const char * identifier, const rmw_guard_condition_t * guard_condition)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    identifier_ = identifier;
+    guard_condition_ = guard_condition;
+  }
+
+  /// Notify a graph change, or record it if notifications are deferred.
+  void
+  notify()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (deferred_) {
+        pending_ = true;
+        return;
+      }
+    }
+    trigger();
+  }
+
+  /// Defer notifications until flush() is called.
+  void
+  defer()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    deferred_ = true;
+  }
+
+  /// Stop deferring notifications, and notify once if any was deferred.
+  void
+  flush()
+  {
+    bool pending;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      deferred_ = false;
+      pending = pending_;
+      pending_ = false;
+    }
+    if (pending) {
+      trigger();
+    }
+  }
+
+  /// Notify a watcher of the changes of the endpoints of a topic, until it is removed.
+  /**
+   * \param[in] topic_name DDS topic name, i.e. mangled
+   */
+  void
+  add_topic_watcher(const std::string & topic_name, TopicGraphWatcher * watcher)
+  {
+    std::lock_guard<std::mutex> lock(topic_watchers_mutex_);
+    topic_watchers_.emplace(topic_name, watcher);
+  }
+
+  /// Stop notifying a watcher, which isn't used anymore once this returns.
+  void
+  remove_topic_watcher(const std::string & topic_name, const TopicGraphWatcher * watcher)
+  {
+    std::lock_guard<std::mutex> lock(topic_watchers_mutex_);
+    auto range = topic_watchers_.equal_range(topic_name);
+    for (auto it = range.first; it != range.second; ++it) {
+      if (it->second == watcher) {
+        topic_watchers_.erase(it);
+        return;
+      }
+    }
+  }
+
+  /// Trigger a guard condition when the endpoints of a topic change, until it is removed.
+  void
+  add_topic_guard_condition(
+    const std::string & topic_name,
+    const rmw_guard_condition_t * guard_condition)
+  {
+    auto watcher = std::make_unique<TopicGraphWatcher>();
+    watcher->set_guard_condition(guard_condition);
+    std::lock_guard<std::mutex> lock(topic_watchers_mutex_);
+    topic_watchers_.emplace(topic_name, watcher.get());
+    owned_watchers_.emplace(watcher.get(), std::move(watcher));
+  }
+
+  /// Stop triggering a guard condition, which isn't used anymore once this returns.
+  /**
+   * \return `false` if the guard condition wasn't added for this topic.
+   */
+  bool
+  remove_topic_guard_condition(
+    const std::string & topic_name,
+    const rmw_guard_condition_t * guard_condition)
+  {
+    std::lock_guard<std::mutex> lock(topic_watchers_mutex_);
+    auto range = topic_watchers_.equal_range(topic_name);
+    for (auto it = range.first; it != range.second; ++it) {
+      auto owned_it = owned_watchers_.find(it->second);
+      if (owned_it != owned_watchers_.end() &&
+        it->second->get_guard_condition() == guard_condition)
+      {
+        topic_watchers_.erase(it);
+        owned_watchers_.erase(owned_it);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /// Notify the watchers of a topic that its endpoints changed.
+  void
+  notify_topic(const std::string & topic_name)
+  {
+    std::lock_guard<std::mutex> lock(topic_watchers_mutex_);
+    auto range = topic_watchers_.equal_range(topic_name);
+    for (auto it = range.first; it != range.second; ++it) {
+      it->second->notify();
+    }
+  }
+
+  /// Notify the watchers of every topic, e.g. when a participant and its endpoints are gone.
+  void
+  notify_all_topics()
+  {
+    std::lock_guard<std::mutex> lock(topic_watchers_mutex_);
+    for (auto & topic_and_watcher : topic_watchers_) {
+      topic_and_watcher.second->notify();
+    }
+  }
+
+private:
+  void
+  trigger()
+  {
+    const char * identifier;
+    const rmw_guard_condition_t * guard_condition;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      identifier = identifier_;
+      guard_condition = guard_condition_;
+    }
+    if (nullptr != guard_condition) {
+      __rmw_trigger_guard_condition(identifier, guard_condition);
+    }
+  }
+
+  std::mutex mutex_;
+  const char * identifier_ RCPPUTILS_TSA_GUARDED_BY(mutex_) = nullptr;
+  const rmw_guard_condition_t * guard_condition_ RCPPUTILS_TSA_GUARDED_BY(mutex_) = nullptr;
+  bool deferred_ RCPPUTILS_TSA_GUARDED_BY(mutex_) = false;
+  bool pending_ RCPPUTILS_TSA_GUARDED_BY(mutex_) = false;
+
+  std::mutex topic_watchers_mutex_;
+  std::multimap<std::string, TopicGraphWatcher *> topic_watchers_
+    RCPPUTILS_TSA_GUARDED_BY(topic_watchers_mutex_);
+  // Watchers created for add_topic_guard_condition()
+  std::map<const TopicGraphWatcher *, std::unique_ptr<TopicGraphWatcher>> owned_watchers_
+    RCPPUTILS_TSA_GUARDED_BY(topic_watchers_mutex_);
+};
+
+}  // namespace rmw_fastrtps_shared_cpp
+
+#endif  // RMW_FASTRTPS_SHARED_CPP__GRAPH_CHANGE_NOTIFIER_HPP_
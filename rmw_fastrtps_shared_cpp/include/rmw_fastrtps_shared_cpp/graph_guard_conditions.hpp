@@ -0,0 +1,114 @@
+// Copyright 2021 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RMW_FASTRTPS_SHARED_CPP__GRAPH_GUARD_CONDITIONS_HPP_
+#define RMW_FASTRTPS_SHARED_CPP__GRAPH_GUARD_CONDITIONS_HPP_
+
+#include "rmw/rmw.h"
+
+#include "rmw_fastrtps_shared_cpp/visibility_control.h"
+
+namespace rmw_fastrtps_shared_cpp
+{
+
+/// Trigger a guard condition when the publishers or subscriptions of a topic change.
+/**
+ * Unlike the graph guard condition of the node, which is triggered by any change in the
+ * domain, the guard condition is only triggered by changes to the endpoints of this topic.
+ *
+ * \param[in] identifier implementation identifier, as returned by
+ *   rmw_get_implementation_identifier()
+ * \param[in] node node whose context is watched
+ * \param[in] topic_name fully qualified ROS topic name
+ * \param[in] guard_condition guard condition to trigger, which must outlive the watch
+ * \return `RMW_RET_OK` if successful, or
+ * \return `RMW_RET_INVALID_ARGUMENT` if any argument is null, or
+ * \return `RMW_RET_INCORRECT_RMW_IMPLEMENTATION` if the node or guard condition is from
+ *   another implementation.
+ */
+RMW_FASTRTPS_SHARED_CPP_PUBLIC
+rmw_ret_t
+add_topic_graph_guard_condition(
+  const char * identifier,
+  const rmw_node_t * node,
+  const char * topic_name,
+  const rmw_guard_condition_t * guard_condition);
+
+/// Stop triggering a guard condition added with add_topic_graph_guard_condition().
+/**
+ * \return `RMW_RET_OK` if successful, or
+ * \return `RMW_RET_INVALID_ARGUMENT` if any argument is null, or the guard condition
+ *   wasn't added for this topic, or
+ * \return `RMW_RET_INCORRECT_RMW_IMPLEMENTATION` if the node is from another implementation.
+ */
+RMW_FASTRTPS_SHARED_CPP_PUBLIC
+rmw_ret_t
+remove_topic_graph_guard_condition(
+  const char * identifier,
+  const rmw_node_t * node,
+  const char * topic_name,
+  const rmw_guard_condition_t * guard_condition);
+
+/// Trigger a guard condition when the servers or clients of a service change.
+/**
+ * \sa add_topic_graph_guard_condition()
+ *
+ * \param[in] service_name fully qualified ROS service name
+ */
+RMW_FASTRTPS_SHARED_CPP_PUBLIC
+rmw_ret_t
+add_service_graph_guard_condition(
+  const char * identifier,
+  const rmw_node_t * node,
+  const char * service_name,
+  const rmw_guard_condition_t * guard_condition);
+
+/// Stop triggering a guard condition added with add_service_graph_guard_condition().
+RMW_FASTRTPS_SHARED_CPP_PUBLIC
+rmw_ret_t
+remove_service_graph_guard_condition(
+  const char * identifier,
+  const rmw_node_t * node,
+  const char * service_name,
+  const rmw_guard_condition_t * guard_condition);
+
+/// Get a guard condition triggered when the server of a client may become (un)available.
+/**
+ * The guard condition is triggered when the endpoints of the service change, or get
+ * matched with the client, so waiting on it before calling rmw_service_server_is_available()
+ * doesn't wake up on unrelated graph changes.
+ * It is owned by the client, and destroyed along with it.
+ *
+ * \param[in] identifier implementation identifier, as returned by
+ *   rmw_get_implementation_identifier()
+ * \param[in] node node the client was created from
+ * \param[in] client client to get the guard condition of
+ * \param[out] guard_condition guard condition of the client
+ * \return `RMW_RET_OK` if successful, or
+ * \return `RMW_RET_INVALID_ARGUMENT` if any argument is null, or
+ * \return `RMW_RET_INCORRECT_RMW_IMPLEMENTATION` if the node or client is from another
+ *   implementation, or
+ * \return `RMW_RET_ERROR` if the guard condition couldn't be created.
+ */
+RMW_FASTRTPS_SHARED_CPP_PUBLIC
+rmw_ret_t
+get_client_graph_guard_condition(
+  const char * identifier,
+  const rmw_node_t * node,
+  const rmw_client_t * client,
+  const rmw_guard_condition_t ** guard_condition);
+
+}  // namespace rmw_fastrtps_shared_cpp
+
+#endif  // RMW_FASTRTPS_SHARED_CPP__GRAPH_GUARD_CONDITIONS_HPP_
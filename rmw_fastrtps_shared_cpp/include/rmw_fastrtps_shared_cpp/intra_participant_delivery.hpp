@@ -0,0 +1,157 @@
+// Copyright 2021 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RMW_FASTRTPS_SHARED_CPP__INTRA_PARTICIPANT_DELIVERY_HPP_
+#define RMW_FASTRTPS_SHARED_CPP__INTRA_PARTICIPANT_DELIVERY_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "fastdds/dds/subscriber/SampleInfo.hpp"
+#include "fastdds/rtps/common/Guid.h"
+#include "fastdds/rtps/common/WriteParams.h"
+
+#include "rcpputils/thread_safety_annotations.hpp"
+
+#include "rmw/types.h"
+
+#include "rmw_fastrtps_shared_cpp/visibility_control.h"
+
+struct CustomPublisherInfo;
+struct CustomSubscriberInfo;
+
+namespace rmw_fastrtps_shared_cpp
+{
+
+/// Message published to the subscriptions of the same participant.
+struct LocalSample
+{
+  // Immutable copy of the message, shared by all the subscriptions it is delivered to
+  std::shared_ptr<const void> ros_message;
+  eprosima::fastrtps::rtps::GUID_t writer_guid;
+  rmw_time_point_value_t source_timestamp{0};
+  // Number of the publication among those of the writer, starting at 1, which the sample
+  // written with Fast DDS for the same publication, if any, is tagged with
+  uint64_t publication_number{0};
+};
+
+/// Tag a sample written with Fast DDS with the number of its publication, see LocalSample.
+RMW_FASTRTPS_SHARED_CPP_PUBLIC
+void
+set_local_publication_number(
+  eprosima::fastrtps::rtps::WriteParams & params,
+  const eprosima::fastrtps::rtps::GUID_t & writer_guid,
+  uint64_t publication_number);
+
+/// Get the number of the publication a sample taken with Fast DDS is tagged with.
+/**
+ * \return the number of the publication, or 0 if the sample isn't tagged.
+ */
+RMW_FASTRTPS_SHARED_CPP_PUBLIC
+uint64_t
+get_local_publication_number(const eprosima::fastdds::dds::SampleInfo & sample_info);
+
+/// Shortcut between the publishers and subscriptions of a participant.
+/**
+ * Enabled when the `RMW_FASTRTPS_INTRA_PARTICIPANT_DELIVERY` environment variable is set to
+ * `1`, for the type supports which can copy ROS messages.
+ *
+ * A message published by a registered publisher is copied once, and the copy is queued in
+ * the registered subscriptions of the same type the publisher is matched with, which copy it
+ * into the message they take, instead of it being serialized, written and deserialized.
+ * The publisher writes the message with Fast DDS only when it is matched with other
+ * subscriptions, tagged with the number of the publication, and registered subscriptions
+ * ignore the samples of the publications queued in them.
+ * A subscription may be matched by Fast DDS before being delivered messages, so that it
+ * receives the samples of the first publications instead.
+ *
+ * Only volatile publishers and subscriptions without a deadline, whose samples aren't loaned,
+ * are registered.
+ */
+class IntraParticipantDelivery : public std::enable_shared_from_this<IntraParticipantDelivery>
+{
+public:
+  /// Register a publisher, and set its `local_delivery_`, if it can deliver messages.
+  /**
+   * Must be called once the publisher is created, as it delivers messages from then on.
+   */
+  RMW_FASTRTPS_SHARED_CPP_PUBLIC
+  void
+  add_publisher(CustomPublisherInfo * info, bool can_loan_messages);
+
+  RMW_FASTRTPS_SHARED_CPP_PUBLIC
+  void
+  remove_publisher(CustomPublisherInfo * info);
+
+  /// Register a subscription, and set its `local_delivery_`, if it can be delivered messages.
+  /**
+   * Must be called once the subscription is created, as it is delivered messages from then on.
+   */
+  RMW_FASTRTPS_SHARED_CPP_PUBLIC
+  void
+  add_subscription(
+    CustomSubscriberInfo * info, bool can_loan_messages, bool ignore_local_publications);
+
+  /// Unregister a subscription, which isn't delivered messages anymore once it returns.
+  RMW_FASTRTPS_SHARED_CPP_PUBLIC
+  void
+  remove_subscription(CustomSubscriberInfo * info);
+
+  /// Deliver a message of a registered publisher to the subscriptions it is matched with.
+  /**
+   * Subscriptions ignoring local publications are counted without being delivered anything.
+   *
+   * \param[in] info publisher of the message
+   * \param[inout] sample message to deliver, whose publication number is set
+   * \return the number of subscriptions the message was delivered to.
+   */
+  RMW_FASTRTPS_SHARED_CPP_PUBLIC
+  size_t
+  deliver(const CustomPublisherInfo * info, LocalSample & sample);
+
+private:
+  struct LocalSubscription
+  {
+    CustomSubscriberInfo * info;
+    // Messages which aren't taken yet are dropped past it, unless it is 0
+    size_t depth;
+    bool ignore_local_publications;
+  };
+
+  struct LocalPublisher
+  {
+    // Type support implementation of the writer, which only delivers to subscriptions of the
+    // same one
+    const void * type_support_impl;
+    // Numbered under the mutex, so that each subscription is delivered the publications
+    // following the first one it is delivered
+    uint64_t publication_count;
+  };
+
+  std::mutex mutex_;
+  // Registered publishers, by writer GUID
+  std::map<eprosima::fastrtps::rtps::GUID_t, LocalPublisher> publishers_
+    RCPPUTILS_TSA_GUARDED_BY(mutex_);
+  // Registered subscriptions, by topic name
+  std::multimap<std::string, LocalSubscription> subscriptions_
+    RCPPUTILS_TSA_GUARDED_BY(mutex_);
+};
+
+}  // namespace rmw_fastrtps_shared_cpp
+
+#endif  // RMW_FASTRTPS_SHARED_CPP__INTRA_PARTICIPANT_DELIVERY_HPP_
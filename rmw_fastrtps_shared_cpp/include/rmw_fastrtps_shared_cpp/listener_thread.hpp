@@ -16,19 +16,39 @@
 #define RMW_FASTRTPS_SHARED_CPP__LISTENER_THREAD_HPP_
 
 #include "rmw/init.h"
+#include "rmw/types.h"
 
 #include "rmw_fastrtps_shared_cpp/visibility_control.h"
 
 namespace rmw_fastrtps_shared_cpp
 {
 
+/// Start listening to the ros_discovery_info subscription of a context.
+/**
+ * A single thread listens for every context of the process, and the messages received by
+ * contexts on the same domain are only deserialized once.
+ * The thread is started along with the first context.
+ */
 RMW_FASTRTPS_SHARED_CPP_PUBLIC
 rmw_ret_t
 run_listener_thread(rmw_context_t * context);
 
+/// Stop listening to the ros_discovery_info subscription of a context.
+/**
+ * After this returns, the subscription is not used anymore and can be destroyed.
+ * The thread is joined along with the last context.
+ */
 RMW_FASTRTPS_SHARED_CPP_PUBLIC
 rmw_ret_t
 join_listener_thread(rmw_context_t * context);
 
+/// Forget the last ros_discovery_info message of a participant that went away.
+/**
+ * Contexts created afterwards then don't learn about the participant from it.
+ */
+RMW_FASTRTPS_SHARED_CPP_PUBLIC
+void
+forget_discovery_participant(const rmw_gid_t & gid);
+
 }  // namespace rmw_fastrtps_shared_cpp
 #endif  // RMW_FASTRTPS_SHARED_CPP__LISTENER_THREAD_HPP_
@@ -0,0 +1,86 @@
+// Copyright 2021 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RMW_FASTRTPS_SHARED_CPP__MESSAGE_SEQUENCE_LOANS_HPP_
+#define RMW_FASTRTPS_SHARED_CPP__MESSAGE_SEQUENCE_LOANS_HPP_
+
+#include <cstddef>
+
+#include "rmw/message_sequence.h"
+#include "rmw/rmw.h"
+
+#include "rmw_fastrtps_shared_cpp/visibility_control.h"
+
+namespace rmw_fastrtps_shared_cpp
+{
+
+/// Take several messages at once as loans, from a subscription which can loan messages.
+/**
+ * The messages are loaned by a single call to the DataReader, instead of one per message as
+ * with rmw_take_loaned_message().
+ * They are returned either one by one with rmw_return_loaned_message_from_subscription(), or
+ * all at once with return_loaned_message_sequence_from_subscription().
+ *
+ * \param[in] identifier implementation identifier, as returned by
+ *   rmw_get_implementation_identifier()
+ * \param[in] subscription subscription to take the messages from
+ * \param[in] count maximum number of messages to take
+ * \param[inout] message_sequence sequence with a capacity of at least `count`, whose
+ *   messages are set to the loaned ones
+ * \param[inout] message_info_sequence sequence with a capacity of at least `count`, set to
+ *   the info of the messages taken
+ * \param[out] taken number of messages taken
+ * \return `RMW_RET_OK` if successful, or
+ * \return `RMW_RET_INVALID_ARGUMENT` if any argument is null, `count` is zero or a sequence
+ *   is too small, or
+ * \return `RMW_RET_INCORRECT_RMW_IMPLEMENTATION` if the subscription is from another
+ *   implementation, or
+ * \return `RMW_RET_UNSUPPORTED` if the subscription cannot loan messages, or
+ * \return `RMW_RET_BAD_ALLOC` if memory allocation failed, or
+ * \return `RMW_RET_ERROR` if too many messages are loaned.
+ */
+RMW_FASTRTPS_SHARED_CPP_PUBLIC
+rmw_ret_t
+take_loaned_message_sequence(
+  const char * identifier,
+  const rmw_subscription_t * subscription,
+  size_t count,
+  rmw_message_sequence_t * message_sequence,
+  rmw_message_info_sequence_t * message_info_sequence,
+  size_t * taken);
+
+/// Return all the messages of a sequence loaned by a subscription.
+/**
+ * \param[in] identifier implementation identifier, as returned by
+ *   rmw_get_implementation_identifier()
+ * \param[in] subscription subscription the messages were taken from
+ * \param[inout] message_sequence sequence of loaned messages, emptied of those returned
+ * \return `RMW_RET_OK` if successful, or
+ * \return `RMW_RET_INVALID_ARGUMENT` if any argument is null, or
+ * \return `RMW_RET_INCORRECT_RMW_IMPLEMENTATION` if the subscription is from another
+ *   implementation, or
+ * \return `RMW_RET_UNSUPPORTED` if the subscription cannot loan messages, or
+ * \return `RMW_RET_ERROR` if a message was not loaned by this subscription, in which case
+ *   the sequence is left with the messages from that one on.
+ */
+RMW_FASTRTPS_SHARED_CPP_PUBLIC
+rmw_ret_t
+return_loaned_message_sequence_from_subscription(
+  const char * identifier,
+  const rmw_subscription_t * subscription,
+  rmw_message_sequence_t * message_sequence);
+
+}  // namespace rmw_fastrtps_shared_cpp
+
+#endif  // RMW_FASTRTPS_SHARED_CPP__MESSAGE_SEQUENCE_LOANS_HPP_
@@ -0,0 +1,157 @@
+// Copyright 2021 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RMW_FASTRTPS_SHARED_CPP__PAYLOAD_POOL_HPP_
+#define RMW_FASTRTPS_SHARED_CPP__PAYLOAD_POOL_HPP_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "fastdds/dds/publisher/DataWriter.hpp"
+#include "fastdds/dds/publisher/DataWriterListener.hpp"
+#include "fastdds/dds/publisher/Publisher.hpp"
+#include "fastdds/dds/publisher/qos/DataWriterQos.hpp"
+#include "fastdds/dds/topic/Topic.hpp"
+#include "fastdds/rtps/common/CacheChange.h"
+#include "fastdds/rtps/common/SerializedPayload.h"
+#include "fastdds/rtps/history/IPayloadPool.h"
+
+#include "rcpputils/thread_safety_annotations.hpp"
+
+#include "rmw/rmw.h"
+
+#include "rmw_fastrtps_shared_cpp/visibility_control.h"
+
+namespace rmw_fastrtps_shared_cpp
+{
+
+/// Statistics of the payload pool of a publisher.
+struct PayloadPoolStatistics
+{
+  /// Number of payloads reused from the pool.
+  uint64_t hits;
+  /// Number of payloads which had to be allocated.
+  uint64_t misses;
+  /// Number of bytes currently allocated by the pool, whether in use or not.
+  uint64_t allocated_bytes;
+};
+
+/// Pool of DataWriter payloads, rounded up to powers of two.
+/**
+ * Payloads are allocated the first times a size class is needed, and are reused once
+ * released, so a publisher stops allocating once its history has been filled with
+ * messages of each size it publishes.
+ * Up to `max_free_per_class` free payloads are kept per size class, or all of them if 0,
+ * so that a burst of large messages does not hold memory forever.
+ */
+class SizeClassedPayloadPool : public eprosima::fastrtps::rtps::IPayloadPool
+{
+public:
+  RMW_FASTRTPS_SHARED_CPP_PUBLIC
+  explicit SizeClassedPayloadPool(size_t max_free_per_class);
+
+  RMW_FASTRTPS_SHARED_CPP_PUBLIC
+  ~SizeClassedPayloadPool() override;
+
+  RMW_FASTRTPS_SHARED_CPP_PUBLIC
+  bool
+  get_payload(
+    uint32_t size,
+    eprosima::fastrtps::rtps::CacheChange_t & cache_change) override;
+
+  RMW_FASTRTPS_SHARED_CPP_PUBLIC
+  bool
+  get_payload(
+    eprosima::fastrtps::rtps::SerializedPayload_t & data,
+    eprosima::fastrtps::rtps::IPayloadPool * & data_owner,
+    eprosima::fastrtps::rtps::CacheChange_t & cache_change) override;
+
+  RMW_FASTRTPS_SHARED_CPP_PUBLIC
+  bool
+  release_payload(eprosima::fastrtps::rtps::CacheChange_t & cache_change) override;
+
+  RMW_FASTRTPS_SHARED_CPP_PUBLIC
+  PayloadPoolStatistics
+  get_statistics() const;
+
+  /// Size of the payloads of the class a requested size belongs to.
+  RMW_FASTRTPS_SHARED_CPP_PUBLIC
+  static uint32_t
+  class_size(uint32_t size);
+
+private:
+  static constexpr size_t min_class_log2 = 6;
+  // The largest class holds payloads of 2 GiB
+  static constexpr size_t class_count = 32 - min_class_log2;
+
+  static size_t
+  class_index(uint32_t size);
+
+  const size_t max_free_per_class_;
+
+  mutable std::mutex mutex_;
+  std::array<std::vector<eprosima::fastrtps::rtps::octet *>, class_count> free_payloads_
+    RCPPUTILS_TSA_GUARDED_BY(mutex_);
+  PayloadPoolStatistics statistics_ RCPPUTILS_TSA_GUARDED_BY(mutex_) = {0u, 0u, 0u};
+};
+
+/// Create a payload pool for a DataWriter.
+/**
+ * As many free payloads per size class are kept as the history of the DataWriter can hold.
+ *
+ * \return the pool, or null if this version of Fast DDS cannot give a pool to DataWriters.
+ */
+RMW_FASTRTPS_SHARED_CPP_PUBLIC
+std::shared_ptr<SizeClassedPayloadPool>
+create_payload_pool(const eprosima::fastdds::dds::DataWriterQos & qos);
+
+/// Create a DataWriter taking its payloads from a pool, or from its history if null.
+RMW_FASTRTPS_SHARED_CPP_PUBLIC
+eprosima::fastdds::dds::DataWriter *
+create_datawriter(
+  eprosima::fastdds::dds::Publisher * publisher,
+  eprosima::fastdds::dds::Topic * topic,
+  const eprosima::fastdds::dds::DataWriterQos & qos,
+  eprosima::fastdds::dds::DataWriterListener * listener,
+  const std::shared_ptr<SizeClassedPayloadPool> & payload_pool);
+
+/// Get the statistics of the payload pool of a publisher.
+/**
+ * Publishers use a payload pool when the `RMW_FASTRTPS_PUBLISHER_PAYLOAD_POOL` environment
+ * variable is set to `1`, if built with Fast DDS 2.5 or newer, as reported when configuring.
+ *
+ * \param[in] identifier implementation identifier, as returned by
+ *   rmw_get_implementation_identifier()
+ * \param[in] publisher publisher to get the statistics of
+ * \param[out] statistics payload pool statistics
+ * \return `RMW_RET_OK` if successful, or
+ * \return `RMW_RET_INVALID_ARGUMENT` if any argument is null, or
+ * \return `RMW_RET_INCORRECT_RMW_IMPLEMENTATION` if the publisher is from another
+ *   implementation, or
+ * \return `RMW_RET_UNSUPPORTED` if the publisher does not use a payload pool.
+ */
+RMW_FASTRTPS_SHARED_CPP_PUBLIC
+rmw_ret_t
+get_publisher_payload_pool_statistics(
+  const char * identifier,
+  const rmw_publisher_t * publisher,
+  PayloadPoolStatistics * statistics);
+
+}  // namespace rmw_fastrtps_shared_cpp
+
+#endif  // RMW_FASTRTPS_SHARED_CPP__PAYLOAD_POOL_HPP_
@@ -0,0 +1,201 @@
+// Copyright 2021 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RMW_FASTRTPS_SHARED_CPP__PUBLISHER_COALESCING_HPP_
+#define RMW_FASTRTPS_SHARED_CPP__PUBLISHER_COALESCING_HPP_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "fastdds/dds/publisher/DataWriter.hpp"
+
+#include "rcpputils/thread_safety_annotations.hpp"
+
+#include "rmw/rmw.h"
+#include "rmw/serialized_message.h"
+
+#include "rmw_fastrtps_shared_cpp/publisher_statistics.hpp"
+#include "rmw_fastrtps_shared_cpp/TypeSupport.hpp"
+#include "rmw_fastrtps_shared_cpp/visibility_control.h"
+
+namespace rmw_fastrtps_shared_cpp
+{
+
+/// Messages of a publisher held back to be written in a burst.
+/**
+ * Messages are serialized back to back into a buffer, which is kept from one burst to the
+ * next, and written when the oldest one is held back for the maximum delay, when the buffer
+ * reaches the maximum size, or when flushed explicitly.
+ * The asynchronous thread of Fast DDS then sends the burst in as few RTPS messages as fit.
+ */
+class PublisherCoalescing : public std::enable_shared_from_this<PublisherCoalescing>
+{
+public:
+  PublisherCoalescing(
+    eprosima::fastdds::dds::DataWriter * data_writer,
+    const TypeSupport * type_support,
+    const void * type_support_impl,
+    PublisherCounters * counters);
+
+  /// Set the bounds past which held back messages are written, a zero one being ignored.
+  /**
+   * Messages held back until then are written first.
+   *
+   * \return `RMW_RET_OK` if successful, or
+   * \return `RMW_RET_ERROR` if writing the held back messages failed.
+   */
+  RMW_FASTRTPS_SHARED_CPP_PUBLIC
+  rmw_ret_t
+  set_bounds(std::chrono::nanoseconds max_delay, size_t max_bytes);
+
+  /// Hold back a ROS message, serializing it.
+  /**
+   * \param[in] ros_message message to hold back
+   * \param[in] local_publication_number number the sample is tagged with, unless it is 0,
+   *   see intra_participant_delivery.hpp
+   * \return `RMW_RET_OK` if successful, or
+   * \return `RMW_RET_ERROR` if the message could not be serialized, or if writing the held
+   *   back messages failed.
+   */
+  RMW_FASTRTPS_SHARED_CPP_PUBLIC
+  rmw_ret_t
+  add_ros_message(const void * ros_message, uint64_t local_publication_number);
+
+  /// Hold back a serialized message, copying it.
+  /**
+   * \param[in] serialized_message message to hold back
+   * \param[in] local_publication_number number the sample is tagged with, unless it is 0
+   * \return `RMW_RET_OK` if successful, or
+   * \return `RMW_RET_BAD_ALLOC` if the message could not be copied, or
+   * \return `RMW_RET_ERROR` if writing the held back messages failed.
+   */
+  RMW_FASTRTPS_SHARED_CPP_PUBLIC
+  rmw_ret_t
+  add_serialized_message(
+    const rmw_serialized_message_t * serialized_message, uint64_t local_publication_number);
+
+  /// Write the held back messages, if any.
+  /**
+   * Messages are dropped, and counted as failed, if writing one of them fails.
+   *
+   * \return `RMW_RET_OK` if successful, or
+   * \return `RMW_RET_ERROR` if writing a message failed.
+   */
+  RMW_FASTRTPS_SHARED_CPP_PUBLIC
+  rmw_ret_t
+  flush();
+
+  /// Write the held back messages, if the oldest one is due by a given time.
+  bool
+  flush_if_due(std::chrono::steady_clock::time_point now);
+
+  /// Write the held back messages, after which the DataWriter isn't used anymore.
+  RMW_FASTRTPS_SHARED_CPP_PUBLIC
+  rmw_ret_t
+  close();
+
+private:
+  struct HeldBackMessage
+  {
+    size_t offset;
+    size_t length;
+    uint64_t local_publication_number;
+  };
+
+  rmw_ret_t
+  hold_back(size_t offset, size_t length, uint64_t local_publication_number)
+  RCPPUTILS_TSA_REQUIRES(mutex_);
+
+  bool
+  write_held_back() RCPPUTILS_TSA_REQUIRES(mutex_);
+
+  const TypeSupport * type_support_;
+  const void * type_support_impl_;
+  PublisherCounters * counters_;
+
+  std::mutex mutex_;
+  // Null once closed
+  eprosima::fastdds::dds::DataWriter * data_writer_ RCPPUTILS_TSA_GUARDED_BY(mutex_);
+  std::chrono::nanoseconds max_delay_ RCPPUTILS_TSA_GUARDED_BY(mutex_){0};
+  size_t max_bytes_ RCPPUTILS_TSA_GUARDED_BY(mutex_){0u};
+  // CDR encoded messages, encapsulation included, back to back
+  std::vector<char> buffer_ RCPPUTILS_TSA_GUARDED_BY(mutex_);
+  std::vector<HeldBackMessage> messages_ RCPPUTILS_TSA_GUARDED_BY(mutex_);
+  // Time by which the oldest held back message is written, if there is a maximum delay
+  std::chrono::steady_clock::time_point deadline_ RCPPUTILS_TSA_GUARDED_BY(mutex_);
+};
+
+/// Hold back the messages of a publisher to write them in bursts.
+/**
+ * Publishing many small messages costs an RTPS message, and a wake up of the asynchronous
+ * thread of Fast DDS, for each of them.
+ * Coalescing publications serializes the messages back to back instead, and writes them in
+ * a burst, which Fast DDS sends in as few RTPS messages as fit, once the oldest one is held
+ * back for `max_delay`, once their total size reaches `max_bytes`, or once flushed with
+ * flush_publisher().
+ * A zero bound is ignored, and coalescing is disabled, after writing the held back
+ * messages, when both are zero.
+ * Deadlines are enforced by a single thread for the whole process.
+ *
+ * Publishing loaned messages, waiting for all acknowledgments or destroying the publisher
+ * writes the held back messages first.
+ * Must not be called concurrently with publications on the same publisher.
+ *
+ * \param[in] identifier implementation identifier, as returned by
+ *   rmw_get_implementation_identifier()
+ * \param[in] publisher publisher to coalesce the messages of
+ * \param[in] max_delay maximum time a message is held back for, or zero or infinite
+ * \param[in] max_bytes size of the held back messages past which they are written, or zero
+ * \return `RMW_RET_OK` if successful, or
+ * \return `RMW_RET_INVALID_ARGUMENT` if the publisher is null, or
+ * \return `RMW_RET_INCORRECT_RMW_IMPLEMENTATION` if the publisher is from another
+ *   implementation, or
+ * \return `RMW_RET_UNSUPPORTED` if the publisher doesn't use the asynchronous publication
+ *   mode, in which a burst cannot be sent at once, or
+ * \return `RMW_RET_BAD_ALLOC` if memory allocation failed, or
+ * \return `RMW_RET_ERROR` if the flush thread could not be started, or writing held back
+ *   messages failed.
+ */
+RMW_FASTRTPS_SHARED_CPP_PUBLIC
+rmw_ret_t
+set_publisher_coalescing(
+  const char * identifier,
+  const rmw_publisher_t * publisher,
+  rmw_time_t max_delay,
+  size_t max_bytes);
+
+/// Write the messages held back by a publisher, e.g. at the end of a cycle.
+/**
+ * Does nothing if the publisher doesn't coalesce its messages.
+ *
+ * \param[in] identifier implementation identifier, as returned by
+ *   rmw_get_implementation_identifier()
+ * \param[in] publisher publisher to flush
+ * \return `RMW_RET_OK` if successful, or
+ * \return `RMW_RET_INVALID_ARGUMENT` if the publisher is null, or
+ * \return `RMW_RET_INCORRECT_RMW_IMPLEMENTATION` if the publisher is from another
+ *   implementation, or
+ * \return `RMW_RET_ERROR` if writing a message failed.
+ */
+RMW_FASTRTPS_SHARED_CPP_PUBLIC
+rmw_ret_t
+flush_publisher(const char * identifier, const rmw_publisher_t * publisher);
+
+}  // namespace rmw_fastrtps_shared_cpp
+
+#endif  // RMW_FASTRTPS_SHARED_CPP__PUBLISHER_COALESCING_HPP_
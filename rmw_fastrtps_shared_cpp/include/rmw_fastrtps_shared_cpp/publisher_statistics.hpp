@@ -0,0 +1,172 @@
+// Copyright 2021 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RMW_FASTRTPS_SHARED_CPP__PUBLISHER_STATISTICS_HPP_
+#define RMW_FASTRTPS_SHARED_CPP__PUBLISHER_STATISTICS_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include "fastdds/dds/publisher/DataWriter.hpp"
+
+#include "rmw/rmw.h"
+
+#include "rmw_fastrtps_shared_cpp/TypeSupport.hpp"
+#include "rmw_fastrtps_shared_cpp/visibility_control.h"
+
+namespace rmw_fastrtps_shared_cpp
+{
+
+/// Number of buckets of the histograms of PublisherStatistics.
+constexpr size_t kPublisherHistogramSize = 32u;
+
+/// Statistics of the publications of a publisher, since it was created.
+struct PublisherStatistics
+{
+  // Messages published successfully, whether written, delivered locally or held back
+  uint64_t published_messages;
+  // Messages whose publication failed, and which were dropped
+  uint64_t failed_messages;
+  // Size of the messages written, CDR encoded with their encapsulation
+  uint64_t written_bytes;
+
+  // Timings, only measured when the `RMW_FASTRTPS_PUBLISHER_TIMING` environment variable
+  // is set to `1`.
+  // Bucket `i` of a histogram counts the durations of `[2^i, 2^(i+1))` nanoseconds, the
+  // first one also counting shorter durations and the last one longer ones.
+  // Time spent serializing messages
+  uint64_t serialize_time_ns;
+  uint64_t serialize_time_histogram[kPublisherHistogramSize];
+  // Time spent in DataWriter::write(), serialization excluded
+  uint64_t write_time_ns;
+  uint64_t write_time_histogram[kPublisherHistogramSize];
+};
+
+/// Counters of the publications of a publisher, updated by the publishing threads.
+/**
+ * Counters are relaxed atomics, as they are only read to be reported.
+ */
+class PublisherCounters
+{
+public:
+  /// Enable the measure of timings, must be done before publishing.
+  void
+  enable_timing()
+  {
+    timing_ = true;
+  }
+
+  bool
+  timing_enabled() const
+  {
+    return timing_;
+  }
+
+  void
+  add_published_messages(size_t count)
+  {
+    published_messages_.fetch_add(count, std::memory_order_relaxed);
+  }
+
+  void
+  add_failed_messages(size_t count)
+  {
+    failed_messages_.fetch_add(count, std::memory_order_relaxed);
+  }
+
+  void
+  add_written_bytes(size_t bytes)
+  {
+    written_bytes_.fetch_add(bytes, std::memory_order_relaxed);
+  }
+
+  void
+  add_serialize_time(std::chrono::nanoseconds time)
+  {
+    add_time(time, serialize_time_ns_, serialize_time_histogram_);
+  }
+
+  void
+  add_write_time(std::chrono::nanoseconds time)
+  {
+    add_time(time, write_time_ns_, write_time_histogram_);
+  }
+
+  /// Write serialized data, counting its size and, if enabled, timing its serialization.
+  /**
+   * \return whether the DataWriter wrote the data.
+   */
+  RMW_FASTRTPS_SHARED_CPP_PUBLIC
+  bool
+  write(eprosima::fastdds::dds::DataWriter * data_writer, SerializedData & data);
+
+  /// Write a loaned sample, counting its size and, if enabled, timing the write.
+  /**
+   * \return whether the DataWriter wrote the sample.
+   */
+  RMW_FASTRTPS_SHARED_CPP_PUBLIC
+  bool
+  write_sample(eprosima::fastdds::dds::DataWriter * data_writer, void * sample, size_t size);
+
+  /// Read the counters, each of them atomically but not all at once.
+  RMW_FASTRTPS_SHARED_CPP_PUBLIC
+  void
+  get(PublisherStatistics & statistics) const;
+
+private:
+  RMW_FASTRTPS_SHARED_CPP_PUBLIC
+  static
+  void
+  add_time(
+    std::chrono::nanoseconds time,
+    std::atomic<uint64_t> & total,
+    std::atomic<uint64_t> (& histogram)[kPublisherHistogramSize]);
+
+  bool timing_{false};
+
+  std::atomic<uint64_t> published_messages_{0u};
+  std::atomic<uint64_t> failed_messages_{0u};
+  std::atomic<uint64_t> written_bytes_{0u};
+  std::atomic<uint64_t> serialize_time_ns_{0u};
+  std::atomic<uint64_t> serialize_time_histogram_[kPublisherHistogramSize] = {};
+  std::atomic<uint64_t> write_time_ns_{0u};
+  std::atomic<uint64_t> write_time_histogram_[kPublisherHistogramSize] = {};
+};
+
+/// Get the statistics of the publications of a publisher.
+/**
+ * Meant to find the heaviest publishers of a process, e.g. by sampling the statistics
+ * periodically, at the cost of a few relaxed atomic increments per publication.
+ *
+ * \param[in] identifier implementation identifier, as returned by
+ *   rmw_get_implementation_identifier()
+ * \param[in] publisher publisher to get the statistics of
+ * \param[out] statistics statistics of the publisher
+ * \return `RMW_RET_OK` if successful, or
+ * \return `RMW_RET_INVALID_ARGUMENT` if any argument is null, or
+ * \return `RMW_RET_INCORRECT_RMW_IMPLEMENTATION` if the publisher is from another
+ *   implementation.
+ */
+RMW_FASTRTPS_SHARED_CPP_PUBLIC
+rmw_ret_t
+get_publisher_statistics(
+  const char * identifier,
+  const rmw_publisher_t * publisher,
+  PublisherStatistics * statistics);
+
+}  // namespace rmw_fastrtps_shared_cpp
+
+#endif  // RMW_FASTRTPS_SHARED_CPP__PUBLISHER_STATISTICS_HPP_
@@ -128,6 +128,33 @@ __rmw_get_node_names_with_enclaves(
   rcutils_string_array_t * node_namespaces,
   rcutils_string_array_t * enclaves);
 
+/// Initialize an allocation for publishing messages of a type without allocating memory.
+/**
+ * Only bounded types are supported: their payloads are preallocated with their maximum
+ * serialized size by the DataWriter history, and are serialized to directly.
+ * Publishing with the allocation fails with `RMW_RET_UNSUPPORTED` if the publisher delivers
+ * to the subscriptions of its participant or coalesces its messages, as both allocate.
+ *
+ * \param[in] type_support_impl type support of the messages, as stored by publishers
+ * \param[in] bounded whether the serialized size of the messages is bounded
+ * \param[in] type_support ROS type support the allocation was initialized with
+ * \return `RMW_RET_UNSUPPORTED` if the type is not bounded.
+ */
+RMW_FASTRTPS_SHARED_CPP_PUBLIC
+rmw_ret_t
+__rmw_init_publisher_allocation(
+  const char * identifier,
+  const void * type_support_impl,
+  bool bounded,
+  const rosidl_message_type_support_t * type_support,
+  rmw_publisher_allocation_t * allocation);
+
+RMW_FASTRTPS_SHARED_CPP_PUBLIC
+rmw_ret_t
+__rmw_fini_publisher_allocation(
+  const char * identifier,
+  rmw_publisher_allocation_t * allocation);
+
 RMW_FASTRTPS_SHARED_CPP_PUBLIC
 rmw_ret_t
 __rmw_publish(
@@ -136,6 +163,23 @@ __rmw_publish(
   const void * ros_message,
   rmw_publisher_allocation_t * allocation);
 
+/// Publish several messages in a row.
+/**
+ * The publisher is validated, and its state locked, once for the whole sequence.
+ * Publishing stops at the first message that fails to be published.
+ *
+ * \param[in] ros_messages messages to publish, in order
+ * \param[out] published number of messages published, which may be null
+ */
+RMW_FASTRTPS_SHARED_CPP_PUBLIC
+rmw_ret_t
+__rmw_publish_sequence(
+  const char * identifier,
+  const rmw_publisher_t * publisher,
+  const rmw_message_sequence_t * ros_messages,
+  size_t * published,
+  rmw_publisher_allocation_t * allocation);
+
 RMW_FASTRTPS_SHARED_CPP_PUBLIC
 rmw_ret_t
 __rmw_publish_serialized_message(
@@ -317,6 +361,29 @@ __rmw_subscription_get_actual_qos(
   const rmw_subscription_t * subscription,
   rmw_qos_profile_t * qos);
 
+/// Initialize an allocation for taking messages of a type.
+/**
+ * Takes with the allocation check that the subscription is of that type.
+ * Whether taking is then free of memory allocations depends on the type support, which
+ * must be checked before.
+ *
+ * \param[in] type_support_impl type support of the messages, as stored by subscriptions
+ * \param[in] type_support ROS type support the allocation was initialized with
+ */
+RMW_FASTRTPS_SHARED_CPP_PUBLIC
+rmw_ret_t
+__rmw_init_subscription_allocation(
+  const char * identifier,
+  const void * type_support_impl,
+  const rosidl_message_type_support_t * type_support,
+  rmw_subscription_allocation_t * allocation);
+
+RMW_FASTRTPS_SHARED_CPP_PUBLIC
+rmw_ret_t
+__rmw_fini_subscription_allocation(
+  const char * identifier,
+  rmw_subscription_allocation_t * allocation);
+
 RMW_FASTRTPS_SHARED_CPP_PUBLIC
 rmw_ret_t
 __rmw_take(
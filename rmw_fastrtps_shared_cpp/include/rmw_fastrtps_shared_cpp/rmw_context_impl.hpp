@@ -15,8 +15,13 @@
 #ifndef RMW_FASTRTPS_SHARED_CPP__RMW_CONTEXT_IMPL_HPP_
 #define RMW_FASTRTPS_SHARED_CPP__RMW_CONTEXT_IMPL_HPP_
 
+#include <memory>
 #include <mutex>
 
+#include "rmw_dds_common/msg/participant_entities_info.hpp"
+
+#include "rmw_fastrtps_shared_cpp/graph_change_notifier.hpp"
+
 struct rmw_context_impl_t
 {
   /// Pointer to `rmw_dds_common::Context`.
@@ -29,6 +34,14 @@ struct rmw_context_impl_t
   uint64_t count;
   /// Shutdown flag.
   bool is_shutdown;
+  /// Triggers the graph guard condition when the graph cache changes.
+  rmw_fastrtps_shared_cpp::GraphChangeNotifier graph_change_notifier;
+  /// Mutex used to protect the discovery batch state below.
+  std::mutex discovery_batch_mutex;
+  /// Nesting depth of discovery batches (see discovery_batch.hpp).
+  uint64_t discovery_batch_depth;
+  /// Last ros_discovery_info message held back by a discovery batch, if any.
+  std::unique_ptr<rmw_dds_common::msg::ParticipantEntitiesInfo> pending_discovery_info;
 };
 
 #endif  // RMW_FASTRTPS_SHARED_CPP__RMW_CONTEXT_IMPL_HPP_
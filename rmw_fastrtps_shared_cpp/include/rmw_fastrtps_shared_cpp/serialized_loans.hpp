@@ -0,0 +1,202 @@
+// Copyright 2021 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RMW_FASTRTPS_SHARED_CPP__SERIALIZED_LOANS_HPP_
+#define RMW_FASTRTPS_SHARED_CPP__SERIALIZED_LOANS_HPP_
+
+#include "rmw/rmw.h"
+#include "rmw/serialized_message.h"
+
+#include "rmw_fastrtps_shared_cpp/visibility_control.h"
+
+namespace rmw_fastrtps_shared_cpp
+{
+
+/// Check whether a publisher can loan samples to hold serialized messages.
+/**
+ * Only messages of plain types can be loaned, as their samples are the messages themselves.
+ * When the `RMW_FASTRTPS_SERIALIZED_LOANS` environment variable is set to `1`, samples of
+ * other bounded types, e.g. with bounded strings or sequences, can instead be loaned to hold
+ * the messages serialized, as long as data sharing is used.
+ * Publishers of plain types or of unbounded types, e.g. with unbounded strings or sequences,
+ * or which don't use data sharing, can't loan serialized messages.
+ *
+ * \param[in] identifier implementation identifier, as returned by
+ *   rmw_get_implementation_identifier()
+ * \param[in] publisher publisher to check
+ * \param[out] can_loan whether the publisher can loan serialized messages
+ * \return `RMW_RET_OK` if successful, or
+ * \return `RMW_RET_INVALID_ARGUMENT` if any argument is null, or
+ * \return `RMW_RET_INCORRECT_RMW_IMPLEMENTATION` if the publisher is from another
+ *   implementation.
+ */
+RMW_FASTRTPS_SHARED_CPP_PUBLIC
+rmw_ret_t
+publisher_can_loan_serialized_messages(
+  const char * identifier,
+  const rmw_publisher_t * publisher,
+  bool * can_loan);
+
+/// Borrow a sample of a publisher, to serialize a message into.
+/**
+ * The serialized message is set to the sample, in the data sharing segment, with a capacity
+ * of the maximum serialized size of the type, encapsulation included.
+ * The sample ends with a few more bytes, where the length of the message is written.
+ * A message serialized into it, e.g. with rmw_serialize(), is then published without being
+ * copied with publish_loaned_serialized_message().
+ * The serialized message cannot be resized nor finalized, and must be either published or
+ * returned with return_loaned_serialized_message_from_publisher().
+ *
+ * \param[in] identifier implementation identifier, as returned by
+ *   rmw_get_implementation_identifier()
+ * \param[in] publisher publisher to borrow a sample from
+ * \param[out] serialized_message zero initialized serialized message set to the sample
+ * \return `RMW_RET_OK` if successful, or
+ * \return `RMW_RET_INVALID_ARGUMENT` if any argument is null or the serialized message
+ *   holds a buffer, or
+ * \return `RMW_RET_INCORRECT_RMW_IMPLEMENTATION` if the publisher is from another
+ *   implementation, or
+ * \return `RMW_RET_UNSUPPORTED` if the publisher cannot loan serialized messages, or
+ * \return `RMW_RET_ERROR` if no sample could be loaned.
+ */
+RMW_FASTRTPS_SHARED_CPP_PUBLIC
+rmw_ret_t
+borrow_loaned_serialized_message(
+  const char * identifier,
+  const rmw_publisher_t * publisher,
+  rmw_serialized_message_t * serialized_message);
+
+/// Return a borrowed sample to a publisher, without publishing it.
+/**
+ * \param[in] identifier implementation identifier, as returned by
+ *   rmw_get_implementation_identifier()
+ * \param[in] publisher publisher the sample was borrowed from
+ * \param[inout] serialized_message borrowed serialized message, zero initialized on success
+ * \return `RMW_RET_OK` if successful, or
+ * \return `RMW_RET_INVALID_ARGUMENT` if any argument is null, or
+ * \return `RMW_RET_INCORRECT_RMW_IMPLEMENTATION` if the publisher is from another
+ *   implementation, or
+ * \return `RMW_RET_UNSUPPORTED` if the publisher cannot loan serialized messages, or
+ * \return `RMW_RET_ERROR` if the sample was not borrowed from this publisher.
+ */
+RMW_FASTRTPS_SHARED_CPP_PUBLIC
+rmw_ret_t
+return_loaned_serialized_message_from_publisher(
+  const char * identifier,
+  const rmw_publisher_t * publisher,
+  rmw_serialized_message_t * serialized_message);
+
+/// Publish a message serialized into a borrowed sample, and give the sample back.
+/**
+ * Samples are written whole, so readers which do not use data sharing receive the maximum
+ * serialized size of the type.
+ * The length of the serialized message is written at the end of the sample, for subscriptions
+ * taking it with take_loaned_serialized_message() to get it back.
+ *
+ * \param[in] identifier implementation identifier, as returned by
+ *   rmw_get_implementation_identifier()
+ * \param[in] publisher publisher the sample was borrowed from
+ * \param[inout] serialized_message borrowed serialized message, zero initialized on success
+ * \return `RMW_RET_OK` if successful, or
+ * \return `RMW_RET_INVALID_ARGUMENT` if any argument is null, or the serialized message is
+ *   shorter than its encapsulation or longer than the sample, or
+ * \return `RMW_RET_INCORRECT_RMW_IMPLEMENTATION` if the publisher is from another
+ *   implementation, or
+ * \return `RMW_RET_UNSUPPORTED` if the publisher cannot loan serialized messages, or
+ * \return `RMW_RET_ERROR` if the message could not be published.
+ */
+RMW_FASTRTPS_SHARED_CPP_PUBLIC
+rmw_ret_t
+publish_loaned_serialized_message(
+  const char * identifier,
+  const rmw_publisher_t * publisher,
+  rmw_serialized_message_t * serialized_message);
+
+/// Check whether a subscription can loan the serialized messages it receives.
+/**
+ * Samples of a bounded type loaned to hold serialized messages, see
+ * publisher_can_loan_serialized_messages(), can be taken as loans of the serialized
+ * messages received, as long as data sharing is used.
+ *
+ * \param[in] identifier implementation identifier, as returned by
+ *   rmw_get_implementation_identifier()
+ * \param[in] subscription subscription to check
+ * \param[out] can_loan whether the subscription can loan serialized messages
+ * \return `RMW_RET_OK` if successful, or
+ * \return `RMW_RET_INVALID_ARGUMENT` if any argument is null, or
+ * \return `RMW_RET_INCORRECT_RMW_IMPLEMENTATION` if the subscription is from another
+ *   implementation.
+ */
+RMW_FASTRTPS_SHARED_CPP_PUBLIC
+rmw_ret_t
+subscription_can_loan_serialized_messages(
+  const char * identifier,
+  const rmw_subscription_t * subscription,
+  bool * can_loan);
+
+/// Take a serialized message, loaned from the subscription instead of copied.
+/**
+ * The serialized message is set to the payload received, encapsulation included, where it
+ * is held by Fast DDS, e.g. in the data sharing segment.
+ * Its length is that of the message published, and its capacity the maximum serialized size
+ * of the type, which payloads are allocated with whatever the size of their message.
+ * The serialized message cannot be resized nor finalized, and must be returned with
+ * return_loaned_serialized_message_from_subscription() once done with.
+ *
+ * \param[in] identifier implementation identifier, as returned by
+ *   rmw_get_implementation_identifier()
+ * \param[in] subscription subscription to take the message from
+ * \param[out] serialized_message zero initialized serialized message set to the payload
+ * \param[out] taken whether a message was taken
+ * \param[out] message_info info of the message taken, or nullptr
+ * \return `RMW_RET_OK` if successful, or
+ * \return `RMW_RET_INVALID_ARGUMENT` if any argument but `message_info` is null or the
+ *   serialized message holds a buffer, or
+ * \return `RMW_RET_INCORRECT_RMW_IMPLEMENTATION` if the subscription is from another
+ *   implementation, or
+ * \return `RMW_RET_UNSUPPORTED` if the subscription cannot loan serialized messages, or
+ * \return `RMW_RET_ERROR` if too many messages are loaned.
+ */
+RMW_FASTRTPS_SHARED_CPP_PUBLIC
+rmw_ret_t
+take_loaned_serialized_message(
+  const char * identifier,
+  const rmw_subscription_t * subscription,
+  rmw_serialized_message_t * serialized_message,
+  bool * taken,
+  rmw_message_info_t * message_info);
+
+/// Return a serialized message loaned by a subscription.
+/**
+ * \param[in] identifier implementation identifier, as returned by
+ *   rmw_get_implementation_identifier()
+ * \param[in] subscription subscription the message was taken from
+ * \param[inout] serialized_message loaned serialized message, zero initialized on success
+ * \return `RMW_RET_OK` if successful, or
+ * \return `RMW_RET_INVALID_ARGUMENT` if any argument is null, or
+ * \return `RMW_RET_INCORRECT_RMW_IMPLEMENTATION` if the subscription is from another
+ *   implementation, or
+ * \return `RMW_RET_UNSUPPORTED` if the subscription cannot loan serialized messages, or
+ * \return `RMW_RET_ERROR` if the message was not loaned by this subscription.
+ */
+RMW_FASTRTPS_SHARED_CPP_PUBLIC
+rmw_ret_t
+return_loaned_serialized_message_from_subscription(
+  const char * identifier,
+  const rmw_subscription_t * subscription,
+  rmw_serialized_message_t * serialized_message);
+
+}  // namespace rmw_fastrtps_shared_cpp
+
+#endif  // RMW_FASTRTPS_SHARED_CPP__SERIALIZED_LOANS_HPP_
@@ -0,0 +1,87 @@
+// Copyright 2021 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RMW_FASTRTPS_SHARED_CPP__WAIT_SET_SPIN_HPP_
+#define RMW_FASTRTPS_SHARED_CPP__WAIT_SET_SPIN_HPP_
+
+#include <cstdint>
+
+#include "rmw/rmw.h"
+
+#include "rmw_fastrtps_shared_cpp/visibility_control.h"
+
+namespace rmw_fastrtps_shared_cpp
+{
+
+/// Statistics of the spin phase of rmw_wait() on a wait set.
+struct WaitSetSpinStatistics
+{
+  /// Number of waits where the spin phase found a ready entity.
+  uint64_t spin_hits;
+  /// Number of waits where the spin phase ended without a ready entity, and had to block.
+  uint64_t spin_misses;
+  /// Current spin interval, tuned after each wait, in nanoseconds.
+  uint64_t spin_budget_ns;
+};
+
+/// Set the maximum time rmw_wait() spins on a wait set before blocking.
+/**
+ * When nothing is ready, rmw_wait() polls the listeners of the wait set for a while before
+ * blocking on its condition variable, saving the wake up latency when data arrives shortly.
+ * The actual spin interval is tuned after each wait, up to `max_spin_ns`, according to how
+ * long it took for an entity to become ready.
+ *
+ * It defaults to the value of the `RMW_FASTRTPS_WAIT_SPIN_US` environment variable, in
+ * microseconds, or to 0 when unset or not a number, which disables spinning.
+ * Both are limited to one second, past which spinning is no better than blocking.
+ * Must not be called concurrently with rmw_wait() on the same wait set.
+ *
+ * \param[in] identifier implementation identifier, as returned by
+ *   rmw_get_implementation_identifier()
+ * \param[in] wait_set wait set to configure
+ * \param[in] max_spin_ns maximum spin interval in nanoseconds, 0 to disable spinning, at most
+ *   one second
+ * \return `RMW_RET_OK` if successful, or
+ * \return `RMW_RET_INVALID_ARGUMENT` if the wait set is null, or
+ * \return `RMW_RET_INCORRECT_RMW_IMPLEMENTATION` if the wait set is from another
+ *   implementation.
+ */
+RMW_FASTRTPS_SHARED_CPP_PUBLIC
+rmw_ret_t
+set_wait_set_max_spin(
+  const char * identifier,
+  rmw_wait_set_t * wait_set,
+  uint64_t max_spin_ns);
+
+/// Get the statistics of the spin phase of rmw_wait() on a wait set.
+/**
+ * \param[in] identifier implementation identifier, as returned by
+ *   rmw_get_implementation_identifier()
+ * \param[in] wait_set wait set to get the statistics of
+ * \param[out] statistics spin statistics
+ * \return `RMW_RET_OK` if successful, or
+ * \return `RMW_RET_INVALID_ARGUMENT` if any argument is null, or
+ * \return `RMW_RET_INCORRECT_RMW_IMPLEMENTATION` if the wait set is from another
+ *   implementation.
+ */
+RMW_FASTRTPS_SHARED_CPP_PUBLIC
+rmw_ret_t
+get_wait_set_spin_statistics(
+  const char * identifier,
+  const rmw_wait_set_t * wait_set,
+  WaitSetSpinStatistics * statistics);
+
+}  // namespace rmw_fastrtps_shared_cpp
+
+#endif  // RMW_FASTRTPS_SHARED_CPP__WAIT_SET_SPIN_HPP_
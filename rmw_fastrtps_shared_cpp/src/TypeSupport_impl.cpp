@@ -13,6 +13,10 @@
 // limitations under the License.
 
 #include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <exception>
 #include <string>
 #include <vector>
 
@@ -31,6 +35,7 @@ TypeSupport::TypeSupport()
   m_isGetKeyDefined = false;
   max_size_bound_ = false;
   is_plain_ = false;
+  serialized_loans_ = false;
 }
 
 void TypeSupport::deleteData(void * data)
@@ -50,14 +55,39 @@ bool TypeSupport::serialize(
   assert(data);
   assert(payload);
 
+  if (!serialize_payload(data, payload)) {
+    return false;
+  }
+  if (serialized_loans_ && payload->max_size >= m_typeSize) {
+    // Readers loaning the payload can't tell its length otherwise
+    set_serialized_loan_length(payload->data, payload->length);
+  }
+  return true;
+}
+
+bool TypeSupport::serialize_payload(
+  void * data, eprosima::fastrtps::rtps::SerializedPayload_t * payload)
+{
+
   auto ser_data = static_cast<SerializedData *>(data);
-  if (ser_data->is_cdr_buffer) {
+  if (nullptr != ser_data->cdr_data) {
+    // Already serialized, either by the caller or when the size was requested
+    if (payload->max_size >= ser_data->cdr_length && ser_data->cdr_length >= 4u) {
+      payload->length = static_cast<uint32_t>(ser_data->cdr_length);
+      // The second byte of the encapsulation header tells the endianness
+      payload->encapsulation = 0 == ser_data->cdr_data[1] ? CDR_BE : CDR_LE;
+      memcpy(payload->data, ser_data->cdr_data, ser_data->cdr_length);
+      ser_data->serialized_length = payload->length;
+      return true;
+    }
+  } else if (ser_data->is_cdr_buffer) {
     auto ser = static_cast<eprosima::fastcdr::Cdr *>(ser_data->data);
     if (payload->max_size >= ser->getSerializedDataLength()) {
       payload->length = static_cast<uint32_t>(ser->getSerializedDataLength());
       payload->encapsulation = ser->endianness() ==
         eprosima::fastcdr::Cdr::BIG_ENDIANNESS ? CDR_BE : CDR_LE;
       memcpy(payload->data, ser->getBufferPointer(), ser->getSerializedDataLength());
+      ser_data->serialized_length = payload->length;
       return true;
     }
   } else {
@@ -66,10 +96,25 @@ bool TypeSupport::serialize(
       payload->max_size);  // Object that manages the raw buffer.
     eprosima::fastcdr::Cdr ser(fastbuffer, eprosima::fastcdr::Cdr::DEFAULT_ENDIAN,
       eprosima::fastcdr::Cdr::DDS_CDR);  // Object that serializes the data.
-    if (this->serializeROSmessage(ser_data->data, ser, ser_data->impl)) {
+    std::chrono::steady_clock::time_point start;
+    if (ser_data->measure_serialize_time) {
+      start = std::chrono::steady_clock::now();
+    }
+    bool serialized = false;
+    try {
+      serialized = this->serializeROSmessage(ser_data->data, ser, ser_data->impl);
+    } catch (const std::exception &) {
+      // The message doesn't fit in the payload, or exceeds the bounds of its type.
+      // The write fails instead of throwing through the DataWriter.
+    }
+    if (ser_data->measure_serialize_time) {
+      ser_data->serialize_time += std::chrono::steady_clock::now() - start;
+    }
+    if (serialized) {
       payload->encapsulation = ser.endianness() ==
         eprosima::fastcdr::Cdr::BIG_ENDIANNESS ? CDR_BE : CDR_LE;
       payload->length = (uint32_t)ser.getSerializedDataLength();
+      ser_data->serialized_length = payload->length;
       return true;
     }
   }
@@ -101,7 +146,42 @@ bool TypeSupport::deserialize(
     fastbuffer,
     eprosima::fastcdr::Cdr::DEFAULT_ENDIAN,
     eprosima::fastcdr::Cdr::DDS_CDR);
-  return deserializeROSmessage(deser, ser_data->data, ser_data->impl);
+  MessageSlots * slots = ser_data->message_slots;
+  if (nullptr == slots) {
+    return deserializeROSmessage(deser, ser_data->data, ser_data->impl);
+  }
+  if (slots->next >= slots->count) {
+    return false;
+  }
+  void * ros_message = slots->messages[slots->next];
+  if (!deserializeROSmessage(deser, ros_message, ser_data->impl)) {
+    // The next valid sample overwrites the message
+    return false;
+  }
+  ser_data->data = ros_message;
+  ++slots->next;
+  return true;
+}
+
+void TypeSupport::set_serialized_loan_length(uint8_t * buffer, size_t length) const
+{
+  assert(length <= serialized_loan_capacity());
+  const uint32_t trailer[2] = {
+    static_cast<uint32_t>(length), ~static_cast<uint32_t>(length)};
+  memcpy(buffer + serialized_loan_capacity(), trailer, sizeof(trailer));
+}
+
+size_t TypeSupport::get_serialized_loan_length(const uint8_t * buffer) const
+{
+  uint32_t trailer[2];
+  memcpy(trailer, buffer + serialized_loan_capacity(), sizeof(trailer));
+  if (trailer[1] != ~trailer[0] ||
+    trailer[0] < eprosima::fastrtps::rtps::SerializedPayload_t::representation_header_size ||
+    trailer[0] > serialized_loan_capacity())
+  {
+    return serialized_loan_capacity();
+  }
+  return trailer[0];
 }
 
 std::function<uint32_t()> TypeSupport::getSerializedSizeProvider(void * data)
@@ -111,10 +191,37 @@ std::function<uint32_t()> TypeSupport::getSerializedSizeProvider(void * data)
   auto ser_data = static_cast<SerializedData *>(data);
   auto ser_size = [this, ser_data]() -> uint32_t
     {
+      if (nullptr != ser_data->cdr_data) {
+        return static_cast<uint32_t>(ser_data->cdr_length);
+      }
       if (ser_data->is_cdr_buffer) {
         auto ser = static_cast<eprosima::fastcdr::Cdr *>(ser_data->data);
         return static_cast<uint32_t>(ser->getSerializedDataLength());
       }
+      if (nullptr != ser_data->scratch_buffer && !max_size_bound_) {
+        // Serialize right away, so that the size is exact and the message isn't walked again
+        eprosima::fastcdr::Cdr ser(
+          *ser_data->scratch_buffer, eprosima::fastcdr::Cdr::DEFAULT_ENDIAN,
+          eprosima::fastcdr::Cdr::DDS_CDR);
+        std::chrono::steady_clock::time_point start;
+        if (ser_data->measure_serialize_time) {
+          start = std::chrono::steady_clock::now();
+        }
+        bool serialized = false;
+        try {
+          serialized = this->serializeROSmessage(ser_data->data, ser, ser_data->impl);
+        } catch (const std::exception &) {
+          // Fall back to serializing the message when writing it
+        }
+        if (ser_data->measure_serialize_time) {
+          ser_data->serialize_time += std::chrono::steady_clock::now() - start;
+        }
+        if (serialized) {
+          ser_data->cdr_data = ser_data->scratch_buffer->getBuffer();
+          ser_data->cdr_length = ser.getSerializedDataLength();
+          return static_cast<uint32_t>(ser_data->cdr_length);
+        }
+      }
       return static_cast<uint32_t>(
         this->getEstimatedSerializedSize(
           ser_data->data,
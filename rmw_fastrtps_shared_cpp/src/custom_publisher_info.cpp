@@ -32,14 +32,16 @@ PubListener::on_offered_deadline_missed(
 
   // the change to liveliness_lost_count_ needs to be mutually exclusive with
   // rmw_wait() which checks hasEvent() and decides if wait() needs to be called
-  ConditionalScopedLock clock(conditionMutex_, conditionVariable_);
+  ConditionalScopedLock clock(conditions_, this);
 
   // Assign absolute values
   offered_deadline_missed_status_.total_count = status.total_count;
   // Accumulate deltas
   offered_deadline_missed_status_.total_count_change += status.total_count_change;
 
-  deadline_changes_.store(true, std::memory_order_relaxed);
+  if (!deadline_changes_.exchange(true, std::memory_order_relaxed)) {
+    clock.became_ready();
+  }
 }
 
 void PubListener::on_liveliness_lost(
@@ -50,14 +52,16 @@ void PubListener::on_liveliness_lost(
 
   // the change to liveliness_lost_count_ needs to be mutually exclusive with
   // rmw_wait() which checks hasEvent() and decides if wait() needs to be called
-  ConditionalScopedLock clock(conditionMutex_, conditionVariable_);
+  ConditionalScopedLock clock(conditions_, this);
 
   // Assign absolute values
   liveliness_lost_status_.total_count = status.total_count;
   // Accumulate deltas
   liveliness_lost_status_.total_count_change += status.total_count_change;
 
-  liveliness_changes_.store(true, std::memory_order_relaxed);
+  if (!liveliness_changes_.exchange(true, std::memory_order_relaxed)) {
+    clock.became_ready();
+  }
 }
 
 bool PubListener::hasEvent(rmw_event_type_t event_type) const
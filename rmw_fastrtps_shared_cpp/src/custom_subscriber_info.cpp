@@ -34,14 +34,16 @@ SubListener::on_requested_deadline_missed(
 
   // the change to liveliness_lost_count_ needs to be mutually exclusive with
   // rmw_wait() which checks hasEvent() and decides if wait() needs to be called
-  ConditionalScopedLock clock(conditionMutex_, conditionVariable_);
+  ConditionalScopedLock clock(conditions_, this);
 
   // Assign absolute values
   requested_deadline_missed_status_.total_count = status.total_count;
   // Accumulate deltas
   requested_deadline_missed_status_.total_count_change += status.total_count_change;
 
-  deadline_changes_.store(true, std::memory_order_relaxed);
+  if (!deadline_changes_.exchange(true, std::memory_order_relaxed)) {
+    clock.became_ready();
+  }
 }
 
 void SubListener::on_liveliness_changed(
@@ -52,7 +54,7 @@ void SubListener::on_liveliness_changed(
 
   // the change to liveliness_lost_count_ needs to be mutually exclusive with
   // rmw_wait() which checks hasEvent() and decides if wait() needs to be called
-  ConditionalScopedLock clock(conditionMutex_, conditionVariable_);
+  ConditionalScopedLock clock(conditions_, this);
 
   // Assign absolute values
   liveliness_changed_status_.alive_count = status.alive_count;
@@ -61,7 +63,9 @@ void SubListener::on_liveliness_changed(
   liveliness_changed_status_.alive_count_change += status.alive_count_change;
   liveliness_changed_status_.not_alive_count_change += status.not_alive_count_change;
 
-  liveliness_changes_.store(true, std::memory_order_relaxed);
+  if (!liveliness_changes_.exchange(true, std::memory_order_relaxed)) {
+    clock.became_ready();
+  }
 }
 
 bool SubListener::hasEvent(rmw_event_type_t event_type) const
@@ -24,17 +24,24 @@
 #include "rmw_fastrtps_shared_cpp/namespace_prefix.hpp"
 
 #include "demangle.hpp"
+#include "demangle_cache.hpp"
 
-/// Return the demangle ROS topic or the original if not a ROS topic.
+namespace
+{
+// Maximum number of names kept by each demangle cache
+constexpr size_t kMaxDemangleCacheSize = 16384u;
+
+/// Memoize a demangle function, as the demangled name only depends on the mangled one.
+template<DemangleFunction demangle>
 std::string
-_demangle_if_ros_topic(const std::string & topic_name)
+memoized(const std::string & name)
 {
-  return _strip_ros_prefix_if_exists(topic_name);
+  static DemangleCache cache(kMaxDemangleCacheSize);
+  return cache.get(name, demangle);
 }
 
-/// Return the demangled ROS type or the original if not a ROS type.
 std::string
-_demangle_if_ros_type(const std::string & dds_type_string)
+demangle_if_ros_type(const std::string & dds_type_string)
 {
   if (dds_type_string[dds_type_string.size() - 1] != '_') {
     // not a ROS type
@@ -55,16 +62,14 @@ _demangle_if_ros_type(const std::string & dds_type_string)
   return type_namespace + type_name;
 }
 
-/// Return the topic name for a given topic if it is part of one, else "".
 std::string
-_demangle_ros_topic_from_topic(const std::string & topic_name)
+demangle_ros_topic_from_topic(const std::string & topic_name)
 {
   return _resolve_prefix(topic_name, ros_topic_prefix);
 }
 
-/// Return the service name for a given topic if it is part of one, else "".
 std::string
-_demangle_service_from_topic(
+demangle_service_from_topic(
   const std::string & prefix, const std::string & topic_name, std::string suffix)
 {
   std::string service_name = _resolve_prefix(topic_name, prefix);
@@ -92,31 +97,19 @@ _demangle_service_from_topic(
 }
 
 std::string
-_demangle_service_from_topic(const std::string & topic_name)
-{
-  const std::string demangled_topic = _demangle_service_reply_from_topic(topic_name);
-  if ("" != demangled_topic) {
-    return demangled_topic;
-  }
-  return _demangle_service_request_from_topic(topic_name);
-}
-
-
-std::string
-_demangle_service_request_from_topic(const std::string & topic_name)
+demangle_service_request_from_topic(const std::string & topic_name)
 {
-  return _demangle_service_from_topic(ros_service_requester_prefix, topic_name, "Request");
+  return demangle_service_from_topic(ros_service_requester_prefix, topic_name, "Request");
 }
 
 std::string
-_demangle_service_reply_from_topic(const std::string & topic_name)
+demangle_service_reply_from_topic(const std::string & topic_name)
 {
-  return _demangle_service_from_topic(ros_service_response_prefix, topic_name, "Reply");
+  return demangle_service_from_topic(ros_service_response_prefix, topic_name, "Reply");
 }
 
-/// Return the demangled service type if it is a ROS srv type, else "".
 std::string
-_demangle_service_type_only(const std::string & dds_type_name)
+demangle_service_type_only(const std::string & dds_type_name)
 {
   std::string ns_substring = "dds_::";
   size_t ns_substring_position = dds_type_name.find(ns_substring);
@@ -159,6 +152,57 @@ _demangle_service_type_only(const std::string & dds_type_name)
   std::string type_name = dds_type_name.substr(start, suffix_position - start);
   return type_namespace + type_name;
 }
+}  // namespace
+
+/// Return the demangle ROS topic or the original if not a ROS topic.
+std::string
+_demangle_if_ros_topic(const std::string & topic_name)
+{
+  return memoized<_strip_ros_prefix_if_exists>(topic_name);
+}
+
+/// Return the demangled ROS type or the original if not a ROS type.
+std::string
+_demangle_if_ros_type(const std::string & dds_type_string)
+{
+  return memoized<demangle_if_ros_type>(dds_type_string);
+}
+
+/// Return the topic name for a given topic if it is part of one, else "".
+std::string
+_demangle_ros_topic_from_topic(const std::string & topic_name)
+{
+  return memoized<demangle_ros_topic_from_topic>(topic_name);
+}
+
+std::string
+_demangle_service_from_topic(const std::string & topic_name)
+{
+  const std::string demangled_topic = _demangle_service_reply_from_topic(topic_name);
+  if ("" != demangled_topic) {
+    return demangled_topic;
+  }
+  return _demangle_service_request_from_topic(topic_name);
+}
+
+std::string
+_demangle_service_request_from_topic(const std::string & topic_name)
+{
+  return memoized<demangle_service_request_from_topic>(topic_name);
+}
+
+std::string
+_demangle_service_reply_from_topic(const std::string & topic_name)
+{
+  return memoized<demangle_service_reply_from_topic>(topic_name);
+}
+
+/// Return the demangled service type if it is a ROS srv type, else "".
+std::string
+_demangle_service_type_only(const std::string & dds_type_name)
+{
+  return memoized<demangle_service_type_only>(dds_type_name);
+}
 
 std::string
 _identity_demangle(const std::string & name)
@@ -0,0 +1,79 @@
+// Copyright 2021 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef DEMANGLE_CACHE_HPP_
+#define DEMANGLE_CACHE_HPP_
+
+#include <cstddef>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "demangle.hpp"
+
+/// Bounded cache of demangled names, evicting the least recently used name when full.
+/**
+ * Graph queries demangle the names of every endpoint, again and again for the same names.
+ * Evicting the least recently used name keeps the names of the current graph cached when
+ * more distinct names than the capacity went through the cache, while the names of
+ * endpoints gone from the graph are eventually evicted.
+ */
+class DemangleCache
+{
+public:
+  explicit DemangleCache(size_t capacity)
+  : capacity_(capacity)
+  {
+  }
+
+  /// Return the demangled name, only calling `demangle` if it is not cached.
+  std::string
+  get(const std::string & name, DemangleFunction demangle)
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    auto it = entries_.find(name);
+    if (it != entries_.end()) {
+      // Move the name to the front, as the most recently used one
+      lru_.splice(lru_.begin(), lru_, it->second);
+      return it->second->second;
+    }
+    if (!lru_.empty() && entries_.size() >= capacity_) {
+      entries_.erase(lru_.back().first);
+      lru_.pop_back();
+    }
+    lru_.emplace_front(name, demangle(name));
+    entries_.emplace(name, lru_.begin());
+    return lru_.front().second;
+  }
+
+  size_t
+  size()
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    return entries_.size();
+  }
+
+private:
+  using Entry = std::pair<std::string, std::string>;
+
+  const size_t capacity_;
+  std::mutex mutex_;
+  // Mangled and demangled names, from the most to the least recently used
+  std::list<Entry> lru_;
+  std::unordered_map<std::string, std::list<Entry>::iterator> entries_;
+};
+
+#endif  // DEMANGLE_CACHE_HPP_
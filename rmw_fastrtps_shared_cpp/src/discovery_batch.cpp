@@ -0,0 +1,108 @@
+// Copyright 2021 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <memory>
+#include <mutex>
+#include <utility>
+
+#include "rmw/error_handling.h"
+#include "rmw/impl/cpp/macros.hpp"
+#include "rmw/rmw.h"
+
+#include "rmw_dds_common/context.hpp"
+#include "rmw_dds_common/msg/participant_entities_info.hpp"
+
+#include "rmw_fastrtps_shared_cpp/discovery_batch.hpp"
+#include "rmw_fastrtps_shared_cpp/rmw_common.hpp"
+#include "rmw_fastrtps_shared_cpp/rmw_context_impl.hpp"
+
+using rmw_dds_common::msg::ParticipantEntitiesInfo;
+
+namespace rmw_fastrtps_shared_cpp
+{
+rmw_ret_t
+begin_discovery_batch(const char * identifier, rmw_context_t * context)
+{
+  RMW_CHECK_ARGUMENT_FOR_NULL(context, RMW_RET_INVALID_ARGUMENT);
+  RMW_CHECK_ARGUMENT_FOR_NULL(context->impl, RMW_RET_INVALID_ARGUMENT);
+  RMW_CHECK_TYPE_IDENTIFIERS_MATCH(
+    init context,
+    context->implementation_identifier, identifier,
+    return RMW_RET_INCORRECT_RMW_IMPLEMENTATION)
+
+  std::lock_guard<std::mutex> guard(context->impl->discovery_batch_mutex);
+  ++context->impl->discovery_batch_depth;
+  return RMW_RET_OK;
+}
+
+rmw_ret_t
+end_discovery_batch(const char * identifier, rmw_context_t * context)
+{
+  RMW_CHECK_ARGUMENT_FOR_NULL(context, RMW_RET_INVALID_ARGUMENT);
+  RMW_CHECK_ARGUMENT_FOR_NULL(context->impl, RMW_RET_INVALID_ARGUMENT);
+  RMW_CHECK_TYPE_IDENTIFIERS_MATCH(
+    init context,
+    context->implementation_identifier, identifier,
+    return RMW_RET_INCORRECT_RMW_IMPLEMENTATION)
+
+  rmw_dds_common::Context * common_context;
+  {
+    std::lock_guard<std::mutex> guard(context->impl->mutex);
+    common_context = static_cast<rmw_dds_common::Context *>(context->impl->common);
+  }
+
+  // The held back message has to be published before any newer one, see __rmw_create_node()
+  std::unique_lock<std::mutex> node_update_lock;
+  if (nullptr != common_context) {
+    node_update_lock = std::unique_lock<std::mutex>(common_context->node_update_mutex);
+  }
+  std::unique_ptr<ParticipantEntitiesInfo> msg;
+  {
+    std::lock_guard<std::mutex> guard(context->impl->discovery_batch_mutex);
+    if (0u == context->impl->discovery_batch_depth) {
+      RMW_SET_ERROR_MSG("no discovery batch was started");
+      return RMW_RET_ERROR;
+    }
+    if (0u == --context->impl->discovery_batch_depth) {
+      msg = std::move(context->impl->pending_discovery_info);
+    }
+  }
+  if (!msg || nullptr == common_context) {
+    return RMW_RET_OK;
+  }
+  return __rmw_publish(identifier, common_context->pub, msg.get(), nullptr);
+}
+
+rmw_ret_t
+publish_participant_entities_info(
+  const char * identifier,
+  rmw_context_t * context,
+  const ParticipantEntitiesInfo & msg)
+{
+  {
+    std::lock_guard<std::mutex> guard(context->impl->discovery_batch_mutex);
+    if (0u != context->impl->discovery_batch_depth) {
+      auto & pending = context->impl->pending_discovery_info;
+      if (pending) {
+        *pending = msg;
+      } else {
+        pending = std::make_unique<ParticipantEntitiesInfo>(msg);
+      }
+      return RMW_RET_OK;
+    }
+  }
+  auto common_context = static_cast<rmw_dds_common::Context *>(context->impl->common);
+  return __rmw_publish(identifier, common_context->pub, &msg, nullptr);
+}
+}  // namespace rmw_fastrtps_shared_cpp
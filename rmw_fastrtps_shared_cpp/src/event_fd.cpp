@@ -0,0 +1,83 @@
+// Copyright 2021 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <mutex>
+
+#include "rmw/error_handling.h"
+#include "rmw/impl/cpp/macros.hpp"
+#include "rmw/rmw.h"
+
+#include "rmw_fastrtps_shared_cpp/custom_subscriber_info.hpp"
+#include "rmw_fastrtps_shared_cpp/event_fd.hpp"
+
+#include "types/custom_wait_set_info.hpp"
+
+namespace rmw_fastrtps_shared_cpp
+{
+rmw_ret_t
+get_wait_set_event_fd(
+  const char * identifier,
+  rmw_wait_set_t * wait_set,
+  int * fd)
+{
+  RMW_CHECK_ARGUMENT_FOR_NULL(wait_set, RMW_RET_INVALID_ARGUMENT);
+  RMW_CHECK_TYPE_IDENTIFIERS_MATCH(
+    wait set handle,
+    wait_set->implementation_identifier, identifier,
+    return RMW_RET_INCORRECT_RMW_IMPLEMENTATION)
+  RMW_CHECK_ARGUMENT_FOR_NULL(fd, RMW_RET_INVALID_ARGUMENT);
+
+#ifndef __linux__
+  RMW_SET_ERROR_MSG("eventfd is only available on Linux");
+  return RMW_RET_UNSUPPORTED;
+#else
+  auto wait_set_info = static_cast<CustomWaitsetInfo *>(wait_set->data);
+  std::lock_guard<std::mutex> lock(wait_set_info->condition.mutex);
+  if (!wait_set_info->condition.event_fd.enable()) {
+    RMW_SET_ERROR_MSG("failed to create wait set eventfd");
+    return RMW_RET_ERROR;
+  }
+  *fd = wait_set_info->condition.event_fd.get();
+  return RMW_RET_OK;
+#endif
+}
+
+rmw_ret_t
+get_subscription_event_fd(
+  const char * identifier,
+  rmw_subscription_t * subscription,
+  int * fd)
+{
+  RMW_CHECK_ARGUMENT_FOR_NULL(subscription, RMW_RET_INVALID_ARGUMENT);
+  RMW_CHECK_TYPE_IDENTIFIERS_MATCH(
+    subscription handle,
+    subscription->implementation_identifier, identifier,
+    return RMW_RET_INCORRECT_RMW_IMPLEMENTATION)
+  RMW_CHECK_ARGUMENT_FOR_NULL(fd, RMW_RET_INVALID_ARGUMENT);
+
+#ifndef __linux__
+  RMW_SET_ERROR_MSG("eventfd is only available on Linux");
+  return RMW_RET_UNSUPPORTED;
+#else
+  auto info = static_cast<CustomSubscriberInfo *>(subscription->data);
+  int event_fd = info->listener_->enable_event_fd();
+  if (event_fd < 0) {
+    RMW_SET_ERROR_MSG("failed to create subscription eventfd");
+    return RMW_RET_ERROR;
+  }
+  *fd = event_fd;
+  return RMW_RET_OK;
+#endif
+}
+}  // namespace rmw_fastrtps_shared_cpp
@@ -0,0 +1,131 @@
+// Copyright 2021 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string>
+
+#include "rmw/error_handling.h"
+#include "rmw/impl/cpp/macros.hpp"
+#include "rmw/rmw.h"
+
+#include "rmw_fastrtps_shared_cpp/graph_guard_conditions.hpp"
+#include "rmw_fastrtps_shared_cpp/names.hpp"
+#include "rmw_fastrtps_shared_cpp/namespace_prefix.hpp"
+#include "rmw_fastrtps_shared_cpp/rmw_context_impl.hpp"
+
+namespace rmw_fastrtps_shared_cpp
+{
+static
+rmw_ret_t
+check_arguments(
+  const char * identifier,
+  const rmw_node_t * node,
+  const char * name,
+  const rmw_guard_condition_t * guard_condition)
+{
+  RMW_CHECK_ARGUMENT_FOR_NULL(node, RMW_RET_INVALID_ARGUMENT);
+  RMW_CHECK_TYPE_IDENTIFIERS_MATCH(
+    node handle,
+    node->implementation_identifier, identifier,
+    return RMW_RET_INCORRECT_RMW_IMPLEMENTATION);
+  RMW_CHECK_ARGUMENT_FOR_NULL(name, RMW_RET_INVALID_ARGUMENT);
+  RMW_CHECK_ARGUMENT_FOR_NULL(guard_condition, RMW_RET_INVALID_ARGUMENT);
+  RMW_CHECK_TYPE_IDENTIFIERS_MATCH(
+    guard condition handle,
+    guard_condition->implementation_identifier, identifier,
+    return RMW_RET_INCORRECT_RMW_IMPLEMENTATION);
+  return RMW_RET_OK;
+}
+
+rmw_ret_t
+add_topic_graph_guard_condition(
+  const char * identifier,
+  const rmw_node_t * node,
+  const char * topic_name,
+  const rmw_guard_condition_t * guard_condition)
+{
+  rmw_ret_t ret = check_arguments(identifier, node, topic_name, guard_condition);
+  if (RMW_RET_OK != ret) {
+    return ret;
+  }
+  node->context->impl->graph_change_notifier.add_topic_guard_condition(
+    _mangle_topic_name(ros_topic_prefix, topic_name).to_string(), guard_condition);
+  return RMW_RET_OK;
+}
+
+rmw_ret_t
+remove_topic_graph_guard_condition(
+  const char * identifier,
+  const rmw_node_t * node,
+  const char * topic_name,
+  const rmw_guard_condition_t * guard_condition)
+{
+  rmw_ret_t ret = check_arguments(identifier, node, topic_name, guard_condition);
+  if (RMW_RET_OK != ret) {
+    return ret;
+  }
+  if (!node->context->impl->graph_change_notifier.remove_topic_guard_condition(
+      _mangle_topic_name(ros_topic_prefix, topic_name).to_string(), guard_condition))
+  {
+    RMW_SET_ERROR_MSG("guard condition was not added for this topic");
+    return RMW_RET_INVALID_ARGUMENT;
+  }
+  return RMW_RET_OK;
+}
+
+rmw_ret_t
+add_service_graph_guard_condition(
+  const char * identifier,
+  const rmw_node_t * node,
+  const char * service_name,
+  const rmw_guard_condition_t * guard_condition)
+{
+  rmw_ret_t ret = check_arguments(identifier, node, service_name, guard_condition);
+  if (RMW_RET_OK != ret) {
+    return ret;
+  }
+  auto & notifier = node->context->impl->graph_change_notifier;
+  notifier.add_topic_guard_condition(
+    _mangle_topic_name(ros_service_requester_prefix, service_name, "Request").to_string(),
+    guard_condition);
+  notifier.add_topic_guard_condition(
+    _mangle_topic_name(ros_service_response_prefix, service_name, "Reply").to_string(),
+    guard_condition);
+  return RMW_RET_OK;
+}
+
+rmw_ret_t
+remove_service_graph_guard_condition(
+  const char * identifier,
+  const rmw_node_t * node,
+  const char * service_name,
+  const rmw_guard_condition_t * guard_condition)
+{
+  rmw_ret_t ret = check_arguments(identifier, node, service_name, guard_condition);
+  if (RMW_RET_OK != ret) {
+    return ret;
+  }
+  auto & notifier = node->context->impl->graph_change_notifier;
+  bool request_removed = notifier.remove_topic_guard_condition(
+    _mangle_topic_name(ros_service_requester_prefix, service_name, "Request").to_string(),
+    guard_condition);
+  bool response_removed = notifier.remove_topic_guard_condition(
+    _mangle_topic_name(ros_service_response_prefix, service_name, "Reply").to_string(),
+    guard_condition);
+  if (!request_removed || !response_removed) {
+    RMW_SET_ERROR_MSG("guard condition was not added for this service");
+    return RMW_RET_INVALID_ARGUMENT;
+  }
+  return RMW_RET_OK;
+}
+}  // namespace rmw_fastrtps_shared_cpp
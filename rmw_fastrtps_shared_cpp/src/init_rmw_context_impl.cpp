@@ -94,6 +94,12 @@ rmw_fastrtps_shared_cpp::decrement_context_impl_ref_count(rmw_context_t * contex
   }
 
   common_context->graph_cache.clear_on_change_callback();
+  context->impl->graph_change_notifier.set_guard_condition(nullptr, nullptr);
+  {
+    // The discovery publisher is gone
+    std::lock_guard<std::mutex> guard(context->impl->discovery_batch_mutex);
+    context->impl->pending_discovery_info.reset();
+  }
   if (RMW_RET_OK != rmw_fastrtps_shared_cpp::__rmw_destroy_guard_condition(
       common_context->graph_guard_condition))
   {
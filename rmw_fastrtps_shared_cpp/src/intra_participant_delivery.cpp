@@ -0,0 +1,169 @@
+// Copyright 2021 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <string>
+
+#include "fastdds/dds/core/policy/QosPolicies.hpp"
+#include "fastdds/dds/publisher/DataWriter.hpp"
+#include "fastdds/dds/publisher/qos/DataWriterQos.hpp"
+#include "fastdds/dds/subscriber/DataReader.hpp"
+#include "fastdds/dds/subscriber/qos/DataReaderQos.hpp"
+#include "fastdds/dds/topic/Topic.hpp"
+#include "fastdds/dds/topic/TopicDescription.hpp"
+#include "fastdds/rtps/common/InstanceHandle.h"
+#include "fastdds/rtps/common/SequenceNumber.h"
+#include "fastdds/rtps/common/Time_t.h"
+
+#include "rmw_fastrtps_shared_cpp/custom_publisher_info.hpp"
+#include "rmw_fastrtps_shared_cpp/custom_subscriber_info.hpp"
+#include "rmw_fastrtps_shared_cpp/intra_participant_delivery.hpp"
+#include "rmw_fastrtps_shared_cpp/TypeSupport.hpp"
+
+namespace rmw_fastrtps_shared_cpp
+{
+
+void
+set_local_publication_number(
+  eprosima::fastrtps::rtps::WriteParams & params,
+  const eprosima::fastrtps::rtps::GUID_t & writer_guid,
+  uint64_t publication_number)
+{
+  // The related sample identity is otherwise only used by services
+  params.related_sample_identity().writer_guid() = writer_guid;
+  params.related_sample_identity().sequence_number().high =
+    static_cast<int32_t>(publication_number >> 32);
+  params.related_sample_identity().sequence_number().low =
+    static_cast<uint32_t>(publication_number & 0xFFFFFFFF);
+}
+
+uint64_t
+get_local_publication_number(const eprosima::fastdds::dds::SampleInfo & sample_info)
+{
+  const eprosima::fastrtps::rtps::SampleIdentity & related = sample_info.related_sample_identity;
+  if (related.writer_guid() !=
+    eprosima::fastrtps::rtps::iHandle2GUID(sample_info.publication_handle) ||
+    related.sequence_number().high < 0)
+  {
+    return 0u;
+  }
+  return (static_cast<uint64_t>(related.sequence_number().high) << 32) |
+         related.sequence_number().low;
+}
+
+void
+IntraParticipantDelivery::add_publisher(CustomPublisherInfo * info, bool can_loan_messages)
+{
+  auto type_support = static_cast<const TypeSupport *>(info->type_support_.get());
+  if (!type_support->can_copy_ros_messages() || nullptr == info->listener_ ||
+    can_loan_messages || info->can_loan_serialized_messages_)
+  {
+    return;
+  }
+  // Messages must be written for the publisher to meet these QoS
+  const eprosima::fastdds::dds::DataWriterQos & qos = info->data_writer_->get_qos();
+  if (eprosima::fastdds::dds::VOLATILE_DURABILITY_QOS != qos.durability().kind ||
+    eprosima::fastdds::dds::AUTOMATIC_LIVELINESS_QOS != qos.liveliness().kind ||
+    eprosima::fastrtps::c_TimeInfinite != qos.deadline().period ||
+    eprosima::fastrtps::c_TimeInfinite != qos.lifespan().duration)
+  {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  publishers_[info->data_writer_->guid()] = {info->type_support_impl_, 0u};
+  info->local_delivery_ = shared_from_this();
+}
+
+void
+IntraParticipantDelivery::remove_publisher(CustomPublisherInfo * info)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  publishers_.erase(info->data_writer_->guid());
+}
+
+void
+IntraParticipantDelivery::add_subscription(
+  CustomSubscriberInfo * info, bool can_loan_messages, bool ignore_local_publications)
+{
+  auto type_support = static_cast<const TypeSupport *>(info->type_support_.get());
+  if (!type_support->can_copy_ros_messages() || nullptr == info->listener_ ||
+    can_loan_messages || info->can_loan_serialized_messages_)
+  {
+    return;
+  }
+  // Samples must be received for the subscription to meet its deadline
+  const eprosima::fastdds::dds::DataReaderQos & qos = info->data_reader_->get_qos();
+  if (eprosima::fastrtps::c_TimeInfinite != qos.deadline().period) {
+    return;
+  }
+
+  LocalSubscription subscription;
+  subscription.info = info;
+  if (eprosima::fastdds::dds::KEEP_LAST_HISTORY_QOS == qos.history().kind) {
+    subscription.depth = static_cast<size_t>(qos.history().depth);
+  } else {
+    subscription.depth =
+      static_cast<size_t>(std::max<int32_t>(qos.resource_limits().max_samples, 0));
+  }
+  subscription.ignore_local_publications = ignore_local_publications;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  subscriptions_.emplace(info->data_reader_->get_topicdescription()->get_name(), subscription);
+  info->local_delivery_ = shared_from_this();
+}
+
+void
+IntraParticipantDelivery::remove_subscription(CustomSubscriberInfo * info)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto range = subscriptions_.equal_range(info->data_reader_->get_topicdescription()->get_name());
+  for (auto it = range.first; it != range.second; ++it) {
+    if (it->second.info == info) {
+      subscriptions_.erase(it);
+      break;
+    }
+  }
+}
+
+size_t
+IntraParticipantDelivery::deliver(const CustomPublisherInfo * info, LocalSample & sample)
+{
+  const std::string & topic_name = info->data_writer_->get_topic()->get_name();
+  size_t delivered = 0u;
+
+  // Held while queueing, so that subscriptions aren't delivered anything once removed
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto publisher = publishers_.find(sample.writer_guid);
+  sample.publication_number =
+    publisher != publishers_.end() ? ++publisher->second.publication_count : 0u;
+  auto range = subscriptions_.equal_range(topic_name);
+  for (auto it = range.first; it != range.second; ++it) {
+    const LocalSubscription & subscription = it->second;
+    if (subscription.info->type_support_impl_ != info->type_support_impl_) {
+      continue;
+    }
+    SubListener * listener = subscription.info->listener_;
+    if (subscription.ignore_local_publications) {
+      if (listener->hasPublisher(sample.writer_guid)) {
+        ++delivered;
+      }
+    } else if (listener->add_local_sample(sample, subscription.depth)) {
+      ++delivered;
+    }
+  }
+  return delivered;
+}
+
+}  // namespace rmw_fastrtps_shared_cpp
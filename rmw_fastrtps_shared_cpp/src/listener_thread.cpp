@@ -12,18 +12,30 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
-#include <atomic>
+#include <algorithm>
+#include <array>
 #include <cassert>
+#include <condition_variable>
+#include <cstdint>
 #include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
 #include <thread>
+#include <tuple>
+#include <vector>
 
+#include "rcutils/allocator.h"
 #include "rcutils/macros.h"
 
+#include "rcpputils/thread_safety_annotations.hpp"
+
 #include "rmw/allocators.h"
 #include "rmw/error_handling.h"
 #include "rmw/init.h"
 #include "rmw/ret_types.h"
 #include "rmw/rmw.h"
+#include "rmw/serialized_message.h"
 #include "rmw/types.h"
 #include "rmw/impl/cpp/macros.hpp"
 
@@ -37,56 +49,302 @@
 
 using rmw_dds_common::operator<<;
 
-static
+#define TERMINATE_THREAD(msg) \
+  { \
+    RCUTILS_SAFE_FWRITE_TO_STDERR( \
+      RCUTILS_STRINGIFY(__FILE__) ":" RCUTILS_STRINGIFY(__function__) ":" \
+      RCUTILS_STRINGIFY(__LINE__) RCUTILS_STRINGIFY(msg) \
+      ": ros discovery info listener thread will shutdown ...\n"); \
+    break; \
+  }
+
+// Maximum number of discovery messages taken at once
+static constexpr size_t kTakeBatchSize = 32u;
+
+namespace
+{
+
+/// Listen to ros_discovery_info for every context of the process, in a single thread.
+/**
+ * Contexts that receive the same discovery traffic, i.e. that use the same domain id,
+ * localhost only setting and enclave, are grouped together.
+ * Only the subscription of the first context of a group is deserialized, and its messages
+ * update the graph cache of every context of the group, except the messages a context
+ * published itself.
+ * The subscriptions of the other contexts are drained without deserializing their messages,
+ * so that their history doesn't grow, and take over when the first context goes away.
+ *
+ * Only the last message of a participant matters, so the last message of each participant
+ * fanned out to a group is kept.
+ * A context joining a group learns about the participants that published before from those,
+ * as the history its own subscription receives is drained.
+ */
+class DiscoveryListener
+{
+public:
+  static DiscoveryListener &
+  get_instance()
+  {
+    // Never destroyed, so that exiting without shutting down contexts doesn't destroy
+    // a joinable thread.
+    static DiscoveryListener * instance = new DiscoveryListener();
+    return *instance;
+  }
+
+  rmw_ret_t
+  add_context(rmw_context_t * context);
+
+  rmw_ret_t
+  remove_context(rmw_context_t * context);
+
+  void
+  forget_participant(const rmw_gid_t & gid);
+
+private:
+  using GroupKey = std::tuple<size_t, rmw_localhost_only_t, std::string>;
+  using Group = std::vector<rmw_context_t *>;
+  using ParticipantKey = std::array<uint8_t, RMW_GID_STORAGE_SIZE>;
+  using ParticipantMessages =
+    std::map<ParticipantKey, rmw_dds_common::msg::ParticipantEntitiesInfo>;
+
+  struct WaitedSubscription
+  {
+    rmw_context_t * context;
+    // Group to fan messages out to, or null if the messages are only drained
+    const Group * group;
+  };
+
+  DiscoveryListener() = default;
+
+  static GroupKey
+  get_group_key(const rmw_context_t * context)
+  {
+    return GroupKey(
+      context->actual_domain_id,
+      context->options.localhost_only,
+      nullptr != context->options.enclave ? context->options.enclave : "");
+  }
+
+  static ParticipantKey
+  get_participant_key(const uint8_t * gid_data)
+  {
+    ParticipantKey key;
+    std::copy(gid_data, gid_data + RMW_GID_STORAGE_SIZE, key.begin());
+    return key;
+  }
+
+  void
+  catch_up(rmw_context_t * context);
+
+  rmw_ret_t
+  start_thread(rmw_context_t * context);
+
+  rmw_ret_t
+  stop_thread();
+
+  void
+  run();
+
+  bool
+  take_and_fan_out(rmw_context_t * context, const Group & group);
+
+  bool
+  drain(rmw_context_t * context);
+
+  // Serializes adding and removing contexts, held while starting or joining the thread
+  std::mutex lifecycle_mutex_;
+  std::thread thread_;
+  rmw_guard_condition_t * wake_up_gc_{nullptr};
+  rmw_wait_set_t * wait_set_{nullptr};
+
+  std::mutex mutex_;
+  std::condition_variable applied_cv_;
+  std::map<GroupKey, Group> groups_ RCPPUTILS_TSA_GUARDED_BY(mutex_);
+  // Incremented on each change of the groups, see remove_context()
+  uint64_t version_ RCPPUTILS_TSA_GUARDED_BY(mutex_) = 0u;
+  // Version of the groups the thread is waiting on
+  uint64_t applied_version_ RCPPUTILS_TSA_GUARDED_BY(mutex_) = 0u;
+  bool is_running_ RCPPUTILS_TSA_GUARDED_BY(mutex_) = false;
+  bool is_alive_ RCPPUTILS_TSA_GUARDED_BY(mutex_) = false;
+
+  // Not mutex_, as it is locked by the participant listeners of the contexts, which must not
+  // wait for the thread to be done taking messages
+  std::mutex participants_mutex_;
+  // Last message of each participant fanned out to a group
+  std::map<GroupKey, ParticipantMessages> participants_
+  RCPPUTILS_TSA_GUARDED_BY(participants_mutex_);
+
+  // Only used by the thread
+  std::vector<rmw_dds_common::msg::ParticipantEntitiesInfo> msgs_;
+  std::vector<void *> msg_ptrs_;
+  std::vector<rmw_message_info_t> msg_infos_;
+  rmw_serialized_message_t serialized_msg_;
+};
+
+rmw_ret_t
+DiscoveryListener::add_context(rmw_context_t * context)
+{
+  std::lock_guard<std::mutex> lifecycle_guard(lifecycle_mutex_);
+  if (nullptr == wait_set_) {
+    rmw_ret_t ret = start_thread(context);
+    if (RMW_RET_OK != ret) {
+      return ret;
+    }
+  }
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    Group & group = groups_[get_group_key(context)];
+    if (!group.empty()) {
+      // The messages its subscription receives are only drained
+      catch_up(context);
+    }
+    group.push_back(context);
+    ++version_;
+  }
+  return rmw_fastrtps_shared_cpp::__rmw_trigger_guard_condition(
+    wake_up_gc_->implementation_identifier, wake_up_gc_);
+}
+
+rmw_ret_t
+DiscoveryListener::remove_context(rmw_context_t * context)
+{
+  std::lock_guard<std::mutex> lifecycle_guard(lifecycle_mutex_);
+  uint64_t version;
+  bool is_last;
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    auto group_it = groups_.find(get_group_key(context));
+    assert(group_it != groups_.end());
+    Group & group = group_it->second;
+    auto it = std::find(group.begin(), group.end(), context);
+    assert(it != group.end());
+    group.erase(it);
+    auto common_context = static_cast<rmw_dds_common::Context *>(context->impl->common);
+    {
+      std::lock_guard<std::mutex> participants_guard(participants_mutex_);
+      if (group.empty()) {
+        participants_.erase(group_it->first);
+      } else {
+        participants_[group_it->first].erase(get_participant_key(common_context->gid.data));
+      }
+    }
+    if (group.empty()) {
+      groups_.erase(group_it);
+    }
+    version = ++version_;
+    is_last = groups_.empty();
+    if (is_last) {
+      is_running_ = false;
+    }
+  }
+  rmw_ret_t ret = rmw_fastrtps_shared_cpp::__rmw_trigger_guard_condition(
+    wake_up_gc_->implementation_identifier, wake_up_gc_);
+  if (RMW_RET_OK != ret) {
+    return ret;
+  }
+  if (is_last) {
+    return stop_thread();
+  }
+  // The subscription of the context is destroyed after this returns, so wait until the
+  // thread doesn't wait on it anymore.
+  std::unique_lock<std::mutex> lock(mutex_);
+  applied_cv_.wait(
+    lock, [this, version]() RCPPUTILS_TSA_REQUIRES(mutex_) {
+      return applied_version_ >= version || !is_alive_;
+    });
+  return RMW_RET_OK;
+}
+
 void
-node_listener(rmw_context_t * context);
+DiscoveryListener::forget_participant(const rmw_gid_t & gid)
+{
+  ParticipantKey key = get_participant_key(gid.data);
+  std::lock_guard<std::mutex> guard(participants_mutex_);
+  for (auto & key_and_messages : participants_) {
+    key_and_messages.second.erase(key);
+  }
+}
+
+void
+DiscoveryListener::catch_up(rmw_context_t * context)
+{
+  auto common_context = static_cast<rmw_dds_common::Context *>(context->impl->common);
+  ParticipantKey own_key = get_participant_key(common_context->gid.data);
+  std::vector<rmw_dds_common::msg::ParticipantEntitiesInfo> msgs;
+  {
+    std::lock_guard<std::mutex> guard(participants_mutex_);
+    for (const auto & key_and_msg : participants_[get_group_key(context)]) {
+      if (key_and_msg.first != own_key) {
+        msgs.push_back(key_and_msg.second);
+      }
+    }
+  }
+  context->impl->graph_change_notifier.defer();
+  for (const auto & msg : msgs) {
+    common_context->graph_cache.update_participant_entities(msg);
+  }
+  context->impl->graph_change_notifier.flush();
+}
 
 rmw_ret_t
-rmw_fastrtps_shared_cpp::run_listener_thread(rmw_context_t * context)
+DiscoveryListener::start_thread(rmw_context_t * context)
 {
   RCUTILS_CAN_RETURN_WITH_ERROR_OF(RMW_RET_ERROR);
 
-  auto common_context = static_cast<rmw_dds_common::Context *>(context->impl->common);
-  common_context->thread_is_running.store(true);
-  common_context->listener_thread_gc = rmw_fastrtps_shared_cpp::__rmw_create_guard_condition(
+  wake_up_gc_ = rmw_fastrtps_shared_cpp::__rmw_create_guard_condition(
     context->implementation_identifier);
-  if (common_context->listener_thread_gc) {
+  if (nullptr == wake_up_gc_) {
+    RMW_SET_ERROR_MSG("Failed to create guard condition");
+    return RMW_RET_ERROR;
+  }
+  // The same wait set is used for the thread lifetime, so that the subscriptions and guard
+  // condition stay attached to it between waits.
+  wait_set_ = rmw_fastrtps_shared_cpp::__rmw_create_wait_set(
+    context->implementation_identifier, context, 0);
+  if (nullptr != wait_set_) {
+    {
+      std::lock_guard<std::mutex> guard(mutex_);
+      is_running_ = true;
+      is_alive_ = true;
+    }
     try {
-      common_context->listener_thread = std::thread(node_listener, context);
+      thread_ = std::thread(&DiscoveryListener::run, this);
       return RMW_RET_OK;
     } catch (const std::exception & exc) {
       RMW_SET_ERROR_MSG_WITH_FORMAT_STRING("Failed to create std::thread: %s", exc.what());
     } catch (...) {
       RMW_SET_ERROR_MSG("Failed to create std::thread");
     }
-  } else {
-    RMW_SET_ERROR_MSG("Failed to create guard condition");
-  }
-  common_context->thread_is_running.store(false);
-  if (common_context->listener_thread_gc) {
-    if (RMW_RET_OK != rmw_fastrtps_shared_cpp::__rmw_destroy_guard_condition(
-        common_context->listener_thread_gc))
+    {
+      std::lock_guard<std::mutex> guard(mutex_);
+      is_running_ = false;
+      is_alive_ = false;
+    }
+    if (RMW_RET_OK != rmw_fastrtps_shared_cpp::__rmw_destroy_wait_set(
+        wait_set_->implementation_identifier, wait_set_))
     {
       RCUTILS_SAFE_FWRITE_TO_STDERR(
         RCUTILS_STRINGIFY(__FILE__) ":" RCUTILS_STRINGIFY(__function__) ":"
-        RCUTILS_STRINGIFY(__LINE__) ": Failed to destroy guard condition");
+        RCUTILS_STRINGIFY(__LINE__) ": Failed to destroy wait set");
     }
+    wait_set_ = nullptr;
+  } else {
+    RMW_SET_ERROR_MSG("Failed to create wait set");
+  }
+  if (RMW_RET_OK != rmw_fastrtps_shared_cpp::__rmw_destroy_guard_condition(wake_up_gc_)) {
+    RCUTILS_SAFE_FWRITE_TO_STDERR(
+      RCUTILS_STRINGIFY(__FILE__) ":" RCUTILS_STRINGIFY(__function__) ":"
+      RCUTILS_STRINGIFY(__LINE__) ": Failed to destroy guard condition");
   }
+  wake_up_gc_ = nullptr;
   return RMW_RET_ERROR;
 }
 
 rmw_ret_t
-rmw_fastrtps_shared_cpp::join_listener_thread(rmw_context_t * context)
+DiscoveryListener::stop_thread()
 {
-  auto common_context = static_cast<rmw_dds_common::Context *>(context->impl->common);
-  common_context->thread_is_running.exchange(false);
-  rmw_ret_t rmw_ret = rmw_fastrtps_shared_cpp::__rmw_trigger_guard_condition(
-    context->implementation_identifier, common_context->listener_thread_gc);
-  if (RMW_RET_OK != rmw_ret) {
-    return rmw_ret;
-  }
   try {
-    common_context->listener_thread.join();
+    thread_.join();
   } catch (const std::exception & exc) {
     RMW_SET_ERROR_MSG_WITH_FORMAT_STRING("Failed to join std::thread: %s", exc.what());
     return RMW_RET_ERROR;
@@ -94,87 +352,211 @@ rmw_fastrtps_shared_cpp::join_listener_thread(rmw_context_t * context)
     RMW_SET_ERROR_MSG("Failed to join std::thread");
     return RMW_RET_ERROR;
   }
-  rmw_ret = rmw_fastrtps_shared_cpp::__rmw_destroy_guard_condition(
-    common_context->listener_thread_gc);
-  if (RMW_RET_OK != rmw_ret) {
-    return rmw_ret;
+  rmw_ret_t ret = rmw_fastrtps_shared_cpp::__rmw_destroy_wait_set(
+    wait_set_->implementation_identifier, wait_set_);
+  wait_set_ = nullptr;
+  if (RMW_RET_OK != ret) {
+    return ret;
   }
-  return RMW_RET_OK;
+  ret = rmw_fastrtps_shared_cpp::__rmw_destroy_guard_condition(wake_up_gc_);
+  wake_up_gc_ = nullptr;
+  return ret;
 }
 
-#define TERMINATE_THREAD(msg) \
-  { \
-    RCUTILS_SAFE_FWRITE_TO_STDERR( \
-      RCUTILS_STRINGIFY(__FILE__) ":" RCUTILS_STRINGIFY(__function__) ":" \
-      RCUTILS_STRINGIFY(__LINE__) RCUTILS_STRINGIFY(msg) \
-      ": ros discovery info listener thread will shutdown ...\n"); \
-    break; \
-  }
-
 void
-node_listener(rmw_context_t * context)
+DiscoveryListener::run()
 {
-  assert(nullptr != context);
-  assert(nullptr != context->impl);
-  assert(nullptr != context->impl->common);
-  auto common_context = static_cast<rmw_dds_common::Context *>(context->impl->common);
-  while (common_context->thread_is_running.load()) {
-    assert(nullptr != common_context->sub);
-    assert(nullptr != common_context->sub->data);
-    void * subscriptions_buffer[] = {common_context->sub->data};
-    void * guard_conditions_buffer[] = {common_context->listener_thread_gc->data};
+  msgs_.resize(kTakeBatchSize);
+  msg_ptrs_.resize(kTakeBatchSize);
+  msg_infos_.resize(kTakeBatchSize);
+  for (size_t i = 0; i < kTakeBatchSize; ++i) {
+    msg_ptrs_[i] = &msgs_[i];
+  }
+  serialized_msg_ = rmw_get_zero_initialized_serialized_message();
+  rcutils_allocator_t allocator = rcutils_get_default_allocator();
+  if (RMW_RET_OK != rmw_serialized_message_init(&serialized_msg_, 0u, &allocator)) {
+    rmw_reset_error();
+  }
+
+  std::vector<WaitedSubscription> waited;
+  std::vector<void *> subscriptions_buffer;
+  while (true) {
+    {
+      std::lock_guard<std::mutex> guard(mutex_);
+      if (!is_running_) {
+        break;
+      }
+      waited.clear();
+      for (const auto & key_and_group : groups_) {
+        const Group & group = key_and_group.second;
+        waited.push_back({group.front(), &group});
+        for (size_t i = 1u; i < group.size(); ++i) {
+          waited.push_back({group[i], nullptr});
+        }
+      }
+      applied_version_ = version_;
+    }
+    applied_cv_.notify_all();
+
+    subscriptions_buffer.clear();
+    for (const auto & entry : waited) {
+      auto common_context = static_cast<rmw_dds_common::Context *>(entry.context->impl->common);
+      subscriptions_buffer.push_back(common_context->sub->data);
+    }
+    void * guard_conditions_buffer[] = {wake_up_gc_->data};
     rmw_subscriptions_t subscriptions;
     rmw_guard_conditions_t guard_conditions;
-    subscriptions.subscriber_count = 1;
-    subscriptions.subscribers = subscriptions_buffer;
+    subscriptions.subscriber_count = subscriptions_buffer.size();
+    subscriptions.subscribers = subscriptions_buffer.data();
     guard_conditions.guard_condition_count = 1;
     guard_conditions.guard_conditions = guard_conditions_buffer;
-    // number of conditions of a subscription is 2
-    rmw_wait_set_t * wait_set = rmw_fastrtps_shared_cpp::__rmw_create_wait_set(
-      context->implementation_identifier, context, 2);
-    if (nullptr == wait_set) {
-      TERMINATE_THREAD("failed to create wait set");
-    }
     if (RMW_RET_OK != rmw_fastrtps_shared_cpp::__rmw_wait(
-        context->implementation_identifier,
+        wait_set_->implementation_identifier,
         &subscriptions,
         &guard_conditions,
         nullptr,
         nullptr,
         nullptr,
-        wait_set,
+        wait_set_,
         nullptr))
     {
       TERMINATE_THREAD("rmw_wait failed");
     }
-    if (RMW_RET_OK != rmw_fastrtps_shared_cpp::__rmw_destroy_wait_set(
-        context->implementation_identifier, wait_set))
+
+    std::lock_guard<std::mutex> guard(mutex_);
+    if (applied_version_ != version_) {
+      // Contexts were added or removed meanwhile, the groups have to be looked up again
+      continue;
+    }
+    bool failed = false;
+    for (size_t i = 0u; i < waited.size() && !failed; ++i) {
+      if (!subscriptions_buffer[i]) {
+        continue;
+      }
+      if (nullptr != waited[i].group) {
+        failed = !take_and_fan_out(waited[i].context, *waited[i].group);
+      } else {
+        failed = !drain(waited[i].context);
+      }
+    }
+    if (failed) {
+      TERMINATE_THREAD("__rmw_take_sequence failed");
+    }
+  }
+
+  if (RMW_RET_OK != rmw_serialized_message_fini(&serialized_msg_)) {
+    rmw_reset_error();
+  }
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    is_alive_ = false;
+  }
+  applied_cv_.notify_all();
+}
+
+bool
+DiscoveryListener::take_and_fan_out(rmw_context_t * context, const Group & group)
+{
+  auto common_context = static_cast<rmw_dds_common::Context *>(context->impl->common);
+  assert(nullptr != common_context->sub);
+  assert(nullptr != common_context->sub->data);
+
+  rmw_message_sequence_t message_sequence;
+  message_sequence.data = msg_ptrs_.data();
+  message_sequence.size = 0u;
+  message_sequence.capacity = kTakeBatchSize;
+  message_sequence.allocator = nullptr;
+  rmw_message_info_sequence_t message_info_sequence;
+  message_info_sequence.data = msg_infos_.data();
+  message_info_sequence.size = 0u;
+  message_info_sequence.capacity = kTakeBatchSize;
+  message_info_sequence.allocator = nullptr;
+
+  // Drain every available message, notifying the graph changes they carry at once
+  bool failed = false;
+  for (rmw_context_t * group_context : group) {
+    group_context->impl->graph_change_notifier.defer();
+  }
+  const GroupKey group_key = get_group_key(context);
+  size_t taken = kTakeBatchSize;
+  while (taken == kTakeBatchSize) {
+    if (RMW_RET_OK != rmw_fastrtps_shared_cpp::__rmw_take_sequence(
+        context->implementation_identifier,
+        common_context->sub,
+        kTakeBatchSize,
+        &message_sequence,
+        &message_info_sequence,
+        &taken,
+        nullptr))
     {
-      TERMINATE_THREAD("failed to destroy wait set");
-    }
-    if (subscriptions_buffer[0]) {
-      rmw_dds_common::msg::ParticipantEntitiesInfo msg;
-      bool taken;
-      if (RMW_RET_OK != rmw_fastrtps_shared_cpp::__rmw_take(
-          context->implementation_identifier,
-          common_context->sub,
-          static_cast<void *>(&msg),
-          &taken,
-          nullptr))
-      {
-        TERMINATE_THREAD("__rmw_take failed");
+      failed = true;
+      break;
+    }
+    if (taken > 0u) {
+      std::lock_guard<std::mutex> guard(participants_mutex_);
+      ParticipantMessages & participants = participants_[group_key];
+      for (size_t i = 0; i < taken; ++i) {
+        participants[get_participant_key(msgs_[i].gid.data.data())] = msgs_[i];
       }
-      if (taken) {
+    }
+    for (size_t i = 0; i < taken; ++i) {
+      const auto & msg = msgs_[i];
+      for (rmw_context_t * group_context : group) {
+        auto group_common_context =
+          static_cast<rmw_dds_common::Context *>(group_context->impl->common);
         if (std::memcmp(
-            reinterpret_cast<char *>(common_context->gid.data),
-            reinterpret_cast<char *>(&msg.gid.data),
+            reinterpret_cast<char *>(group_common_context->gid.data),
+            reinterpret_cast<const char *>(&msg.gid.data),
             RMW_GID_STORAGE_SIZE) == 0)
         {
-          // ignore local messages
+          // ignore the messages of the context's own participant
           continue;
         }
-        common_context->graph_cache.update_participant_entities(msg);
+        group_common_context->graph_cache.update_participant_entities(msg);
       }
     }
   }
+  for (rmw_context_t * group_context : group) {
+    group_context->impl->graph_change_notifier.flush();
+  }
+  return !failed;
+}
+
+bool
+DiscoveryListener::drain(rmw_context_t * context)
+{
+  auto common_context = static_cast<rmw_dds_common::Context *>(context->impl->common);
+  bool taken = true;
+  while (taken) {
+    if (RMW_RET_OK != rmw_fastrtps_shared_cpp::__rmw_take_serialized_message(
+        context->implementation_identifier,
+        common_context->sub,
+        &serialized_msg_,
+        &taken,
+        nullptr))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+rmw_ret_t
+rmw_fastrtps_shared_cpp::run_listener_thread(rmw_context_t * context)
+{
+  return DiscoveryListener::get_instance().add_context(context);
+}
+
+rmw_ret_t
+rmw_fastrtps_shared_cpp::join_listener_thread(rmw_context_t * context)
+{
+  return DiscoveryListener::get_instance().remove_context(context);
+}
+
+void
+rmw_fastrtps_shared_cpp::forget_discovery_participant(const rmw_gid_t & gid)
+{
+  DiscoveryListener::get_instance().forget_participant(gid);
 }
@@ -39,6 +39,7 @@
 #include "rmw/allocators.h"
 
 #include "rmw_fastrtps_shared_cpp/custom_participant_info.hpp"
+#include "rmw_fastrtps_shared_cpp/intra_participant_delivery.hpp"
 #include "rmw_fastrtps_shared_cpp/participant.hpp"
 #include "rmw_fastrtps_shared_cpp/rmw_common.hpp"
 #include "rmw_fastrtps_shared_cpp/rmw_security_logging.hpp"
@@ -53,6 +54,11 @@ __create_participant(
   const eprosima::fastdds::dds::DomainParticipantQos & domainParticipantQos,
   bool leave_middleware_default_qos,
   publishing_mode_t publishing_mode,
+  bool serialize_once,
+  bool publisher_payload_pool,
+  bool serialized_loans,
+  bool intra_participant_delivery,
+  bool publisher_timing,
   rmw_dds_common::Context * common_context,
   size_t domain_id)
 {
@@ -110,6 +116,19 @@ __create_participant(
   // Set participant info parameters
   participant_info->leave_middleware_default_qos = leave_middleware_default_qos;
   participant_info->publishing_mode = publishing_mode;
+  participant_info->serialize_once = serialize_once;
+  participant_info->publisher_payload_pool = publisher_payload_pool;
+  participant_info->serialized_loans = serialized_loans;
+  participant_info->publisher_timing = publisher_timing;
+  if (intra_participant_delivery) {
+    try {
+      participant_info->intra_participant_delivery =
+        std::make_shared<rmw_fastrtps_shared_cpp::IntraParticipantDelivery>();
+    } catch (std::bad_alloc &) {
+      RMW_SET_ERROR_MSG("__create_participant failed to allocate intra participant delivery");
+      return nullptr;
+    }
+  }
 
   /////
   // Create Publisher
@@ -220,6 +239,51 @@ rmw_fastrtps_shared_cpp::create_participant(
       }
     }
   }
+  bool serialize_once = false;
+  error_str = rcutils_get_env("RMW_FASTRTPS_SERIALIZE_ONCE", &env_value);
+  if (error_str != NULL) {
+    RMW_SET_ERROR_MSG_WITH_FORMAT_STRING("Error getting env var: %s\n", error_str);
+    return nullptr;
+  }
+  if (env_value != nullptr) {
+    serialize_once = strcmp(env_value, "1") == 0;
+  }
+  bool publisher_payload_pool = false;
+  error_str = rcutils_get_env("RMW_FASTRTPS_PUBLISHER_PAYLOAD_POOL", &env_value);
+  if (error_str != NULL) {
+    RMW_SET_ERROR_MSG_WITH_FORMAT_STRING("Error getting env var: %s\n", error_str);
+    return nullptr;
+  }
+  if (env_value != nullptr) {
+    publisher_payload_pool = strcmp(env_value, "1") == 0;
+  }
+  bool serialized_loans = false;
+  error_str = rcutils_get_env("RMW_FASTRTPS_SERIALIZED_LOANS", &env_value);
+  if (error_str != NULL) {
+    RMW_SET_ERROR_MSG_WITH_FORMAT_STRING("Error getting env var: %s\n", error_str);
+    return nullptr;
+  }
+  if (env_value != nullptr) {
+    serialized_loans = strcmp(env_value, "1") == 0;
+  }
+  bool intra_participant_delivery = false;
+  error_str = rcutils_get_env("RMW_FASTRTPS_INTRA_PARTICIPANT_DELIVERY", &env_value);
+  if (error_str != NULL) {
+    RMW_SET_ERROR_MSG_WITH_FORMAT_STRING("Error getting env var: %s\n", error_str);
+    return nullptr;
+  }
+  if (env_value != nullptr) {
+    intra_participant_delivery = strcmp(env_value, "1") == 0;
+  }
+  bool publisher_timing = false;
+  error_str = rcutils_get_env("RMW_FASTRTPS_PUBLISHER_TIMING", &env_value);
+  if (error_str != NULL) {
+    RMW_SET_ERROR_MSG_WITH_FORMAT_STRING("Error getting env var: %s\n", error_str);
+    return nullptr;
+  }
+  if (env_value != nullptr) {
+    publisher_timing = strcmp(env_value, "1") == 0;
+  }
   // allow reallocation to support discovery messages bigger than 5000 bytes
   if (!leave_middleware_default_qos) {
     domainParticipantQos.wire_protocol().builtin.readerHistoryMemoryPolicy =
@@ -285,6 +349,11 @@ rmw_fastrtps_shared_cpp::create_participant(
     domainParticipantQos,
     leave_middleware_default_qos,
     publishing_mode,
+    serialize_once,
+    publisher_payload_pool,
+    serialized_loans,
+    intra_participant_delivery,
+    publisher_timing,
     common_context,
     domain_id);
 }
@@ -0,0 +1,220 @@
+// Copyright 2021 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+
+#include "rcutils/logging_macros.h"
+
+#include "rmw/error_handling.h"
+#include "rmw/impl/cpp/macros.hpp"
+#include "rmw/rmw.h"
+
+#include "rmw_fastrtps_shared_cpp/custom_publisher_info.hpp"
+#include "rmw_fastrtps_shared_cpp/payload_pool.hpp"
+
+using eprosima::fastrtps::rtps::CacheChange_t;
+using eprosima::fastrtps::rtps::IPayloadPool;
+using eprosima::fastrtps::rtps::SerializedPayload_t;
+using eprosima::fastrtps::rtps::octet;
+
+// HAVE_DATAWRITER_PAYLOAD_POOL is defined by CMake, from the version of Fast DDS
+
+namespace rmw_fastrtps_shared_cpp
+{
+
+SizeClassedPayloadPool::SizeClassedPayloadPool(size_t max_free_per_class)
+: max_free_per_class_(max_free_per_class)
+{
+}
+
+SizeClassedPayloadPool::~SizeClassedPayloadPool()
+{
+  for (auto & free_payloads : free_payloads_) {
+    for (octet * payload : free_payloads) {
+      std::free(payload);
+    }
+  }
+}
+
+uint32_t
+SizeClassedPayloadPool::class_size(uint32_t size)
+{
+  return static_cast<uint32_t>(1u) << (class_index(size) + min_class_log2);
+}
+
+size_t
+SizeClassedPayloadPool::class_index(uint32_t size)
+{
+  size_t index = 0u;
+  while (index < class_count - 1 &&
+    (static_cast<uint32_t>(1u) << (index + min_class_log2)) < size)
+  {
+    ++index;
+  }
+  return index;
+}
+
+bool
+SizeClassedPayloadPool::get_payload(uint32_t size, CacheChange_t & cache_change)
+{
+  const uint32_t payload_size = class_size(size);
+  if (payload_size < size) {
+    return false;
+  }
+  octet * payload = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto & free_payloads = free_payloads_[class_index(size)];
+    if (!free_payloads.empty()) {
+      payload = free_payloads.back();
+      free_payloads.pop_back();
+      ++statistics_.hits;
+    } else {
+      ++statistics_.misses;
+    }
+  }
+  if (nullptr == payload) {
+    payload = static_cast<octet *>(std::malloc(payload_size));
+    if (nullptr == payload) {
+      return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    statistics_.allocated_bytes += payload_size;
+  }
+
+  cache_change.serializedPayload.data = payload;
+  cache_change.serializedPayload.max_size = payload_size;
+  cache_change.serializedPayload.length = 0u;
+  cache_change.serializedPayload.pos = 0u;
+  cache_change.payload_owner(this);
+  return true;
+}
+
+bool
+SizeClassedPayloadPool::get_payload(
+  SerializedPayload_t & data,
+  IPayloadPool * & /* data_owner */,
+  CacheChange_t & cache_change)
+{
+  // Payloads are not reference counted, so the data is always copied
+  if (!get_payload(data.length, cache_change)) {
+    return false;
+  }
+  cache_change.serializedPayload.encapsulation = data.encapsulation;
+  cache_change.serializedPayload.length = data.length;
+  if (0u != data.length) {
+    std::memcpy(cache_change.serializedPayload.data, data.data, data.length);
+  }
+  return true;
+}
+
+bool
+SizeClassedPayloadPool::release_payload(CacheChange_t & cache_change)
+{
+  if (this != cache_change.payload_owner()) {
+    return false;
+  }
+  octet * payload = cache_change.serializedPayload.data;
+  const uint32_t payload_size = cache_change.serializedPayload.max_size;
+  cache_change.serializedPayload.data = nullptr;
+  cache_change.serializedPayload.max_size = 0u;
+  cache_change.serializedPayload.length = 0u;
+  cache_change.serializedPayload.pos = 0u;
+  cache_change.payload_owner(nullptr);
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto & free_payloads = free_payloads_[class_index(payload_size)];
+    if (0u == max_free_per_class_ || free_payloads.size() < max_free_per_class_) {
+      free_payloads.push_back(payload);
+      return true;
+    }
+    statistics_.allocated_bytes -= payload_size;
+  }
+  std::free(payload);
+  return true;
+}
+
+PayloadPoolStatistics
+SizeClassedPayloadPool::get_statistics() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return statistics_;
+}
+
+std::shared_ptr<SizeClassedPayloadPool>
+create_payload_pool(const eprosima::fastdds::dds::DataWriterQos & qos)
+{
+#if HAVE_DATAWRITER_PAYLOAD_POOL
+  size_t max_free_per_class = 0u;
+  if (eprosima::fastdds::dds::KEEP_LAST_HISTORY_QOS == qos.history().kind) {
+    max_free_per_class = static_cast<size_t>(qos.history().depth);
+  } else if (qos.resource_limits().max_samples > 0) {
+    max_free_per_class = static_cast<size_t>(qos.resource_limits().max_samples);
+  }
+  return std::make_shared<SizeClassedPayloadPool>(max_free_per_class);
+#else
+  (void) qos;
+  RCUTILS_LOG_WARN_ONCE_NAMED(
+    "rmw_fastrtps_shared_cpp",
+    "RMW_FASTRTPS_PUBLISHER_PAYLOAD_POOL needs Fast DDS 2.5 or newer, and is ignored");
+  return nullptr;
+#endif
+}
+
+eprosima::fastdds::dds::DataWriter *
+create_datawriter(
+  eprosima::fastdds::dds::Publisher * publisher,
+  eprosima::fastdds::dds::Topic * topic,
+  const eprosima::fastdds::dds::DataWriterQos & qos,
+  eprosima::fastdds::dds::DataWriterListener * listener,
+  const std::shared_ptr<SizeClassedPayloadPool> & payload_pool)
+{
+#if HAVE_DATAWRITER_PAYLOAD_POOL
+  if (payload_pool) {
+    return publisher->create_datawriter(
+      topic, qos, listener, eprosima::fastdds::dds::StatusMask::all(), payload_pool);
+  }
+#else
+  (void) payload_pool;
+#endif
+  return publisher->create_datawriter(topic, qos, listener);
+}
+
+rmw_ret_t
+get_publisher_payload_pool_statistics(
+  const char * identifier,
+  const rmw_publisher_t * publisher,
+  PayloadPoolStatistics * statistics)
+{
+  RMW_CHECK_ARGUMENT_FOR_NULL(publisher, RMW_RET_INVALID_ARGUMENT);
+  RMW_CHECK_TYPE_IDENTIFIERS_MATCH(
+    publisher handle,
+    publisher->implementation_identifier, identifier,
+    return RMW_RET_INCORRECT_RMW_IMPLEMENTATION)
+  RMW_CHECK_ARGUMENT_FOR_NULL(statistics, RMW_RET_INVALID_ARGUMENT);
+
+  auto info = static_cast<const CustomPublisherInfo *>(publisher->data);
+  if (!info->payload_pool_) {
+    RMW_SET_ERROR_MSG("publisher does not use a payload pool");
+    return RMW_RET_UNSUPPORTED;
+  }
+  *statistics = info->payload_pool_->get_statistics();
+  return RMW_RET_OK;
+}
+
+}  // namespace rmw_fastrtps_shared_cpp
@@ -18,10 +18,14 @@
 
 #include "rmw_fastrtps_shared_cpp/custom_participant_info.hpp"
 #include "rmw_fastrtps_shared_cpp/custom_publisher_info.hpp"
+#include "rmw_fastrtps_shared_cpp/intra_participant_delivery.hpp"
 #include "rmw_fastrtps_shared_cpp/publisher.hpp"
+#include "rmw_fastrtps_shared_cpp/publisher_coalescing.hpp"
 #include "rmw_fastrtps_shared_cpp/TypeSupport.hpp"
 #include "rmw_fastrtps_shared_cpp/utils.hpp"
 
+#include "types/custom_wait_set_info.hpp"
+
 namespace rmw_fastrtps_shared_cpp
 {
 rmw_ret_t
@@ -31,7 +35,6 @@ destroy_publisher(
   rmw_publisher_t * publisher)
 {
   assert(publisher->implementation_identifier == identifier);
-  static_cast<void>(identifier);
 
   {
     std::lock_guard<std::mutex> lck(participant_info->entity_creation_mutex_);
@@ -39,6 +42,18 @@ destroy_publisher(
     // Get RMW Publisher
     auto info = static_cast<CustomPublisherInfo *>(publisher->data);
 
+    // Publish the held back messages while the DataWriter exists. The publisher is left
+    // valid, without coalescing, if that fails.
+    rmw_ret_t flush_ret = set_publisher_coalescing(identifier, publisher, {0, 0}, 0u);
+    if (RMW_RET_OK != flush_ret) {
+      return flush_ret;
+    }
+
+    // Stop delivering messages to the subscriptions of the same participant
+    if (info->local_delivery_) {
+      info->local_delivery_->remove_publisher(info);
+    }
+
     // Keep pointer to topic, so we can remove it later
     auto topic = info->data_writer_->get_topic();
 
@@ -52,6 +67,7 @@ destroy_publisher(
     }
 
     // Delete DataWriter listener
+    internal::detach_listener_from_wait_sets(info->listener_);
     delete info->listener_;
 
     // Delete topic and unregister type
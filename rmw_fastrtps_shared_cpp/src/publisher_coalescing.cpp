@@ -0,0 +1,462 @@
+// Copyright 2021 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "fastcdr/Cdr.h"
+#include "fastcdr/FastBuffer.h"
+#include "fastcdr/exceptions/Exception.h"
+
+#include "fastdds/dds/core/policy/QosPolicies.hpp"
+#include "fastdds/dds/publisher/DataWriter.hpp"
+#include "fastdds/dds/publisher/qos/DataWriterQos.hpp"
+
+#include "rcpputils/thread_safety_annotations.hpp"
+
+#include "rcutils/logging_macros.h"
+
+#include "rmw/error_handling.h"
+#include "rmw/impl/cpp/macros.hpp"
+#include "rmw/rmw.h"
+#include "rmw/time.h"
+
+#include "rmw_fastrtps_shared_cpp/custom_publisher_info.hpp"
+#include "rmw_fastrtps_shared_cpp/publisher_coalescing.hpp"
+#include "rmw_fastrtps_shared_cpp/TypeSupport.hpp"
+
+namespace
+{
+
+using rmw_fastrtps_shared_cpp::PublisherCoalescing;
+
+/// Write the messages held back by publishers once they are due, in a single thread.
+/**
+ * The thread is started along with the first coalescing publisher, and joined along with
+ * the last one.
+ */
+class CoalescingFlusher
+{
+public:
+  static CoalescingFlusher &
+  get_instance()
+  {
+    // Never destroyed, so that exiting without destroying publishers doesn't destroy
+    // a joinable thread.
+    static CoalescingFlusher * instance = new CoalescingFlusher();
+    return *instance;
+  }
+
+  rmw_ret_t
+  add_publisher();
+
+  rmw_ret_t
+  remove_publisher();
+
+  /// Write the messages of a publisher once a deadline is reached.
+  void
+  schedule(
+    const std::shared_ptr<PublisherCoalescing> & coalescing,
+    std::chrono::steady_clock::time_point deadline);
+
+private:
+  CoalescingFlusher() = default;
+
+  void
+  run();
+
+  // Serializes adding and removing publishers, held while starting or joining the thread
+  std::mutex lifecycle_mutex_;
+  std::thread thread_;
+  size_t publisher_count_ RCPPUTILS_TSA_GUARDED_BY(lifecycle_mutex_) = 0u;
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::multimap<std::chrono::steady_clock::time_point, std::weak_ptr<PublisherCoalescing>>
+  deadlines_ RCPPUTILS_TSA_GUARDED_BY(mutex_);
+  bool is_running_ RCPPUTILS_TSA_GUARDED_BY(mutex_) = false;
+
+  // Only used by the thread
+  std::vector<std::weak_ptr<PublisherCoalescing>> due_;
+};
+
+rmw_ret_t
+CoalescingFlusher::add_publisher()
+{
+  std::lock_guard<std::mutex> lifecycle_guard(lifecycle_mutex_);
+  if (0u == publisher_count_) {
+    {
+      std::lock_guard<std::mutex> guard(mutex_);
+      is_running_ = true;
+    }
+    try {
+      thread_ = std::thread(&CoalescingFlusher::run, this);
+    } catch (const std::exception & exc) {
+      RMW_SET_ERROR_MSG_WITH_FORMAT_STRING("Failed to create std::thread: %s", exc.what());
+      std::lock_guard<std::mutex> guard(mutex_);
+      is_running_ = false;
+      return RMW_RET_ERROR;
+    }
+  }
+  ++publisher_count_;
+  return RMW_RET_OK;
+}
+
+rmw_ret_t
+CoalescingFlusher::remove_publisher()
+{
+  std::lock_guard<std::mutex> lifecycle_guard(lifecycle_mutex_);
+  if (0u != --publisher_count_) {
+    return RMW_RET_OK;
+  }
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    is_running_ = false;
+    deadlines_.clear();
+  }
+  cv_.notify_one();
+  try {
+    thread_.join();
+  } catch (const std::exception & exc) {
+    RMW_SET_ERROR_MSG_WITH_FORMAT_STRING("Failed to join std::thread: %s", exc.what());
+    return RMW_RET_ERROR;
+  }
+  return RMW_RET_OK;
+}
+
+void
+CoalescingFlusher::schedule(
+  const std::shared_ptr<PublisherCoalescing> & coalescing,
+  std::chrono::steady_clock::time_point deadline)
+{
+  bool is_earliest;
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    auto it = deadlines_.emplace(deadline, coalescing);
+    is_earliest = it == deadlines_.begin();
+  }
+  if (is_earliest) {
+    cv_.notify_one();
+  }
+}
+
+void
+CoalescingFlusher::run()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (is_running_) {
+    if (deadlines_.empty()) {
+      cv_.wait(lock);
+      continue;
+    }
+    auto now = std::chrono::steady_clock::now();
+    if (now < deadlines_.begin()->first) {
+      cv_.wait_until(lock, deadlines_.begin()->first);
+      continue;
+    }
+    while (!deadlines_.empty() && deadlines_.begin()->first <= now) {
+      due_.push_back(std::move(deadlines_.begin()->second));
+      deadlines_.erase(deadlines_.begin());
+    }
+
+    // Publications schedule their deadline with the publisher mutex locked
+    lock.unlock();
+    for (const auto & weak_coalescing : due_) {
+      auto coalescing = weak_coalescing.lock();
+      if (coalescing && !coalescing->flush_if_due(now)) {
+        RCUTILS_LOG_ERROR_NAMED(
+          "rmw_fastrtps_shared_cpp",
+          "failed to write the messages held back by a publisher");
+      }
+    }
+    due_.clear();
+    lock.lock();
+  }
+}
+
+}  // namespace
+
+namespace rmw_fastrtps_shared_cpp
+{
+
+PublisherCoalescing::PublisherCoalescing(
+  eprosima::fastdds::dds::DataWriter * data_writer,
+  const TypeSupport * type_support,
+  const void * type_support_impl,
+  PublisherCounters * counters)
+: type_support_(type_support),
+  type_support_impl_(type_support_impl),
+  counters_(counters),
+  data_writer_(data_writer)
+{
+}
+
+rmw_ret_t
+PublisherCoalescing::set_bounds(std::chrono::nanoseconds max_delay, size_t max_bytes)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  max_delay_ = max_delay;
+  max_bytes_ = max_bytes;
+  if (nullptr != data_writer_ && !write_held_back()) {
+    RMW_SET_ERROR_MSG("cannot publish held back messages");
+    return RMW_RET_ERROR;
+  }
+  return RMW_RET_OK;
+}
+
+rmw_ret_t
+PublisherCoalescing::add_ros_message(const void * ros_message, uint64_t local_publication_number)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (nullptr == data_writer_) {
+    RMW_SET_ERROR_MSG("publisher coalescing is closed");
+    return RMW_RET_ERROR;
+  }
+
+  // Serialized right after the held back messages, into the space it may take at most
+  size_t offset = buffer_.size();
+  size_t max_length = type_support_->getEstimatedSerializedSize(
+    ros_message, type_support_impl_);
+  try {
+    buffer_.resize(offset + max_length);
+  } catch (const std::bad_alloc &) {
+    RMW_SET_ERROR_MSG("cannot allocate memory to hold back message");
+    return RMW_RET_BAD_ALLOC;
+  }
+  eprosima::fastcdr::FastBuffer fastbuffer(&buffer_[offset], max_length);
+  eprosima::fastcdr::Cdr ser(
+    fastbuffer, eprosima::fastcdr::Cdr::DEFAULT_ENDIAN, eprosima::fastcdr::Cdr::DDS_CDR);
+  std::chrono::steady_clock::time_point start;
+  if (counters_->timing_enabled()) {
+    start = std::chrono::steady_clock::now();
+  }
+  bool serialized = false;
+  try {
+    serialized = type_support_->serializeROSmessage(ros_message, ser, type_support_impl_);
+  } catch (const eprosima::fastcdr::exception::Exception &) {
+    serialized = false;
+  } catch (const std::exception &) {
+    // e.g. a bound of the message is exceeded
+    serialized = false;
+  }
+  if (counters_->timing_enabled()) {
+    counters_->add_serialize_time(std::chrono::steady_clock::now() - start);
+  }
+  if (!serialized) {
+    buffer_.resize(offset);
+    RMW_SET_ERROR_MSG("cannot serialize message");
+    return RMW_RET_ERROR;
+  }
+  size_t length = ser.getSerializedDataLength();
+  buffer_.resize(offset + length);
+  return hold_back(offset, length, local_publication_number);
+}
+
+rmw_ret_t
+PublisherCoalescing::add_serialized_message(
+  const rmw_serialized_message_t * serialized_message, uint64_t local_publication_number)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (nullptr == data_writer_) {
+    RMW_SET_ERROR_MSG("publisher coalescing is closed");
+    return RMW_RET_ERROR;
+  }
+
+  size_t offset = buffer_.size();
+  auto data = reinterpret_cast<const char *>(serialized_message->buffer);
+  try {
+    buffer_.insert(buffer_.end(), data, data + serialized_message->buffer_length);
+  } catch (const std::bad_alloc &) {
+    RMW_SET_ERROR_MSG("cannot allocate memory to hold back message");
+    return RMW_RET_BAD_ALLOC;
+  }
+  return hold_back(offset, serialized_message->buffer_length, local_publication_number);
+}
+
+rmw_ret_t
+PublisherCoalescing::flush()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (nullptr != data_writer_ && !write_held_back()) {
+    RMW_SET_ERROR_MSG("cannot publish held back messages");
+    return RMW_RET_ERROR;
+  }
+  return RMW_RET_OK;
+}
+
+bool
+PublisherCoalescing::flush_if_due(std::chrono::steady_clock::time_point now)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  // The messages the deadline was scheduled for may have been written already
+  if (nullptr == data_writer_ || 0 == max_delay_.count() || now < deadline_) {
+    return true;
+  }
+  return write_held_back();
+}
+
+rmw_ret_t
+PublisherCoalescing::close()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (nullptr == data_writer_) {
+    return RMW_RET_OK;
+  }
+  bool written = write_held_back();
+  data_writer_ = nullptr;
+  if (!written) {
+    RMW_SET_ERROR_MSG("cannot publish held back messages");
+    return RMW_RET_ERROR;
+  }
+  return RMW_RET_OK;
+}
+
+rmw_ret_t
+PublisherCoalescing::hold_back(
+  size_t offset, size_t length, uint64_t local_publication_number)
+{
+  try {
+    messages_.push_back({offset, length, local_publication_number});
+  } catch (const std::bad_alloc &) {
+    buffer_.resize(offset);
+    RMW_SET_ERROR_MSG("cannot allocate memory to hold back message");
+    return RMW_RET_BAD_ALLOC;
+  }
+
+  bool write = 0u != max_bytes_ && buffer_.size() >= max_bytes_;
+  if (!write && 1u == messages_.size() && 0 != max_delay_.count()) {
+    deadline_ = std::chrono::steady_clock::now() + max_delay_;
+    try {
+      CoalescingFlusher::get_instance().schedule(shared_from_this(), deadline_);
+    } catch (const std::bad_alloc &) {
+      // Not held back, as nothing would write it in time
+      write = true;
+    }
+  }
+  if (write && !write_held_back()) {
+    RMW_SET_ERROR_MSG("cannot publish held back messages");
+    return RMW_RET_ERROR;
+  }
+  return RMW_RET_OK;
+}
+
+bool
+PublisherCoalescing::write_held_back()
+{
+  size_t written = 0u;
+  for (const HeldBackMessage & message : messages_) {
+    SerializedData data;
+    data.is_cdr_buffer = false;
+    data.data = nullptr;
+    data.impl = nullptr;    // not used when cdr_data is set
+    data.cdr_data = buffer_.data() + message.offset;
+    data.cdr_length = message.length;
+    data.local_publication_number = message.local_publication_number;
+    if (!counters_->write(data_writer_, data)) {
+      break;
+    }
+    ++written;
+  }
+  // Counted as published once held back
+  size_t dropped = messages_.size() - written;
+  if (0u != dropped) {
+    counters_->add_failed_messages(dropped);
+  }
+  // Capacities are kept for the next burst
+  buffer_.clear();
+  messages_.clear();
+  return 0u == dropped;
+}
+
+rmw_ret_t
+set_publisher_coalescing(
+  const char * identifier,
+  const rmw_publisher_t * publisher,
+  rmw_time_t max_delay,
+  size_t max_bytes)
+{
+  RMW_CHECK_ARGUMENT_FOR_NULL(publisher, RMW_RET_INVALID_ARGUMENT);
+  RMW_CHECK_TYPE_IDENTIFIERS_MATCH(
+    publisher, publisher->implementation_identifier, identifier,
+    return RMW_RET_INCORRECT_RMW_IMPLEMENTATION);
+
+  auto info = static_cast<CustomPublisherInfo *>(publisher->data);
+  std::chrono::nanoseconds delay{0};
+  if (!rmw_time_equal(max_delay, RMW_DURATION_INFINITE)) {
+    delay = std::chrono::seconds(max_delay.sec) + std::chrono::nanoseconds(max_delay.nsec);
+  }
+
+  if (0 == delay.count() && 0u == max_bytes) {
+    if (!info->coalescing_) {
+      return RMW_RET_OK;
+    }
+    rmw_ret_t ret = info->coalescing_->close();
+    info->coalescing_.reset();
+    rmw_ret_t remove_ret = CoalescingFlusher::get_instance().remove_publisher();
+    return RMW_RET_OK != ret ? ret : remove_ret;
+  }
+
+  if (!info->coalescing_) {
+    // Written messages are sent right away in the synchronous mode
+    if (eprosima::fastdds::dds::ASYNCHRONOUS_PUBLISH_MODE !=
+      info->data_writer_->get_qos().publish_mode().kind)
+    {
+      RMW_SET_ERROR_MSG("coalescing publications needs the asynchronous publication mode");
+      return RMW_RET_UNSUPPORTED;
+    }
+    std::shared_ptr<PublisherCoalescing> coalescing;
+    try {
+      coalescing = std::make_shared<PublisherCoalescing>(
+        info->data_writer_,
+        static_cast<const TypeSupport *>(info->type_support_.get()),
+        info->type_support_impl_,
+        &info->statistics_);
+    } catch (const std::bad_alloc &) {
+      RMW_SET_ERROR_MSG("cannot allocate publisher coalescing");
+      return RMW_RET_BAD_ALLOC;
+    }
+    rmw_ret_t ret = CoalescingFlusher::get_instance().add_publisher();
+    if (RMW_RET_OK != ret) {
+      return ret;
+    }
+    info->coalescing_ = std::move(coalescing);
+  }
+  return info->coalescing_->set_bounds(delay, max_bytes);
+}
+
+rmw_ret_t
+flush_publisher(const char * identifier, const rmw_publisher_t * publisher)
+{
+  RMW_CHECK_ARGUMENT_FOR_NULL(publisher, RMW_RET_INVALID_ARGUMENT);
+  RMW_CHECK_TYPE_IDENTIFIERS_MATCH(
+    publisher, publisher->implementation_identifier, identifier,
+    return RMW_RET_INCORRECT_RMW_IMPLEMENTATION);
+
+  auto info = static_cast<CustomPublisherInfo *>(publisher->data);
+  if (!info->coalescing_) {
+    return RMW_RET_OK;
+  }
+  return info->coalescing_->flush();
+}
+
+}  // namespace rmw_fastrtps_shared_cpp
@@ -0,0 +1,134 @@
+// Copyright 2021 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "fastdds/dds/publisher/DataWriter.hpp"
+#include "fastdds/rtps/common/WriteParams.h"
+
+#include "rmw/error_handling.h"
+#include "rmw/impl/cpp/macros.hpp"
+#include "rmw/rmw.h"
+
+#include "rmw_fastrtps_shared_cpp/custom_publisher_info.hpp"
+#include "rmw_fastrtps_shared_cpp/intra_participant_delivery.hpp"
+#include "rmw_fastrtps_shared_cpp/publisher_statistics.hpp"
+#include "rmw_fastrtps_shared_cpp/TypeSupport.hpp"
+
+namespace rmw_fastrtps_shared_cpp
+{
+
+// Write serialized data, tagged with the number of its publication if it has one
+static
+bool
+write_data(eprosima::fastdds::dds::DataWriter * data_writer, SerializedData & data)
+{
+  if (0u == data.local_publication_number) {
+    return data_writer->write(&data);
+  }
+  eprosima::fastrtps::rtps::WriteParams params;
+  set_local_publication_number(params, data_writer->guid(), data.local_publication_number);
+  return data_writer->write(&data, params);
+}
+
+bool
+PublisherCounters::write(eprosima::fastdds::dds::DataWriter * data_writer, SerializedData & data)
+{
+  bool written;
+  if (!timing_) {
+    written = write_data(data_writer, data);
+  } else {
+    // The message is serialized from within DataWriter::write()
+    data.measure_serialize_time = true;
+    auto start = std::chrono::steady_clock::now();
+    written = write_data(data_writer, data);
+    std::chrono::nanoseconds write_time = std::chrono::steady_clock::now() - start;
+    add_serialize_time(data.serialize_time);
+    add_write_time(write_time - data.serialize_time);
+  }
+  if (written) {
+    add_written_bytes(data.serialized_length);
+  }
+  return written;
+}
+
+bool
+PublisherCounters::write_sample(
+  eprosima::fastdds::dds::DataWriter * data_writer, void * sample, size_t size)
+{
+  bool written;
+  if (!timing_) {
+    written = data_writer->write(sample);
+  } else {
+    auto start = std::chrono::steady_clock::now();
+    written = data_writer->write(sample);
+    add_write_time(std::chrono::steady_clock::now() - start);
+  }
+  if (written) {
+    add_written_bytes(size);
+  }
+  return written;
+}
+
+void
+PublisherCounters::get(PublisherStatistics & statistics) const
+{
+  statistics.published_messages = published_messages_.load(std::memory_order_relaxed);
+  statistics.failed_messages = failed_messages_.load(std::memory_order_relaxed);
+  statistics.written_bytes = written_bytes_.load(std::memory_order_relaxed);
+  statistics.serialize_time_ns = serialize_time_ns_.load(std::memory_order_relaxed);
+  statistics.write_time_ns = write_time_ns_.load(std::memory_order_relaxed);
+  for (size_t i = 0u; i < kPublisherHistogramSize; ++i) {
+    statistics.serialize_time_histogram[i] =
+      serialize_time_histogram_[i].load(std::memory_order_relaxed);
+    statistics.write_time_histogram[i] = write_time_histogram_[i].load(std::memory_order_relaxed);
+  }
+}
+
+void
+PublisherCounters::add_time(
+  std::chrono::nanoseconds time,
+  std::atomic<uint64_t> & total,
+  std::atomic<uint64_t> (& histogram)[kPublisherHistogramSize])
+{
+  uint64_t ns = time.count() > 0 ? static_cast<uint64_t>(time.count()) : 0u;
+  total.fetch_add(ns, std::memory_order_relaxed);
+  // Index of the highest bit set
+  size_t bucket = 0u;
+  while (bucket + 1u < kPublisherHistogramSize && (ns >> (bucket + 1u)) != 0u) {
+    ++bucket;
+  }
+  histogram[bucket].fetch_add(1u, std::memory_order_relaxed);
+}
+
+rmw_ret_t
+get_publisher_statistics(
+  const char * identifier,
+  const rmw_publisher_t * publisher,
+  PublisherStatistics * statistics)
+{
+  RMW_CHECK_ARGUMENT_FOR_NULL(publisher, RMW_RET_INVALID_ARGUMENT);
+  RMW_CHECK_TYPE_IDENTIFIERS_MATCH(
+    publisher, publisher->implementation_identifier, identifier,
+    return RMW_RET_INCORRECT_RMW_IMPLEMENTATION);
+  RMW_CHECK_ARGUMENT_FOR_NULL(statistics, RMW_RET_INVALID_ARGUMENT);
+
+  auto info = static_cast<const CustomPublisherInfo *>(publisher->data);
+  info->statistics_.get(*statistics);
+  return RMW_RET_OK;
+}
+
+}  // namespace rmw_fastrtps_shared_cpp
@@ -12,6 +12,7 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <mutex>
 #include <string>
 
 #include "rcutils/logging_macros.h"
@@ -25,11 +26,14 @@
 #include "rmw_fastrtps_shared_cpp/custom_participant_info.hpp"
 #include "rmw_fastrtps_shared_cpp/namespace_prefix.hpp"
 #include "rmw_fastrtps_shared_cpp/qos.hpp"
+#include "rmw_fastrtps_shared_cpp/discovery_batch.hpp"
 #include "rmw_fastrtps_shared_cpp/rmw_common.hpp"
 #include "rmw_fastrtps_shared_cpp/rmw_context_impl.hpp"
 #include "rmw_fastrtps_shared_cpp/TypeSupport.hpp"
 #include "rmw_fastrtps_shared_cpp/utils.hpp"
 
+#include "types/custom_wait_set_info.hpp"
+
 namespace rmw_fastrtps_shared_cpp
 {
 rmw_ret_t
@@ -59,11 +63,10 @@ __rmw_destroy_client(
     rmw_dds_common::msg::ParticipantEntitiesInfo msg =
       common_context->graph_cache.dissociate_reader(
       gid, common_context->gid, node->name, node->namespace_);
-    final_ret = rmw_fastrtps_shared_cpp::__rmw_publish(
+    final_ret = rmw_fastrtps_shared_cpp::publish_participant_entities_info(
       identifier,
-      common_context->pub,
-      static_cast<void *>(&msg),
-      nullptr);
+      node->context,
+      msg);
   }
 
   auto show_previous_error =
@@ -75,6 +78,17 @@ __rmw_destroy_client(
       }
     };
 
+  {
+    // Stop watching the endpoints of the service
+    std::lock_guard<std::mutex> lock(info->graph_watcher_mutex_);
+    if (nullptr != info->graph_change_notifier_) {
+      info->graph_change_notifier_->remove_topic_watcher(
+        info->request_topic_, &info->graph_watcher_);
+      info->graph_change_notifier_->remove_topic_watcher(
+        info->response_topic_, &info->graph_watcher_);
+    }
+  }
+
   /////
   // Delete DataWriter and DataReader
   {
@@ -95,6 +109,7 @@ __rmw_destroy_client(
 
     // Delete DataReader listener
     if (nullptr != info->listener_) {
+      internal::detach_listener_from_wait_sets(info->listener_);
       delete info->listener_;
     }
 
@@ -112,6 +127,18 @@ __rmw_destroy_client(
       delete info->pub_listener_;
     }
 
+    // Delete graph guard condition, now that nothing can trigger it
+    {
+      std::lock_guard<std::mutex> lock(info->graph_watcher_mutex_);
+      if (nullptr != info->graph_guard_condition_ &&
+        RMW_RET_OK != __rmw_destroy_guard_condition(info->graph_guard_condition_))
+      {
+        show_previous_error();
+        RMW_SET_ERROR_MSG("destroy_client() failed to delete graph guard condition");
+        final_ret = RMW_RET_ERROR;
+      }
+    }
+
     // Delete topics and unregister types
     remove_topic_and_type(participant_info, request_topic, info->request_type_support_);
     remove_topic_and_type(participant_info, response_topic, info->response_type_support_);
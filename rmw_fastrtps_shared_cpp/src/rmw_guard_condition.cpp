@@ -17,6 +17,7 @@
 
 #include "rmw_fastrtps_shared_cpp/rmw_common.hpp"
 
+#include "types/custom_wait_set_info.hpp"
 #include "types/guard_condition.hpp"
 
 namespace rmw_fastrtps_shared_cpp
@@ -38,7 +39,9 @@ __rmw_destroy_guard_condition(rmw_guard_condition_t * guard_condition)
   rmw_ret_t ret = RMW_RET_ERROR;
 
   if (guard_condition) {
-    delete static_cast<GuardCondition *>(guard_condition->data);
+    auto guard_condition_impl = static_cast<GuardCondition *>(guard_condition->data);
+    internal::detach_listener_from_wait_sets(guard_condition_impl);
+    delete guard_condition_impl;
     delete guard_condition;
     ret = RMW_RET_OK;
   }
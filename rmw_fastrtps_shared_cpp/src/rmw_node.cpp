@@ -33,6 +33,7 @@
 #include "rmw_dds_common/context.hpp"
 
 #include "rmw_fastrtps_shared_cpp/custom_participant_info.hpp"
+#include "rmw_fastrtps_shared_cpp/discovery_batch.hpp"
 #include "rmw_fastrtps_shared_cpp/rmw_common.hpp"
 #include "rmw_fastrtps_shared_cpp/rmw_context_impl.hpp"
 
@@ -112,11 +113,10 @@ __rmw_create_node(
     std::lock_guard<std::mutex> guard(common_context->node_update_mutex);
     rmw_dds_common::msg::ParticipantEntitiesInfo participant_msg =
       graph_cache.add_node(common_context->gid, name, namespace_);
-    if (RMW_RET_OK != __rmw_publish(
+    if (RMW_RET_OK != publish_participant_entities_info(
         node_handle->implementation_identifier,
-        common_context->pub,
-        static_cast<void *>(&participant_msg),
-        nullptr))
+        context,
+        participant_msg))
     {
       return nullptr;
     }
@@ -138,11 +138,10 @@ __rmw_destroy_node(
     std::lock_guard<std::mutex> guard(common_context->node_update_mutex);
     rmw_dds_common::msg::ParticipantEntitiesInfo participant_msg =
       graph_cache.remove_node(common_context->gid, node->name, node->namespace_);
-    ret = __rmw_publish(
+    ret = publish_participant_entities_info(
       identifier,
-      common_context->pub,
-      static_cast<void *>(&participant_msg),
-      nullptr);
+      context,
+      participant_msg);
   }
   rmw_free(const_cast<char *>(node->name));
   rmw_free(const_cast<char *>(node->namespace_));
@@ -12,8 +12,17 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <new>
+
 #include "fastcdr/Cdr.h"
 #include "fastcdr/FastBuffer.h"
+#include "fastcdr/exceptions/Exception.h"
+
+#include "rcutils/time.h"
 
 #include "rmw/allocators.h"
 #include "rmw/error_handling.h"
@@ -22,10 +31,245 @@
 
 #include "rmw_fastrtps_shared_cpp/rmw_common.hpp"
 #include "rmw_fastrtps_shared_cpp/custom_publisher_info.hpp"
+#include "rmw_fastrtps_shared_cpp/intra_participant_delivery.hpp"
+#include "rmw_fastrtps_shared_cpp/publisher_coalescing.hpp"
+#include "rmw_fastrtps_shared_cpp/publisher_statistics.hpp"
 #include "rmw_fastrtps_shared_cpp/TypeSupport.hpp"
 
 namespace rmw_fastrtps_shared_cpp
 {
+// Must be called with the scratch buffer mutex locked, if the publisher serializes once
+static
+bool
+write_ros_message(
+  CustomPublisherInfo * info, const void * ros_message, uint64_t local_publication_number)
+{
+  rmw_fastrtps_shared_cpp::SerializedData data;
+  data.is_cdr_buffer = false;
+  data.data = const_cast<void *>(ros_message);
+  data.impl = info->type_support_impl_;
+  data.local_publication_number = local_publication_number;
+  if (info->serialize_once_) {
+    data.scratch_buffer = &info->scratch_buffer_;
+  }
+  return info->statistics_.write(info->data_writer_, data);
+}
+
+// Create the message of a sample delivered to the subscriptions of the same participant
+static
+rmw_ret_t
+create_local_sample(CustomPublisherInfo * info, LocalSample & sample, void ** ros_message)
+{
+  auto type_support = static_cast<const TypeSupport *>(info->type_support_.get());
+  const void * impl = info->type_support_impl_;
+  void * message = type_support->createROSmessage(impl);
+  if (nullptr == message) {
+    RMW_SET_ERROR_MSG("cannot allocate message for the local subscriptions");
+    return RMW_RET_BAD_ALLOC;
+  }
+  // The type support is kept alive by the message, which may outlive the publisher
+  eprosima::fastdds::dds::TypeSupport fastdds_type = info->type_support_;
+  try {
+    sample.ros_message = std::shared_ptr<const void>(
+      message, [fastdds_type, impl](void * data) {
+        static_cast<const TypeSupport *>(fastdds_type.get())->deleteROSmessage(data, impl);
+      });
+  } catch (std::bad_alloc &) {
+    // The message was already deleted
+    RMW_SET_ERROR_MSG("cannot allocate message for the local subscriptions");
+    return RMW_RET_BAD_ALLOC;
+  }
+  sample.writer_guid = info->data_writer_->guid();
+  if (RCUTILS_RET_OK != rcutils_system_time_now(&sample.source_timestamp)) {
+    RMW_SET_ERROR_MSG("cannot get the source timestamp");
+    return RMW_RET_ERROR;
+  }
+  *ros_message = message;
+  return RMW_RET_OK;
+}
+
+// Deliver a sample to the subscriptions of the same participant, and tell whether it must
+// still be written for the other subscriptions the publisher is matched with, tagged with
+// the number of its publication
+static
+bool
+deliver_local_sample(
+  CustomPublisherInfo * info, LocalSample & sample, uint64_t * local_publication_number)
+{
+  size_t delivered = info->local_delivery_->deliver(info, sample);
+  *local_publication_number = sample.publication_number;
+  return info->listener_->subscriptionCount() > delivered;
+}
+
+// Deliver a message to the subscriptions of the same participant, if the publisher is
+// registered to the intra participant delivery, see intra_participant_delivery.hpp
+static
+rmw_ret_t
+deliver_ros_message(
+  CustomPublisherInfo * info, const void * ros_message, bool * write,
+  uint64_t * local_publication_number)
+{
+  *write = true;
+  *local_publication_number = 0u;
+  if (!info->local_delivery_) {
+    return RMW_RET_OK;
+  }
+
+  LocalSample sample;
+  void * copy = nullptr;
+  rmw_ret_t ret = create_local_sample(info, sample, &copy);
+  if (RMW_RET_OK != ret) {
+    return ret;
+  }
+  auto type_support = static_cast<const TypeSupport *>(info->type_support_.get());
+  if (!type_support->copyROSmessage(ros_message, copy, info->type_support_impl_)) {
+    return RMW_RET_ERROR;  // Error message already set
+  }
+  *write = deliver_local_sample(info, sample, local_publication_number);
+  return RMW_RET_OK;
+}
+
+// Deliver a serialized message to the subscriptions of the same participant, if the
+// publisher is registered to the intra participant delivery
+static
+rmw_ret_t
+deliver_serialized_message(
+  CustomPublisherInfo * info, const rmw_serialized_message_t * serialized_message, bool * write,
+  uint64_t * local_publication_number)
+{
+  *write = true;
+  *local_publication_number = 0u;
+  if (!info->local_delivery_) {
+    return RMW_RET_OK;
+  }
+
+  LocalSample sample;
+  void * ros_message = nullptr;
+  rmw_ret_t ret = create_local_sample(info, sample, &ros_message);
+  if (RMW_RET_OK != ret) {
+    return ret;
+  }
+  eprosima::fastcdr::FastBuffer buffer(
+    reinterpret_cast<char *>(serialized_message->buffer), serialized_message->buffer_length);
+  eprosima::fastcdr::Cdr deser(
+    buffer, eprosima::fastcdr::Cdr::DEFAULT_ENDIAN, eprosima::fastcdr::Cdr::DDS_CDR);
+  auto type_support = static_cast<const TypeSupport *>(info->type_support_.get());
+  bool deserialized = false;
+  try {
+    deserialized =
+      type_support->deserializeROSmessage(deser, ros_message, info->type_support_impl_);
+  } catch (const eprosima::fastcdr::exception::Exception &) {
+    deserialized = false;
+  } catch (const std::exception &) {
+    // e.g. a sequence length past the end of a malformed message
+    deserialized = false;
+  }
+  if (!deserialized) {
+    RMW_SET_ERROR_MSG("cannot deserialize message for the local subscriptions");
+    return RMW_RET_ERROR;
+  }
+  *write = deliver_local_sample(info, sample, local_publication_number);
+  return RMW_RET_OK;
+}
+
+// Count a publication into the statistics of the publisher
+static
+rmw_ret_t
+count_publication(CustomPublisherInfo * info, rmw_ret_t ret)
+{
+  if (RMW_RET_OK == ret) {
+    info->statistics_.add_published_messages(1u);
+  } else {
+    info->statistics_.add_failed_messages(1u);
+  }
+  return ret;
+}
+
+// Deliver, hold back or write a message, once checked.
+// Must be called with the scratch buffer mutex locked, if the publisher serializes once.
+static
+rmw_ret_t
+publish_ros_message(CustomPublisherInfo * info, const void * ros_message)
+{
+  bool write = true;
+  uint64_t local_publication_number = 0u;
+  rmw_ret_t ret = deliver_ros_message(info, ros_message, &write, &local_publication_number);
+  if (RMW_RET_OK != ret || !write) {
+    return ret;
+  }
+  if (info->coalescing_) {
+    return info->coalescing_->add_ros_message(ros_message, local_publication_number);
+  }
+  if (!write_ros_message(info, ros_message, local_publication_number)) {
+    RMW_SET_ERROR_MSG("cannot publish data");
+    return RMW_RET_ERROR;
+  }
+  return RMW_RET_OK;
+}
+
+// Deliver, hold back or write a serialized message, once checked
+static
+rmw_ret_t
+publish_serialized_message(
+  CustomPublisherInfo * info, const rmw_serialized_message_t * serialized_message)
+{
+  bool write = true;
+  uint64_t local_publication_number = 0u;
+  rmw_ret_t ret = deliver_serialized_message(
+    info, serialized_message, &write, &local_publication_number);
+  if (RMW_RET_OK != ret || !write) {
+    return ret;
+  }
+  if (info->coalescing_) {
+    return info->coalescing_->add_serialized_message(
+      serialized_message, local_publication_number);
+  }
+
+  // The caller's buffer is referenced until write() returns, and copied once to the payload
+  rmw_fastrtps_shared_cpp::SerializedData data;
+  data.is_cdr_buffer = false;
+  data.data = nullptr;
+  data.impl = nullptr;    // not used when cdr_data is set
+  data.cdr_data = reinterpret_cast<const char *>(serialized_message->buffer);
+  data.cdr_length = serialized_message->buffer_length;
+  data.local_publication_number = local_publication_number;
+  if (!info->statistics_.write(info->data_writer_, data)) {
+    RMW_SET_ERROR_MSG("cannot publish data");
+    return RMW_RET_ERROR;
+  }
+  return RMW_RET_OK;
+}
+
+// Check that an allocation, if any, was initialized for the type of a publisher
+static
+rmw_ret_t
+check_publisher_allocation(
+  const char * identifier,
+  const CustomPublisherInfo * info,
+  const rmw_publisher_allocation_t * allocation)
+{
+  if (nullptr == allocation) {
+    return RMW_RET_OK;
+  }
+  RMW_CHECK_TYPE_IDENTIFIERS_MATCH(
+    publisher allocation, allocation->implementation_identifier, identifier,
+    return RMW_RET_INCORRECT_RMW_IMPLEMENTATION);
+  auto allocation_info = static_cast<const CustomPublisherAllocation *>(allocation->data);
+  if (nullptr == allocation_info ||
+    allocation_info->type_support_impl_ != info->type_support_impl_)
+  {
+    RMW_SET_ERROR_MSG("publisher allocation was not initialized for the type of the publisher");
+    return RMW_RET_INVALID_ARGUMENT;
+  }
+  // Both copy the message to memory they allocate, which the allocation can't provide
+  if (info->local_delivery_ || info->coalescing_) {
+    RMW_SET_ERROR_MSG(
+      "publisher allocations can't be used with intra participant delivery or coalescing");
+    return RMW_RET_UNSUPPORTED;
+  }
+  return RMW_RET_OK;
+}
+
 rmw_ret_t
 __rmw_publish(
   const char * identifier,
@@ -36,8 +280,8 @@ __rmw_publish(
   RCUTILS_CAN_RETURN_WITH_ERROR_OF(RMW_RET_INVALID_ARGUMENT);
   RCUTILS_CAN_RETURN_WITH_ERROR_OF(RMW_RET_INCORRECT_RMW_IMPLEMENTATION);
   RCUTILS_CAN_RETURN_WITH_ERROR_OF(RMW_RET_ERROR);
+  RCUTILS_CAN_RETURN_WITH_ERROR_OF(RMW_RET_UNSUPPORTED);
 
-  (void) allocation;
   RMW_CHECK_FOR_NULL_WITH_MSG(
     publisher, "publisher handle is null",
     return RMW_RET_INVALID_ARGUMENT);
@@ -50,14 +294,68 @@ __rmw_publish(
 
   auto info = static_cast<CustomPublisherInfo *>(publisher->data);
   RCUTILS_CHECK_FOR_NULL_WITH_MSG(info, "publisher info pointer is null", return RMW_RET_ERROR);
+  rmw_ret_t ret = check_publisher_allocation(identifier, info, allocation);
+  if (RMW_RET_OK != ret) {
+    return ret;
+  }
 
-  rmw_fastrtps_shared_cpp::SerializedData data;
-  data.is_cdr_buffer = false;
-  data.data = const_cast<void *>(ros_message);
-  data.impl = info->type_support_impl_;
-  if (!info->data_writer_->write(&data)) {
-    RMW_SET_ERROR_MSG("cannot publish data");
-    return RMW_RET_ERROR;
+  std::unique_lock<std::mutex> scratch_lock;
+  if (info->serialize_once_) {
+    scratch_lock = std::unique_lock<std::mutex>(info->scratch_buffer_mutex_);
+  }
+  return count_publication(info, publish_ros_message(info, ros_message));
+}
+
+rmw_ret_t
+__rmw_publish_sequence(
+  const char * identifier,
+  const rmw_publisher_t * publisher,
+  const rmw_message_sequence_t * ros_messages,
+  size_t * published,
+  rmw_publisher_allocation_t * allocation)
+{
+  RCUTILS_CAN_RETURN_WITH_ERROR_OF(RMW_RET_INVALID_ARGUMENT);
+  RCUTILS_CAN_RETURN_WITH_ERROR_OF(RMW_RET_INCORRECT_RMW_IMPLEMENTATION);
+  RCUTILS_CAN_RETURN_WITH_ERROR_OF(RMW_RET_ERROR);
+  RCUTILS_CAN_RETURN_WITH_ERROR_OF(RMW_RET_UNSUPPORTED);
+
+  if (nullptr != published) {
+    *published = 0u;
+  }
+  RMW_CHECK_FOR_NULL_WITH_MSG(
+    publisher, "publisher handle is null",
+    return RMW_RET_INVALID_ARGUMENT);
+  RMW_CHECK_TYPE_IDENTIFIERS_MATCH(
+    publisher, publisher->implementation_identifier, identifier,
+    return RMW_RET_INCORRECT_RMW_IMPLEMENTATION);
+  RMW_CHECK_FOR_NULL_WITH_MSG(
+    ros_messages, "ros message sequence handle is null",
+    return RMW_RET_INVALID_ARGUMENT);
+  for (size_t i = 0u; i < ros_messages->size; ++i) {
+    RMW_CHECK_FOR_NULL_WITH_MSG(
+      ros_messages->data[i], "ros message handle is null",
+      return RMW_RET_INVALID_ARGUMENT);
+  }
+
+  auto info = static_cast<CustomPublisherInfo *>(publisher->data);
+  RCUTILS_CHECK_FOR_NULL_WITH_MSG(info, "publisher info pointer is null", return RMW_RET_ERROR);
+  rmw_ret_t ret = check_publisher_allocation(identifier, info, allocation);
+  if (RMW_RET_OK != ret) {
+    return ret;
+  }
+
+  std::unique_lock<std::mutex> scratch_lock;
+  if (info->serialize_once_) {
+    scratch_lock = std::unique_lock<std::mutex>(info->scratch_buffer_mutex_);
+  }
+  for (size_t i = 0u; i < ros_messages->size; ++i) {
+    ret = count_publication(info, publish_ros_message(info, ros_messages->data[i]));
+    if (RMW_RET_OK != ret) {
+      return ret;
+    }
+    if (nullptr != published) {
+      ++*published;
+    }
   }
 
   return RMW_RET_OK;
@@ -88,25 +386,12 @@ __rmw_publish_serialized_message(
   auto info = static_cast<CustomPublisherInfo *>(publisher->data);
   RCUTILS_CHECK_FOR_NULL_WITH_MSG(info, "publisher info pointer is null", return RMW_RET_ERROR);
 
-  eprosima::fastcdr::FastBuffer buffer(
-    reinterpret_cast<char *>(serialized_message->buffer), serialized_message->buffer_length);
-  eprosima::fastcdr::Cdr ser(
-    buffer, eprosima::fastcdr::Cdr::DEFAULT_ENDIAN, eprosima::fastcdr::Cdr::DDS_CDR);
-  if (!ser.jump(serialized_message->buffer_length)) {
-    RMW_SET_ERROR_MSG("cannot correctly set serialized buffer");
-    return RMW_RET_ERROR;
-  }
-
-  rmw_fastrtps_shared_cpp::SerializedData data;
-  data.is_cdr_buffer = true;
-  data.data = &ser;
-  data.impl = nullptr;    // not used when is_cdr_buffer is true
-  if (!info->data_writer_->write(&data)) {
-    RMW_SET_ERROR_MSG("cannot publish data");
-    return RMW_RET_ERROR;
+  if (serialized_message->buffer_length < 4u) {
+    RMW_SET_ERROR_MSG("serialized message is shorter than its encapsulation header");
+    return RMW_RET_INVALID_ARGUMENT;
   }
 
-  return RMW_RET_OK;
+  return count_publication(info, publish_serialized_message(info, serialized_message));
 }
 rmw_ret_t
 __rmw_publish_loaned_message(
@@ -132,11 +417,21 @@ __rmw_publish_loaned_message(
   RMW_CHECK_ARGUMENT_FOR_NULL(ros_message, RMW_RET_INVALID_ARGUMENT);
 
   auto info = static_cast<CustomPublisherInfo *>(publisher->data);
-  if (!info->data_writer_->write(const_cast<void *>(ros_message))) {
+  // Messages held back are published before this one
+  if (info->coalescing_) {
+    rmw_ret_t ret = info->coalescing_->flush();
+    if (RMW_RET_OK != ret) {
+      return count_publication(info, ret);
+    }
+  }
+  // Loaned messages are of plain types, whose size is the one of the type
+  if (!info->statistics_.write_sample(
+      info->data_writer_, const_cast<void *>(ros_message), info->type_support_->m_typeSize))
+  {
     RMW_SET_ERROR_MSG("cannot publish data");
-    return RMW_RET_ERROR;
+    return count_publication(info, RMW_RET_ERROR);
   }
 
-  return RMW_RET_OK;
+  return count_publication(info, RMW_RET_OK);
 }
 }  // namespace rmw_fastrtps_shared_cpp
@@ -13,6 +13,7 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <new>
 #include <string>
 
 #include "rmw/allocators.h"
@@ -27,7 +28,9 @@
 #include "rmw_fastrtps_shared_cpp/custom_publisher_info.hpp"
 #include "rmw_fastrtps_shared_cpp/namespace_prefix.hpp"
 #include "rmw_fastrtps_shared_cpp/publisher.hpp"
+#include "rmw_fastrtps_shared_cpp/publisher_coalescing.hpp"
 #include "rmw_fastrtps_shared_cpp/qos.hpp"
+#include "rmw_fastrtps_shared_cpp/discovery_batch.hpp"
 #include "rmw_fastrtps_shared_cpp/rmw_common.hpp"
 #include "rmw_fastrtps_shared_cpp/rmw_context_impl.hpp"
 #include "rmw_fastrtps_shared_cpp/TypeSupport.hpp"
@@ -55,11 +58,10 @@ __rmw_destroy_publisher(
     rmw_dds_common::msg::ParticipantEntitiesInfo msg =
       common_context->graph_cache.dissociate_writer(
       info->publisher_gid, common_context->gid, node->name, node->namespace_);
-    rmw_ret_t publish_ret = rmw_fastrtps_shared_cpp::__rmw_publish(
+    rmw_ret_t publish_ret = rmw_fastrtps_shared_cpp::publish_participant_entities_info(
       identifier,
-      common_context->pub,
-      &msg,
-      nullptr);
+      node->context,
+      msg);
     if (RMW_RET_OK != publish_ret) {
       error_state = *rmw_get_error_state();
       ret = publish_ret;
@@ -135,6 +137,13 @@ __rmw_publisher_wait_for_all_acked(
     return RMW_RET_INCORRECT_RMW_IMPLEMENTATION);
 
   auto info = static_cast<CustomPublisherInfo *>(publisher->data);
+  // Messages held back would never be acknowledged
+  if (info->coalescing_) {
+    rmw_ret_t ret = info->coalescing_->flush();
+    if (RMW_RET_OK != ret) {
+      return ret;
+    }
+  }
 
   eprosima::fastrtps::Duration_t timeout = rmw_time_to_fastrtps(wait_timeout);
 
@@ -214,4 +223,51 @@ __rmw_return_loaned_message_from_publisher(
 
   return RMW_RET_OK;
 }
+
+rmw_ret_t
+__rmw_init_publisher_allocation(
+  const char * identifier,
+  const void * type_support_impl,
+  bool bounded,
+  const rosidl_message_type_support_t * type_support,
+  rmw_publisher_allocation_t * allocation)
+{
+  RMW_CHECK_ARGUMENT_FOR_NULL(allocation, RMW_RET_INVALID_ARGUMENT);
+  if (nullptr != allocation->data) {
+    RMW_SET_ERROR_MSG("publisher allocation is already initialized");
+    return RMW_RET_INVALID_ARGUMENT;
+  }
+  if (!bounded) {
+    RMW_SET_ERROR_MSG("publisher allocations need a message type of bounded size");
+    return RMW_RET_UNSUPPORTED;
+  }
+
+  auto allocation_info = new (std::nothrow) CustomPublisherAllocation();
+  if (!allocation_info) {
+    RMW_SET_ERROR_MSG("failed to allocate publisher allocation");
+    return RMW_RET_BAD_ALLOC;
+  }
+  allocation_info->type_support_impl_ = type_support_impl;
+  allocation_info->type_support_ = type_support;
+  allocation->implementation_identifier = identifier;
+  allocation->data = allocation_info;
+  return RMW_RET_OK;
+}
+
+rmw_ret_t
+__rmw_fini_publisher_allocation(
+  const char * identifier,
+  rmw_publisher_allocation_t * allocation)
+{
+  RMW_CHECK_ARGUMENT_FOR_NULL(allocation, RMW_RET_INVALID_ARGUMENT);
+  RMW_CHECK_TYPE_IDENTIFIERS_MATCH(
+    publisher allocation, allocation->implementation_identifier, identifier,
+    return RMW_RET_INCORRECT_RMW_IMPLEMENTATION);
+  RMW_CHECK_ARGUMENT_FOR_NULL(allocation->data, RMW_RET_INVALID_ARGUMENT);
+
+  delete static_cast<CustomPublisherAllocation *>(allocation->data);
+  allocation->implementation_identifier = nullptr;
+  allocation->data = nullptr;
+  return RMW_RET_OK;
+}
 }  // namespace rmw_fastrtps_shared_cpp
@@ -13,6 +13,7 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <mutex>
 #include <string>
 
 #include "fastrtps/subscriber/Subscriber.h"
@@ -29,55 +30,39 @@
 
 #include "demangle.hpp"
 #include "rmw_fastrtps_shared_cpp/custom_client_info.hpp"
+#include "rmw_fastrtps_shared_cpp/graph_guard_conditions.hpp"
 #include "rmw_fastrtps_shared_cpp/rmw_common.hpp"
 #include "rmw_fastrtps_shared_cpp/rmw_context_impl.hpp"
 
 namespace rmw_fastrtps_shared_cpp
 {
-rmw_ret_t
-__rmw_service_server_is_available(
-  const char * identifier,
-  const rmw_node_t * node,
-  const rmw_client_t * client,
-  bool * is_available)
+// Start watching the endpoints of the service of a client, on first use
+static
+void
+watch_client_graph(const rmw_node_t * node, CustomClientInfo * client_info)
 {
-  if (!node) {
-    RMW_SET_ERROR_MSG("node handle is null");
-    return RMW_RET_ERROR;
-  }
-
-  RMW_CHECK_TYPE_IDENTIFIERS_MATCH(
-    node handle,
-    node->implementation_identifier, identifier,
-    return RMW_RET_INCORRECT_RMW_IMPLEMENTATION);
-
-  if (!client) {
-    RMW_SET_ERROR_MSG("client handle is null");
-    return RMW_RET_ERROR;
-  }
-
-  RMW_CHECK_TYPE_IDENTIFIERS_MATCH(
-    client handle,
-    client->implementation_identifier, identifier,
-    return RMW_RET_INCORRECT_RMW_IMPLEMENTATION);
-
-  if (!is_available) {
-    RMW_SET_ERROR_MSG("is_available is null");
-    return RMW_RET_ERROR;
-  }
-
-  auto client_info = static_cast<CustomClientInfo *>(client->data);
-  if (!client_info) {
-    RMW_SET_ERROR_MSG("client info handle is null");
-    return RMW_RET_ERROR;
+  std::lock_guard<std::mutex> lock(client_info->graph_watcher_mutex_);
+  if (nullptr != client_info->graph_change_notifier_) {
+    return;
   }
+  auto notifier = &node->context->impl->graph_change_notifier;
+  notifier->add_topic_watcher(client_info->request_topic_, &client_info->graph_watcher_);
+  notifier->add_topic_watcher(client_info->response_topic_, &client_info->graph_watcher_);
+  client_info->graph_change_notifier_ = notifier;
+}
 
+static
+rmw_ret_t
+check_service_server_is_available(
+  rmw_dds_common::Context * common_context,
+  CustomClientInfo * client_info,
+  bool * is_available)
+{
   auto pub_topic_name = client_info->request_topic_;
 
   auto sub_topic_name = client_info->response_topic_;
 
   *is_available = false;
-  auto common_context = static_cast<rmw_dds_common::Context *>(node->context->impl->common);
 
   size_t number_of_request_subscribers = 0;
   rmw_ret_t ret =
@@ -127,4 +112,103 @@ __rmw_service_server_is_available(
   *is_available = true;
   return RMW_RET_OK;
 }
+
+rmw_ret_t
+__rmw_service_server_is_available(
+  const char * identifier,
+  const rmw_node_t * node,
+  const rmw_client_t * client,
+  bool * is_available)
+{
+  if (!node) {
+    RMW_SET_ERROR_MSG("node handle is null");
+    return RMW_RET_ERROR;
+  }
+
+  RMW_CHECK_TYPE_IDENTIFIERS_MATCH(
+    node handle,
+    node->implementation_identifier, identifier,
+    return RMW_RET_INCORRECT_RMW_IMPLEMENTATION);
+
+  if (!client) {
+    RMW_SET_ERROR_MSG("client handle is null");
+    return RMW_RET_ERROR;
+  }
+
+  RMW_CHECK_TYPE_IDENTIFIERS_MATCH(
+    client handle,
+    client->implementation_identifier, identifier,
+    return RMW_RET_INCORRECT_RMW_IMPLEMENTATION);
+
+  if (!is_available) {
+    RMW_SET_ERROR_MSG("is_available is null");
+    return RMW_RET_ERROR;
+  }
+
+  auto client_info = static_cast<CustomClientInfo *>(client->data);
+  if (!client_info) {
+    RMW_SET_ERROR_MSG("client info handle is null");
+    return RMW_RET_ERROR;
+  }
+
+  // The answer only changes along with the endpoints of the service, so it is kept until
+  // the watcher of the client is notified.
+  watch_client_graph(node, client_info);
+  const uint64_t changes = client_info->graph_watcher_.get_changes();
+  {
+    std::lock_guard<std::mutex> lock(client_info->graph_watcher_mutex_);
+    if (client_info->has_cached_availability_ &&
+      client_info->cached_availability_changes_ == changes)
+    {
+      *is_available = client_info->cached_availability_;
+      return RMW_RET_OK;
+    }
+  }
+
+  auto common_context = static_cast<rmw_dds_common::Context *>(node->context->impl->common);
+  rmw_ret_t ret = check_service_server_is_available(common_context, client_info, is_available);
+  if (RMW_RET_OK != ret) {
+    return ret;
+  }
+
+  std::lock_guard<std::mutex> lock(client_info->graph_watcher_mutex_);
+  client_info->has_cached_availability_ = true;
+  client_info->cached_availability_changes_ = changes;
+  client_info->cached_availability_ = *is_available;
+  return RMW_RET_OK;
+}
+
+rmw_ret_t
+get_client_graph_guard_condition(
+  const char * identifier,
+  const rmw_node_t * node,
+  const rmw_client_t * client,
+  const rmw_guard_condition_t ** guard_condition)
+{
+  RMW_CHECK_ARGUMENT_FOR_NULL(node, RMW_RET_INVALID_ARGUMENT);
+  RMW_CHECK_TYPE_IDENTIFIERS_MATCH(
+    node handle,
+    node->implementation_identifier, identifier,
+    return RMW_RET_INCORRECT_RMW_IMPLEMENTATION);
+  RMW_CHECK_ARGUMENT_FOR_NULL(client, RMW_RET_INVALID_ARGUMENT);
+  RMW_CHECK_TYPE_IDENTIFIERS_MATCH(
+    client handle,
+    client->implementation_identifier, identifier,
+    return RMW_RET_INCORRECT_RMW_IMPLEMENTATION);
+  RMW_CHECK_ARGUMENT_FOR_NULL(guard_condition, RMW_RET_INVALID_ARGUMENT);
+
+  auto client_info = static_cast<CustomClientInfo *>(client->data);
+  watch_client_graph(node, client_info);
+
+  std::lock_guard<std::mutex> lock(client_info->graph_watcher_mutex_);
+  if (nullptr == client_info->graph_guard_condition_) {
+    client_info->graph_guard_condition_ = __rmw_create_guard_condition(identifier);
+    if (nullptr == client_info->graph_guard_condition_) {
+      return RMW_RET_ERROR;  // Error message already set
+    }
+    client_info->graph_watcher_.set_guard_condition(client_info->graph_guard_condition_);
+  }
+  *guard_condition = client_info->graph_guard_condition_;
+  return RMW_RET_OK;
+}
 }  // namespace rmw_fastrtps_shared_cpp
@@ -13,11 +13,13 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <new>
 #include <utility>
 #include <string>
 
 #include "rmw/allocators.h"
 #include "rmw/error_handling.h"
+#include "rmw/impl/cpp/macros.hpp"
 #include "rmw/rmw.h"
 
 #include "fastdds/dds/subscriber/DataReader.hpp"
@@ -27,6 +29,7 @@
 #include "rmw_fastrtps_shared_cpp/custom_subscriber_info.hpp"
 #include "rmw_fastrtps_shared_cpp/namespace_prefix.hpp"
 #include "rmw_fastrtps_shared_cpp/qos.hpp"
+#include "rmw_fastrtps_shared_cpp/discovery_batch.hpp"
 #include "rmw_fastrtps_shared_cpp/rmw_common.hpp"
 #include "rmw_fastrtps_shared_cpp/rmw_context_impl.hpp"
 #include "rmw_fastrtps_shared_cpp/subscription.hpp"
@@ -54,11 +57,10 @@ __rmw_destroy_subscription(
     rmw_dds_common::msg::ParticipantEntitiesInfo msg =
       common_context->graph_cache.dissociate_reader(
       info->subscription_gid_, common_context->gid, node->name, node->namespace_);
-    ret = rmw_fastrtps_shared_cpp::__rmw_publish(
+    ret = rmw_fastrtps_shared_cpp::publish_participant_entities_info(
       identifier,
-      common_context->pub,
-      static_cast<void *>(&msg),
-      nullptr);
+      node->context,
+      msg);
     if (RMW_RET_OK != ret) {
       error_state = *rmw_get_error_state();
       error_string = rmw_get_error_string();
@@ -106,4 +108,46 @@ __rmw_subscription_get_actual_qos(
 
   return RMW_RET_OK;
 }
+
+rmw_ret_t
+__rmw_init_subscription_allocation(
+  const char * identifier,
+  const void * type_support_impl,
+  const rosidl_message_type_support_t * type_support,
+  rmw_subscription_allocation_t * allocation)
+{
+  RMW_CHECK_ARGUMENT_FOR_NULL(allocation, RMW_RET_INVALID_ARGUMENT);
+  if (nullptr != allocation->data) {
+    RMW_SET_ERROR_MSG("subscription allocation is already initialized");
+    return RMW_RET_INVALID_ARGUMENT;
+  }
+
+  auto allocation_info = new (std::nothrow) CustomSubscriptionAllocation();
+  if (!allocation_info) {
+    RMW_SET_ERROR_MSG("failed to allocate subscription allocation");
+    return RMW_RET_BAD_ALLOC;
+  }
+  allocation_info->type_support_impl_ = type_support_impl;
+  allocation_info->type_support_ = type_support;
+  allocation->implementation_identifier = identifier;
+  allocation->data = allocation_info;
+  return RMW_RET_OK;
+}
+
+rmw_ret_t
+__rmw_fini_subscription_allocation(
+  const char * identifier,
+  rmw_subscription_allocation_t * allocation)
+{
+  RMW_CHECK_ARGUMENT_FOR_NULL(allocation, RMW_RET_INVALID_ARGUMENT);
+  RMW_CHECK_TYPE_IDENTIFIERS_MATCH(
+    subscription allocation, allocation->implementation_identifier, identifier,
+    return RMW_RET_INCORRECT_RMW_IMPLEMENTATION);
+  RMW_CHECK_ARGUMENT_FOR_NULL(allocation->data, RMW_RET_INVALID_ARGUMENT);
+
+  delete static_cast<CustomSubscriptionAllocation *>(allocation->data);
+  allocation->implementation_identifier = nullptr;
+  allocation->data = nullptr;
+  return RMW_RET_OK;
+}
 }  // namespace rmw_fastrtps_shared_cpp
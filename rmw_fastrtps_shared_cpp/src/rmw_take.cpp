@@ -12,14 +12,27 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+#include <cstdint>
+#include <limits>
 #include <memory>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "rcutils/allocator.h"
 
 #include "rmw/allocators.h"
 #include "rmw/error_handling.h"
+#include "rmw/message_sequence.h"
 #include "rmw/serialized_message.h"
 #include "rmw/rmw.h"
 
+#include "fastdds/dds/core/LoanableCollection.hpp"
 #include "fastdds/dds/subscriber/SampleInfo.hpp"
+#include "fastdds/rtps/common/SerializedPayload.h"
 
 #include "fastrtps/utils/collections/ResourceLimitedVector.hpp"
 
@@ -28,7 +41,10 @@
 
 #include "rmw_fastrtps_shared_cpp/custom_subscriber_info.hpp"
 #include "rmw_fastrtps_shared_cpp/guid_utils.hpp"
+#include "rmw_fastrtps_shared_cpp/intra_participant_delivery.hpp"
+#include "rmw_fastrtps_shared_cpp/message_sequence_loans.hpp"
 #include "rmw_fastrtps_shared_cpp/rmw_common.hpp"
+#include "rmw_fastrtps_shared_cpp/serialized_loans.hpp"
 #include "rmw_fastrtps_shared_cpp/subscription.hpp"
 #include "rmw_fastrtps_shared_cpp/TypeSupport.hpp"
 #include "rmw_fastrtps_shared_cpp/utils.hpp"
@@ -55,6 +71,107 @@ _assign_message_info(
     sender_gid->data);
 }
 
+static
+void
+_assign_local_message_info(
+  const char * identifier,
+  rmw_message_info_t * message_info,
+  const LocalSample & sample)
+{
+  // Delivered when published
+  message_info->source_timestamp = sample.source_timestamp;
+  message_info->received_timestamp = sample.source_timestamp;
+  rmw_gid_t * sender_gid = &message_info->publisher_gid;
+  sender_gid->implementation_identifier = identifier;
+  memset(sender_gid->data, 0, RMW_GID_STORAGE_SIZE);
+
+  rmw_fastrtps_shared_cpp::copy_from_fastrtps_guid_to_byte_array(
+    sample.writer_guid,
+    sender_gid->data);
+}
+
+// Whether a sample taken with Fast DDS was already delivered by a publisher of the same
+// participant, or is to be ignored as such.
+// Delivered samples are told apart by the publication they are tagged with, as the first
+// publications of a publisher may be received before it delivers to the subscription.
+static
+bool
+_is_local_sample(
+  const rmw_subscription_t * subscription,
+  const CustomSubscriberInfo * info,
+  const eprosima::fastdds::dds::SampleInfo & sinfo)
+{
+  if (!subscription->options.ignore_local_publications && !info->local_delivery_) {
+    return false;
+  }
+  auto sample_writer_guid = eprosima::fastrtps::rtps::iHandle2GUID(sinfo.publication_handle);
+  if (sample_writer_guid.guidPrefix != info->data_reader_->guid().guidPrefix) {
+    return false;
+  }
+  if (subscription->options.ignore_local_publications) {
+    return true;
+  }
+  return info->listener_->was_delivered_locally(
+    sample_writer_guid, get_local_publication_number(sinfo));
+}
+
+// Whether the samples taken with Fast DDS may be local publications to be skipped
+static
+bool
+_filters_local_samples(
+  const rmw_subscription_t * subscription,
+  const CustomSubscriberInfo * info)
+{
+  return subscription->options.ignore_local_publications || info->local_delivery_;
+}
+
+// Deserialize a sample taken as a CDR buffer, once known not to be skipped
+static
+bool
+_deserialize_cdr_buffer(
+  const CustomSubscriberInfo * info,
+  eprosima::fastcdr::FastBuffer & buffer,
+  void * ros_message)
+{
+  auto type_support = static_cast<const TypeSupport *>(info->type_support_.get());
+  eprosima::fastcdr::Cdr deser(
+    buffer, eprosima::fastcdr::Cdr::DEFAULT_ENDIAN, eprosima::fastcdr::Cdr::DDS_CDR);
+  return type_support->deserializeROSmessage(deser, ros_message, info->type_support_impl_);
+}
+
+// Take the oldest message delivered by a publisher of the same participant, if any
+static
+bool
+_take_local_sample(CustomSubscriberInfo * info, LocalSample & sample)
+{
+  return info->local_delivery_ && info->listener_->take_local_sample(sample);
+}
+
+// Check that an allocation, if any, was initialized for the type of a subscription
+static
+rmw_ret_t
+check_subscription_allocation(
+  const char * identifier,
+  const CustomSubscriberInfo * info,
+  const rmw_subscription_allocation_t * allocation)
+{
+  if (nullptr == allocation) {
+    return RMW_RET_OK;
+  }
+  RMW_CHECK_TYPE_IDENTIFIERS_MATCH(
+    subscription allocation, allocation->implementation_identifier, identifier,
+    return RMW_RET_INCORRECT_RMW_IMPLEMENTATION);
+  auto allocation_info = static_cast<const CustomSubscriptionAllocation *>(allocation->data);
+  if (nullptr == allocation_info ||
+    allocation_info->type_support_impl_ != info->type_support_impl_)
+  {
+    RMW_SET_ERROR_MSG(
+      "subscription allocation was not initialized for the type of the subscription");
+    return RMW_RET_INVALID_ARGUMENT;
+  }
+  return RMW_RET_OK;
+}
+
 rmw_ret_t
 _take(
   const char * identifier,
@@ -64,7 +181,6 @@ _take(
   rmw_message_info_t * message_info,
   rmw_subscription_allocation_t * allocation)
 {
-  (void) allocation;
   *taken = false;
 
   RMW_CHECK_TYPE_IDENTIFIERS_MATCH(
@@ -74,6 +190,25 @@ _take(
 
   auto info = static_cast<CustomSubscriberInfo *>(subscription->data);
   RCUTILS_CHECK_FOR_NULL_WITH_MSG(info, "custom subscriber info is null", return RMW_RET_ERROR);
+  rmw_ret_t ret = check_subscription_allocation(identifier, info, allocation);
+  if (RMW_RET_OK != ret) {
+    return ret;
+  }
+
+  LocalSample local_sample;
+  if (_take_local_sample(info, local_sample)) {
+    auto type_support = static_cast<const TypeSupport *>(info->type_support_.get());
+    if (!type_support->copyROSmessage(
+        local_sample.ros_message.get(), ros_message, info->type_support_impl_))
+    {
+      return RMW_RET_ERROR;  // Error message already set
+    }
+    if (message_info) {
+      _assign_local_message_info(identifier, message_info, local_sample);
+    }
+    *taken = true;
+    return RMW_RET_OK;
+  }
 
   eprosima::fastdds::dds::SampleInfo sinfo;
 
@@ -83,34 +218,99 @@ _take(
   data.data = ros_message;
   data.impl = info->type_support_impl_;
 
-  while (0 < info->data_reader_->get_unread_count()) {
-    if (info->data_reader_->take_next_sample(&data, &sinfo) == ReturnCode_t::RETCODE_OK) {
-      // Update hasData from listener
+  // Samples peeked at as local publications are taken as CDR buffers, so that they are
+  // neither deserialized for nothing nor overwrite the message
+  eprosima::fastcdr::FastBuffer buffer;
+  rmw_fastrtps_shared_cpp::SerializedData cdr_data;
+  cdr_data.is_cdr_buffer = true;
+  cdr_data.data = &buffer;
+  cdr_data.impl = nullptr;  // not used when is_cdr_buffer is true
+  bool filter_local = _filters_local_samples(subscription, info);
+
+  while (true) {
+    bool peeked_local = filter_local &&
+      info->data_reader_->get_first_untaken_info(&sinfo) == ReturnCode_t::RETCODE_OK &&
+      _is_local_sample(subscription, info, sinfo);
+    auto next_data = peeked_local ? &cdr_data : &data;
+    if (info->data_reader_->take_next_sample(next_data, &sinfo) != ReturnCode_t::RETCODE_OK) {
+      // No sample left, update hasData from the reader
       info->listener_->update_has_data(info->data_reader_);
+      break;
+    }
+    // Update hasData from listener
+    info->listener_->on_samples_taken(info->data_reader_, 1u);
 
-      if (subscription->options.ignore_local_publications) {
-        auto sample_writer_guid =
-          eprosima::fastrtps::rtps::iHandle2GUID(sinfo.publication_handle);
+    if (_is_local_sample(subscription, info, sinfo)) {
+      // This is a local publication, either ignored or already delivered. Ignore it
+      continue;
+    }
 
-        if (sample_writer_guid.guidPrefix == info->data_reader_->guid().guidPrefix) {
-          // This is a local publication. Ignore it
-          continue;
-        }
+    if (sinfo.valid_data) {
+      // Another sample than the one peeked at may be taken, e.g. if the history was full
+      if (peeked_local && !_deserialize_cdr_buffer(info, buffer, ros_message)) {
+        continue;
       }
-
-      if (sinfo.valid_data) {
-        if (message_info) {
-          _assign_message_info(identifier, message_info, &sinfo);
-        }
-        *taken = true;
-        break;
+      if (message_info) {
+        _assign_message_info(identifier, message_info, &sinfo);
       }
+      *taken = true;
+      break;
     }
   }
 
   return RMW_RET_OK;
 }
 
+// Collection of SerializedData deserializing the samples taken with DataReader::take() into
+// the messages of a sequence, or copying them into CDR buffers, neither of which it owns.
+// The valid samples are deserialized into consecutive messages, whichever slot they are
+// taken in, so that the samples without data leave no gap.
+class MessageSequenceCollection : public eprosima::fastdds::dds::LoanableCollection
+{
+public:
+  MessageSequenceCollection(
+    void ** ros_messages, eprosima::fastcdr::FastBuffer * buffers, size_type count,
+    const void * impl)
+  : data_(static_cast<size_t>(count)),
+    elements_storage_(static_cast<size_t>(count))
+  {
+    slots_.messages = ros_messages;
+    slots_.count = static_cast<size_t>(count);
+    for (size_t i = 0u; i < data_.size(); ++i) {
+      if (nullptr != buffers) {
+        data_[i].is_cdr_buffer = true;
+        data_[i].data = &buffers[i];
+        data_[i].impl = nullptr;  // not used when is_cdr_buffer is true
+      } else {
+        data_[i].is_cdr_buffer = false;
+        data_[i].data = nullptr;  // set to the message the sample is deserialized into
+        data_[i].impl = impl;
+        data_[i].message_slots = &slots_;
+      }
+      elements_storage_[i] = &data_[i];
+    }
+    elements_ = elements_storage_.data();
+    maximum_ = count;
+  }
+
+  void resize(size_type /*new_length*/) override
+  {
+    // Never called, as samples are only taken up to the number of messages
+    throw std::bad_alloc();
+  }
+
+  /// Whether the sample taken in a slot was deserialized into the next message of the sequence.
+  bool deserialized(size_type index) const
+  {
+    return nullptr != data_[static_cast<size_t>(index)].data;
+  }
+
+private:
+  MessageSlots slots_;
+  std::vector<SerializedData> data_;
+  std::vector<void *> elements_storage_;
+};
+
 rmw_ret_t
 _take_sequence(
   const char * identifier,
@@ -122,8 +322,8 @@ _take_sequence(
   rmw_subscription_allocation_t * allocation)
 {
   *taken = 0;
-  bool taken_flag = false;
-  rmw_ret_t ret = RMW_RET_OK;
+  message_sequence->size = 0u;
+  message_info_sequence->size = 0u;
 
   RMW_CHECK_TYPE_IDENTIFIERS_MATCH(
     subscription handle,
@@ -132,27 +332,69 @@ _take_sequence(
 
   auto info = static_cast<CustomSubscriberInfo *>(subscription->data);
   RCUTILS_CHECK_FOR_NULL_WITH_MSG(info, "custom subscriber info is null", return RMW_RET_ERROR);
-
-  // Limit the upper bound of reads to the number unread at the beginning.
-  // This prevents any samples that are added after the beginning of the
-  // _take_sequence call from being read.
-  auto unread_count = info->data_reader_->get_unread_count();
-  if (unread_count < count) {
-    count = unread_count;
+  rmw_ret_t ret = check_subscription_allocation(identifier, info, allocation);
+  if (RMW_RET_OK != ret) {
+    return ret;
   }
+  auto type_support = static_cast<const TypeSupport *>(info->type_support_.get());
 
-  for (size_t ii = 0; ii < count; ++ii) {
-    taken_flag = false;
-    ret = _take(
-      identifier, subscription, message_sequence->data[*taken],
-      &taken_flag, &message_info_sequence->data[*taken], allocation);
-
-    if (ret != RMW_RET_OK) {
+  // Messages delivered by publishers of the same participant come first, as in _take()
+  LocalSample local_sample;
+  while (*taken < count && info->local_delivery_ &&
+    info->listener_->take_local_sample(local_sample))
+  {
+    if (!type_support->copyROSmessage(
+        local_sample.ros_message.get(), message_sequence->data[*taken],
+        info->type_support_impl_))
+    {
+      ret = RMW_RET_ERROR;  // Error message already set
       break;
     }
+    _assign_local_message_info(identifier, &message_info_sequence->data[*taken], local_sample);
+    ++(*taken);
+  }
 
-    if (taken_flag) {
-      (*taken)++;
+  // Take the other samples at once, deserializing them straight into the remaining messages,
+  // unless some of them may be local publications to be skipped, which are then taken as CDR
+  // buffers not to be deserialized for nothing.
+  // Only the samples received by then are taken.
+  if (RMW_RET_OK == ret && *taken < count) {
+    auto max_samples = static_cast<eprosima::fastdds::dds::LoanableCollection::size_type>(
+      std::min<size_t>(count - *taken, std::numeric_limits<int32_t>::max()));
+    std::vector<eprosima::fastcdr::FastBuffer> buffers(
+      _filters_local_samples(subscription, info) ? static_cast<size_t>(max_samples) : 0u);
+    MessageSequenceCollection data_seq(
+      &message_sequence->data[*taken], buffers.empty() ? nullptr : buffers.data(), max_samples,
+      info->type_support_impl_);
+    eprosima::fastdds::dds::SampleInfoSeq info_seq(max_samples);
+    if (ReturnCode_t::RETCODE_OK == info->data_reader_->take(data_seq, info_seq, max_samples)) {
+      // Update hasData from listener, once for the whole sequence, or from the reader if it
+      // had no sample left
+      if (info_seq.length() < max_samples) {
+        info->listener_->update_has_data(info->data_reader_);
+      } else {
+        info->listener_->on_samples_taken(
+          info->data_reader_, static_cast<size_t>(info_seq.length()));
+      }
+      for (size_t i = 0u; i < static_cast<size_t>(info_seq.length()); ++i) {
+        const auto & sinfo = info_seq[static_cast<int32_t>(i)];
+        if (!sinfo.valid_data || _is_local_sample(subscription, info, sinfo)) {
+          // Either without data, or a local publication ignored or already delivered
+          continue;
+        }
+        if (!buffers.empty()) {
+          if (!_deserialize_cdr_buffer(info, buffers[i], message_sequence->data[*taken])) {
+            continue;
+          }
+        } else if (!data_seq.deserialized(static_cast<int32_t>(i))) {
+          continue;
+        }
+        _assign_message_info(identifier, &message_info_sequence->data[*taken], &sinfo);
+        ++(*taken);
+      }
+    } else {
+      // No sample left, update hasData from the reader
+      info->listener_->update_has_data(info->data_reader_);
     }
   }
 
@@ -296,6 +538,34 @@ _take_serialized_message(
   auto info = static_cast<CustomSubscriberInfo *>(subscription->data);
   RCUTILS_CHECK_FOR_NULL_WITH_MSG(info, "custom subscriber info is null", return RMW_RET_ERROR);
 
+  LocalSample local_sample;
+  if (_take_local_sample(info, local_sample)) {
+    auto type_support = static_cast<const TypeSupport *>(info->type_support_.get());
+    const void * ros_message = local_sample.ros_message.get();
+    size_t max_length =
+      type_support->getEstimatedSerializedSize(ros_message, info->type_support_impl_);
+    if (serialized_message->buffer_capacity < max_length) {
+      auto ret = rmw_serialized_message_resize(serialized_message, max_length);
+      if (ret != RMW_RET_OK) {
+        return ret;  // Error message already set
+      }
+    }
+    eprosima::fastcdr::FastBuffer local_buffer(
+      reinterpret_cast<char *>(serialized_message->buffer), serialized_message->buffer_capacity);
+    eprosima::fastcdr::Cdr ser(
+      local_buffer, eprosima::fastcdr::Cdr::DEFAULT_ENDIAN, eprosima::fastcdr::Cdr::DDS_CDR);
+    if (!type_support->serializeROSmessage(ros_message, ser, info->type_support_impl_)) {
+      RMW_SET_ERROR_MSG("cannot serialize message delivered by a local publisher");
+      return RMW_RET_ERROR;
+    }
+    serialized_message->buffer_length = ser.getSerializedDataLength();
+    if (message_info) {
+      _assign_local_message_info(identifier, message_info, local_sample);
+    }
+    *taken = true;
+    return RMW_RET_OK;
+  }
+
   eprosima::fastcdr::FastBuffer buffer;
   eprosima::fastdds::dds::SampleInfo sinfo;
 
@@ -304,11 +574,19 @@ _take_serialized_message(
   data.data = &buffer;
   data.impl = nullptr;    // not used when is_cdr_buffer is true
 
-  if (info->data_reader_->take_next_sample(&data, &sinfo) == ReturnCode_t::RETCODE_OK) {
-    // Update hasData from listener
+  if (info->data_reader_->take_next_sample(&data, &sinfo) != ReturnCode_t::RETCODE_OK) {
+    // No sample left, update hasData from the reader
     info->listener_->update_has_data(info->data_reader_);
+  } else {
+    // Update hasData from listener
+    info->listener_->on_samples_taken(info->data_reader_, 1u);
 
-    if (sinfo.valid_data) {
+    // Samples of the publications delivered to the subscription were already taken as such
+    bool delivered = info->local_delivery_ && info->listener_->was_delivered_locally(
+      eprosima::fastrtps::rtps::iHandle2GUID(sinfo.publication_handle),
+      get_local_publication_number(sinfo));
+
+    if (sinfo.valid_data && !delivered) {
       auto buffer_size = static_cast<size_t>(buffer.getBufferSize());
       if (serialized_message->buffer_capacity < buffer_size) {
         auto ret = rmw_serialized_message_resize(serialized_message, buffer_size);
@@ -394,15 +672,70 @@ struct LoanManager
   {
     GenericSequence data_seq{};
     eprosima::fastdds::dds::SampleInfoSeq info_seq{};
+    // Samples of the sequence with data which are still loaned
+    size_t loaned_samples{0u};
   };
 
   explicit LoanManager(const eprosima::fastrtps::ResourceLimitedContainerConfig & items_cfg)
-  : items(items_cfg)
+  : max_items(items_cfg.maximum)
   {
   }
 
+  // Get an item to loan a sequence of samples into, or nullptr if too many are loaned
+  Item *
+  acquire_item() RCPPUTILS_TSA_REQUIRES(mtx)
+  {
+    if (!free_items.empty()) {
+      Item * item = free_items.back();
+      free_items.pop_back();
+      return item;
+    }
+    if (items.size() >= max_items) {
+      return nullptr;
+    }
+    std::unique_ptr<Item> item(new Item());
+    items.push_back(std::move(item));
+    // So that releasing items never allocates
+    free_items.reserve(items.size());
+    return items.back().get();
+  }
+
+  void
+  release_item(Item * item) RCPPUTILS_TSA_REQUIRES(mtx)
+  {
+    free_items.push_back(item);
+  }
+
+  // Return a loaned sample, and its sequence once all of its samples are
+  rmw_ret_t
+  return_loan(eprosima::fastdds::dds::DataReader * reader, const void * sample)
+  RCPPUTILS_TSA_REQUIRES(mtx)
+  {
+    auto it = loans.find(sample);
+    if (loans.end() == it) {
+      RMW_SET_ERROR_MSG("Trying to return message not loaned by this subscription");
+      return RMW_RET_ERROR;
+    }
+    Item * item = it->second;
+    if (1u == item->loaned_samples) {
+      if (!reader->return_loan(item->data_seq, item->info_seq)) {
+        RMW_SET_ERROR_MSG("Error returning loan");
+        return RMW_RET_ERROR;
+      }
+      release_item(item);
+    }
+    --item->loaned_samples;
+    loans.erase(it);
+    return RMW_RET_OK;
+  }
+
   std::mutex mtx;
-  eprosima::fastrtps::ResourceLimitedVector<Item> items RCPPUTILS_TSA_GUARDED_BY(mtx);
+  const size_t max_items;
+  // Items are kept once allocated, those without a loaned sequence being reused
+  std::vector<std::unique_ptr<Item>> items RCPPUTILS_TSA_GUARDED_BY(mtx);
+  std::vector<Item *> free_items RCPPUTILS_TSA_GUARDED_BY(mtx);
+  // Item each loaned sample was taken into, so that returning it takes constant time
+  std::unordered_map<const void *, Item *> loans RCPPUTILS_TSA_GUARDED_BY(mtx);
 };
 
 void
@@ -412,13 +745,93 @@ __init_subscription_for_loans(
   auto info = static_cast<CustomSubscriberInfo *>(subscription->data);
   const auto & qos = info->data_reader_->get_qos();
   bool has_data_sharing = DataSharingKind::OFF != qos.data_sharing().kind();
-  subscription->can_loan_messages = has_data_sharing && info->type_support_->is_plain();
-  if (subscription->can_loan_messages) {
+  auto type_support =
+    static_cast<const rmw_fastrtps_shared_cpp::TypeSupport *>(info->type_support_.get());
+  subscription->can_loan_messages = has_data_sharing && type_support->can_loan_ros_messages();
+  info->can_loan_serialized_messages_ =
+    has_data_sharing && type_support->has_serialized_loans();
+  if (subscription->can_loan_messages || info->can_loan_serialized_messages_) {
     const auto & allocation_qos = qos.reader_resource_limits().outstanding_reads_allocation;
     info->loan_manager_ = std::make_shared<LoanManager>(allocation_qos);
   }
 }
 
+// Take up to a number of samples with data as loans, at once, kept track of by the loan
+// manager
+static
+rmw_ret_t
+_take_loans(
+  const char * identifier,
+  CustomSubscriberInfo * info,
+  int32_t max_samples,
+  void ** samples,
+  rmw_message_info_t * message_infos,
+  size_t * taken)
+{
+  *taken = 0u;
+  auto loan_mgr = info->loan_manager_;
+  std::lock_guard<std::mutex> guard(loan_mgr->mtx);
+  LoanManager::Item * item = nullptr;
+  try {
+    item = loan_mgr->acquire_item();
+  } catch (const std::bad_alloc &) {
+    RMW_SET_ERROR_MSG("cannot allocate loaned message info");
+    return RMW_RET_BAD_ALLOC;
+  }
+  if (nullptr == item) {
+    RMW_SET_ERROR_MSG("Out of resources for loaned message info");
+    return RMW_RET_ERROR;
+  }
+
+  while (ReturnCode_t::RETCODE_OK ==
+    info->data_reader_->take(item->data_seq, item->info_seq, max_samples))
+  {
+    // Update hasData from listener, or from the reader if it had no sample left
+    int32_t length = item->info_seq.length();
+    if (length < max_samples) {
+      info->listener_->update_has_data(info->data_reader_);
+    } else {
+      info->listener_->on_samples_taken(info->data_reader_, static_cast<size_t>(length));
+    }
+
+    try {
+      for (int32_t i = 0; i < length; ++i) {
+        if (!item->info_seq[i].valid_data) {
+          continue;
+        }
+        void * sample = item->data_seq.buffer()[i];
+        loan_mgr->loans.emplace(sample, item);
+        samples[*taken] = sample;
+        if (nullptr != message_infos) {
+          _assign_message_info(identifier, &message_infos[*taken], &item->info_seq[i]);
+        }
+        ++(*taken);
+      }
+    } catch (const std::bad_alloc &) {
+      for (size_t i = 0u; i < *taken; ++i) {
+        loan_mgr->loans.erase(samples[i]);
+      }
+      *taken = 0u;
+      info->data_reader_->return_loan(item->data_seq, item->info_seq);
+      loan_mgr->release_item(item);
+      RMW_SET_ERROR_MSG("cannot allocate loaned message info");
+      return RMW_RET_BAD_ALLOC;
+    }
+    if (0u != *taken) {
+      item->loaned_samples = *taken;
+      return RMW_RET_OK;
+    }
+
+    // Should return loan before taking again
+    info->data_reader_->return_loan(item->data_seq, item->info_seq);
+  }
+
+  // No data available, return loan information.
+  loan_mgr->release_item(item);
+  info->listener_->update_has_data(info->data_reader_);
+  return RMW_RET_OK;
+}
+
 rmw_ret_t
 __rmw_take_loaned_message_internal(
   const char * identifier,
@@ -439,42 +852,86 @@ __rmw_take_loaned_message_internal(
   RMW_CHECK_ARGUMENT_FOR_NULL(loaned_message, RMW_RET_INVALID_ARGUMENT);
   RMW_CHECK_ARGUMENT_FOR_NULL(taken, RMW_RET_INVALID_ARGUMENT);
 
+  auto info = static_cast<CustomSubscriberInfo *>(subscription->data);
+  size_t taken_count = 0u;
+  rmw_ret_t ret = _take_loans(identifier, info, 1, loaned_message, message_info, &taken_count);
+  *taken = 0u != taken_count;
+  return ret;
+}
+
+rmw_ret_t
+__rmw_return_loaned_message_from_subscription(
+  const char * identifier,
+  const rmw_subscription_t * subscription,
+  void * loaned_message)
+{
+  RMW_CHECK_ARGUMENT_FOR_NULL(subscription, RMW_RET_INVALID_ARGUMENT);
+  RMW_CHECK_TYPE_IDENTIFIERS_MATCH(
+    subscription, subscription->implementation_identifier, identifier,
+    return RMW_RET_INCORRECT_RMW_IMPLEMENTATION);
+  if (!subscription->can_loan_messages) {
+    RMW_SET_ERROR_MSG("Loaning is not supported");
+    return RMW_RET_UNSUPPORTED;
+  }
+  RMW_CHECK_ARGUMENT_FOR_NULL(loaned_message, RMW_RET_INVALID_ARGUMENT);
+
   auto info = static_cast<CustomSubscriberInfo *>(subscription->data);
   auto loan_mgr = info->loan_manager_;
-  std::unique_lock<std::mutex> guard(loan_mgr->mtx);
-  auto item = loan_mgr->items.emplace_back();
-  if (nullptr == item) {
-    RMW_SET_ERROR_MSG("Out of resources for loaned message info");
-    return RMW_RET_ERROR;
+  std::lock_guard<std::mutex> guard(loan_mgr->mtx);
+  return loan_mgr->return_loan(info->data_reader_, loaned_message);
+}
+
+rmw_ret_t
+take_loaned_message_sequence(
+  const char * identifier,
+  const rmw_subscription_t * subscription,
+  size_t count,
+  rmw_message_sequence_t * message_sequence,
+  rmw_message_info_sequence_t * message_info_sequence,
+  size_t * taken)
+{
+  RMW_CHECK_ARGUMENT_FOR_NULL(subscription, RMW_RET_INVALID_ARGUMENT);
+  RMW_CHECK_TYPE_IDENTIFIERS_MATCH(
+    subscription, subscription->implementation_identifier, identifier,
+    return RMW_RET_INCORRECT_RMW_IMPLEMENTATION);
+  if (!subscription->can_loan_messages) {
+    RMW_SET_ERROR_MSG("Loaning is not supported");
+    return RMW_RET_UNSUPPORTED;
   }
+  RMW_CHECK_ARGUMENT_FOR_NULL(message_sequence, RMW_RET_INVALID_ARGUMENT);
+  RMW_CHECK_ARGUMENT_FOR_NULL(message_info_sequence, RMW_RET_INVALID_ARGUMENT);
+  RMW_CHECK_ARGUMENT_FOR_NULL(taken, RMW_RET_INVALID_ARGUMENT);
 
-  while (ReturnCode_t::RETCODE_OK == info->data_reader_->take(item->data_seq, item->info_seq, 1)) {
-    if (item->info_seq[0].valid_data) {
-      if (nullptr != message_info) {
-        _assign_message_info(identifier, message_info, &item->info_seq[0]);
-      }
-      *loaned_message = item->data_seq.buffer()[0];
-      *taken = true;
-      info->listener_->update_has_data(info->data_reader_);
-      return RMW_RET_OK;
-    }
+  if (0u == count) {
+    RMW_SET_ERROR_MSG("count cannot be 0");
+    return RMW_RET_INVALID_ARGUMENT;
+  }
 
-    // Should return loan before taking again
-    info->data_reader_->return_loan(item->data_seq, item->info_seq);
+  if (count > message_sequence->capacity) {
+    RMW_SET_ERROR_MSG("Insufficient capacity in message_sequence");
+    return RMW_RET_INVALID_ARGUMENT;
   }
 
-  // No data available, return loan information.
-  loan_mgr->items.pop_back();
-  *taken = false;
-  info->listener_->update_has_data(info->data_reader_);
-  return RMW_RET_OK;
+  if (count > message_info_sequence->capacity) {
+    RMW_SET_ERROR_MSG("Insufficient capacity in message_info_sequence");
+    return RMW_RET_INVALID_ARGUMENT;
+  }
+
+  auto info = static_cast<CustomSubscriberInfo *>(subscription->data);
+  auto max_samples = static_cast<int32_t>(
+    std::min<size_t>(count, std::numeric_limits<int32_t>::max()));
+  rmw_ret_t ret = _take_loans(
+    identifier, info, max_samples, message_sequence->data, message_info_sequence->data, taken);
+  message_sequence->size = *taken;
+  message_info_sequence->size = *taken;
+  return ret;
 }
 
 rmw_ret_t
-__rmw_return_loaned_message_from_subscription(
+return_loaned_message_sequence_from_subscription(
   const char * identifier,
   const rmw_subscription_t * subscription,
-  void * loaned_message)
+  rmw_message_sequence_t * message_sequence)
 {
   RMW_CHECK_ARGUMENT_FOR_NULL(subscription, RMW_RET_INVALID_ARGUMENT);
   RMW_CHECK_TYPE_IDENTIFIERS_MATCH(
@@ -484,23 +941,131 @@ __rmw_return_loaned_message_from_subscription(
     RMW_SET_ERROR_MSG("Loaning is not supported");
     return RMW_RET_UNSUPPORTED;
   }
-  RMW_CHECK_ARGUMENT_FOR_NULL(loaned_message, RMW_RET_INVALID_ARGUMENT);
+  RMW_CHECK_ARGUMENT_FOR_NULL(message_sequence, RMW_RET_INVALID_ARGUMENT);
 
   auto info = static_cast<CustomSubscriberInfo *>(subscription->data);
   auto loan_mgr = info->loan_manager_;
   std::lock_guard<std::mutex> guard(loan_mgr->mtx);
-  for (auto it = loan_mgr->items.begin(); it != loan_mgr->items.end(); ++it) {
-    if (loaned_message == it->data_seq.buffer()[0]) {
-      if (!info->data_reader_->return_loan(it->data_seq, it->info_seq)) {
-        RMW_SET_ERROR_MSG("Error returning loan");
-        return RMW_RET_ERROR;
+  for (size_t i = 0u; i < message_sequence->size; ++i) {
+    rmw_ret_t ret = loan_mgr->return_loan(info->data_reader_, message_sequence->data[i]);
+    if (RMW_RET_OK != ret) {
+      // Keep the messages not returned
+      if (0u != i) {
+        std::copy(
+          message_sequence->data + i, message_sequence->data + message_sequence->size,
+          message_sequence->data);
+        message_sequence->size -= i;
       }
-      loan_mgr->items.erase(it);
-      return RMW_RET_OK;
+      return ret;
     }
   }
+  message_sequence->size = 0u;
+  return RMW_RET_OK;
+}
 
-  RMW_SET_ERROR_MSG("Trying to return message not loaned by this subscription");
-  return RMW_RET_ERROR;
+// Check the subscription of a serialized loan, and get its info
+static
+rmw_ret_t
+get_loaning_subscription_info(
+  const char * identifier,
+  const rmw_subscription_t * subscription,
+  CustomSubscriberInfo ** info)
+{
+  RMW_CHECK_ARGUMENT_FOR_NULL(subscription, RMW_RET_INVALID_ARGUMENT);
+  RMW_CHECK_TYPE_IDENTIFIERS_MATCH(
+    subscription, subscription->implementation_identifier, identifier,
+    return RMW_RET_INCORRECT_RMW_IMPLEMENTATION);
+  *info = static_cast<CustomSubscriberInfo *>(subscription->data);
+  if (!(*info)->can_loan_serialized_messages_) {
+    RMW_SET_ERROR_MSG("Loaning serialized messages is not supported");
+    return RMW_RET_UNSUPPORTED;
+  }
+  return RMW_RET_OK;
+}
+
+rmw_ret_t
+subscription_can_loan_serialized_messages(
+  const char * identifier,
+  const rmw_subscription_t * subscription,
+  bool * can_loan)
+{
+  RMW_CHECK_ARGUMENT_FOR_NULL(subscription, RMW_RET_INVALID_ARGUMENT);
+  RMW_CHECK_TYPE_IDENTIFIERS_MATCH(
+    subscription, subscription->implementation_identifier, identifier,
+    return RMW_RET_INCORRECT_RMW_IMPLEMENTATION);
+  RMW_CHECK_ARGUMENT_FOR_NULL(can_loan, RMW_RET_INVALID_ARGUMENT);
+
+  auto info = static_cast<const CustomSubscriberInfo *>(subscription->data);
+  *can_loan = info->can_loan_serialized_messages_;
+  return RMW_RET_OK;
+}
+
+rmw_ret_t
+take_loaned_serialized_message(
+  const char * identifier,
+  const rmw_subscription_t * subscription,
+  rmw_serialized_message_t * serialized_message,
+  bool * taken,
+  rmw_message_info_t * message_info)
+{
+  CustomSubscriberInfo * info = nullptr;
+  rmw_ret_t ret = get_loaning_subscription_info(identifier, subscription, &info);
+  if (RMW_RET_OK != ret) {
+    return ret;
+  }
+  RMW_CHECK_ARGUMENT_FOR_NULL(serialized_message, RMW_RET_INVALID_ARGUMENT);
+  RMW_CHECK_ARGUMENT_FOR_NULL(taken, RMW_RET_INVALID_ARGUMENT);
+  if (nullptr != serialized_message->buffer) {
+    RMW_SET_ERROR_MSG("serialized message already holds a buffer");
+    return RMW_RET_INVALID_ARGUMENT;
+  }
+
+  void * sample = nullptr;
+  size_t taken_count = 0u;
+  ret = _take_loans(identifier, info, 1, &sample, message_info, &taken_count);
+  *taken = 0u != taken_count;
+  if (RMW_RET_OK != ret || !*taken) {
+    return ret;
+  }
+
+  // Fast DDS loans the sample past the encapsulation of the payload it is held in.
+  // The zero initialized allocator keeps the payload from being resized or deallocated.
+  serialized_message->buffer = static_cast<uint8_t *>(sample) -
+    eprosima::fastrtps::rtps::SerializedPayload_t::representation_header_size;
+  // Payloads are written whole, with the length of their message in a trailer.
+  auto type_support = static_cast<const TypeSupport *>(info->type_support_.get());
+  serialized_message->buffer_length =
+    type_support->get_serialized_loan_length(serialized_message->buffer);
+  serialized_message->buffer_capacity = type_support->serialized_loan_capacity();
+  serialized_message->allocator = rcutils_get_zero_initialized_allocator();
+  return RMW_RET_OK;
+}
+
+rmw_ret_t
+return_loaned_serialized_message_from_subscription(
+  const char * identifier,
+  const rmw_subscription_t * subscription,
+  rmw_serialized_message_t * serialized_message)
+{
+  CustomSubscriberInfo * info = nullptr;
+  rmw_ret_t ret = get_loaning_subscription_info(identifier, subscription, &info);
+  if (RMW_RET_OK != ret) {
+    return ret;
+  }
+  RMW_CHECK_ARGUMENT_FOR_NULL(serialized_message, RMW_RET_INVALID_ARGUMENT);
+  RMW_CHECK_ARGUMENT_FOR_NULL(serialized_message->buffer, RMW_RET_INVALID_ARGUMENT);
+
+  {
+    auto loan_mgr = info->loan_manager_;
+    std::lock_guard<std::mutex> guard(loan_mgr->mtx);
+    ret = loan_mgr->return_loan(
+      info->data_reader_, serialized_message->buffer +
+      eprosima::fastrtps::rtps::SerializedPayload_t::representation_header_size);
+  }
+  if (RMW_RET_OK != ret) {
+    return ret;
+  }
+  *serialized_message = rmw_get_zero_initialized_serialized_message();
+  return RMW_RET_OK;
 }
 }  // namespace rmw_fastrtps_shared_cpp
@@ -12,6 +12,13 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <utility>
+#include <vector>
+
 #include "rcutils/macros.h"
 
 #include "rmw/error_handling.h"
@@ -24,42 +31,93 @@
 #include "types/custom_wait_set_info.hpp"
 #include "types/guard_condition.hpp"
 
-// helper function for wait
-bool
-check_wait_set_for_data(
+// Store the entities of a wait call, returning whether they differ from the stored ones
+static bool
+store_entities(std::vector<void *> & stored, void ** entities, size_t count)
+{
+  if (stored.size() == count && std::equal(stored.begin(), stored.end(), entities)) {
+    return false;
+  }
+  stored.assign(entities, entities + count);
+  return true;
+}
+
+static bool
+store_events(
+  std::vector<std::pair<void *, rmw_event_type_t>> & stored,
+  const rmw_events_t * events)
+{
+  size_t count = events ? events->event_count : 0u;
+  bool changed = stored.size() != count;
+  stored.resize(count);
+  for (size_t i = 0; i < count; ++i) {
+    auto event = static_cast<rmw_event_t *>(events->events[i]);
+    std::pair<void *, rmw_event_type_t> entry(event->data, event->event_type);
+    if (stored[i] != entry) {
+      stored[i] = entry;
+      changed = true;
+    }
+  }
+  return changed;
+}
+
+using Entry = CustomWaitsetEntry;
+
+// Order entries by listener, so the entities of a listener can be found with a binary search
+struct EntryListenerLess
+{
+  bool operator()(const Entry & lhs, const Entry & rhs) const
+  {
+    return std::less<ConditionListenerInterface *>()(lhs.listener, rhs.listener);
+  }
+
+  bool operator()(const Entry & entry, ConditionListenerInterface * listener) const
+  {
+    return std::less<ConditionListenerInterface *>()(entry.listener, listener);
+  }
+
+  bool operator()(ConditionListenerInterface * listener, const Entry & entry) const
+  {
+    return std::less<ConditionListenerInterface *>()(listener, entry.listener);
+  }
+};
+
+// Gather the entities of a wait call along with their listeners
+static void
+collect_entries(
   const rmw_subscriptions_t * subscriptions,
   const rmw_guard_conditions_t * guard_conditions,
   const rmw_services_t * services,
   const rmw_clients_t * clients,
-  const rmw_events_t * events)
+  const rmw_events_t * events,
+  std::vector<Entry> & entries)
 {
+  entries.clear();
+
   if (subscriptions) {
     for (size_t i = 0; i < subscriptions->subscriber_count; ++i) {
-      void * data = subscriptions->subscribers[i];
-      auto custom_subscriber_info = static_cast<CustomSubscriberInfo *>(data);
-      // Short circuiting out of this function is possible
-      if (custom_subscriber_info && custom_subscriber_info->listener_->hasData()) {
-        return true;
+      auto custom_subscriber_info = static_cast<CustomSubscriberInfo *>(
+        subscriptions->subscribers[i]);
+      if (custom_subscriber_info) {
+        entries.push_back({custom_subscriber_info->listener_, Entry::Kind::SUBSCRIPTION, i});
       }
     }
   }
 
   if (clients) {
     for (size_t i = 0; i < clients->client_count; ++i) {
-      void * data = clients->clients[i];
-      auto custom_client_info = static_cast<CustomClientInfo *>(data);
-      if (custom_client_info && custom_client_info->listener_->hasData()) {
-        return true;
+      auto custom_client_info = static_cast<CustomClientInfo *>(clients->clients[i]);
+      if (custom_client_info) {
+        entries.push_back({custom_client_info->listener_, Entry::Kind::CLIENT, i});
       }
     }
   }
 
   if (services) {
     for (size_t i = 0; i < services->service_count; ++i) {
-      void * data = services->services[i];
-      auto custom_service_info = static_cast<CustomServiceInfo *>(data);
-      if (custom_service_info && custom_service_info->listener_->hasData()) {
-        return true;
+      auto custom_service_info = static_cast<CustomServiceInfo *>(services->services[i]);
+      if (custom_service_info) {
+        entries.push_back({custom_service_info->listener_, Entry::Kind::SERVICE, i});
       }
     }
   }
@@ -68,24 +126,109 @@ check_wait_set_for_data(
     for (size_t i = 0; i < events->event_count; ++i) {
       auto event = static_cast<rmw_event_t *>(events->events[i]);
       auto custom_event_info = static_cast<CustomEventInfo *>(event->data);
-      if (custom_event_info->getListener()->hasEvent(event->event_type)) {
-        return true;
-      }
+      entries.push_back({custom_event_info->getListener(), Entry::Kind::EVENT, i});
     }
   }
 
   if (guard_conditions) {
     for (size_t i = 0; i < guard_conditions->guard_condition_count; ++i) {
-      void * data = guard_conditions->guard_conditions[i];
-      auto guard_condition = static_cast<GuardCondition *>(data);
-      if (guard_condition && guard_condition->hasTriggered()) {
-        return true;
+      auto guard_condition = static_cast<GuardCondition *>(
+        guard_conditions->guard_conditions[i]);
+      if (guard_condition) {
+        entries.push_back({guard_condition, Entry::Kind::GUARD_CONDITION, i});
       }
     }
   }
+
+  std::stable_sort(entries.begin(), entries.end(), EntryListenerLess());
+}
+
+// Check whether the entity of an entry is ready, without consuming a guard condition trigger
+static bool
+is_entry_ready(const CustomWaitsetInfo * wait_set_info, const Entry & entry)
+{
+  switch (entry.kind) {
+    case Entry::Kind::SUBSCRIPTION:
+      return static_cast<CustomSubscriberInfo *>(
+        wait_set_info->subscriptions[entry.index])->listener_->hasData();
+    case Entry::Kind::CLIENT:
+      return static_cast<CustomClientInfo *>(
+        wait_set_info->clients[entry.index])->listener_->hasData();
+    case Entry::Kind::SERVICE:
+      return static_cast<CustomServiceInfo *>(
+        wait_set_info->services[entry.index])->listener_->hasData();
+    case Entry::Kind::EVENT:
+      {
+        const auto & event = wait_set_info->events[entry.index];
+        return static_cast<CustomEventInfo *>(event.first)->getListener()->hasEvent(event.second);
+      }
+    case Entry::Kind::GUARD_CONDITION:
+      return static_cast<GuardCondition *>(
+        wait_set_info->guard_conditions[entry.index])->hasTriggered(&wait_set_info->condition);
+  }
   return false;
 }
 
+// Keep only the ready candidates with at least one ready entity, returning whether any is left
+static bool
+check_ready_listeners(CustomWaitsetInfo * wait_set_info)
+{
+  auto & listeners = wait_set_info->ready_listeners;
+  std::sort(listeners.begin(), listeners.end(), std::less<ConditionListenerInterface *>());
+  listeners.erase(std::unique(listeners.begin(), listeners.end()), listeners.end());
+
+  const auto & entries = wait_set_info->entries;
+  auto is_not_ready = [wait_set_info, &entries](ConditionListenerInterface * listener) {
+      auto range = std::equal_range(
+        entries.begin(), entries.end(), listener, EntryListenerLess());
+      return std::none_of(
+        range.first, range.second, [wait_set_info](const Entry & entry) {
+          return is_entry_ready(wait_set_info, entry);
+        });
+    };
+  listeners.erase(
+    std::remove_if(listeners.begin(), listeners.end(), is_not_ready), listeners.end());
+  return !listeners.empty();
+}
+
+static inline void
+cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  asm volatile ("yield");
+#endif
+}
+
+// Spin until a ready candidate of the condition satisfies the predicate, for at most `duration`.
+// The lock is released while spinning, and held again on return.
+template<typename PredicateT>
+static bool
+spin_for_data(
+  WaitSetCondition * condition,
+  std::unique_lock<std::mutex> & lock,
+  std::chrono::nanoseconds duration,
+  PredicateT & predicate)
+{
+  const auto deadline = std::chrono::steady_clock::now() + duration;
+  lock.unlock();
+  while (true) {
+    if (condition->has_ready()) {
+      lock.lock();
+      if (predicate()) {
+        return true;
+      }
+      lock.unlock();
+    }
+    if (std::chrono::steady_clock::now() >= deadline) {
+      lock.lock();
+      return false;
+    }
+    cpu_relax();
+  }
+}
+
 namespace rmw_fastrtps_shared_cpp
 {
 rmw_ret_t
@@ -115,135 +258,178 @@ __rmw_wait(
   // - Heap is corrupt.
   // In all three cases, it's better if this crashes soon enough.
   auto wait_set_info = static_cast<CustomWaitsetInfo *>(wait_set->data);
-  std::mutex * conditionMutex = &wait_set_info->condition_mutex;
-  std::condition_variable * conditionVariable = &wait_set_info->condition;
-
-  if (subscriptions) {
-    for (size_t i = 0; i < subscriptions->subscriber_count; ++i) {
-      void * data = subscriptions->subscribers[i];
-      auto custom_subscriber_info = static_cast<CustomSubscriberInfo *>(data);
-      custom_subscriber_info->listener_->attachCondition(conditionMutex, conditionVariable);
-    }
-  }
+  WaitSetCondition * condition = &wait_set_info->condition;
 
-  if (clients) {
-    for (size_t i = 0; i < clients->client_count; ++i) {
-      void * data = clients->clients[i];
-      auto custom_client_info = static_cast<CustomClientInfo *>(data);
-      custom_client_info->listener_->attachCondition(conditionMutex, conditionVariable);
-    }
-  }
-
-  if (services) {
-    for (size_t i = 0; i < services->service_count; ++i) {
-      void * data = services->services[i];
-      auto custom_service_info = static_cast<CustomServiceInfo *>(data);
-      custom_service_info->listener_->attachCondition(conditionMutex, conditionVariable);
-    }
-  }
+  // Listeners are kept attached to the wait set between calls, so they only need to be
+  // updated when the entities differ from the previous call, or some of them were detached.
+  bool entities_changed = store_entities(
+    wait_set_info->subscriptions,
+    subscriptions ? subscriptions->subscribers : nullptr,
+    subscriptions ? subscriptions->subscriber_count : 0u);
+  entities_changed |= store_entities(
+    wait_set_info->clients,
+    clients ? clients->clients : nullptr,
+    clients ? clients->client_count : 0u);
+  entities_changed |= store_entities(
+    wait_set_info->services,
+    services ? services->services : nullptr,
+    services ? services->service_count : 0u);
+  entities_changed |= store_events(wait_set_info->events, events);
+  entities_changed |= store_entities(
+    wait_set_info->guard_conditions,
+    guard_conditions ? guard_conditions->guard_conditions : nullptr,
+    guard_conditions ? guard_conditions->guard_condition_count : 0u);
 
-  if (events) {
-    for (size_t i = 0; i < events->event_count; ++i) {
-      auto event = static_cast<rmw_event_t *>(events->events[i]);
-      auto custom_event_info = static_cast<CustomEventInfo *>(event->data);
-      custom_event_info->getListener()->attachCondition(conditionMutex, conditionVariable);
-    }
-  }
-
-  if (guard_conditions) {
-    for (size_t i = 0; i < guard_conditions->guard_condition_count; ++i) {
-      void * data = guard_conditions->guard_conditions[i];
-      auto guard_condition = static_cast<GuardCondition *>(data);
-      guard_condition->attachCondition(conditionMutex, conditionVariable);
+  if (entities_changed || wait_set_info->attachments_changed.load()) {
+    collect_entries(
+      subscriptions, guard_conditions, services, clients, events, wait_set_info->entries);
+    std::vector<ConditionListenerInterface *> listeners;
+    listeners.reserve(wait_set_info->entries.size());
+    for (const auto & entry : wait_set_info->entries) {
+      if (listeners.empty() || listeners.back() != entry.listener) {
+        listeners.push_back(entry.listener);
+      }
     }
+    // Newly attached listeners are pushed as ready candidates, so they are checked below
+    rmw_fastrtps_shared_cpp::internal::update_wait_set_attachments(wait_set_info, listeners);
   }
 
   // This mutex prevents any of the listeners
   // to change the internal state and notify the condition
-  // between the call to hasData() / hasTriggered() and wait()
-  // otherwise the decision to wait might be incorrect
-  std::unique_lock<std::mutex> lock(*conditionMutex);
-
-  bool hasData = check_wait_set_for_data(
-    subscriptions, guard_conditions, services, clients, events);
-  auto predicate = [subscriptions, guard_conditions, services, clients, events]() {
-      return check_wait_set_for_data(subscriptions, guard_conditions, services, clients, events);
+  // between the check of the ready candidates and wait()
+  // otherwise the decision to wait might be incorrect.
+  // Only the listeners that notified since the previous check, plus the ones found ready
+  // by the previous call, have to be checked.
+  std::unique_lock<std::mutex> lock(condition->mutex);
+
+  // While nothing is ready, the wait set is eligible to be woken up by the next notification
+  // of its listeners, which only wake up one of the wait sets waiting for them.
+  auto predicate = [wait_set_info, condition]() RCPPUTILS_TSA_REQUIRES(condition->mutex)->bool {
+      condition->take_ready(wait_set_info->ready_listeners);
+      bool ready = check_ready_listeners(wait_set_info);
+      condition->set_waiting(!ready);
+      return ready;
     };
+  bool hasData = predicate();
 
   bool timeout = false;
   if (!hasData) {
-    if (!wait_timeout) {
-      conditionVariable->wait(lock, predicate);
-    } else if (wait_timeout->sec > 0 || wait_timeout->nsec > 0) {
-      auto n = std::chrono::duration_cast<std::chrono::nanoseconds>(
-        std::chrono::seconds(wait_timeout->sec));
-      n += std::chrono::nanoseconds(wait_timeout->nsec);
-      timeout = !conditionVariable->wait_for(lock, n, predicate);
-    } else {
+    if (wait_timeout && wait_timeout->sec == 0 && wait_timeout->nsec == 0) {
       timeout = true;
+    } else {
+      auto n = std::chrono::nanoseconds::max();
+      if (wait_timeout) {
+        n = std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::seconds(wait_timeout->sec));
+        n += std::chrono::nanoseconds(wait_timeout->nsec);
+      }
+
+      // Poll the listeners for a while before blocking, if enabled
+      const auto spin_budget = wait_set_info->spin_budget.load();
+      const bool spin = spin_budget.count() > 0;
+      std::chrono::steady_clock::time_point start;
+      if (spin) {
+        start = std::chrono::steady_clock::now();
+        hasData = spin_for_data(condition, lock, std::min(spin_budget, n), predicate);
+        if (hasData) {
+          ++wait_set_info->spin_hits;
+        } else {
+          ++wait_set_info->spin_misses;
+          if (wait_timeout) {
+            n -= std::chrono::steady_clock::now() - start;
+          }
+        }
+      }
+
+      if (!hasData) {
+        if (!wait_timeout) {
+          condition->condition_variable.wait(lock, predicate);
+        } else {
+          timeout = !condition->condition_variable.wait_for(lock, n, predicate);
+        }
+      }
+
+      if (spin) {
+        rmw_fastrtps_shared_cpp::internal::update_wait_set_spin_budget(
+          wait_set_info,
+          timeout ? std::chrono::nanoseconds::max() : std::chrono::steady_clock::now() - start);
+      }
     }
   }
 
-  // Unlock the condition variable mutex to prevent deadlocks that can occur if
-  // a listener triggers while the condition variable is being detached.
   // Listeners will no longer be prevented from changing their internal state,
   // but that should not cause issues (if a listener has data / has triggered
   // after we check, it will be caught on the next call to this function).
+  condition->set_waiting(false);
   lock.unlock();
 
-  if (subscriptions) {
-    for (size_t i = 0; i < subscriptions->subscriber_count; ++i) {
-      void * data = subscriptions->subscribers[i];
-      auto custom_subscriber_info = static_cast<CustomSubscriberInfo *>(data);
-      custom_subscriber_info->listener_->detachCondition();
-      if (!custom_subscriber_info->listener_->hasData()) {
-        subscriptions->subscribers[i] = 0;
+  // Gather the ready entities before clearing the arrays.
+  // Guard conditions triggers are consumed here, for this wait set only.
+  auto & ready_slots = wait_set_info->ready_slots;
+  ready_slots.clear();
+  auto & ready_listeners = wait_set_info->ready_listeners;
+  auto reported_end = ready_listeners.begin();
+  for (auto listener : ready_listeners) {
+    bool reported = false;
+    auto range = std::equal_range(
+      wait_set_info->entries.begin(), wait_set_info->entries.end(), listener,
+      EntryListenerLess());
+    for (auto it = range.first; it != range.second; ++it) {
+      void ** slot = nullptr;
+      bool ready = false;
+      switch (it->kind) {
+        case Entry::Kind::SUBSCRIPTION:
+          slot = &subscriptions->subscribers[it->index];
+          ready = static_cast<CustomSubscriberInfo *>(*slot)->listener_->hasData();
+          break;
+        case Entry::Kind::CLIENT:
+          slot = &clients->clients[it->index];
+          ready = static_cast<CustomClientInfo *>(*slot)->listener_->hasData();
+          break;
+        case Entry::Kind::SERVICE:
+          slot = &services->services[it->index];
+          ready = static_cast<CustomServiceInfo *>(*slot)->listener_->hasData();
+          break;
+        case Entry::Kind::EVENT:
+          slot = &events->events[it->index];
+          ready = is_entry_ready(wait_set_info, *it);
+          break;
+        case Entry::Kind::GUARD_CONDITION:
+          slot = &guard_conditions->guard_conditions[it->index];
+          ready = static_cast<GuardCondition *>(*slot)->getHasTriggered(
+            &wait_set_info->condition);
+          break;
+      }
+      if (ready) {
+        ready_slots.emplace_back(slot, *slot);
+        reported = true;
       }
     }
+    // Listeners reported as ready are checked again on the next call, as they may still be
+    if (reported) {
+      *reported_end++ = listener;
+    }
   }
+  ready_listeners.erase(reported_end, ready_listeners.end());
 
+  if (subscriptions) {
+    std::fill_n(subscriptions->subscribers, subscriptions->subscriber_count, nullptr);
+  }
   if (clients) {
-    for (size_t i = 0; i < clients->client_count; ++i) {
-      void * data = clients->clients[i];
-      auto custom_client_info = static_cast<CustomClientInfo *>(data);
-      custom_client_info->listener_->detachCondition();
-      if (!custom_client_info->listener_->hasData()) {
-        clients->clients[i] = 0;
-      }
-    }
+    std::fill_n(clients->clients, clients->client_count, nullptr);
   }
-
   if (services) {
-    for (size_t i = 0; i < services->service_count; ++i) {
-      void * data = services->services[i];
-      auto custom_service_info = static_cast<CustomServiceInfo *>(data);
-      custom_service_info->listener_->detachCondition();
-      if (!custom_service_info->listener_->hasData()) {
-        services->services[i] = 0;
-      }
-    }
+    std::fill_n(services->services, services->service_count, nullptr);
   }
-
   if (events) {
-    for (size_t i = 0; i < events->event_count; ++i) {
-      auto event = static_cast<rmw_event_t *>(events->events[i]);
-      auto custom_event_info = static_cast<CustomEventInfo *>(event->data);
-      custom_event_info->getListener()->detachCondition();
-      if (!custom_event_info->getListener()->hasEvent(event->event_type)) {
-        events->events[i] = nullptr;
-      }
-    }
+    std::fill_n(events->events, events->event_count, nullptr);
   }
-
   if (guard_conditions) {
-    for (size_t i = 0; i < guard_conditions->guard_condition_count; ++i) {
-      void * data = guard_conditions->guard_conditions[i];
-      auto guard_condition = static_cast<GuardCondition *>(data);
-      guard_condition->detachCondition();
-      if (!guard_condition->getHasTriggered()) {
-        guard_conditions->guard_conditions[i] = 0;
-      }
-    }
+    std::fill_n(
+      guard_conditions->guard_conditions, guard_conditions->guard_condition_count, nullptr);
+  }
+  for (const auto & ready_slot : ready_slots) {
+    *ready_slot.first = ready_slot.second;
   }
 
   return timeout ? RMW_RET_TIMEOUT : RMW_RET_OK;
@@ -12,6 +12,15 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "rcpputils/thread_safety_annotations.hpp"
+
 #include "rcutils/macros.h"
 
 #include "rmw/allocators.h"
@@ -23,8 +32,113 @@
 
 #include "types/custom_wait_set_info.hpp"
 
+// Protects the attached listeners of every wait set, as well as the map below.
+static std::mutex g_attachments_mutex;
+// Wait sets each attached listener notifies.
+static std::unordered_map<ConditionListenerInterface *, std::vector<CustomWaitsetInfo *>>
+g_attached_wait_sets RCPPUTILS_TSA_GUARDED_BY(g_attachments_mutex);
+
+static void
+remove_attached_listener(
+  CustomWaitsetInfo * wait_set_info,
+  ConditionListenerInterface * listener)
+RCPPUTILS_TSA_REQUIRES(g_attachments_mutex)
+{
+  auto & attached = wait_set_info->attached_listeners;
+  auto it = std::lower_bound(
+    attached.begin(), attached.end(), listener, std::less<ConditionListenerInterface *>());
+  if (it != attached.end() && *it == listener) {
+    attached.erase(it);
+  }
+  wait_set_info->attachments_changed.store(true);
+}
+
+static void
+unregister_attachment(
+  ConditionListenerInterface * listener,
+  CustomWaitsetInfo * wait_set_info)
+RCPPUTILS_TSA_REQUIRES(g_attachments_mutex)
+{
+  auto it = g_attached_wait_sets.find(listener);
+  if (it == g_attached_wait_sets.end()) {
+    return;
+  }
+  auto & wait_sets = it->second;
+  wait_sets.erase(std::remove(wait_sets.begin(), wait_sets.end(), wait_set_info), wait_sets.end());
+  if (wait_sets.empty()) {
+    g_attached_wait_sets.erase(it);
+  }
+}
+
 namespace rmw_fastrtps_shared_cpp
 {
+namespace internal
+{
+
+void
+update_wait_set_attachments(
+  CustomWaitsetInfo * wait_set_info,
+  std::vector<ConditionListenerInterface *> & listeners)
+{
+  std::less<ConditionListenerInterface *> less;
+  std::sort(listeners.begin(), listeners.end(), less);
+  listeners.erase(std::unique(listeners.begin(), listeners.end()), listeners.end());
+
+  std::lock_guard<std::mutex> lock(g_attachments_mutex);
+  wait_set_info->attachments_changed.store(false);
+
+  auto & attached = wait_set_info->attached_listeners;
+  std::vector<ConditionListenerInterface *> to_detach;
+  std::set_difference(
+    attached.begin(), attached.end(), listeners.begin(), listeners.end(),
+    std::back_inserter(to_detach), less);
+  std::vector<ConditionListenerInterface *> to_attach;
+  std::set_difference(
+    listeners.begin(), listeners.end(), attached.begin(), attached.end(),
+    std::back_inserter(to_attach), less);
+
+  for (auto listener : to_detach) {
+    listener->detachCondition(&wait_set_info->condition);
+    unregister_attachment(listener, wait_set_info);
+  }
+
+  // A listener may stay attached to other wait sets, which wait for it concurrently
+  for (auto listener : to_attach) {
+    listener->attachCondition(&wait_set_info->condition);
+    g_attached_wait_sets[listener].push_back(wait_set_info);
+  }
+
+  attached = listeners;
+}
+
+void
+detach_wait_set_listeners(CustomWaitsetInfo * wait_set_info)
+{
+  std::lock_guard<std::mutex> lock(g_attachments_mutex);
+  for (auto listener : wait_set_info->attached_listeners) {
+    listener->detachCondition(&wait_set_info->condition);
+    unregister_attachment(listener, wait_set_info);
+  }
+  wait_set_info->attached_listeners.clear();
+}
+
+void
+detach_listener_from_wait_sets(ConditionListenerInterface * listener)
+{
+  std::lock_guard<std::mutex> lock(g_attachments_mutex);
+  auto it = g_attached_wait_sets.find(listener);
+  if (it == g_attached_wait_sets.end()) {
+    return;
+  }
+  for (auto wait_set_info : it->second) {
+    remove_attached_listener(wait_set_info, listener);
+    listener->detachCondition(&wait_set_info->condition);
+  }
+  g_attached_wait_sets.erase(it);
+}
+
+}  // namespace internal
+
 rmw_wait_set_t *
 __rmw_create_wait_set(const char * identifier, rmw_context_t * context, size_t max_conditions)
 {
@@ -59,7 +173,8 @@ __rmw_create_wait_set(const char * identifier, rmw_context_t * context, size_t m
     goto fail,
     // cppcheck-suppress syntaxError
     CustomWaitsetInfo, );
-  (void) wait_set_info;
+  wait_set_info->max_spin = internal::default_wait_set_max_spin();
+  wait_set_info->spin_budget.store(wait_set_info->max_spin);
 
   return wait_set;
 
@@ -93,6 +208,7 @@ __rmw_destroy_wait_set(const char * identifier, rmw_wait_set_t * wait_set)
 
   if (wait_set->data) {
     if (wait_set_info) {
+      internal::detach_wait_set_listeners(wait_set_info);
       RMW_TRY_DESTRUCTOR(
         wait_set_info->~CustomWaitsetInfo(), wait_set_info, result = RMW_RET_ERROR)
     }
@@ -0,0 +1,192 @@
+// Copyright 2021 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstdint>
+
+#include "fastdds/dds/publisher/DataWriter.hpp"
+#include "fastdds/rtps/common/SerializedPayload.h"
+
+#include "rcutils/allocator.h"
+
+#include "rmw/error_handling.h"
+#include "rmw/impl/cpp/macros.hpp"
+#include "rmw/rmw.h"
+#include "rmw/serialized_message.h"
+
+#include "rmw_fastrtps_shared_cpp/custom_publisher_info.hpp"
+#include "rmw_fastrtps_shared_cpp/publisher_coalescing.hpp"
+#include "rmw_fastrtps_shared_cpp/publisher_statistics.hpp"
+#include "rmw_fastrtps_shared_cpp/serialized_loans.hpp"
+#include "rmw_fastrtps_shared_cpp/TypeSupport.hpp"
+
+using eprosima::fastrtps::rtps::SerializedPayload_t;
+
+namespace rmw_fastrtps_shared_cpp
+{
+
+// Check the publisher of a serialized loan, and get its info
+static
+rmw_ret_t
+get_loaning_publisher_info(
+  const char * identifier,
+  const rmw_publisher_t * publisher,
+  CustomPublisherInfo ** info)
+{
+  RMW_CHECK_ARGUMENT_FOR_NULL(publisher, RMW_RET_INVALID_ARGUMENT);
+  RMW_CHECK_TYPE_IDENTIFIERS_MATCH(
+    publisher, publisher->implementation_identifier, identifier,
+    return RMW_RET_INCORRECT_RMW_IMPLEMENTATION);
+  *info = static_cast<CustomPublisherInfo *>(publisher->data);
+  if (!(*info)->can_loan_serialized_messages_) {
+    RMW_SET_ERROR_MSG("Loaning serialized messages is not supported");
+    return RMW_RET_UNSUPPORTED;
+  }
+  return RMW_RET_OK;
+}
+
+// Type support of a publisher, which can loan serialized messages
+static
+const TypeSupport *
+get_type_support(const CustomPublisherInfo * info)
+{
+  return static_cast<const TypeSupport *>(info->type_support_.get());
+}
+
+// Fast DDS loans the sample past the encapsulation, which the serialized message starts with
+static
+void *
+get_sample(const rmw_serialized_message_t * serialized_message)
+{
+  return serialized_message->buffer + SerializedPayload_t::representation_header_size;
+}
+
+rmw_ret_t
+publisher_can_loan_serialized_messages(
+  const char * identifier,
+  const rmw_publisher_t * publisher,
+  bool * can_loan)
+{
+  RMW_CHECK_ARGUMENT_FOR_NULL(publisher, RMW_RET_INVALID_ARGUMENT);
+  RMW_CHECK_TYPE_IDENTIFIERS_MATCH(
+    publisher, publisher->implementation_identifier, identifier,
+    return RMW_RET_INCORRECT_RMW_IMPLEMENTATION);
+  RMW_CHECK_ARGUMENT_FOR_NULL(can_loan, RMW_RET_INVALID_ARGUMENT);
+
+  auto info = static_cast<const CustomPublisherInfo *>(publisher->data);
+  *can_loan = info->can_loan_serialized_messages_;
+  return RMW_RET_OK;
+}
+
+rmw_ret_t
+borrow_loaned_serialized_message(
+  const char * identifier,
+  const rmw_publisher_t * publisher,
+  rmw_serialized_message_t * serialized_message)
+{
+  CustomPublisherInfo * info = nullptr;
+  rmw_ret_t ret = get_loaning_publisher_info(identifier, publisher, &info);
+  if (RMW_RET_OK != ret) {
+    return ret;
+  }
+  RMW_CHECK_ARGUMENT_FOR_NULL(serialized_message, RMW_RET_INVALID_ARGUMENT);
+  if (nullptr != serialized_message->buffer) {
+    RMW_SET_ERROR_MSG("serialized message already holds a buffer");
+    return RMW_RET_INVALID_ARGUMENT;
+  }
+
+  void * sample = nullptr;
+  if (!info->data_writer_->loan_sample(sample)) {
+    RMW_SET_ERROR_MSG("cannot loan a sample");
+    return RMW_RET_ERROR;
+  }
+
+  // The zero initialized allocator keeps the sample from being resized or deallocated
+  serialized_message->buffer =
+    static_cast<uint8_t *>(sample) - SerializedPayload_t::representation_header_size;
+  serialized_message->buffer_length = 0u;
+  serialized_message->buffer_capacity = get_type_support(info)->serialized_loan_capacity();
+  serialized_message->allocator = rcutils_get_zero_initialized_allocator();
+  return RMW_RET_OK;
+}
+
+rmw_ret_t
+return_loaned_serialized_message_from_publisher(
+  const char * identifier,
+  const rmw_publisher_t * publisher,
+  rmw_serialized_message_t * serialized_message)
+{
+  CustomPublisherInfo * info = nullptr;
+  rmw_ret_t ret = get_loaning_publisher_info(identifier, publisher, &info);
+  if (RMW_RET_OK != ret) {
+    return ret;
+  }
+  RMW_CHECK_ARGUMENT_FOR_NULL(serialized_message, RMW_RET_INVALID_ARGUMENT);
+  RMW_CHECK_ARGUMENT_FOR_NULL(serialized_message->buffer, RMW_RET_INVALID_ARGUMENT);
+
+  void * sample = get_sample(serialized_message);
+  if (!info->data_writer_->discard_loan(sample)) {
+    RMW_SET_ERROR_MSG("serialized message was not loaned by this publisher");
+    return RMW_RET_ERROR;
+  }
+
+  *serialized_message = rmw_get_zero_initialized_serialized_message();
+  return RMW_RET_OK;
+}
+
+rmw_ret_t
+publish_loaned_serialized_message(
+  const char * identifier,
+  const rmw_publisher_t * publisher,
+  rmw_serialized_message_t * serialized_message)
+{
+  CustomPublisherInfo * info = nullptr;
+  rmw_ret_t ret = get_loaning_publisher_info(identifier, publisher, &info);
+  if (RMW_RET_OK != ret) {
+    return ret;
+  }
+  RMW_CHECK_ARGUMENT_FOR_NULL(serialized_message, RMW_RET_INVALID_ARGUMENT);
+  RMW_CHECK_ARGUMENT_FOR_NULL(serialized_message->buffer, RMW_RET_INVALID_ARGUMENT);
+  if (serialized_message->buffer_length < SerializedPayload_t::representation_header_size ||
+    serialized_message->buffer_length > get_type_support(info)->serialized_loan_capacity())
+  {
+    RMW_SET_ERROR_MSG("serialized message does not fit the loaned sample");
+    return RMW_RET_INVALID_ARGUMENT;
+  }
+
+  // Messages held back are published before this one
+  if (info->coalescing_) {
+    ret = info->coalescing_->flush();
+    if (RMW_RET_OK != ret) {
+      info->statistics_.add_failed_messages(1u);
+      return ret;
+    }
+  }
+  // Already serialized in the sample, which Fast DDS writes as is, so whole.
+  // The length is kept with the message for readers to tell where it ends.
+  get_type_support(info)->set_serialized_loan_length(
+    serialized_message->buffer, serialized_message->buffer_length);
+  if (!info->statistics_.write_sample(
+      info->data_writer_, get_sample(serialized_message), serialized_message->buffer_length))
+  {
+    info->statistics_.add_failed_messages(1u);
+    RMW_SET_ERROR_MSG("cannot publish data");
+    return RMW_RET_ERROR;
+  }
+  info->statistics_.add_published_messages(1u);
+
+  *serialized_message = rmw_get_zero_initialized_serialized_message();
+  return RMW_RET_OK;
+}
+
+}  // namespace rmw_fastrtps_shared_cpp
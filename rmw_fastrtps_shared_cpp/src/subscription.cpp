@@ -21,6 +21,7 @@
 
 #include "rmw_fastrtps_shared_cpp/custom_participant_info.hpp"
 #include "rmw_fastrtps_shared_cpp/custom_subscriber_info.hpp"
+#include "rmw_fastrtps_shared_cpp/intra_participant_delivery.hpp"
 #include "rmw_fastrtps_shared_cpp/namespace_prefix.hpp"
 #include "rmw_fastrtps_shared_cpp/qos.hpp"
 #include "rmw_fastrtps_shared_cpp/rmw_common.hpp"
@@ -28,6 +29,8 @@
 #include "rmw_fastrtps_shared_cpp/TypeSupport.hpp"
 #include "rmw_fastrtps_shared_cpp/utils.hpp"
 
+#include "types/custom_wait_set_info.hpp"
+
 namespace rmw_fastrtps_shared_cpp
 {
 rmw_ret_t
@@ -45,6 +48,11 @@ destroy_subscription(
     // Get RMW Subscriber
     auto info = static_cast<CustomSubscriberInfo *>(subscription->data);
 
+    // Stop being delivered messages by the publishers of the same participant
+    if (info->local_delivery_) {
+      info->local_delivery_->remove_subscription(info);
+    }
+
     // Keep pointer to topic, so we can remove it later
     auto topic = info->data_reader_->get_topicdescription();
 
@@ -58,6 +66,7 @@ destroy_subscription(
     }
 
     // Delete DataReader listener
+    internal::detach_listener_from_wait_sets(info->listener_);
     delete info->listener_;
 
     // Delete topic and unregister type
@@ -15,13 +15,103 @@
 #ifndef TYPES__CUSTOM_WAIT_SET_INFO_HPP_
 #define TYPES__CUSTOM_WAIT_SET_INFO_HPP_
 
-#include <condition_variable>
-#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "rmw/event.h"
+
+#include "rmw_fastrtps_shared_cpp/condition_listener.hpp"
+
+// Entity of a wait call, along with the listener notifying about it
+struct CustomWaitsetEntry
+{
+  enum class Kind
+  {
+    SUBSCRIPTION,
+    CLIENT,
+    SERVICE,
+    EVENT,
+    GUARD_CONDITION
+  };
+
+  ConditionListenerInterface * listener;
+  Kind kind;
+  size_t index;  // Position of the entity in the array of its kind
+};
 
 typedef struct CustomWaitsetInfo
 {
-  std::condition_variable condition;
-  std::mutex condition_mutex;
+  WaitSetCondition condition;
+
+  // Entities passed to the previous rmw_wait() call.
+  // Only accessed by rmw_wait(), which cannot be called concurrently on the same wait set.
+  std::vector<void *> subscriptions;
+  std::vector<void *> clients;
+  std::vector<void *> services;
+  std::vector<std::pair<void *, rmw_event_type_t>> events;
+  std::vector<void *> guard_conditions;
+
+  // Entities of the previous call, sorted by listener.
+  std::vector<CustomWaitsetEntry> entries;
+  // Listeners to check on the next call, as they were found ready by the previous one
+  // and may still be.
+  std::vector<ConditionListenerInterface *> ready_listeners;
+  // Slots of the output arrays to restore after clearing them, reused between calls.
+  std::vector<std::pair<void **, void *>> ready_slots;
+
+  // Listeners currently attached to this wait set, sorted by address.
+  // Guarded by the process wide attachments mutex (see rmw_wait_set.cpp).
+  std::vector<ConditionListenerInterface *> attached_listeners;
+
+  // Set whenever a listener is detached from this wait set outside of rmw_wait(), so the
+  // next call cannot rely on the entities of the previous one being still attached.
+  std::atomic_bool attachments_changed{false};
+
+  // Spin-then-block waiting (see wait_set_spin.hpp), disabled when max_spin is zero.
+  // The budget is the current spin interval, tuned by rmw_wait().
+  std::chrono::nanoseconds max_spin{0};
+  std::atomic<std::chrono::nanoseconds> spin_budget{std::chrono::nanoseconds(0)};
+  std::atomic<uint64_t> spin_hits{0};
+  std::atomic<uint64_t> spin_misses{0};
 } CustomWaitsetInfo;
 
+namespace rmw_fastrtps_shared_cpp
+{
+namespace internal
+{
+
+/// Make `listeners` the set of listeners attached to the condition of a wait set.
+/**
+ * Only the difference with the currently attached listeners is attached or detached.
+ * Listeners may be attached to other wait sets as well.
+ */
+void
+update_wait_set_attachments(
+  CustomWaitsetInfo * wait_set_info,
+  std::vector<ConditionListenerInterface *> & listeners);
+
+/// Detach every listener from the condition of a wait set that is about to be destroyed.
+void
+detach_wait_set_listeners(CustomWaitsetInfo * wait_set_info);
+
+/// Detach a listener from the wait sets it is attached to, if any, before destroying it.
+void
+detach_listener_from_wait_sets(ConditionListenerInterface * listener);
+
+/// Return the maximum spin interval of new wait sets, from the environment.
+std::chrono::nanoseconds
+default_wait_set_max_spin();
+
+/// Tune the spin interval of a wait set, given how long a wait took to find a ready entity.
+void
+update_wait_set_spin_budget(
+  CustomWaitsetInfo * wait_set_info,
+  std::chrono::nanoseconds elapsed);
+
+}  // namespace internal
+}  // namespace rmw_fastrtps_shared_cpp
+
 #endif  // TYPES__CUSTOM_WAIT_SET_INFO_HPP_
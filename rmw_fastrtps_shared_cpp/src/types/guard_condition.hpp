@@ -15,73 +15,122 @@
 #ifndef TYPES__GUARD_CONDITION_HPP_
 #define TYPES__GUARD_CONDITION_HPP_
 
+#include <algorithm>
 #include <array>
 #include <atomic>
 #include <cassert>
 #include <condition_variable>
+#include <cstdint>
 #include <mutex>
 #include <utility>
+#include <vector>
 
 #include "rcpputils/thread_safety_annotations.hpp"
 
-class GuardCondition
+#include "rmw_fastrtps_shared_cpp/condition_listener.hpp"
+
+/// Guard condition, triggered for every wait set it is attached to.
+/**
+ * The same guard condition may be waited for by several wait sets at once, e.g. when it
+ * interrupts several executors.
+ * A trigger wakes all of them up, and each of them consumes it on its own.
+ */
+class GuardCondition : public ConditionListenerInterface
 {
 public:
-  GuardCondition()
-  : hasTriggered_(false),
-    conditionMutex_(nullptr), conditionVariable_(nullptr) {}
+  GuardCondition() = default;
 
   void
   trigger()
   {
     std::lock_guard<std::mutex> lock(internalMutex_);
 
-    if (conditionMutex_ != nullptr) {
-      std::unique_lock<std::mutex> clock(*conditionMutex_);
-      // the change to hasTriggered_ needs to be mutually exclusive with
-      // rmw_wait() which checks hasTriggered() and decides if wait() needs to
-      // be called
-      hasTriggered_ = true;
-      clock.unlock();
-      conditionVariable_->notify_one();
-    } else {
-      hasTriggered_ = true;
-    }
+    // the change to triggerCount_ needs to be mutually exclusive with
+    // rmw_wait() which checks hasTriggered() and decides if wait() needs to
+    // be called
+    ConditionalScopedLock clock(conditions_, this, true);
+    triggerCount_.fetch_add(1u);
+    // Every trigger is new to the wait sets, whether they consumed the previous ones or not
+    clock.became_ready();
   }
 
   void
-  attachCondition(std::mutex * conditionMutex, std::condition_variable * conditionVariable)
+  attachCondition(WaitSetCondition * condition)
   {
     std::lock_guard<std::mutex> lock(internalMutex_);
-    conditionMutex_ = conditionMutex;
-    conditionVariable_ = conditionVariable;
+    {
+      // A trigger consumed by another wait set already is not seen by this one
+      std::lock_guard<std::mutex> triggers_lock(triggersMutex_);
+      triggers_.push_back({condition, consumedCount_});
+    }
+    conditions_.attach(condition, this);
   }
 
   void
-  detachCondition()
+  detachCondition(WaitSetCondition * condition)
   {
     std::lock_guard<std::mutex> lock(internalMutex_);
-    conditionMutex_ = nullptr;
-    conditionVariable_ = nullptr;
+    conditions_.detach(condition, this);
+    std::lock_guard<std::mutex> triggers_lock(triggersMutex_);
+    triggers_.erase(
+      std::remove_if(
+        triggers_.begin(), triggers_.end(),
+        [condition](const Trigger & trigger) {return trigger.condition == condition;}),
+      triggers_.end());
   }
 
+  /// Whether the guard condition was triggered since the wait set last consumed a trigger.
   bool
-  hasTriggered()
+  hasTriggered(const WaitSetCondition * condition)
   {
-    return hasTriggered_;
+    std::lock_guard<std::mutex> triggers_lock(triggersMutex_);
+    return triggerCount_.load() > *seen_count(condition);
   }
 
+  /// Same as hasTriggered(), consuming the trigger for the wait set only.
   bool
-  getHasTriggered()
+  getHasTriggered(const WaitSetCondition * condition)
   {
-    return hasTriggered_.exchange(false);
+    std::lock_guard<std::mutex> triggers_lock(triggersMutex_);
+    uint64_t * seen = seen_count(condition);
+    uint64_t count = triggerCount_.load();
+    if (count <= *seen) {
+      return false;
+    }
+    *seen = count;
+    consumedCount_ = std::max(consumedCount_, count);
+    return true;
   }
 
 private:
+  struct Trigger
+  {
+    const WaitSetCondition * condition;
+    // Trigger count the wait set last consumed
+    uint64_t seen_count;
+  };
+
+  // Return the trigger count the wait set last consumed, or the one consumed by any wait set
+  // if it is not attached
+  uint64_t *
+  seen_count(const WaitSetCondition * condition) RCPPUTILS_TSA_REQUIRES(triggersMutex_)
+  {
+    for (auto & trigger : triggers_) {
+      if (trigger.condition == condition) {
+        return &trigger.seen_count;
+      }
+    }
+    return &consumedCount_;
+  }
+
   std::mutex internalMutex_;
-  std::atomic_bool hasTriggered_;
-  std::mutex * conditionMutex_ RCPPUTILS_TSA_GUARDED_BY(internalMutex_);
-  std::condition_variable * conditionVariable_ RCPPUTILS_TSA_GUARDED_BY(internalMutex_);
+  std::atomic<uint64_t> triggerCount_{0u};
+  AttachedConditions conditions_ RCPPUTILS_TSA_GUARDED_BY(internalMutex_);
+
+  // Only ever locked last, as it is locked by rmw_wait() with the wait set condition locked
+  std::mutex triggersMutex_;
+  std::vector<Trigger> triggers_ RCPPUTILS_TSA_GUARDED_BY(triggersMutex_);
+  uint64_t consumedCount_ RCPPUTILS_TSA_GUARDED_BY(triggersMutex_) = 0u;
 };
 
 #endif  // TYPES__GUARD_CONDITION_HPP_
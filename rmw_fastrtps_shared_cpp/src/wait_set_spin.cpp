@@ -0,0 +1,143 @@
+// Copyright 2021 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#include "rcutils/env.h"
+#include "rcutils/logging_macros.h"
+
+#include "rmw/error_handling.h"
+#include "rmw/impl/cpp/macros.hpp"
+#include "rmw/rmw.h"
+
+#include "rmw_fastrtps_shared_cpp/wait_set_spin.hpp"
+
+#include "types/custom_wait_set_info.hpp"
+
+namespace rmw_fastrtps_shared_cpp
+{
+
+// Spinning longer than that would only burn a core, blocking is as good by then
+static constexpr std::chrono::nanoseconds kMaxWaitSetSpin = std::chrono::seconds(1);
+
+namespace internal
+{
+
+std::chrono::nanoseconds
+default_wait_set_max_spin()
+{
+  static const std::chrono::nanoseconds max_spin = []() {
+      const char * env_value;
+      const char * error_str = rcutils_get_env("RMW_FASTRTPS_WAIT_SPIN_US", &env_value);
+      if (error_str != NULL) {
+        RCUTILS_LOG_DEBUG_NAMED(
+          "rmw_fastrtps_shared_cpp", "Error getting env var: %s\n", error_str);
+        return std::chrono::nanoseconds(0);
+      }
+      if (env_value == nullptr || strcmp(env_value, "") == 0) {
+        return std::chrono::nanoseconds(0);
+      }
+      // strtoull() would accept leading blanks and signs, wrapping negative values around
+      char * end = nullptr;
+      errno = 0;
+      unsigned long long value = 0u;  // NOLINT(runtime/int)
+      if (isdigit(static_cast<unsigned char>(env_value[0]))) {
+        value = strtoull(env_value, &end, 10);
+      }
+      if (nullptr == end || *end != '\0') {
+        RCUTILS_LOG_WARN_NAMED(
+          "rmw_fastrtps_shared_cpp",
+          "Value %s unknown for environment variable RMW_FASTRTPS_WAIT_SPIN_US"
+          ". Spinning in rmw_wait() is disabled.", env_value);
+        return std::chrono::nanoseconds(0);
+      }
+      const auto max_us = std::chrono::duration_cast<std::chrono::microseconds>(kMaxWaitSetSpin);
+      if (ERANGE == errno || value > static_cast<uint64_t>(max_us.count())) {
+        RCUTILS_LOG_WARN_NAMED(
+          "rmw_fastrtps_shared_cpp",
+          "Value %s of environment variable RMW_FASTRTPS_WAIT_SPIN_US is too large"
+          ". Spinning in rmw_wait() is limited to %lld microseconds.",
+          env_value, static_cast<long long>(max_us.count()));  // NOLINT(runtime/int)
+        return kMaxWaitSetSpin;
+      }
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::microseconds(value));
+    }();
+  return max_spin;
+}
+
+void
+update_wait_set_spin_budget(
+  CustomWaitsetInfo * wait_set_info,
+  std::chrono::nanoseconds elapsed)
+{
+  // Keep spinning a little, so the budget can grow back when data arrives faster again
+  const auto min_budget = wait_set_info->max_spin / 16;
+  if (elapsed <= wait_set_info->max_spin) {
+    // Spinning about twice as long as it took this time would have been enough
+    wait_set_info->spin_budget.store(
+      std::min(std::max(2 * elapsed, min_budget), wait_set_info->max_spin));
+  } else {
+    wait_set_info->spin_budget.store(
+      std::max(wait_set_info->spin_budget.load() / 2, min_budget));
+  }
+}
+
+}  // namespace internal
+
+rmw_ret_t
+set_wait_set_max_spin(
+  const char * identifier,
+  rmw_wait_set_t * wait_set,
+  uint64_t max_spin_ns)
+{
+  RMW_CHECK_ARGUMENT_FOR_NULL(wait_set, RMW_RET_INVALID_ARGUMENT);
+  RMW_CHECK_TYPE_IDENTIFIERS_MATCH(
+    wait set handle,
+    wait_set->implementation_identifier, identifier,
+    return RMW_RET_INCORRECT_RMW_IMPLEMENTATION)
+
+  auto wait_set_info = static_cast<CustomWaitsetInfo *>(wait_set->data);
+  wait_set_info->max_spin = std::chrono::nanoseconds(
+    std::min<uint64_t>(max_spin_ns, static_cast<uint64_t>(kMaxWaitSetSpin.count())));
+  wait_set_info->spin_budget.store(wait_set_info->max_spin);
+  return RMW_RET_OK;
+}
+
+rmw_ret_t
+get_wait_set_spin_statistics(
+  const char * identifier,
+  const rmw_wait_set_t * wait_set,
+  WaitSetSpinStatistics * statistics)
+{
+  RMW_CHECK_ARGUMENT_FOR_NULL(wait_set, RMW_RET_INVALID_ARGUMENT);
+  RMW_CHECK_TYPE_IDENTIFIERS_MATCH(
+    wait set handle,
+    wait_set->implementation_identifier, identifier,
+    return RMW_RET_INCORRECT_RMW_IMPLEMENTATION)
+  RMW_CHECK_ARGUMENT_FOR_NULL(statistics, RMW_RET_INVALID_ARGUMENT);
+
+  auto wait_set_info = static_cast<const CustomWaitsetInfo *>(wait_set->data);
+  statistics->spin_hits = wait_set_info->spin_hits.load();
+  statistics->spin_misses = wait_set_info->spin_misses.load();
+  statistics->spin_budget_ns = static_cast<uint64_t>(wait_set_info->spin_budget.load().count());
+  return RMW_RET_OK;
+}
+}  // namespace rmw_fastrtps_shared_cpp
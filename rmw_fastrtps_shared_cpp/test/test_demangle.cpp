@@ -0,0 +1,95 @@
+// Copyright 2021 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "demangle.hpp"
+#include "demangle_cache.hpp"
+
+// More names than the demangle caches keep, so that names are evicted from them
+static constexpr size_t kNameCount = 40000u;
+
+static size_t demangle_count = 0u;
+
+static std::string
+counting_demangle(const std::string & name)
+{
+  ++demangle_count;
+  return "demangled_" + name;
+}
+
+TEST(DemangleTest, repeated_lookups_are_identical) {
+  for (size_t i = 0u; i < 3u; ++i) {
+    EXPECT_EQ("std_msgs/msg/String", _demangle_if_ros_type("std_msgs::msg::dds_::String_"));
+    EXPECT_EQ("not_a_ros_type", _demangle_if_ros_type("not_a_ros_type"));
+    EXPECT_EQ("/chatter", _demangle_if_ros_topic("rt/chatter"));
+    EXPECT_EQ("/chatter", _demangle_ros_topic_from_topic("rt/chatter"));
+    EXPECT_EQ("", _demangle_ros_topic_from_topic("rq/chatterRequest"));
+    EXPECT_EQ("/add", _demangle_service_request_from_topic("rq/addRequest"));
+    EXPECT_EQ("/add", _demangle_service_reply_from_topic("rr/addReply"));
+    EXPECT_EQ("/add", _demangle_service_from_topic("rr/addReply"));
+    EXPECT_EQ("", _demangle_service_reply_from_topic("rq/addRequest"));
+    EXPECT_EQ(
+      "example_interfaces/srv/AddTwoInts",
+      _demangle_service_type_only("example_interfaces::srv::dds_::AddTwoInts_Request_"));
+  }
+}
+
+TEST(DemangleTest, correct_past_cache_capacity) {
+  auto type_name = [](size_t i) {
+      return "pkg::msg::dds_::Type" + std::to_string(i) + "_";
+    };
+  auto demangled_type_name = [](size_t i) {
+      return "pkg/msg/Type" + std::to_string(i);
+    };
+  for (size_t i = 0u; i < kNameCount; ++i) {
+    ASSERT_EQ(demangled_type_name(i), _demangle_if_ros_type(type_name(i)));
+    ASSERT_EQ("/topic" + std::to_string(i), _demangle_if_ros_topic("rt/topic" + std::to_string(i)));
+  }
+  // Names evicted from the caches, and those still cached, are both right
+  for (size_t i = 0u; i < kNameCount; i += 97u) {
+    ASSERT_EQ(demangled_type_name(i), _demangle_if_ros_type(type_name(i)));
+    ASSERT_EQ(demangled_type_name(i), _demangle_if_ros_type(type_name(i)));
+  }
+  EXPECT_EQ("std_msgs/msg/String", _demangle_if_ros_type("std_msgs::msg::dds_::String_"));
+}
+
+TEST(DemangleTest, cache_keeps_names_in_use_past_capacity) {
+  constexpr size_t capacity = 100u;
+  constexpr size_t names_in_use = 10u;
+  DemangleCache cache(capacity);
+  demangle_count = 0u;
+  // Many more distinct names than the capacity go through the cache, while some are in use
+  for (size_t i = 0u; i < 10u * capacity; ++i) {
+    const std::string name = "once" + std::to_string(i);
+    ASSERT_EQ("demangled_" + name, cache.get(name, counting_demangle));
+    for (size_t j = 0u; j < names_in_use; ++j) {
+      const std::string name_in_use = "in_use" + std::to_string(j);
+      ASSERT_EQ("demangled_" + name_in_use, cache.get(name_in_use, counting_demangle));
+    }
+    ASSERT_LE(cache.size(), capacity);
+  }
+  // The names in use were only demangled the first time, and every other name once
+  EXPECT_EQ(10u * capacity + names_in_use, demangle_count);
+  EXPECT_EQ(capacity, cache.size());
+
+  // The least recently used names were evicted, and are demangled again
+  demangle_count = 0u;
+  EXPECT_EQ("demangled_once0", cache.get("once0", counting_demangle));
+  EXPECT_EQ(1u, demangle_count);
+  EXPECT_EQ("demangled_once0", cache.get("once0", counting_demangle));
+  EXPECT_EQ(1u, demangle_count);
+}
@@ -0,0 +1,85 @@
+// Copyright 2021 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifdef __linux__
+#include <poll.h>
+#endif
+
+#include "gtest/gtest.h"
+
+#include "rmw_fastrtps_shared_cpp/event_fd.hpp"
+
+using rmw_fastrtps_shared_cpp::EventFd;
+
+#ifdef __linux__
+static bool
+is_readable(int fd)
+{
+  struct pollfd pfd = {fd, POLLIN, 0};
+  return ::poll(&pfd, 1, 0) == 1 && (pfd.revents & POLLIN);
+}
+
+TEST(EventFdTest, disabled_by_default) {
+  EventFd event_fd;
+  EXPECT_EQ(-1, event_fd.get());
+  // Must not fail without an eventfd
+  event_fd.signal();
+}
+
+TEST(EventFdTest, signal_and_clear) {
+  EventFd event_fd;
+  ASSERT_TRUE(event_fd.enable());
+  int fd = event_fd.get();
+  ASSERT_GE(fd, 0);
+
+  // Enabling again keeps the same eventfd
+  ASSERT_TRUE(event_fd.enable());
+  EXPECT_EQ(fd, event_fd.get());
+
+  // A new eventfd starts readable
+  EXPECT_TRUE(is_readable(fd));
+  eventfd_t value = 0;
+  ASSERT_EQ(0, ::eventfd_read(fd, &value));
+  EXPECT_EQ(1u, value);
+  EXPECT_FALSE(is_readable(fd));
+
+  event_fd.signal();
+  event_fd.signal();
+  EXPECT_TRUE(is_readable(fd));
+  ASSERT_EQ(0, ::eventfd_read(fd, &value));
+  EXPECT_EQ(2u, value);
+  EXPECT_FALSE(is_readable(fd));
+
+  event_fd.signal();
+  event_fd.clear();
+  EXPECT_FALSE(is_readable(fd));
+  // Clearing twice does not block
+  event_fd.clear();
+  EXPECT_FALSE(is_readable(fd));
+}
+
+TEST(EventFdTest, starts_not_readable_on_request) {
+  EventFd event_fd;
+  ASSERT_TRUE(event_fd.enable(false));
+  EXPECT_FALSE(is_readable(event_fd.get()));
+  event_fd.signal();
+  EXPECT_TRUE(is_readable(event_fd.get()));
+}
+#else
+TEST(EventFdTest, unsupported) {
+  EventFd event_fd;
+  EXPECT_FALSE(event_fd.enable());
+  EXPECT_EQ(-1, event_fd.get());
+}
+#endif
@@ -0,0 +1,70 @@
+// Copyright 2021 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "gtest/gtest.h"
+
+#include "rmw_fastrtps_shared_cpp/graph_change_notifier.hpp"
+
+using rmw_fastrtps_shared_cpp::GraphChangeNotifier;
+using rmw_fastrtps_shared_cpp::TopicGraphWatcher;
+
+TEST(GraphChangeNotifierTest, topic_watchers_only_see_their_topics) {
+  GraphChangeNotifier notifier;
+  TopicGraphWatcher foo_watcher;
+  TopicGraphWatcher bar_watcher;
+  notifier.add_topic_watcher("rt/foo", &foo_watcher);
+  notifier.add_topic_watcher("rt/bar", &bar_watcher);
+
+  notifier.notify_topic("rt/foo");
+  EXPECT_EQ(1u, foo_watcher.get_changes());
+  EXPECT_EQ(0u, bar_watcher.get_changes());
+
+  notifier.notify_topic("rt/baz");
+  EXPECT_EQ(1u, foo_watcher.get_changes());
+  EXPECT_EQ(0u, bar_watcher.get_changes());
+
+  notifier.notify_all_topics();
+  EXPECT_EQ(2u, foo_watcher.get_changes());
+  EXPECT_EQ(1u, bar_watcher.get_changes());
+
+  notifier.remove_topic_watcher("rt/foo", &foo_watcher);
+  notifier.notify_topic("rt/foo");
+  EXPECT_EQ(2u, foo_watcher.get_changes());
+
+  notifier.remove_topic_watcher("rt/bar", &bar_watcher);
+}
+
+TEST(GraphChangeNotifierTest, watcher_on_several_topics) {
+  GraphChangeNotifier notifier;
+  TopicGraphWatcher watcher;
+  notifier.add_topic_watcher("rq/fooRequest", &watcher);
+  notifier.add_topic_watcher("rr/fooReply", &watcher);
+
+  notifier.notify_topic("rq/fooRequest");
+  notifier.notify_topic("rr/fooReply");
+  EXPECT_EQ(2u, watcher.get_changes());
+
+  notifier.remove_topic_watcher("rq/fooRequest", &watcher);
+  notifier.notify_topic("rq/fooRequest");
+  notifier.notify_topic("rr/fooReply");
+  EXPECT_EQ(3u, watcher.get_changes());
+
+  notifier.remove_topic_watcher("rr/fooReply", &watcher);
+}
+
+TEST(GraphChangeNotifierTest, remove_unknown_topic_guard_condition) {
+  GraphChangeNotifier notifier;
+  rmw_guard_condition_t guard_condition{};
+  EXPECT_FALSE(notifier.remove_topic_guard_condition("rt/foo", &guard_condition));
+}
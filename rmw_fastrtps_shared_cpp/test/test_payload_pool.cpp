@@ -0,0 +1,94 @@
+// Copyright 2021 Open Source Robotics Foundation, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstring>
+
+#include "gtest/gtest.h"
+
+#include "rmw_fastrtps_shared_cpp/payload_pool.hpp"
+
+using eprosima::fastrtps::rtps::CacheChange_t;
+using eprosima::fastrtps::rtps::IPayloadPool;
+using rmw_fastrtps_shared_cpp::PayloadPoolStatistics;
+using rmw_fastrtps_shared_cpp::SizeClassedPayloadPool;
+
+TEST(SizeClassedPayloadPoolTest, class_size) {
+  EXPECT_EQ(64u, SizeClassedPayloadPool::class_size(0u));
+  EXPECT_EQ(64u, SizeClassedPayloadPool::class_size(64u));
+  EXPECT_EQ(128u, SizeClassedPayloadPool::class_size(65u));
+  EXPECT_EQ(1024u * 1024u, SizeClassedPayloadPool::class_size(1000u * 1000u));
+  EXPECT_EQ(0x80000000u, SizeClassedPayloadPool::class_size(0x80000000u));
+}
+
+TEST(SizeClassedPayloadPoolTest, reuses_released_payloads) {
+  SizeClassedPayloadPool pool(0u);
+  CacheChange_t change;
+  ASSERT_TRUE(pool.get_payload(100u, change));
+  EXPECT_EQ(&pool, change.payload_owner());
+  EXPECT_EQ(128u, change.serializedPayload.max_size);
+  auto data = change.serializedPayload.data;
+  ASSERT_TRUE(pool.release_payload(change));
+  EXPECT_EQ(nullptr, change.serializedPayload.data);
+  EXPECT_EQ(nullptr, change.payload_owner());
+
+  // Same class, so the released payload is reused
+  ASSERT_TRUE(pool.get_payload(120u, change));
+  EXPECT_EQ(data, change.serializedPayload.data);
+  ASSERT_TRUE(pool.release_payload(change));
+
+  // Another class
+  ASSERT_TRUE(pool.get_payload(200u, change));
+  EXPECT_EQ(256u, change.serializedPayload.max_size);
+  ASSERT_TRUE(pool.release_payload(change));
+
+  PayloadPoolStatistics statistics = pool.get_statistics();
+  EXPECT_EQ(1u, statistics.hits);
+  EXPECT_EQ(2u, statistics.misses);
+  EXPECT_EQ(128u + 256u, statistics.allocated_bytes);
+}
+
+TEST(SizeClassedPayloadPoolTest, limits_free_payloads) {
+  SizeClassedPayloadPool pool(1u);
+  CacheChange_t first;
+  CacheChange_t second;
+  ASSERT_TRUE(pool.get_payload(10u, first));
+  ASSERT_TRUE(pool.get_payload(10u, second));
+  EXPECT_EQ(128u, pool.get_statistics().allocated_bytes);
+  ASSERT_TRUE(pool.release_payload(first));
+  ASSERT_TRUE(pool.release_payload(second));
+  // Only one free payload is kept
+  EXPECT_EQ(64u, pool.get_statistics().allocated_bytes);
+}
+
+TEST(SizeClassedPayloadPoolTest, copies_payloads_of_other_owners) {
+  SizeClassedPayloadPool pool(0u);
+  SizeClassedPayloadPool other_pool(0u);
+  CacheChange_t other_change;
+  ASSERT_TRUE(other_pool.get_payload(16u, other_change));
+  std::memcpy(other_change.serializedPayload.data, "0123456789abcdef", 16u);
+  other_change.serializedPayload.length = 16u;
+
+  CacheChange_t change;
+  IPayloadPool * owner = &other_pool;
+  ASSERT_TRUE(pool.get_payload(other_change.serializedPayload, owner, change));
+  EXPECT_EQ(&pool, change.payload_owner());
+  EXPECT_EQ(&other_pool, owner);
+  EXPECT_EQ(16u, change.serializedPayload.length);
+  EXPECT_EQ(0, std::memcmp(change.serializedPayload.data, "0123456789abcdef", 16u));
+
+  // Payloads of other pools are not taken back
+  EXPECT_FALSE(pool.release_payload(other_change));
+  ASSERT_TRUE(other_pool.release_payload(other_change));
+  ASSERT_TRUE(pool.release_payload(change));
+}